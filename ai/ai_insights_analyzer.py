@@ -6,6 +6,7 @@ with ML models in the future.
 from typing import List, Dict, Optional
 from datetime import datetime, timedelta
 from models.database import SensorReading
+from services.rule_engine import rule_engine
 
 
 class AIInsightsAnalyzer:
@@ -16,10 +17,8 @@ class AIInsightsAnalyzer:
     by implementing the same interface.
     """
     
-    # Analysis rules (can be replaced with ML model predictions)
-    TEMPERATURE_WARNING_THRESHOLD = 35.0  # Celsius
-    SOIL_MOISTURE_IRRIGATION_THRESHOLD = 30.0  # Percentage
-    BATTERY_MAINTENANCE_THRESHOLD = 20  # Percentage
+    # Analysis rules (can be replaced with ML model predictions); level
+    # thresholds are the named limits of the rule config
     STALE_DATA_THRESHOLD_SECONDS = 60  # Seconds
     
     @staticmethod
@@ -56,21 +55,23 @@ class AIInsightsAnalyzer:
         status = "normal"
         confidence = 1.0
         
-        # Rule 1: Temperature > 35 → ventilation warning
-        if latest_reading.temperature > AIInsightsAnalyzer.TEMPERATURE_WARNING_THRESHOLD:
+        # Rule 1: Temperature above critical_high → ventilation warning
+        temperature_high = rule_engine.limit("temperature", "critical_high")
+        if latest_reading.temperature > temperature_high:
             issues.append(
                 f"High temperature detected: {latest_reading.temperature:.1f}°C "
-                f"(threshold: {AIInsightsAnalyzer.TEMPERATURE_WARNING_THRESHOLD}°C)"
+                f"(threshold: {temperature_high}°C)"
             )
             recommendations.append("Increase ventilation immediately")
             recommendations.append("Activate cooling systems if available")
             status = "warning"
         
-        # Rule 2: Soil moisture < 30 → irrigation recommendation
-        if latest_reading.soil_moisture < AIInsightsAnalyzer.SOIL_MOISTURE_IRRIGATION_THRESHOLD:
+        # Rule 2: Soil moisture below dry → irrigation recommendation
+        soil_dry = rule_engine.limit("soil_moisture", "dry")
+        if latest_reading.soil_moisture < soil_dry:
             issues.append(
                 f"Low soil moisture detected: {latest_reading.soil_moisture:.1f}% "
-                f"(threshold: {AIInsightsAnalyzer.SOIL_MOISTURE_IRRIGATION_THRESHOLD}%)"
+                f"(threshold: {soil_dry}%)"
             )
             recommendations.append("Initiate irrigation system")
             recommendations.append("Check soil moisture sensors for accuracy")
@@ -79,12 +80,13 @@ class AIInsightsAnalyzer:
             else:
                 status = "critical"  # Multiple issues = critical
         
-        # Rule 3: Battery < 20 → maintenance warning
+        # Rule 3: Battery below maintenance → maintenance warning
         if latest_reading.battery_level is not None:
-            if latest_reading.battery_level < AIInsightsAnalyzer.BATTERY_MAINTENANCE_THRESHOLD:
+            battery_maintenance = rule_engine.limit("battery_level", "maintenance")
+            if latest_reading.battery_level < battery_maintenance:
                 issues.append(
                     f"Low battery level: {latest_reading.battery_level}% "
-                    f"(threshold: {AIInsightsAnalyzer.BATTERY_MAINTENANCE_THRESHOLD}%)"
+                    f"(threshold: {battery_maintenance:.0f}%)"
                 )
                 recommendations.append("Schedule sensor maintenance and battery replacement")
                 if status == "normal":
@@ -3,51 +3,44 @@ from typing import List, Dict
 from datetime import datetime
 from models.schemas import InsightItem
 from models.database import SensorReading
-
-
-# Optimal ranges for greenhouse conditions
-OPTIMAL_TEMPERATURE_MIN = 18.0  # Celsius
-OPTIMAL_TEMPERATURE_MAX = 28.0  # Celsius
-CRITICAL_TEMPERATURE_MIN = 10.0  # Celsius
-CRITICAL_TEMPERATURE_MAX = 35.0  # Celsius
-
-OPTIMAL_SOIL_MOISTURE_MIN = 40.0  # Percentage
-CRITICAL_SOIL_MOISTURE_MIN = 20.0  # Percentage
-
-OPTIMAL_HUMIDITY_MIN = 40.0  # Percentage
-OPTIMAL_HUMIDITY_MAX = 70.0  # Percentage
+from services.rule_engine import rule_engine
 
 
 class SensorAnalyzer:
-    """Analyzes sensor data and generates insights."""
+    """Analyzes sensor data and generates insights.
+
+    Optimal and critical ranges are the named limits of the rule config
+    (see services/rule_engine.py).
+    """
 
     @staticmethod
     def analyze_temperature(temperature: float, sensor_id: str) -> List[InsightItem]:
         """Analyze temperature and return insights if abnormal."""
         insights = []
+        limits = rule_engine.limits["temperature"]
 
-        if temperature < CRITICAL_TEMPERATURE_MIN:
+        if temperature < limits["critical_low"]:
             insights.append(InsightItem(
                 type="warning",
                 message=f"Critical: Temperature is dangerously low ({temperature:.1f}°C) at sensor {sensor_id}",
                 severity="high",
                 recommendation="Immediately check heating system and consider emergency heating measures"
             ))
-        elif temperature < OPTIMAL_TEMPERATURE_MIN:
+        elif temperature < limits["optimal_min"]:
             insights.append(InsightItem(
                 type="warning",
                 message=f"Temperature is below optimal range ({temperature:.1f}°C) at sensor {sensor_id}",
                 severity="medium",
                 recommendation="Increase heating or reduce ventilation to maintain optimal growing conditions"
             ))
-        elif temperature > CRITICAL_TEMPERATURE_MAX:
+        elif temperature > limits["critical_high"]:
             insights.append(InsightItem(
                 type="warning",
                 message=f"Critical: Temperature is dangerously high ({temperature:.1f}°C) at sensor {sensor_id}",
                 severity="high",
                 recommendation="Immediately increase ventilation, activate cooling systems, or provide shade"
             ))
-        elif temperature > OPTIMAL_TEMPERATURE_MAX:
+        elif temperature > limits["optimal_max"]:
             insights.append(InsightItem(
                 type="warning",
                 message=f"Temperature is above optimal range ({temperature:.1f}°C) at sensor {sensor_id}",
@@ -61,15 +54,16 @@ class SensorAnalyzer:
     def analyze_soil_moisture(soil_moisture: float, sensor_id: str) -> List[InsightItem]:
         """Analyze soil moisture and return insights if low."""
         insights = []
+        limits = rule_engine.limits["soil_moisture"]
 
-        if soil_moisture < CRITICAL_SOIL_MOISTURE_MIN:
+        if soil_moisture < limits["critical_low"]:
             insights.append(InsightItem(
                 type="warning",
                 message=f"Critical: Soil moisture is critically low ({soil_moisture:.1f}%) at sensor {sensor_id}",
                 severity="high",
                 recommendation="Water the plants immediately to prevent wilting and plant stress"
             ))
-        elif soil_moisture < OPTIMAL_SOIL_MOISTURE_MIN:
+        elif soil_moisture < limits["optimal_min"]:
             insights.append(InsightItem(
                 type="warning",
                 message=f"Soil moisture is below optimal range ({soil_moisture:.1f}%) at sensor {sensor_id}",
@@ -83,15 +77,16 @@ class SensorAnalyzer:
     def analyze_humidity(humidity: float, sensor_id: str) -> List[InsightItem]:
         """Analyze humidity and return insights if abnormal."""
         insights = []
+        limits = rule_engine.limits["humidity"]
 
-        if humidity < OPTIMAL_HUMIDITY_MIN:
+        if humidity < limits["optimal_min"]:
             insights.append(InsightItem(
                 type="info",
                 message=f"Humidity is below optimal range ({humidity:.1f}%) at sensor {sensor_id}",
                 severity="low",
                 recommendation="Consider increasing humidity through misting or water trays"
             ))
-        elif humidity > OPTIMAL_HUMIDITY_MAX:
+        elif humidity > limits["optimal_max"]:
             insights.append(InsightItem(
                 type="info",
                 message=f"Humidity is above optimal range ({humidity:.1f}%) at sensor {sensor_id}",
@@ -109,17 +104,17 @@ class SensorAnalyzer:
         for reading in readings:
             # Analyze temperature
             all_insights.extend(
-                SensorAnalyzer.analyze_temperature(reading.temperature, reading.sensor_id)
+                SensorAnalyzer.analyze_temperature(reading.temperature, reading.node_id)
             )
 
             # Analyze soil moisture
             all_insights.extend(
-                SensorAnalyzer.analyze_soil_moisture(reading.soil_moisture, reading.sensor_id)
+                SensorAnalyzer.analyze_soil_moisture(reading.soil_moisture, reading.node_id)
             )
 
             # Analyze humidity
             all_insights.extend(
-                SensorAnalyzer.analyze_humidity(reading.humidity, reading.sensor_id)
+                SensorAnalyzer.analyze_humidity(reading.humidity, reading.node_id)
             )
 
         # If no issues found, provide positive feedback
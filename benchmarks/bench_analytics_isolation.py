@@ -0,0 +1,145 @@
+"""Benchmark: ingest commit latency and analytics latency when both run at once.
+
+Copies a database built by benchmarks/generate_dataset.py, then, in a child
+process per mode, runs:
+- a writer thread storing readings through SensorService.create_reading at
+  --rate readings/s (the ingest path's insert + commit)
+- a reader running the 7-day AIInsightsService.analyze_node scan back to back
+  through run_analytics (services/analytics.py)
+
+Modes: rollback journal (SQLITE_WAL=false), WAL with analytics threads, and WAL
+with one analytics worker process (ANALYTICS_PROCESSES=1).
+
+Each mode runs three phases: writer alone, reader alone, and both together.
+Reports p50/p99/max write latency, "database is locked" failures and the
+median analysis time per phase.
+
+Usage (from the repository root):
+    python benchmarks/generate_dataset.py --db /tmp/greenhouse-1m.db --rows 1000000
+    python benchmarks/bench_analytics_isolation.py /tmp/greenhouse-1m.db [--seconds 10] [--rate 100]
+"""
+import argparse
+import asyncio
+import json
+import os
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+
+def _percentile(values, q):
+    if not values:
+        return float("nan")
+    ordered = sorted(values)
+    return ordered[min(len(ordered) - 1, int(q * len(ordered)))]
+
+
+def child(args):
+    """Run the phases against DATABASE_URL (set by the parent) and print JSON."""
+    from sqlalchemy.exc import OperationalError
+    from models.database import SessionLocal, SensorNode, init_db
+    from models.ingest import IngestReading
+    from services.ai_insights import AIInsightsService
+    from services.analytics import run_analytics, start_analytics, stop_analytics
+    from services.sensor_service import SensorService
+
+    init_db()
+    db = SessionLocal()
+    node_id, gateway_id = db.query(SensorNode.node_id, SensorNode.gateway_id).order_by(SensorNode.id).first()
+    db.close()
+
+    def writer(stop, out):
+        session = SessionLocal()
+        interval = 1.0 / args.rate
+        next_at = time.perf_counter()
+        while not stop.is_set():
+            reading = IngestReading(
+                node_id=node_id, gateway_id=gateway_id, temperature=21.5, humidity=60.0, soil_moisture=40.0
+            )
+            started = time.perf_counter()
+            try:
+                SensorService.create_reading(session, reading)
+                out["latencies"].append((time.perf_counter() - started) * 1000.0)
+            except OperationalError:
+                session.rollback()
+                out["locked"] += 1
+            next_at += interval
+            time.sleep(max(0.0, next_at - time.perf_counter()))
+        session.close()
+
+    def reader(stop, out):
+        async def analyze_until_stopped():
+            while not stop.is_set():
+                started = time.perf_counter()
+                await run_analytics(AIInsightsService.analyze_node, node_id)
+                out["latencies"].append((time.perf_counter() - started) * 1000.0)
+
+        asyncio.run(analyze_until_stopped())
+
+    asyncio.run(start_analytics())
+
+    results = {}
+    for phase, workers in (("write only", (writer,)), ("analytics only", (reader,)), ("both", (writer, reader))):
+        stop = threading.Event()
+        outputs = {worker.__name__: {"latencies": [], "locked": 0} for worker in workers}
+        threads = [threading.Thread(target=worker, args=(stop, outputs[worker.__name__])) for worker in workers]
+        for thread in threads:
+            thread.start()
+        time.sleep(args.seconds)
+        stop.set()
+        for thread in threads:
+            thread.join()
+        results[phase] = outputs
+    stop_analytics()
+    print(json.dumps(results))
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("database", help="SQLite file built by generate_dataset.py (not modified)")
+    parser.add_argument("--seconds", type=float, default=10.0, help="Length of each phase")
+    parser.add_argument("--rate", type=float, default=100.0, help="Readings written per second")
+    parser.add_argument("--child", action="store_true", help=argparse.SUPPRESS)
+    args = parser.parse_args()
+    if args.child:
+        child(args)
+        return
+    if not os.path.exists(args.database):
+        sys.exit(f"{args.database} does not exist (build it with benchmarks/generate_dataset.py)")
+
+    print(f"{'mode':<10} {'phase':<16} {'writes':>7} {'p50 ms':>8} {'p99 ms':>8} {'max ms':>8} {'locked':>7} "
+          f"{'analyses':>9} {'median ms':>10}")
+    for mode, wal, processes in (("rollback", "false", "0"), ("wal", "true", "0"), ("wal+proc", "true", "1")):
+        workdir = tempfile.mkdtemp(prefix="bench-analytics-")
+        try:
+            path = os.path.join(workdir, "greenhouse.db")
+            shutil.copyfile(args.database, path)
+            env = dict(os.environ, DATABASE_URL=f"sqlite:///{path}", SQLITE_WAL=wal, ANALYTICS_PROCESSES=processes)
+            env.pop("ANALYTICS_DATABASE_URL", None)
+            output = subprocess.run(
+                [sys.executable, os.path.abspath(__file__), args.database, "--child",
+                 "--seconds", str(args.seconds), "--rate", str(args.rate)],
+                env=env, check=True, capture_output=True, text=True
+            ).stdout
+        finally:
+            shutil.rmtree(workdir)
+        results = json.loads(output.strip().splitlines()[-1])
+        for phase, outputs in results.items():
+            writes = outputs.get("writer", {"latencies": [], "locked": 0})
+            reads = outputs.get("reader", {"latencies": []})["latencies"]
+            w = writes["latencies"]
+            print(
+                f"{mode:<10} {phase:<16} {len(w):>7} {_percentile(w, 0.5):>8.1f} {_percentile(w, 0.99):>8.1f} "
+                f"{max(w) if w else float('nan'):>8.1f} {writes['locked']:>7} {len(reads):>9} "
+                f"{statistics.median(reads) if reads else float('nan'):>10.1f}"
+            )
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,112 @@
+"""Benchmark: service-level read paths against large synthetic histories.
+
+Runs SensorService.get_history, TrendInsightService.analyze_trends,
+AIInsightsService.analyze_node and get_system_stats against one or more
+databases built by benchmarks/generate_dataset.py and reports timings per
+table size.
+
+The time-relative services (analyze_trends, analyze_node, get_system_stats)
+look back from the current time, so generate the datasets with the default
+--end (the current time) when benchmarking them.
+
+Usage (from the repository root):
+    python benchmarks/generate_dataset.py --db /tmp/greenhouse-1m.db --rows 1000000
+    python benchmarks/generate_dataset.py --db /tmp/greenhouse-10m.db --rows 10000000
+    python benchmarks/bench_history_queries.py /tmp/greenhouse-1m.db /tmp/greenhouse-10m.db \\
+        [--repeat 5] [--json results.json]
+"""
+import argparse
+import json
+import os
+import statistics
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from sqlalchemy import create_engine, func  # noqa: E402
+from sqlalchemy.orm import sessionmaker  # noqa: E402
+from models.database import SensorReading  # noqa: E402
+from services.sensor_service import SensorService  # noqa: E402
+from services.trend_insights_service import TrendInsightService  # noqa: E402
+from services.ai_insights import AIInsightsService  # noqa: E402
+from services.system_stats import get_system_stats  # noqa: E402
+
+
+def _size(result) -> int:
+    if isinstance(result, list):
+        return len(result)
+    if isinstance(result, dict):
+        return result.get("readings_analyzed", len(result))
+    return 0
+
+
+def bench_database(path: str, repeat: int) -> dict:
+    engine = create_engine(f"sqlite:///{path}")
+    Session = sessionmaker(bind=engine)
+    db = Session()
+    try:
+        rows = db.query(func.count(SensorReading.id)).scalar()
+        newest = db.query(func.max(SensorReading.timestamp)).scalar()
+        node_id = db.query(SensorReading).order_by(SensorReading.id.desc()).first().node_id
+
+        cases = [
+            ("get_history node 24h", lambda: SensorService.get_history(db, hours=24, node_id=node_id, now=newest)),
+            ("get_history node 7d", lambda: SensorService.get_history(db, hours=168, node_id=node_id, now=newest)),
+            ("get_history fleet 1h", lambda: SensorService.get_history(db, hours=1, now=newest)),
+            ("analyze_trends node 60m", lambda: TrendInsightService.analyze_trends(db, node_id=node_id, minutes=60)),
+            ("analyze_trends fleet 60m", lambda: TrendInsightService.analyze_trends(db, minutes=60)),
+            ("analyze_node", lambda: AIInsightsService.analyze_node(db, node_id)),
+            ("get_system_stats", lambda: get_system_stats(db)),
+        ]
+
+        results = {}
+        for name, run in cases:
+            # Warm-up run (page cache, statement cache); not measured
+            result = run()
+            db.expunge_all()
+            timings = []
+            for _ in range(repeat):
+                start = time.perf_counter()
+                result = run()
+                timings.append((time.perf_counter() - start) * 1000.0)
+                db.expunge_all()
+            results[name] = {
+                "rows_returned": _size(result),
+                "min_ms": round(min(timings), 2),
+                "median_ms": round(statistics.median(timings), 2),
+                "max_ms": round(max(timings), 2),
+            }
+        return {"database": path, "rows": rows, "node_id": node_id, "results": results}
+    finally:
+        db.close()
+        engine.dispose()
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("databases", nargs="+", help="SQLite files built by generate_dataset.py")
+    parser.add_argument("--repeat", type=int, default=5, help="Measured runs per case")
+    parser.add_argument("--json", help="Also write the results to this JSON file")
+    args = parser.parse_args()
+
+    reports = []
+    for path in args.databases:
+        if not os.path.exists(path):
+            sys.exit(f"{path} does not exist (build it with benchmarks/generate_dataset.py)")
+        report = bench_database(path, args.repeat)
+        reports.append(report)
+
+        print(f"\n{path}: {report['rows']:,} rows (node {report['node_id']})")
+        print(f"{'case':<28} {'rows':>9} {'min ms':>10} {'median ms':>10} {'max ms':>10}")
+        for name, r in report["results"].items():
+            print(f"{name:<28} {r['rows_returned']:>9} {r['min_ms']:>10.2f} {r['median_ms']:>10.2f} {r['max_ms']:>10.2f}")
+
+    if args.json:
+        with open(args.json, "w") as f:
+            json.dump(reports, f, indent=2)
+            f.write("\n")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,81 @@
+"""Benchmark: insight reads from the insights table against on-request analysis.
+
+For each window, precomputes the fleet trend insight and one node's insights
+with the scheduler's job (services/insight_scheduler.compute_insight). Then it
+times reading the stored rows against running the analysis as the routes did
+before. Both run on a copy of a database built by benchmarks/generate_dataset.py.
+
+Usage (from the repository root):
+    python benchmarks/generate_dataset.py --db /tmp/greenhouse-1m.db --rows 1000000
+    python benchmarks/bench_insight_latency.py /tmp/greenhouse-1m.db [--windows 60,360,1440]
+"""
+import argparse
+import os
+import shutil
+import statistics
+import sys
+import tempfile
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+
+def _median_ms(func, repeat: int) -> float:
+    times = []
+    for _ in range(repeat):
+        started = time.perf_counter()
+        func()
+        times.append((time.perf_counter() - started) * 1000.0)
+    return statistics.median(times)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("database", help="SQLite file built by generate_dataset.py (not modified)")
+    parser.add_argument("--windows", default="60,360,1440", help="Trend windows in minutes")
+    parser.add_argument("--repeat", type=int, default=5, help="Timed runs per measurement")
+    args = parser.parse_args()
+    if not os.path.exists(args.database):
+        sys.exit(f"{args.database} does not exist (build it with benchmarks/generate_dataset.py)")
+
+    workdir = tempfile.mkdtemp(prefix="bench-insights-")
+    path = os.path.join(workdir, "greenhouse.db")
+    shutil.copyfile(args.database, path)
+    os.environ["DATABASE_URL"] = f"sqlite:///{path}"
+    try:
+        from models.database import AnalyticsSessionLocal, SessionLocal, SensorNode, init_db
+        from services.ai_insights import AIInsightsService
+        from services.insight_scheduler import FLEET_SCOPE, NODE_KIND, TREND_KIND, InsightService, compute_insight
+        from services.trend_insights_service import TrendInsightService
+
+        init_db()
+        db = SessionLocal()
+        node_count = db.query(SensorNode).count()
+        node_id = db.query(SensorNode.node_id).order_by(SensorNode.id).first()[0]
+        snapshot = AnalyticsSessionLocal()
+
+        def read_stored(key):
+            db.expunge_all()  # Query the row each time, as a request does
+            return InsightService.get(db, *key).result
+
+        print(f"{node_count} nodes, node {node_id}")
+        print(f"{'insight':<32} {'on request ms':>14} {'stored ms':>10}")
+        cases = [(f"node {node_id} (24 h / 7 d)", (node_id, NODE_KIND, 0),
+                  lambda: AIInsightsService.analyze_node(snapshot, node_id))]
+        for minutes in (int(m) for m in args.windows.split(",")):
+            cases.append((f"fleet trend {minutes} min", (FLEET_SCOPE, TREND_KIND, minutes),
+                          lambda minutes=minutes: TrendInsightService.analyze_trends(snapshot, None, minutes)))
+            cases.append((f"node trend {minutes} min", (node_id, TREND_KIND, minutes),
+                          lambda minutes=minutes: TrendInsightService.analyze_trends(snapshot, node_id, minutes)))
+        for label, key, analyze in cases:
+            InsightService.save(key, *compute_insight(snapshot, *key)[:3])
+            print(f"{label:<32} {_median_ms(analyze, args.repeat):>14.1f} "
+                  f"{_median_ms(lambda: read_stored(key), args.repeat):>10.2f}")
+        snapshot.close()
+        db.close()
+    finally:
+        shutil.rmtree(workdir)
+
+
+if __name__ == "__main__":
+    main()
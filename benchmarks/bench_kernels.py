@@ -0,0 +1,198 @@
+"""Parity check and benchmark of the native numeric kernels (services/kernels.py).
+
+1. Parity: the native kernels (greenhouse_kernels, built from native/) against
+   the Python versions on random windows: lists and array('d'/'f'/'h'/'i'/'q')
+   buffers, sizes 1..100k. median_mad must match exactly. mean and summary must
+   agree to 1e-9 relative. Exits with status 1 on any mismatch.
+2. Micro-benchmarks per kernel and window size: the code they replaced
+   (statistics.mean/stdev, sum()/len(), sorted()), the Python fallback and the
+   native kernel.
+3. With --db, end-to-end analyze_node / analyze_trends / anomaly replay times
+   with NATIVE_KERNELS on and off, on a copy of a generate_dataset.py database.
+
+Usage (from the repository root):
+    pip install ./native        # or: python native/setup.py build_ext --inplace && export PYTHONPATH=native
+    python benchmarks/bench_kernels.py [--db /tmp/greenhouse-1m.db]
+"""
+import argparse
+import json
+import os
+import random
+import shutil
+import statistics
+import subprocess
+import sys
+import tempfile
+import timeit
+from array import array
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, ROOT)
+
+from services import kernels  # noqa: E402
+
+
+def _close(a: float, b: float) -> bool:
+    return abs(a - b) <= 1e-9 * max(1.0, abs(a), abs(b))
+
+
+def check_parity(native) -> int:
+    rng = random.Random(7)
+    failures = 0
+    for size in (1, 2, 3, 5, 31, 60, 257, 4095, 4096, 10_000, 100_000):
+        centi = [rng.randint(-5000, 10000) for _ in range(size)]
+        floats = [c / 100 for c in centi]
+        inputs = [
+            ("list", floats, floats),
+            ("array d", array("d", floats), floats),
+            ("array f", array("f", floats), list(array("f", floats))),
+            ("array h", array("h", centi), centi),
+            ("array i", array("i", centi), centi),
+            ("array q", array("q", centi), centi),
+        ]
+        for label, values, reference in inputs:
+            expected = kernels.py_summary(reference)
+            got = native.summary(values)
+            if got is None or got[0] != expected.count or not all(_close(g, e) for g, e in zip(got[1:], expected[1:])):
+                print(f"summary mismatch ({label}, n={size}): {got} != {tuple(expected)}")
+                failures += 1
+            if not _close(native.mean(values), kernels.py_mean(reference)):
+                print(f"mean mismatch ({label}, n={size})")
+                failures += 1
+        ring = array("h", centi)
+        for start, count in ((0, size), (size // 3, size - size // 3)):
+            if count and native.median_mad(ring, start, count) != kernels.py_median_mad(ring, start, count):
+                print(f"median_mad mismatch (n={size}, start={start})")
+                failures += 1
+            if count and native.median_mad(centi, start, count) != kernels.py_median_mad(centi, start, count):
+                print(f"median_mad mismatch on a list (n={size}, start={start})")
+                failures += 1
+    if native.summary([]) is not None or native.mean(array("d")) is not None:
+        print("empty input must give None")
+        failures += 1
+    return failures
+
+
+def _time_us(func, number: int) -> float:
+    return min(timeit.repeat(func, number=number, repeat=5)) / number * 1e6
+
+
+def micro_benchmarks(native):
+    rng = random.Random(11)
+    print(f"\n{'kernel':<12} {'n':>7} {'before µs':>11} {'python µs':>11} {'native µs':>11} {'speedup':>8}")
+    for size in (60, 1440, 10_080):
+        values = [rng.randint(1500, 3500) / 100 for _ in range(size)]
+        number = max(3, 200_000 // size)
+
+        def old_summary():
+            statistics.mean(values), statistics.stdev(values), min(values), max(values)
+
+        rows = [
+            ("summary", old_summary, lambda: kernels.py_summary(values), lambda: native.summary(values)),
+            ("mean", lambda: sum(values) / len(values), lambda: kernels.py_mean(values), lambda: native.mean(values)),
+        ]
+        for name, before, python, fast in rows:
+            b, p, f = (_time_us(func, number) for func in (before, python, fast))
+            print(f"{name:<12} {size:>7} {b:>11.1f} {p:>11.1f} {f:>11.2f} {b / f:>7.0f}x")
+
+    for window in (31, 60, 240):
+        ring = array("h", (rng.randint(2000, 2600) for _ in range(window * 3)))
+        start = window
+
+        def old_median_mad():
+            recent = sorted(ring[start:start + window])
+            median = recent[window // 2]
+            sorted([abs(v - median) for v in recent])[window // 2]
+
+        b, p, f = (_time_us(func, 20_000) for func in (
+            old_median_mad, lambda: kernels.py_median_mad(ring, start, window), lambda: native.median_mad(ring, start, window)
+        ))
+        print(f"{'median_mad':<12} {window:>7} {b:>11.1f} {p:>11.1f} {f:>11.2f} {b / f:>7.0f}x")
+
+
+def child(db_path: str):
+    """End-to-end timings in this process (NATIVE_KERNELS set by the parent); prints JSON."""
+    import time
+    from models.database import AnalyticsSessionLocal, SessionLocal, SensorNode, SensorReading, init_db
+    from services.ai_insights import AIInsightsService
+    from services.anomaly_detector import AnomalyDetector
+    from services.trend_insights_service import TrendInsightService
+
+    init_db()
+    db = SessionLocal()
+    node_id = db.query(SensorNode.node_id).order_by(SensorNode.id).first()[0]
+    rows = db.query(SensorReading.timestamp, SensorReading.temperature, SensorReading.humidity,
+                    SensorReading.soil_moisture).filter(SensorReading.node_id == node_id).order_by(SensorReading.timestamp).all()
+    db.close()
+    snapshot = AnalyticsSessionLocal()
+
+    def best_ms(func, repeat=3):
+        times = []
+        for _ in range(repeat):
+            started = time.perf_counter()
+            func()
+            times.append((time.perf_counter() - started) * 1000.0)
+        return min(times)
+
+    def replay():
+        AnomalyDetector().bootstrap(node_id, rows)
+
+    readings = TrendInsightService.get_recent_readings(snapshot, None, 1440)
+    results = {
+        "kernels": kernels.implementation(),
+        f"analyze_node ({node_id})": best_ms(lambda: AIInsightsService.analyze_node(snapshot, node_id)),
+        "trend detectors, fleet 24 h (no query)": best_ms(lambda: [
+            TrendInsightService.detect_overwatering_risk(readings),
+            TrendInsightService.detect_temperature_stress(readings),
+            TrendInsightService.detect_sensor_failure(readings),
+        ]),
+        f"anomaly replay ({len(rows)} readings)": best_ms(replay, repeat=1),
+    }
+    snapshot.close()
+    print(json.dumps(results))
+
+
+def end_to_end(db_path: str):
+    workdir = tempfile.mkdtemp(prefix="bench-kernels-")
+    try:
+        path = os.path.join(workdir, "greenhouse.db")
+        shutil.copyfile(db_path, path)
+        results = {}
+        for native in ("false", "true"):
+            env = dict(os.environ, DATABASE_URL=f"sqlite:///{path}", NATIVE_KERNELS=native)
+            output = subprocess.run(
+                [sys.executable, os.path.abspath(__file__), "--child", path],
+                env=env, check=True, capture_output=True, text=True
+            ).stdout
+            results[native] = json.loads(output.strip().splitlines()[-1])
+    finally:
+        shutil.rmtree(workdir)
+    python, native = results["false"], results["true"]
+    print(f"\n{'end to end':<44} {python.pop('kernels') + ' ms':>10} {native.pop('kernels') + ' ms':>10}")
+    for name in python:
+        print(f"{name:<44} {python[name]:>10.1f} {native[name]:>10.1f}")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--db", help="SQLite file built by generate_dataset.py for end-to-end timings (not modified)")
+    parser.add_argument("--child", metavar="DB", help=argparse.SUPPRESS)
+    args = parser.parse_args()
+    if args.child:
+        child(args.child)
+        return
+    try:
+        import greenhouse_kernels as native
+    except ImportError:
+        sys.exit("greenhouse_kernels is not installed (pip install ./native)")
+
+    failures = check_parity(native)
+    print(f"parity: {'OK' if not failures else f'{failures} mismatch(es)'}")
+    micro_benchmarks(native)
+    if args.db:
+        end_to_end(args.db)
+    sys.exit(1 if failures else 0)
+
+
+if __name__ == "__main__":
+    main()
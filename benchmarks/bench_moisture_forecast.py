@@ -0,0 +1,118 @@
+"""Benchmark: soil-moisture depletion forecast accuracy and throughput.
+
+Feeds synthetic node series (the same signal model as generate_dataset.py: soil
+dries faster in daylight and is irrigated back up at a per-node threshold)
+through services/moisture_forecast.py. Every hour after the first day, each
+node's forecast for "hours until its irrigation threshold" is compared with when
+the simulated irrigation actually happened.
+
+Reports the median and 90th percentile absolute ETA error per forecast horizon,
+next to a naive baseline (current level / current drying rate, no hour-of-day
+profile), plus readings per second.
+
+Usage (from the repository root):
+    python benchmarks/bench_moisture_forecast.py [--nodes 100] [--days 5]
+"""
+import argparse
+import os
+import random
+import sys
+import time
+import types
+from datetime import datetime, timedelta
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+
+from generate_dataset import NodeModel  # noqa: E402
+from services import moisture_forecast  # noqa: E402
+from services.moisture_forecast import MoistureForecaster  # noqa: E402
+
+HORIZONS = ((0, 6), (6, 12), (12, 24), (24, 72))
+
+
+def percentile(values, q):
+    values = sorted(values)
+    return values[min(len(values) - 1, int(q * len(values)))] if values else float("nan")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--nodes", type=int, default=100)
+    parser.add_argument("--days", type=int, default=5)
+    parser.add_argument("--interval", type=int, default=60, help="Seconds between readings of a node")
+    parser.add_argument("--seed", type=int, default=1)
+    args = parser.parse_args()
+
+    model_args = types.SimpleNamespace(stuck_rate=0.0, stuck_fraction=0.0, gap_rate=0.0002)
+    rng = random.Random(args.seed)
+    nodes = [
+        NodeModel(f"node-{i:03d}", "gateway-01", random.Random(rng.random()), model_args)
+        for i in range(args.nodes)
+    ]
+    forecaster = MoistureForecaster()
+    start = datetime(2026, 1, 1)
+    epoch = datetime(1970, 1, 1)
+    start_ts = int((start - epoch).total_seconds())
+    steps = args.days * 86400 // args.interval
+    per_hour = 3600 // args.interval
+
+    pending = []  # (node index, forecast time, predicted hours, naive hours)
+    irrigated_at = [[] for _ in nodes]
+    readings = 0
+    elapsed = 0.0
+    for step in range(steps):
+        ts = start_ts + step * args.interval
+        when = epoch + timedelta(seconds=ts)
+        for j, node in enumerate(nodes):
+            before = node.moisture
+            row = node.reading(ts, args.interval)
+            if node.moisture > before + 5:
+                irrigated_at[j].append(ts)
+            if row is None:
+                continue
+            began = time.perf_counter()
+            forecaster.update(node.node_id, node.gateway_id, row[4], when)
+            elapsed += time.perf_counter() - began
+            readings += 1
+
+        if step >= 86400 // args.interval and step % per_hour == 0:
+            for j, node in enumerate(nodes):
+                state = forecaster._states.get(node.node_id)
+                if state is None or not state.fitted or ts - state.last_ts > 600:
+                    continue
+                predicted = moisture_forecast._hours_until(state, node.moisture_threshold, ts)
+                naive = (state.level - node.moisture_threshold) / state.rate if state.rate > 0.02 else None
+                pending.append((j, ts, predicted, naive))
+
+    errors = {h: [] for h in HORIZONS}
+    naive_errors = {h: [] for h in HORIZONS}
+    missed = 0
+    for j, ts, predicted, naive in pending:
+        actual = next((t for t in irrigated_at[j] if t > ts), None)
+        if actual is None:
+            continue
+        actual_hours = (actual - ts) / 3600.0
+        for low, high in HORIZONS:
+            if low <= actual_hours < high:
+                if predicted is None:
+                    missed += 1
+                else:
+                    errors[(low, high)].append(abs(predicted - actual_hours))
+                if naive is not None:
+                    naive_errors[(low, high)].append(abs(naive - actual_hours))
+
+    print(f"{readings:,} readings, {len(nodes)} nodes, {args.days} days")
+    print(f"throughput: {readings / elapsed:,.0f} readings/s")
+    print(f"{'horizon':>10}  {'n':>6}  {'median err':>10}  {'p90 err':>8}  {'naive median':>12}  {'naive p90':>9}")
+    for low, high in HORIZONS:
+        e, n = errors[(low, high)], naive_errors[(low, high)]
+        print(
+            f"{f'{low}-{high} h':>10}  {len(e):>6}  {percentile(e, 0.5):>9.2f}h  {percentile(e, 0.9):>7.2f}h"
+            f"  {percentile(n, 0.5):>11.2f}h  {percentile(n, 0.9):>8.2f}h"
+        )
+    print(f"forecasts with no ETA although irrigation followed: {missed}")
+
+
+if __name__ == "__main__":
+    main()
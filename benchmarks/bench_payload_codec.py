@@ -0,0 +1,129 @@
+"""Benchmark: JSON vs compact binary payloads for gateway uploads.
+
+Compares bytes on the wire and server-side decode cost for the JSON accepted
+by POST /api/sensors/data (ESP32 camelCase format) and the binary frame in
+models/wire_format.py, for single readings and batches.
+
+Usage (from the repository root):
+    python benchmarks/bench_payload_codec.py [--readings 10000] [--batch 50]
+"""
+import argparse
+import json
+import os
+import random
+import sys
+import time
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from models.ingest import IngestReading  # noqa: E402
+from models.schemas import SensorDataInput  # noqa: E402
+from models.wire_format import decode_frame, encode_frame  # noqa: E402
+
+
+def make_readings(count: int, gateway_id: str = "gateway-01"):
+    """Generate realistic readings with 0.1 sensor resolution."""
+    rng = random.Random(42)
+    now = int(time.time())
+    return [
+        IngestReading(
+            node_id=f"node-{i % 12 + 1:02d}",
+            gateway_id=gateway_id,
+            temperature=round(rng.uniform(15, 38), 1),
+            humidity=round(rng.uniform(40, 90), 1),
+            soil_moisture=round(rng.uniform(20, 80), 1),
+            light_level=round(rng.uniform(0, 20000), 1),
+            battery_level=rng.randint(10, 100),
+            rssi=rng.randint(-95, -40),
+            timestamp=now - (count - i) * 10,
+            local_ip="192.168.8.253"
+        )
+        for i in range(count)
+    ]
+
+
+def to_esp32_json(r: IngestReading) -> dict:
+    """JSON object as the ESP32 firmware builds it today."""
+    return {
+        "nodeId": r.node_id,
+        "gatewayId": r.gateway_id,
+        "temperature": r.temperature,
+        "humidity": r.humidity,
+        "soilMoisture": r.soil_moisture,
+        "light_level": r.light_level,
+        "batteryLevel": r.battery_level,
+        "rssi": r.rssi,
+        "timestamp": r.timestamp,
+        "localIp": r.local_ip
+    }
+
+
+def decode_json(body: bytes):
+    """Server-side JSON path: parse, validate with Pydantic, convert to IngestReading."""
+    data = json.loads(body)
+    items = data if isinstance(data, list) else [data]
+    return [IngestReading.from_input(SensorDataInput.model_validate(item)) for item in items]
+
+
+def time_decode(fn, payloads, repeat: int = 3) -> float:
+    """Best-of-N total decode time in seconds."""
+    best = float("inf")
+    for _ in range(repeat):
+        start = time.perf_counter()
+        for payload in payloads:
+            fn(payload)
+        best = min(best, time.perf_counter() - start)
+    return best
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--readings", type=int, default=10000, help="Total readings to encode/decode")
+    parser.add_argument("--batch", type=int, default=50, help="Readings per batched upload")
+    args = parser.parse_args()
+
+    readings = make_readings(args.readings)
+    batches = [readings[i:i + args.batch] for i in range(0, len(readings), args.batch)]
+
+    cases = {
+        "json_single": [json.dumps(to_esp32_json(r)).encode() for r in readings],
+        "binary_single": [encode_frame([r], r.gateway_id, seq=i, local_ip=r.local_ip) for i, r in enumerate(readings)],
+        "json_batch": [json.dumps([to_esp32_json(r) for r in b]).encode() for b in batches],
+        "binary_batch": [encode_frame(b, b[0].gateway_id, seq=i, local_ip=b[0].local_ip) for i, b in enumerate(batches)],
+    }
+    decoders = {
+        "json_single": decode_json,
+        "json_batch": decode_json,
+        "binary_single": lambda p: decode_frame(p).readings,
+        "binary_batch": lambda p: decode_frame(p).readings,
+    }
+
+    # Sanity check: binary round trip preserves values at sensor resolution
+    decoded = decode_frame(cases["binary_batch"][0]).readings
+    for original, roundtrip in zip(batches[0], decoded):
+        assert original.node_id == roundtrip.node_id
+        assert abs(original.temperature - roundtrip.temperature) < 1e-9
+        assert abs(original.soil_moisture - roundtrip.soil_moisture) < 1e-9
+
+    results = {}
+    for name, payloads in cases.items():
+        total_bytes = sum(len(p) for p in payloads)
+        seconds = time_decode(decoders[name], payloads)
+        results[name] = {
+            "payloads": len(payloads),
+            "bytes_per_reading": round(total_bytes / len(readings), 1),
+            "decode_us_per_reading": round(seconds / len(readings) * 1e6, 2),
+        }
+
+    for kind in ("single", "batch"):
+        json_r, bin_r = results[f"json_{kind}"], results[f"binary_{kind}"]
+        results[f"{kind}_ratio"] = {
+            "bytes": round(json_r["bytes_per_reading"] / bin_r["bytes_per_reading"], 1),
+            "decode": round(json_r["decode_us_per_reading"] / bin_r["decode_us_per_reading"], 1),
+        }
+
+    print(json.dumps(results, indent=2))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,120 @@
+"""Benchmark: storage size and scan speed of compressed reading blocks.
+
+Copies a database built by benchmarks/generate_dataset.py, times the history
+read paths, compacts every closed hour into reading_blocks
+(services/reading_store.py), vacuums, and times the same reads again. The
+results before and after compaction are checked to be identical.
+
+Reports the file size, bytes per reading and the median time of each read.
+
+Usage (from the repository root):
+    python benchmarks/generate_dataset.py --db /tmp/greenhouse-1m.db --rows 1000000
+    python benchmarks/bench_reading_blocks.py /tmp/greenhouse-1m.db [--repeat 3]
+"""
+import argparse
+import os
+import shutil
+import statistics
+import sys
+import tempfile
+import time
+from datetime import timedelta
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from sqlalchemy import create_engine, func, text  # noqa: E402
+from sqlalchemy.orm import sessionmaker  # noqa: E402
+from models.database import SensorReading  # noqa: E402
+from models.migrations import run_migrations  # noqa: E402
+from services import reading_store  # noqa: E402
+from services.sensor_service import SensorService  # noqa: E402
+
+
+def _order(row):
+    return row[-1], row[0]
+
+
+def timed(run, repeat):
+    result = run()
+    timings = []
+    for _ in range(repeat):
+        start = time.perf_counter()
+        run()
+        timings.append((time.perf_counter() - start) * 1000.0)
+    return result, statistics.median(timings)
+
+
+def run_cases(db, node_id, gateway_id, newest, repeat):
+    cases = [
+        ("history node 24h", lambda: SensorService.get_history_rows(db, hours=24, node_id=node_id, now=newest)),
+        ("history node 7d", lambda: SensorService.get_history_rows(db, hours=168, node_id=node_id, now=newest)),
+        ("history gateway 6h", lambda: SensorService.get_history_rows(db, hours=6, gateway_id=gateway_id, now=newest)),
+        ("history fleet 24h", lambda: SensorService.get_history_rows(db, hours=24, now=newest)),
+    ]
+    return {name: timed(run, repeat) for name, run in cases}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("database", help="SQLite file built by generate_dataset.py (not modified)")
+    parser.add_argument("--repeat", type=int, default=3, help="Measured runs per case")
+    args = parser.parse_args()
+    if not os.path.exists(args.database):
+        sys.exit(f"{args.database} does not exist (build it with benchmarks/generate_dataset.py)")
+
+    workdir = tempfile.mkdtemp(prefix="bench-blocks-")
+    path = os.path.join(workdir, "greenhouse.db")
+    shutil.copyfile(args.database, path)
+    engine = create_engine(f"sqlite:///{path}")
+    run_migrations(engine)
+    Session = sessionmaker(bind=engine)
+    db = Session()
+    try:
+        with engine.connect() as conn:
+            conn.execute(text("VACUUM"))
+        rows = db.query(func.count(SensorReading.id)).scalar()
+        newest = db.query(func.max(SensorReading.timestamp)).scalar()
+        node_id, gateway_id = db.query(SensorReading.node_id, SensorReading.gateway_id).filter(
+            SensorReading.timestamp == newest
+        ).first()
+        size_before = os.path.getsize(path)
+        before = run_cases(db, node_id, gateway_id, newest, args.repeat)
+
+        # Compact every hour but the newest one
+        horizon = reading_store.compaction_horizon(newest + timedelta(hours=reading_store.READING_BLOCK_COMPACT_AFTER_HOURS))
+        compactor = reading_store.BlockCompactor()
+        started = time.perf_counter()
+        moved = blocks = 0
+        while True:
+            oldest = db.query(func.min(SensorReading.timestamp)).filter(SensorReading.timestamp < horizon).scalar()
+            if oldest is None:
+                break
+            readings, written = compactor.compact_hour(db, oldest.replace(minute=0, second=0, microsecond=0))
+            db.commit()
+            moved += readings
+            blocks += written
+        compact_seconds = time.perf_counter() - started
+        with engine.connect() as conn:
+            conn.execute(text("VACUUM"))
+        size_after = os.path.getsize(path)
+        after = run_cases(db, node_id, gateway_id, newest, args.repeat)
+
+        print(f"{args.database}: {rows:,} readings, {moved:,} compacted into {blocks:,} blocks "
+              f"in {compact_seconds:.1f} s ({moved / compact_seconds:,.0f} readings/s)")
+        print(f"file size: {size_before / 1e6:.1f} MB -> {size_after / 1e6:.1f} MB "
+              f"({size_before / rows:.0f} -> {size_after / rows:.0f} bytes/reading, {size_before / size_after:.1f}x)")
+        print(f"{'case':<22} {'rows':>8} {'rows ms':>9} {'blocks ms':>10}")
+        for name, (result, ms) in before.items():
+            compacted_result, compacted_ms = after[name]
+            # Readings with equal timestamps may come back in a different order
+            if sorted(map(tuple, result), key=_order) != sorted(map(tuple, compacted_result), key=_order):
+                sys.exit(f"{name}: results differ after compaction")
+            print(f"{name:<22} {len(result):>8} {ms:>9.1f} {compacted_ms:>10.1f}")
+    finally:
+        db.close()
+        engine.dispose()
+        shutil.rmtree(workdir)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,172 @@
+"""Benchmark: Pydantic vs row-tuple JSON encoding for /history responses.
+
+Compares the cost of producing a GET /api/sensors/history body for a large
+window:
+- fastapi: ORM objects -> SensorReadingResponse per row -> response_model
+  re-validation -> JSONResponse (the original route)
+- pydantic: ORM objects -> SensorReadingResponse per row -> model_dump_json
+- rows+orjson / rows+json: row tuples -> models/response_json.py (current route)
+
+Also checks that every fast path produces exactly the same bytes as Pydantic,
+so the external schema is unchanged.
+
+Usage (from the repository root):
+    python benchmarks/bench_response_json.py [--rows 60000] [--repeat 5] [--db existing.db]
+"""
+import argparse
+import json
+import os
+import random
+import statistics
+import sys
+import tempfile
+import time
+from datetime import datetime, timedelta
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from sqlalchemy import create_engine  # noqa: E402
+from sqlalchemy.orm import sessionmaker  # noqa: E402
+from models.database import Base, Gateway, SensorNode, SensorReading  # noqa: E402
+from models.schemas import HistoryResponse, SensorReadingResponse  # noqa: E402
+from models import response_json  # noqa: E402
+from services.sensor_service import SensorService  # noqa: E402
+
+
+def build_database(path: str, rows: int, now: datetime):
+    """Fill a fresh database with `rows` readings inside the last 24 hours."""
+    engine = create_engine(f"sqlite:///{path}")
+    Base.metadata.create_all(bind=engine)
+    rng = random.Random(7)
+    step = timedelta(hours=23) / rows
+    records = []
+    for i in range(rows):
+        # Mix of whole-second (device) and sub-second (server utcnow) timestamps
+        ts = now - timedelta(hours=23) + step * i
+        if i % 2:
+            ts = ts.replace(microsecond=0)
+        records.append({
+            "id": i + 1,
+            "node_key": i % 40 + 1 if i % 97 else 41,
+            "gateway_key": i % 4 + 1,
+            "temperature": round(rng.uniform(10, 40), 1),
+            "humidity": float(rng.randint(30, 90)),
+            "soil_moisture": round(rng.uniform(10, 90), 2),
+            "light_level": None if i % 5 == 0 else round(rng.uniform(0, 30000), 1),
+            "battery_level": None if i % 7 == 0 else rng.randint(0, 100),
+            "rssi": None if i % 11 == 0 else rng.randint(-100, -30),
+            "timestamp": ts,
+        })
+    with engine.begin() as conn:
+        conn.execute(Gateway.__table__.insert(), [
+            {"gateway_id": f"gateway-{g:02d}", "last_seen": now, "created_at": now} for g in range(4)
+        ])
+        conn.execute(SensorNode.__table__.insert(), [
+            {"node_id": f"node-{n:02d}" if n < 40 else "nœud-é", "gateway_id": "gateway-00", "last_seen": now, "created_at": now}
+            for n in range(41)
+        ])
+        conn.execute(SensorReading.__table__.insert(), records)
+    engine.dispose()
+
+
+def time_case(run, repeat: int):
+    run()  # warm-up
+    timings = []
+    body = None
+    for _ in range(repeat):
+        start = time.perf_counter()
+        body = run()
+        timings.append((time.perf_counter() - start) * 1000.0)
+    return body, timings
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--rows", type=int, default=60000, help="Readings in the window (ignored with --db)")
+    parser.add_argument("--repeat", type=int, default=5)
+    parser.add_argument("--hours", type=int, default=24)
+    parser.add_argument("--db", help="Use an existing database (e.g. from generate_dataset.py)")
+    args = parser.parse_args()
+
+    now = datetime.utcnow()
+    tmpdir = None
+    path = args.db
+    if path is None:
+        tmpdir = tempfile.TemporaryDirectory()
+        path = os.path.join(tmpdir.name, "bench.db")
+        build_database(path, args.rows, now)
+
+    engine = create_engine(f"sqlite:///{path}")
+    db = sessionmaker(bind=engine)()
+    if args.db:
+        now = db.query(SensorReading.timestamp).order_by(SensorReading.timestamp.desc()).limit(1).scalar()
+
+    def fastapi_path():
+        readings = SensorService.get_history(db, hours=args.hours, now=now)
+        response = HistoryResponse(
+            readings=[SensorReadingResponse.model_validate(r) for r in readings],
+            count=len(readings),
+            hours=args.hours
+        )
+        # FastAPI re-validates the returned model against response_model, then JSONResponse dumps it
+        validated = HistoryResponse.model_validate(response.model_dump())
+        body = json.dumps(validated.model_dump(mode="json"), ensure_ascii=False, separators=(",", ":")).encode()
+        db.expunge_all()
+        return body
+
+    def pydantic_path():
+        readings = SensorService.get_history(db, hours=args.hours, now=now)
+        body = HistoryResponse(
+            readings=[SensorReadingResponse.model_validate(r) for r in readings],
+            count=len(readings),
+            hours=args.hours
+        ).model_dump_json().encode()
+        db.expunge_all()
+        return body
+
+    def rows_path():
+        rows = SensorService.get_history_rows(db, hours=args.hours, now=now)
+        return response_json.readings_json(rows, hours=args.hours)
+
+    def rows_stdlib_path():
+        saved, response_json.orjson = response_json.orjson, None
+        try:
+            return rows_path()
+        finally:
+            response_json.orjson = saved
+
+    cases = [
+        ("fastapi (original route)", fastapi_path),
+        ("pydantic model_dump_json", pydantic_path),
+        ("rows + json", rows_stdlib_path),
+    ]
+    if response_json.orjson is not None:
+        cases.append(("rows + orjson", rows_path))
+    else:
+        print("orjson is not installed; skipping the orjson case", file=sys.stderr)
+
+    results = {name: time_case(run, args.repeat) for name, run in cases}
+    reference = results["pydantic model_dump_json"][0]
+    count = json.loads(reference)["count"]
+
+    print(f"{count:,} readings, {len(reference) / 1e6:.1f} MB per response, {args.repeat} runs\n")
+    print(f"{'path':<28} {'median ms':>10} {'min ms':>10} {'speedup':>8}  identical")
+    baseline = statistics.median(results["fastapi (original route)"][1])
+    for name, (body, timings) in results.items():
+        median = statistics.median(timings)
+        identical = body == reference
+        if name.startswith("fastapi"):
+            # Different JSON float formatting path; compare parsed content instead
+            identical = json.loads(body) == json.loads(reference)
+        print(f"{name:<28} {median:>10.1f} {min(timings):>10.1f} {baseline / median:>7.1f}x  {identical}")
+        if not identical:
+            sys.exit(f"{name} output differs from the Pydantic response")
+
+    db.close()
+    engine.dispose()
+    if tmpdir:
+        tmpdir.cleanup()
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,244 @@
+"""Generate a large synthetic sensor history directly into a SQLite database.
+
+Writes deterministic readings for a fleet of gateways and nodes straight into
+the schema defined in models/database.py, bypassing the API, so 1M-100M row
+databases for benchmarks/bench_history_queries.py can be built in minutes.
+
+Each node's series has:
+- a diurnal temperature cycle (peak mid-afternoon) with humidity moving inversely
+- an irrigation-driven soil moisture sawtooth (drying faster during the day)
+- daylight-shaped light levels, slowly draining batteries and noisy RSSI
+- occasional stuck-sensor episodes (constant values) and offline gaps (no rows)
+
+Rows are written in time order, interleaved across nodes, like live ingest.
+The newest reading is at --end. Because gaps are random, the row count comes
+out close to --rows but not exactly on it. Output is reproducible for a given
+--seed and --end.
+
+Usage (from the repository root):
+    python benchmarks/generate_dataset.py --db /tmp/greenhouse-1m.db --rows 1000000
+    python benchmarks/generate_dataset.py --db /tmp/greenhouse-10m.db --rows 10000000 \\
+        --gateways 20 --nodes 25 --end 2026-01-01T00:00:00
+"""
+import argparse
+import math
+import os
+import random
+import sqlite3
+import sys
+import time
+from datetime import datetime, timedelta
+
+sys.path.insert(0, os.path.dirname(os.path.dirname(os.path.abspath(__file__))))
+
+from sqlalchemy import create_engine  # noqa: E402
+from models.database import Base  # noqa: E402
+from models.measurements import to_centi  # noqa: E402
+
+SECONDS_PER_DAY = 86400
+
+
+class NodeModel:
+    """Deterministic signal generator for one sensor node."""
+
+    def __init__(self, node_id: str, gateway_id: str, rng: random.Random, args):
+        self.node_id = node_id
+        self.gateway_id = gateway_id
+        self.rng = rng
+        self.temp_mean = rng.uniform(20, 27)
+        self.temp_amplitude = rng.uniform(3, 8)
+        self.humidity_mean = rng.uniform(55, 75)
+        self.moisture_top = rng.uniform(65, 80)
+        self.moisture_threshold = rng.uniform(25, 40)
+        self.dry_rate_per_hour = rng.uniform(0.4, 1.5)
+        self.moisture = rng.uniform(self.moisture_threshold, self.moisture_top)
+        self.battery = rng.uniform(60, 100)
+        self.rssi_mean = rng.uniform(-85, -50)
+        self.has_battery = rng.random() < 0.8
+        self.stuck_probability = args.stuck_rate if rng.random() < args.stuck_fraction else 0.0
+        self.gap_probability = args.gap_rate
+        self.stuck_until = 0
+        self.stuck_values = None
+        self.offline_until = 0
+
+    def reading(self, ts: int, interval: int):
+        """Return the row tuple for this node at `ts`, or None during a gap."""
+        rng = self.rng
+
+        if ts < self.offline_until:
+            return None
+        if rng.random() < self.gap_probability:
+            # Offline for between a few minutes and a few hours
+            self.offline_until = ts + rng.randint(5, 240) * 60
+            return None
+
+        sod = ts % SECONDS_PER_DAY
+        day_phase = 2 * math.pi * (sod - 9 * 3600) / SECONDS_PER_DAY  # peaks at 15:00
+        daylight = max(0.0, math.sin(math.pi * (sod - 6 * 3600) / (14 * 3600))) if 6 * 3600 <= sod <= 20 * 3600 else 0.0
+
+        # Soil moisture: dries (faster in daylight) until irrigation refills it
+        self.moisture -= self.dry_rate_per_hour * (0.4 + daylight) * interval / 3600.0
+        if self.moisture <= self.moisture_threshold:
+            self.moisture = self.moisture_top + rng.uniform(-2, 2)
+
+        if self.has_battery:
+            self.battery -= 0.02 * interval / 3600.0
+            if self.battery < 15:
+                self.battery = 100.0
+
+        if ts < self.stuck_until:
+            temperature, humidity, moisture = self.stuck_values
+        else:
+            temperature = self.temp_mean + self.temp_amplitude * math.sin(day_phase) + rng.gauss(0, 0.3)
+            humidity = self.humidity_mean - 1.8 * (temperature - self.temp_mean) + rng.gauss(0, 1.5)
+            moisture = self.moisture + rng.gauss(0, 0.4)
+            if self.stuck_probability and rng.random() < self.stuck_probability:
+                # Stuck sensor: repeats the same values for 30 minutes to 12 hours
+                self.stuck_until = ts + rng.randint(30, 720) * 60
+                self.stuck_values = (temperature, humidity, moisture)
+
+        return (
+            self.node_id,
+            self.gateway_id,
+            round(min(100.0, max(-50.0, temperature)), 1),
+            round(min(100.0, max(0.0, humidity)), 1),
+            round(min(100.0, max(0.0, moisture)), 1),
+            round(daylight * rng.uniform(15000, 30000), 1),
+            int(self.battery) if self.has_battery else None,
+            int(self.rssi_mean + rng.gauss(0, 4)),
+        )
+
+
+def create_schema(db_path: str):
+    """Create the application schema with SQLAlchemy so it matches models/database.py."""
+    engine = create_engine(f"sqlite:///{db_path}")
+    Base.metadata.create_all(bind=engine)
+    engine.dispose()
+
+
+def generate(args):
+    if os.path.exists(args.db):
+        if not args.force:
+            sys.exit(f"{args.db} already exists (use --force to overwrite)")
+        os.remove(args.db)
+
+    create_schema(args.db)
+
+    rng = random.Random(args.seed)
+    nodes = []
+    for g in range(args.gateways):
+        gateway_id = f"gateway-{g + 1:02d}"
+        for n in range(args.nodes):
+            node_id = f"gw{g + 1:02d}-node-{n + 1:02d}"
+            nodes.append(NodeModel(node_id, gateway_id, random.Random(rng.random()), args))
+
+    # Offline gaps (mean 122.5 minutes) drop rows; stretch the time range to compensate
+    mean_gap_steps = 122.5 * 60 / args.interval
+    offline_share = args.gap_rate * mean_gap_steps / (1 + args.gap_rate * mean_gap_steps)
+    steps = math.ceil(args.rows / len(nodes) / (1 - offline_share))
+    end = int((args.end - datetime(1970, 1, 1)).total_seconds()) // args.interval * args.interval
+    start = end - (steps - 1) * args.interval
+    start_dt = datetime(1970, 1, 1) + timedelta(seconds=start)
+    end_dt = datetime(1970, 1, 1) + timedelta(seconds=end)
+
+    conn = sqlite3.connect(args.db, isolation_level=None)
+    conn.execute("PRAGMA journal_mode=OFF")
+    conn.execute("PRAGMA synchronous=OFF")
+    conn.execute("PRAGMA cache_size=-262144")  # 256 MiB
+    conn.execute("PRAGMA temp_store=MEMORY")
+
+    # Bulk load without secondary indexes, then rebuild them once
+    index_ddl = [
+        row[0] for row in conn.execute(
+            "SELECT sql FROM sqlite_master WHERE type='index' AND tbl_name='sensor_readings' AND sql IS NOT NULL"
+        )
+    ]
+    for name, in conn.execute(
+        "SELECT name FROM sqlite_master WHERE type='index' AND tbl_name='sensor_readings' AND sql IS NOT NULL"
+    ).fetchall():
+        conn.execute(f'DROP INDEX "{name}"')
+
+    conn.execute("BEGIN")
+    created = end_dt.strftime("%Y-%m-%d %H:%M:%S.000000")
+    conn.executemany(
+        "INSERT INTO gateways (gateway_id, name, is_online, last_seen, created_at) VALUES (?, ?, 1, ?, ?)",
+        [(f"gateway-{g + 1:02d}", f"Gateway {g + 1:02d}", created, created) for g in range(args.gateways)]
+    )
+    conn.executemany(
+        "INSERT INTO sensor_nodes (node_id, gateway_id, name, is_simulated, is_online, last_seen, created_at) "
+        "VALUES (?, ?, ?, 1, 1, ?, ?)",
+        [(node.node_id, node.gateway_id, node.node_id, created, created) for node in nodes]
+    )
+
+    # Readings store integer node/gateway keys (the registry row ids), measurements in
+    # centi-units and epoch milliseconds
+    gateway_keys = dict(conn.execute("SELECT gateway_id, id FROM gateways"))
+    node_keys = dict(conn.execute("SELECT node_id, id FROM sensor_nodes"))
+    insert = (
+        "INSERT INTO sensor_readings (id, node_key, gateway_key, temperature, humidity, soil_moisture, "
+        "light_level, battery_level, rssi, ts) VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)"
+    )
+    written = 0
+    began = time.perf_counter()
+    batch = []
+    for step in range(steps):
+        ts = start + step * args.interval
+        for node in nodes:
+            row = node.reading(ts, args.interval)
+            if row is not None:
+                batch.append(
+                    (written + len(batch) + 1, node_keys[row[0]], gateway_keys[row[1]])
+                    + tuple(to_centi(value) for value in row[2:5]) + row[5:] + (ts * 1000,)
+                )
+
+        if len(batch) >= args.batch:
+            conn.executemany(insert, batch)
+            written += len(batch)
+            batch.clear()
+            rate = written / (time.perf_counter() - began)
+            print(f"\r{written:,} rows ({rate:,.0f} rows/s)", end="", file=sys.stderr)
+
+    conn.executemany(insert, batch)
+    written += len(batch)
+    conn.execute("COMMIT")
+    load_seconds = time.perf_counter() - began
+
+    print(f"\r{written:,} rows loaded in {load_seconds:.1f}s; building indexes...", file=sys.stderr)
+    began = time.perf_counter()
+    for ddl in index_ddl:
+        conn.execute(ddl)
+    conn.execute("ANALYZE")
+    conn.close()
+
+    print(
+        f"Wrote {written:,} readings for {len(nodes)} nodes on {args.gateways} gateways "
+        f"({start_dt.isoformat()} .. {end_dt.isoformat()}) to {args.db} "
+        f"(indexes {time.perf_counter() - began:.1f}s)",
+        file=sys.stderr
+    )
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--db", required=True, help="SQLite file to create")
+    parser.add_argument("--rows", type=int, default=1_000_000, help="Number of sensor_readings rows")
+    parser.add_argument("--gateways", type=int, default=10)
+    parser.add_argument("--nodes", type=int, default=10, help="Nodes per gateway")
+    parser.add_argument("--interval", type=int, default=60, help="Seconds between readings of a node")
+    parser.add_argument(
+        "--end",
+        type=datetime.fromisoformat,
+        default=datetime.utcnow().replace(second=0, microsecond=0),
+        help="UTC timestamp of the newest reading (default: the current minute)"
+    )
+    parser.add_argument("--stuck-fraction", type=float, default=0.05, help="Share of nodes with stuck episodes")
+    parser.add_argument("--stuck-rate", type=float, default=0.0005, help="Per-reading chance a stuck episode starts")
+    parser.add_argument("--gap-rate", type=float, default=0.0002, help="Per-reading chance a node goes offline")
+    parser.add_argument("--batch", type=int, default=50_000, help="Rows per executemany call")
+    parser.add_argument("--seed", type=int, default=42)
+    parser.add_argument("--force", action="store_true", help="Overwrite an existing database")
+    generate(parser.parse_args())
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,323 @@
+"""Load generator: simulated ESP32 fleet plus dashboard read traffic.
+
+Simulates N gateways x M nodes posting SensorDataInput payloads to a running
+backend, alongside dashboard clients polling /latest, /history and
+/ai/insights, then reports throughput and latency percentiles per endpoint
+as JSON.
+
+Gateway behaviour:
+- Half of the gateways send the ESP32 camelCase format, half the standard format
+- Each node reports every --interval seconds with random jitter
+- Failed uploads (connection errors, 5xx, 429) are retried with backoff,
+  honouring Retry-After
+- With --offline-prob, a gateway occasionally drops offline, buffers its
+  readings and flushes them through POST /api/sensors/data/batch on reconnect
+- With --replay-prob, a payload is occasionally sent twice (lost-ack replay)
+
+Usage (from the repository root, against a running server):
+    python benchmarks/loadgen.py --base-url http://localhost:8000 \\
+        --gateways 12 --nodes 8 --interval 5 --duration 120 --readers 4 \\
+        --output loadgen-report.json
+"""
+import argparse
+import asyncio
+import json
+import math
+import random
+import sys
+import time
+from collections import defaultdict
+from typing import Dict, List, Optional
+
+import httpx
+
+# Upper bound for a single Retry-After sleep, so a misconfigured limit cannot stall the run
+MAX_RETRY_AFTER_SECONDS = 30.0
+
+# Readings per POST /api/sensors/data/batch when flushing an offline buffer
+BACKFILL_BATCH_SIZE = 50
+
+
+class Stats:
+    """Latency samples and status counts per endpoint."""
+
+    def __init__(self):
+        self.latencies: Dict[str, List[float]] = defaultdict(list)
+        self.statuses: Dict[str, Dict[str, int]] = defaultdict(lambda: defaultdict(int))
+        self.counters: Dict[str, int] = defaultdict(int)
+
+    def record(self, endpoint: str, seconds: float, status: str):
+        self.latencies[endpoint].append(seconds * 1000.0)
+        self.statuses[endpoint][status] += 1
+
+
+def percentile(sorted_values: List[float], p: float) -> Optional[float]:
+    """Nearest-rank percentile of an already sorted list."""
+    if not sorted_values:
+        return None
+    rank = max(1, min(len(sorted_values), math.ceil(p / 100.0 * len(sorted_values))))
+    return round(sorted_values[rank - 1], 3)
+
+
+async def timed_request(
+    client: httpx.AsyncClient,
+    stats: Stats,
+    endpoint: str,
+    method: str,
+    url: str,
+    **kwargs
+) -> Optional[httpx.Response]:
+    """Send one request and record its latency under `endpoint`."""
+    start = time.perf_counter()
+    try:
+        response = await client.request(method, url, **kwargs)
+    except httpx.TimeoutException:
+        stats.record(endpoint, time.perf_counter() - start, "timeout")
+        return None
+    except httpx.HTTPError:
+        stats.record(endpoint, time.perf_counter() - start, "error")
+        return None
+    stats.record(endpoint, time.perf_counter() - start, str(response.status_code))
+    return response
+
+
+class SimulatedGateway:
+    """One ESP32 gateway with its sensor nodes."""
+
+    def __init__(self, index: int, args, rng: random.Random):
+        self.gateway_id = f"loadgen-gw-{index:03d}"
+        self.node_ids = [f"loadgen-gw{index:03d}-node-{n:02d}" for n in range(args.nodes)]
+        self.esp32_format = index % 2 == 0
+        self.local_ip = f"10.{index // 250}.{index % 250}.10"
+        self.args = args
+        self.rng = rng
+        # Per-node baseline so series look like real greenhouses rather than noise
+        self.baseline = {
+            node_id: (rng.uniform(18, 30), rng.uniform(45, 80), rng.uniform(30, 70))
+            for node_id in self.node_ids
+        }
+        self.buffer: List[dict] = []
+        self.offline_until = 0.0
+
+    def make_payload(self, node_id: str, timestamp: int) -> dict:
+        temperature, humidity, moisture = self.baseline[node_id]
+        rng = self.rng
+        if self.esp32_format:
+            return {
+                "nodeId": node_id,
+                "gatewayId": self.gateway_id,
+                "temperature": round(temperature + rng.gauss(0, 0.5), 1),
+                "humidity": round(min(100, max(0, humidity + rng.gauss(0, 2))), 1),
+                "soilMoisture": round(min(100, max(0, moisture + rng.gauss(0, 1))), 1),
+                "batteryLevel": rng.randint(40, 100),
+                "rssi": rng.randint(-90, -45),
+                "timestamp": timestamp,
+                "localIp": self.local_ip,
+            }
+        return {
+            "sensor_id": node_id,
+            "gateway_id": self.gateway_id,
+            "temperature": round(temperature + rng.gauss(0, 0.5), 1),
+            "humidity": round(min(100, max(0, humidity + rng.gauss(0, 2))), 1),
+            "soil_moisture": round(min(100, max(0, moisture + rng.gauss(0, 1))), 1),
+            "light_level": round(max(0.0, rng.gauss(8000, 3000)), 1),
+            "timestamp": timestamp,
+            "local_ip": self.local_ip,
+        }
+
+    async def post_with_retry(
+        self,
+        client: httpx.AsyncClient,
+        stats: Stats,
+        endpoint: str,
+        url: str,
+        payload
+    ) -> bool:
+        """POST a payload, retrying transient failures like the firmware does."""
+        backoff = 0.5
+        for attempt in range(self.args.retries + 1):
+            if attempt:
+                stats.counters["retries"] += 1
+            response = await timed_request(client, stats, endpoint, "POST", url, json=payload)
+            if response is not None and response.status_code < 500 and response.status_code != 429:
+                return 200 <= response.status_code < 300
+            delay = backoff * (1 + self.rng.random())
+            if response is not None and response.status_code == 429:
+                try:
+                    delay = float(response.headers.get("retry-after", delay))
+                except ValueError:
+                    pass
+            await asyncio.sleep(min(delay, MAX_RETRY_AFTER_SECONDS))
+            backoff *= 2
+        stats.counters["gave_up"] += 1
+        return False
+
+    async def flush_buffer(self, client: httpx.AsyncClient, stats: Stats):
+        """Upload readings buffered while offline, oldest first."""
+        buffered, self.buffer = self.buffer, []
+        stats.counters["backfill_readings"] += len(buffered)
+        for start in range(0, len(buffered), BACKFILL_BATCH_SIZE):
+            chunk = buffered[start:start + BACKFILL_BATCH_SIZE]
+            await self.post_with_retry(
+                client, stats, "POST /api/sensors/data/batch", "/api/sensors/data/batch", chunk
+            )
+
+    async def run(self, client: httpx.AsyncClient, stats: Stats, deadline: float):
+        args = self.args
+        # Spread gateways over the first interval so they do not start in lockstep
+        await asyncio.sleep(self.rng.uniform(0, args.interval))
+
+        while time.monotonic() < deadline:
+            cycle_start = time.monotonic()
+
+            if self.offline_until and cycle_start >= self.offline_until:
+                self.offline_until = 0.0
+                await self.flush_buffer(client, stats)
+            elif not self.offline_until and self.rng.random() < args.offline_prob:
+                self.offline_until = cycle_start + args.offline_seconds
+                stats.counters["offline_periods"] += 1
+
+            for node_id in self.node_ids:
+                payload = self.make_payload(node_id, int(time.time()))
+                stats.counters["readings_generated"] += 1
+                if self.offline_until:
+                    self.buffer.append(payload)
+                    continue
+
+                await self.post_with_retry(client, stats, "POST /api/sensors/data", "/api/sensors/data", payload)
+                if self.rng.random() < args.replay_prob:
+                    stats.counters["replays"] += 1
+                    await self.post_with_retry(client, stats, "POST /api/sensors/data", "/api/sensors/data", payload)
+
+                # Nodes of one gateway report at slightly different times
+                await asyncio.sleep(self.rng.uniform(0, args.jitter))
+
+            elapsed = time.monotonic() - cycle_start
+            await asyncio.sleep(max(0.0, args.interval - elapsed))
+
+
+async def run_reader(
+    index: int,
+    client: httpx.AsyncClient,
+    stats: Stats,
+    args,
+    node_ids: List[str],
+    deadline: float
+):
+    """Dashboard client polling the read endpoints with conditional requests."""
+    rng = random.Random(args.seed * 1000 + index)
+    etags: Dict[str, str] = {}
+    requests = [
+        ("GET /api/sensors/latest", lambda: "/api/sensors/latest"),
+        ("GET /api/sensors/history", lambda: f"/api/sensors/history?hours=24&node_id={rng.choice(node_ids)}"),
+        ("GET /api/ai/insights", lambda: "/api/ai/insights"),
+    ]
+    await asyncio.sleep(rng.uniform(0, args.read_interval))
+
+    while time.monotonic() < deadline:
+        for endpoint, make_url in requests:
+            url = make_url()
+            headers = {"Accept-Encoding": "gzip"}
+            if url in etags:
+                headers["If-None-Match"] = etags[url]
+            response = await timed_request(client, stats, endpoint, "GET", url, headers=headers)
+            if response is not None and response.headers.get("etag"):
+                etags[url] = response.headers["etag"]
+        await asyncio.sleep(args.read_interval * rng.uniform(0.8, 1.2))
+
+
+def build_report(stats: Stats, args, wall_seconds: float) -> dict:
+    endpoints = {}
+    for endpoint, samples in sorted(stats.latencies.items()):
+        ordered = sorted(samples)
+        endpoints[endpoint] = {
+            "requests": len(ordered),
+            "throughput_rps": round(len(ordered) / wall_seconds, 2),
+            "status": dict(stats.statuses[endpoint]),
+            "latency_ms": {
+                "mean": round(sum(ordered) / len(ordered), 3),
+                "p50": percentile(ordered, 50),
+                "p90": percentile(ordered, 90),
+                "p99": percentile(ordered, 99),
+                "p999": percentile(ordered, 99.9),
+                "max": round(ordered[-1], 3),
+            },
+        }
+
+    total = sum(len(samples) for samples in stats.latencies.values())
+    return {
+        "config": {
+            "base_url": args.base_url,
+            "gateways": args.gateways,
+            "nodes_per_gateway": args.nodes,
+            "interval_seconds": args.interval,
+            "readers": args.readers,
+            "duration_seconds": args.duration,
+            "offline_prob": args.offline_prob,
+            "replay_prob": args.replay_prob,
+            "seed": args.seed,
+        },
+        "wall_seconds": round(wall_seconds, 3),
+        "total_requests": total,
+        "total_throughput_rps": round(total / wall_seconds, 2),
+        "counters": dict(stats.counters),
+        "endpoints": endpoints,
+    }
+
+
+async def main_async(args) -> dict:
+    rng = random.Random(args.seed)
+    gateways = [SimulatedGateway(i, args, random.Random(rng.random())) for i in range(args.gateways)]
+    node_ids = [node_id for gateway in gateways for node_id in gateway.node_ids]
+    stats = Stats()
+
+    limits = httpx.Limits(max_connections=args.connections, max_keepalive_connections=args.connections)
+    async with httpx.AsyncClient(
+        base_url=args.base_url,
+        timeout=httpx.Timeout(args.timeout),
+        limits=limits
+    ) as client:
+        start = time.monotonic()
+        deadline = start + args.duration
+        tasks = [gateway.run(client, stats, deadline) for gateway in gateways]
+        tasks += [run_reader(i, client, stats, args, node_ids, deadline) for i in range(args.readers)]
+        await asyncio.gather(*tasks)
+        # Gateways still offline at the end flush their buffer so no readings are lost
+        await asyncio.gather(*(gateway.flush_buffer(client, stats) for gateway in gateways if gateway.buffer))
+        wall_seconds = time.monotonic() - start
+
+    return build_report(stats, args, wall_seconds)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--base-url", default="http://localhost:8000")
+    parser.add_argument("--gateways", type=int, default=12, help="Simulated gateways")
+    parser.add_argument("--nodes", type=int, default=8, help="Sensor nodes per gateway")
+    parser.add_argument("--interval", type=float, default=10.0, help="Seconds between readings of a node")
+    parser.add_argument("--jitter", type=float, default=0.2, help="Max delay between nodes of a gateway (s)")
+    parser.add_argument("--duration", type=float, default=60.0, help="Run time in seconds")
+    parser.add_argument("--readers", type=int, default=2, help="Concurrent dashboard clients")
+    parser.add_argument("--read-interval", type=float, default=5.0, help="Seconds between dashboard refreshes")
+    parser.add_argument("--offline-prob", type=float, default=0.01, help="Chance per cycle that a gateway goes offline")
+    parser.add_argument("--offline-seconds", type=float, default=60.0, help="Length of an offline period")
+    parser.add_argument("--replay-prob", type=float, default=0.01, help="Chance that an upload is sent twice")
+    parser.add_argument("--retries", type=int, default=3, help="Retries per upload")
+    parser.add_argument("--timeout", type=float, default=10.0, help="Request timeout (s)")
+    parser.add_argument("--connections", type=int, default=100, help="HTTP connection pool size")
+    parser.add_argument("--seed", type=int, default=42)
+    parser.add_argument("--output", help="Write the JSON report to this file instead of stdout")
+    args = parser.parse_args()
+
+    report = asyncio.run(main_async(args))
+    text = json.dumps(report, indent=2)
+    if args.output:
+        with open(args.output, "w") as f:
+            f.write(text + "\n")
+        print(f"Report written to {args.output}", file=sys.stderr)
+    else:
+        print(text)
+
+
+if __name__ == "__main__":
+    main()
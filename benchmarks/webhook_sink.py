@@ -0,0 +1,75 @@
+"""Local webhook receiver for trying out alert delivery.
+
+Prints each batch POSTed by services/webhook_dispatcher.py, checks the
+X-Greenhouse-Signature header when --secret is given, and can fail a share of
+requests to exercise the dispatcher's retries.
+
+Usage (from the repository root):
+    python benchmarks/webhook_sink.py [--port 9000] [--secret s3cret] [--fail-rate 0.3] [--status 503]
+
+Then start the backend with WEBHOOK_URLS=http://127.0.0.1:9000/ (and the same
+WEBHOOK_SECRET).
+"""
+import argparse
+import hashlib
+import hmac
+import json
+import random
+from http.server import BaseHTTPRequestHandler, ThreadingHTTPServer
+
+
+def make_handler(args):
+    counts = {"batches": 0, "events": 0, "failed": 0}
+
+    class Handler(BaseHTTPRequestHandler):
+        def do_POST(self):
+            body = self.rfile.read(int(self.headers.get("Content-Length", 0)))
+            if random.random() < args.fail_rate:
+                counts["failed"] += 1
+                print(f"-> answering HTTP {args.status} (failed {counts['failed']})")
+                self.send_response(args.status)
+                if args.retry_after is not None:
+                    self.send_header("Retry-After", str(args.retry_after))
+                self.end_headers()
+                return
+
+            signature = "unsigned"
+            if args.secret:
+                expected = "sha256=" + hmac.new(args.secret.encode(), body, hashlib.sha256).hexdigest()
+                signature = "valid" if hmac.compare_digest(expected, self.headers.get("X-Greenhouse-Signature", "")) else "INVALID"
+
+            events = json.loads(body).get("events", [])
+            counts["batches"] += 1
+            counts["events"] += len(events)
+            print(f"batch {counts['batches']}: {len(events)} event(s), signature {signature}, total {counts['events']}")
+            for event in events:
+                alert = event.get("alert", {})
+                print(f"  {event.get('event'):<18} {alert.get('node_id', '-')} {alert.get('alert_type', '')} {alert.get('message', '')}")
+            self.send_response(204)
+            self.end_headers()
+
+        def log_message(self, format, *log_args):
+            pass
+
+    return Handler
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--port", type=int, default=9000)
+    parser.add_argument("--secret", default="", help="Verify signatures with this WEBHOOK_SECRET")
+    parser.add_argument("--fail-rate", type=float, default=0.0, help="Share of requests answered with --status")
+    parser.add_argument("--status", type=int, default=503, help="Status code for failed requests")
+    parser.add_argument("--retry-after", type=int, default=None, help="Retry-After seconds sent with failures")
+    args = parser.parse_args()
+
+    server = ThreadingHTTPServer(("127.0.0.1", args.port), make_handler(args))
+    print(f"Listening on http://127.0.0.1:{args.port}/")
+    try:
+        server.serve_forever()
+    except KeyboardInterrupt:
+        pass
+
+
+if __name__ == "__main__":
+    main()
@@ -1,14 +1,28 @@
 """Main FastAPI application entry point."""
 import logging
+import time
 from datetime import datetime
 from fastapi import FastAPI, Request
 from fastapi.middleware.cors import CORSMiddleware
 from contextlib import asynccontextmanager
-from slowapi import Limiter, _rate_limit_exceeded_handler
-from slowapi.util import get_remote_address
-from slowapi.errors import RateLimitExceeded
-from models.database import init_db
-from routes import sensors, insights, ai, gateway
+from models.database import analytics_engine, engine, init_db
+from models.migrations import start_deferred_migrations
+from middleware.compression import CompressionMiddleware
+from services.mqtt_ingest import start_mqtt_ingest, stop_mqtt_ingest
+from services.udp_ingest import start_udp_ingest, stop_udp_ingest
+from services.liveness import start_liveness_tracker, stop_liveness_tracker
+from services.zones import start_zone_aggregator, stop_zone_aggregator
+from services.reading_store import start_block_compactor, stop_block_compactor
+from services.analytics import start_analytics, stop_analytics
+from services.insight_scheduler import start_insight_scheduler, stop_insight_scheduler
+from services.profiling import stop_allocation_tracing
+from services.tracing import start_tracing, stop_tracing
+from services import metrics, tracing
+from services.rule_engine import load_rule_engine
+from services.alert_manager import load_active_alerts
+from services.webhook_dispatcher import start_webhook_dispatcher, stop_webhook_dispatcher
+from routes import sensors, insights, ai, gateway, stream, rules, alerts, zones, admin
+from routes import metrics as metrics_routes
 
 # Configure logging with custom formatter to handle missing gateway_id
 class GatewayIdFormatter(logging.Formatter):
@@ -31,15 +45,62 @@ logging.basicConfig(
 )
 logger = logging.getLogger(__name__)
 
+# Count SQL statements for the per-request query histogram
+metrics.instrument_engine(engine)
+metrics.instrument_engine(analytics_engine)
+# Span per SQL statement when TRACING_ENABLED is set
+tracing.instrument_engine(engine)
+tracing.instrument_engine(analytics_engine)
+
 
 @asynccontextmanager
 async def lifespan(app: FastAPI):
     """Lifespan context manager for startup and shutdown events."""
-    # Startup: Initialize database
-    init_db()
-    logger.info("Backend online - Database initialized")
+    started = time.perf_counter()
+    # Startup: Apply pending schema migrations (a warm restart only reads schema_version)
+    schema = init_db()
+    metrics.startup_timings["schema"] = schema.seconds
+    logger.info(
+        f"Backend online - Database initialized (schema v{schema.version}, "
+        f"{len(schema.applied)} migration(s) applied in {schema.seconds * 1000:.0f} ms)"
+    )
+    # Gateway/node online state with deadline-driven offline transitions
+    await start_liveness_tracker()
+    # Zone hierarchy, latest zone snapshots and periodic rollup flushes
+    await start_zone_aggregator()
+    # Threshold rules evaluated on every ingested reading (config/rules.json)
+    load_rule_engine()
+    # Resume unresolved alerts; deliver alert transitions to webhooks (WEBHOOK_URLS)
+    load_active_alerts()
+    await start_webhook_dispatcher()
+    # Optional MQTT ingest transport (enabled by MQTT_BROKER_URL)
+    start_mqtt_ingest()
+    # Optional UDP datagram ingest listener (enabled by UDP_INGEST_PORT)
+    await start_udp_ingest()
+    # Index builds on large existing tables run in the background while we serve
+    start_deferred_migrations(engine)
+    # Optional compaction of closed hours into compressed blocks (READING_BLOCKS_ENABLED)
+    await start_block_compactor()
+    # Optional analytics worker processes (ANALYTICS_PROCESSES)
+    await start_analytics()
+    # Insights recomputed in the background for nodes with new readings (INSIGHT_PRECOMPUTE_ENABLED)
+    await start_insight_scheduler()
+    # Export of request traces to TRACING_OTLP_ENDPOINT / TRACING_FILE (TRACING_ENABLED)
+    await start_tracing()
+    metrics.startup_timings["total"] = time.perf_counter() - started
     yield
     # Shutdown: Cleanup if needed
+    await stop_tracing()
+    # Allocation tracing left running from /api/admin/tracemalloc/start
+    stop_allocation_tracing()
+    await stop_insight_scheduler()
+    stop_analytics()
+    await stop_block_compactor()
+    stop_udp_ingest()
+    stop_mqtt_ingest()
+    await stop_webhook_dispatcher()
+    await stop_zone_aggregator()
+    await stop_liveness_tracker()
     logger.info("Backend shutting down")
 
 
@@ -51,11 +112,6 @@ app = FastAPI(
     lifespan=lifespan
 )
 
-# Configure rate limiting
-limiter = Limiter(key_func=get_remote_address)
-app.state.limiter = limiter
-app.add_exception_handler(RateLimitExceeded, _rate_limit_exceeded_handler)
-
 # Configure CORS for Flutter app and ESP32 gateway
 app.add_middleware(
     CORSMiddleware,
@@ -65,15 +121,20 @@ app.add_middleware(
     allow_headers=["*"],
 )
 
+# Negotiated gzip/br/zstd compression for large JSON responses
+app.add_middleware(CompressionMiddleware)
+
 # Middleware for logging requests with gateway_id
 @app.middleware("http")
 async def log_requests(request: Request, call_next):
     """Log all requests with gateway_id and timestamp."""
     import time
     start_time = time.time()
+    queries = metrics.begin_request()
     
-    # Extract gateway_id from query params or body if available
+    # Extract gateway_id (and node_id, for traces) from query params or body if available
     gateway_id = request.query_params.get("gateway_id", "unknown")
+    node_id = request.query_params.get("node_id")
     
     # Try to extract from JSON body for POST requests (non-blocking)
     if request.method == "POST" and "application/json" in request.headers.get("content-type", ""):
@@ -84,6 +145,7 @@ async def log_requests(request: Request, call_next):
                 try:
                     body_json = json.loads(body)
                     gateway_id = body_json.get("gatewayId") or body_json.get("gateway_id") or gateway_id
+                    node_id = body_json.get("nodeId") or body_json.get("node_id") or node_id
                 except:
                     pass
             # Recreate request with body for downstream handlers
@@ -99,10 +161,33 @@ async def log_requests(request: Request, call_next):
         extra={"gateway_id": gateway_id}
     )
     
-    response = await call_next(request)
+    with tracing.trace(
+        f"{request.method} {request.url.path}",
+        traceparent=request.headers.get("traceparent"),
+        gateway_id=gateway_id if gateway_id != "unknown" else None,
+        node_id=node_id,
+        **{"http.request.method": request.method, "url.path": request.url.path}
+    ) as span:
+        response = await call_next(request)
+        route = request.scope.get("route")
+        if span is not None:
+            if route is not None:
+                span.name = f"{request.method} {route.path}"
+                span.set("http.route", route.path)
+            span.set("node_id", request.scope.get("path_params", {}).get("node_id"))
+            span.set("http.response.status_code", response.status_code)
+            if response.status_code >= 500:
+                span.fail(f"HTTP {response.status_code}")
     
     # Log response
     process_time = time.time() - start_time
+    metrics.observe_request(
+        request.method,
+        getattr(route, "path", "unmatched"),
+        response.status_code,
+        process_time,
+        queries
+    )
     logger.info(
         f"{request.method} {request.url.path} - {response.status_code} ({process_time:.3f}s)",
         extra={"gateway_id": gateway_id}
@@ -117,6 +202,12 @@ app.include_router(sensors.router)
 app.include_router(insights.router)
 app.include_router(ai.router)
 app.include_router(gateway.router)
+app.include_router(stream.router)
+app.include_router(rules.router)
+app.include_router(alerts.router)
+app.include_router(zones.router)
+app.include_router(metrics_routes.router)
+app.include_router(admin.router)
 
 
 @app.get("/")
@@ -136,8 +227,46 @@ async def root():
                 "GET /api/v1/sensors/history": "Get historical sensor data",
                 "GET /api/v1/gateways/status": "Get gateway online/offline status",
                 "GET /api/v1/gateways": "List all registered gateways",
+                "GET /api/v1/gateways/nodes": "Get node online/offline status",
                 "GET /api/v1/ai/insights": "Get AI insights with trend analysis",
-                "GET /api/v1/ai/insights/{node_id}": "Get node-specific AI insights"
+                "GET /api/v1/ai/insights/{node_id}": "Get node-specific AI insights",
+                "GET /api/v1/ai/moisture-forecast": "Hours until each node's soil moisture reaches a target"
+            },
+            "stream": {
+                "WS /api/stream/ws": "Real-time sensor readings over WebSocket",
+                "GET /api/stream/sse": "Real-time sensor readings over Server-Sent Events"
+            },
+            "rules": {
+                "GET /api/rules": "List threshold rules",
+                "GET /api/rules/events": "Recent rule events",
+                "POST /api/rules/reload": "Reload the rule file (requires API token)"
+            },
+            "alerts": {
+                "GET /api/alerts": "List alerts (active by default)",
+                "POST /api/alerts/{id}/ack": "Acknowledge an alert (requires API token)",
+                "POST /api/alerts/{id}/resolve": "Resolve an alert (requires API token)",
+                "POST /api/alerts/test-webhook": "Send a test webhook event (requires API token)"
+            },
+            "zones": {
+                "GET /api/zones": "List zones (greenhouse -> bay -> bench)",
+                "POST /api/zones": "Create a zone (requires API token)",
+                "DELETE /api/zones/{zone_id}": "Delete an empty zone (requires API token)",
+                "POST /api/zones/{zone_id}/nodes": "Assign nodes to a zone (requires API token)",
+                "GET /api/zones/{zone_id}/latest": "Current zone averages over member nodes",
+                "GET /api/zones/{zone_id}/history": "Zone aggregates per time bucket",
+                "GET /api/zones/{zone_id}/insights": "Trend insights for a zone",
+                "POST /api/zones/{zone_id}/rebuild": "Recompute zone rollups from raw readings (requires API token)"
+            },
+            "monitoring": {
+                "GET /metrics": "Prometheus metrics (ingest stages, request latency, queue depths)"
+            },
+            "admin": {
+                "GET /api/admin/profile": "Sampling CPU profile as collapsed stacks or SVG flame graph (requires API token)",
+                "GET /api/admin/tracemalloc": "Allocation tracing status (requires API token)",
+                "POST /api/admin/tracemalloc/start": "Start allocation tracing with a time limit (requires API token)",
+                "POST /api/admin/tracemalloc/stop": "Stop allocation tracing (requires API token)",
+                "POST /api/admin/tracemalloc/snapshot": "Top allocation sites; sets the diff baseline (requires API token)",
+                "GET /api/admin/tracemalloc/diff": "Allocation growth since the baseline (requires API token)"
             },
             "legacy": {
                 "note": "Legacy endpoints maintained for backward compatibility",
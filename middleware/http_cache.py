@@ -0,0 +1,100 @@
+"""Conditional GET support (strong ETags / If-None-Match) for read endpoints.
+
+Routes describe the data a response depends on as a cache key plus a tuple of
+version counters from services/data_versions.py. From that, a strong ETag is
+computed without touching the database:
+
+- If the client's If-None-Match matches, a 304 is returned immediately.
+- If the same representation was rendered before, the cached body is reused.
+- Otherwise the route's build function runs and its output is cached.
+"""
+import hashlib
+import json
+import threading
+from collections import OrderedDict
+from typing import Any, Callable, Hashable, Tuple
+from fastapi import Request, Response
+from pydantic import BaseModel
+from services.data_versions import BOOT_ID
+
+# Maximum number of rendered bodies kept in memory
+RESPONSE_CACHE_SIZE = 256
+
+# Suffixes appended to ETags by the compression middleware for encoded variants
+ENCODING_ETAG_SUFFIXES = ("-gzip", "-br", "-zstd")
+
+_cache: "OrderedDict[Hashable, Tuple[str, bytes]]" = OrderedDict()
+_cache_lock = threading.Lock()
+
+
+def make_etag(key: Hashable, versions: Tuple) -> str:
+    """Build a strong ETag from a cache key and the versions it depends on."""
+    digest = hashlib.sha1(repr((BOOT_ID, key, versions)).encode()).hexdigest()[:20]
+    return f'"{digest}"'
+
+
+def etag_matches(request: Request, etag: str) -> bool:
+    """Check If-None-Match against an ETag (ignoring weak and encoding markers)."""
+    header = request.headers.get("if-none-match")
+    if not header:
+        return False
+    if header.strip() == "*":
+        return True
+
+    for candidate in header.split(","):
+        candidate = candidate.strip()
+        if candidate.startswith("W/"):
+            candidate = candidate[2:]
+        for suffix in ENCODING_ETAG_SUFFIXES:
+            if candidate.endswith(suffix + '"'):
+                candidate = candidate[:-len(suffix) - 1] + '"'
+                break
+        if candidate == etag:
+            return True
+    return False
+
+
+def cached_json_response(
+    request: Request,
+    key: Hashable,
+    versions: Tuple,
+    build: Callable[[], Any]
+) -> Response:
+    """Serve a JSON response with a strong ETag, answering unchanged polls with 304.
+
+    Args:
+        request: Incoming request (for If-None-Match)
+        key: Identifies the resource and its query parameters
+        versions: Data versions (and time buckets) the response depends on
+        build: Produces the response body as a Pydantic model, dict or bytes
+
+    Returns:
+        304 Not Modified, or 200 with the (possibly cached) JSON body
+    """
+    etag = make_etag(key, versions)
+    headers = {"ETag": etag, "Cache-Control": "no-cache"}
+
+    if etag_matches(request, etag):
+        return Response(status_code=304, headers=headers)
+
+    with _cache_lock:
+        cached = _cache.get(key)
+        if cached and cached[0] == etag:
+            _cache.move_to_end(key)
+            return Response(content=cached[1], media_type="application/json", headers=headers)
+
+    content = build()
+    if isinstance(content, BaseModel):
+        body = content.model_dump_json().encode()
+    elif isinstance(content, bytes):
+        body = content
+    else:
+        body = json.dumps(content, separators=(",", ":"), ensure_ascii=False, default=str).encode()
+
+    with _cache_lock:
+        _cache[key] = (etag, body)
+        _cache.move_to_end(key)
+        while len(_cache) > RESPONSE_CACHE_SIZE:
+            _cache.popitem(last=False)
+
+    return Response(content=body, media_type="application/json", headers=headers)
@@ -4,20 +4,38 @@ This module defines the database schema for the greenhouse monitoring system:
 - Gateways: ESP32 gateway devices that collect and forward sensor data
 - SensorNodes: Individual sensor nodes (can be real or simulated)
 - SensorReadings: Time-series sensor data from nodes
+- ReadingBlocks: Closed hours of readings packed into compressed blocks (models/ts_block.py)
+- Zones: Greenhouse -> bay -> bench hierarchy that nodes are placed in
+- ZoneRollups: Per-zone time-bucketed aggregates maintained at ingest
+- AnomalyEvents: Spikes and drifts found by the streaming anomaly detector
+- Alerts: Alert lifecycle records (open -> acknowledged -> resolved)
+- Insights: Precomputed node and trend insights served by the insight routes
+- SchemaVersion: Applied schema migration steps (see models/migrations.py)
 
 The system is designed to work with both real and simulated data interchangeably.
 """
-from sqlalchemy import create_engine, Column, Integer, Float, DateTime, String, ForeignKey, Boolean, text
+from sqlalchemy import (
+    create_engine, Column, Integer, BigInteger, SmallInteger, Float, DateTime, String, ForeignKey, Boolean, Index,
+    LargeBinary, PrimaryKeyConstraint, Sequence, Text, event, func, select, text
+)
 from sqlalchemy.ext.declarative import declarative_base
-from sqlalchemy.orm import sessionmaker, relationship
-from datetime import datetime
+from sqlalchemy.orm import sessionmaker, relationship, column_property
+from sqlalchemy.orm.properties import ColumnProperty
+from sqlalchemy.sql import operators
+from sqlalchemy.types import TypeDecorator
+from datetime import datetime, timedelta
 import os
 import logging
+from models.measurements import MEASUREMENT_SCALE
 
 logger = logging.getLogger(__name__)
 
 # Database URL - can be overridden by environment variable
 DATABASE_URL = os.getenv("DATABASE_URL", "sqlite:///./greenhouse.db")
+# Analytics sessions (services/analytics.py) may read from a replica instead
+ANALYTICS_DATABASE_URL = os.getenv("ANALYTICS_DATABASE_URL", DATABASE_URL)
+# SQLite write-ahead log: readers and the writer do not block each other
+SQLITE_WAL = os.getenv("SQLITE_WAL", "true").lower() in ("1", "true", "yes")
 
 engine = create_engine(
     DATABASE_URL,
@@ -25,8 +43,65 @@ engine = create_engine(
 )
 
 SessionLocal = sessionmaker(autocommit=False, autoflush=False, bind=engine)
+
+
+def _is_file_sqlite(db_engine) -> bool:
+    return db_engine.dialect.name == "sqlite" and db_engine.url.database not in (None, "", ":memory:")
+
+
+def _enable_wal(dbapi_connection, connection_record):
+    cursor = dbapi_connection.cursor()
+    cursor.execute("PRAGMA journal_mode=WAL")
+    cursor.close()
+
+
+if SQLITE_WAL and _is_file_sqlite(engine):
+    event.listen(engine, "connect", _enable_wal)
+
+
+def _create_analytics_engine():
+    """Read-only engine whose sessions each see one consistent snapshot.
+
+    SQLite (WAL): a dedicated connection per session, in a read transaction that
+    starts with the first query and lasts until the session closes. Commits made
+    meanwhile are invisible to it, and the transaction never blocks them. Without
+    WAL a long read transaction would block commits, so statements run on their
+    own as before. PostgreSQL: REPEATABLE READ, READ ONLY transactions.
+    """
+    if ANALYTICS_DATABASE_URL == DATABASE_URL and engine.dialect.name == "sqlite" and not _is_file_sqlite(engine):
+        return engine  # In-memory database: only the main engine's connection sees it
+    if not ANALYTICS_DATABASE_URL.startswith("sqlite"):
+        return create_engine(
+            ANALYTICS_DATABASE_URL,
+            isolation_level="REPEATABLE READ",
+            execution_options={"postgresql_readonly": True}
+        )
+
+    analytics = create_engine(ANALYTICS_DATABASE_URL, connect_args={"check_same_thread": False})
+
+    @event.listens_for(analytics, "connect")
+    def _read_only(dbapi_connection, connection_record):
+        if SQLITE_WAL:
+            # Let SQLAlchemy's begin event start the transaction, so SELECTs run in it too
+            dbapi_connection.isolation_level = None
+        cursor = dbapi_connection.cursor()
+        cursor.execute("PRAGMA query_only=ON")
+        cursor.close()
+
+    if SQLITE_WAL:
+        @event.listens_for(analytics, "begin")
+        def _begin_snapshot(conn):
+            conn.exec_driver_sql("BEGIN")
+
+    return analytics
+
+
+analytics_engine = _create_analytics_engine()
+AnalyticsSessionLocal = sessionmaker(autocommit=False, autoflush=False, bind=analytics_engine)
 Base = declarative_base()
 
+_EPOCH = datetime(1970, 1, 1)
+
 
 class Gateway(Base):
     """Gateway model for ESP32 gateway devices.
@@ -73,6 +148,8 @@ class SensorNode(Base):
     gateway_id = Column(String, ForeignKey("gateways.gateway_id"), nullable=False, index=True)
     name = Column(String, nullable=True)  # Optional human-readable name
     is_simulated = Column(Boolean, default=False, nullable=False)  # True for simulated nodes
+    is_online = Column(Boolean, default=False, nullable=False)  # Maintained by services/liveness.py
+    zone_id = Column(String, ForeignKey("zones.zone_id"), nullable=True, index=True)  # Innermost zone (usually a bench)
     last_seen = Column(DateTime, default=datetime.utcnow, nullable=False)
     created_at = Column(DateTime, default=datetime.utcnow, nullable=False)
     
@@ -84,6 +161,89 @@ class SensorNode(Base):
         return f"<SensorNode(id={self.id}, node_id={self.node_id}, gateway_id={self.gateway_id})>"
 
 
+class Zone(Base):
+    """A place in the greenhouse -> bay -> bench hierarchy.
+    
+    Nodes are assigned to one zone (usually a bench). Aggregates of a zone
+    cover the nodes of that zone and of all zones below it.
+    """
+    __tablename__ = "zones"
+
+    id = Column(Integer, primary_key=True, index=True)
+    zone_id = Column(String, unique=True, index=True, nullable=False)
+    name = Column(String, nullable=True)
+    kind = Column(String, nullable=False)  # 'greenhouse', 'bay' or 'bench'
+    parent_id = Column(String, ForeignKey("zones.zone_id"), nullable=True, index=True)
+    created_at = Column(DateTime, default=datetime.utcnow, nullable=False)
+
+    def __repr__(self):
+        return f"<Zone(zone_id={self.zone_id}, kind={self.kind}, parent_id={self.parent_id})>"
+
+
+class EpochMillis(TypeDecorator):
+    """Naive UTC datetime stored as integer milliseconds since the Unix epoch."""
+    impl = BigInteger
+    cache_ok = True
+
+    def process_bind_param(self, value, dialect):
+        if value is None or isinstance(value, int):
+            return value
+        delta = value - _EPOCH
+        return (delta.days * 86400 + delta.seconds) * 1000 + delta.microseconds // 1000
+
+    def process_result_value(self, value, dialect):
+        return None if value is None else _EPOCH + timedelta(milliseconds=value)
+
+
+class CentiUnits(TypeDecorator):
+    """Measurement stored as a 16-bit integer in hundredths of its unit (see models/measurements.py).
+
+    Bound values are always scaled, so filters compare in the stored units too.
+    """
+    impl = SmallInteger
+    cache_ok = True
+
+    def process_bind_param(self, value, dialect):
+        return None if value is None else round(value * MEASUREMENT_SCALE)
+
+    def process_result_value(self, value, dialect):
+        return None if value is None else value / MEASUREMENT_SCALE
+
+
+def _dictionary_comparator(key_column, lookup_key, lookup_value):
+    """Comparator for a string attribute stored as an integer key into a lookup table.
+
+    Equality and IN filters become conditions on the key column (so they use
+    its indexes); other operators compare the looked-up string.
+    """
+    class DictionaryComparator(ColumnProperty.Comparator):
+        def operate(self, op, *other, **kwargs):
+            if op is operators.eq:
+                return key_column == select(lookup_key).where(lookup_value == other[0]).scalar_subquery()
+            if op is operators.ne:
+                return key_column != select(lookup_key).where(lookup_value == other[0]).scalar_subquery()
+            if op is operators.in_op:
+                return key_column.in_(select(lookup_key).where(lookup_value.in_(other[0])))
+            if op is operators.not_in_op:
+                return key_column.not_in(select(lookup_key).where(lookup_value.in_(other[0])))
+            return op(self.__clause_element__(), *other, **kwargs)
+
+    return DictionaryComparator
+
+
+def next_reading_id():
+    """SQL expression allocating the next sensor_readings id on SQLite.
+
+    WITHOUT ROWID tables have no autoincrement. The expression is evaluated
+    inside the INSERT, under SQLite's single writer lock, and also covers ids
+    already moved into reading_blocks. Other databases use the id sequence.
+    """
+    return select(func.max(
+        select(func.coalesce(func.max(SensorReading.id), 0)).scalar_subquery(),
+        select(func.coalesce(func.max(ReadingBlock.max_id), 0)).scalar_subquery()
+    ) + 1).scalar_subquery()
+
+
 class SensorReading(Base):
     """Sensor reading model for storing time-series sensor data.
     
@@ -95,165 +255,248 @@ class SensorReading(Base):
     """
     __tablename__ = "sensor_readings"
 
-    id = Column(Integer, primary_key=True, index=True)
+    # Readings of a node are stored together, in time order (clustered primary
+    # key; a WITHOUT ROWID table on SQLite), so a node's history is a contiguous
+    # range scan. Nodes and gateways are stored as their integer ids in
+    # sensor_nodes / gateways, timestamps as epoch milliseconds, and
+    # temperature, humidity and soil moisture in hundredths. The
+    # node_id, gateway_id and timestamp attributes keep their string/datetime
+    # interface, including in filters.
+    id = Column(Integer, Sequence("sensor_readings_id_seq"), nullable=False)  # SQLite: see next_reading_id
+    node_key = Column(Integer, ForeignKey("sensor_nodes.id"), nullable=False)
+    gateway_key = Column(Integer, ForeignKey("gateways.id"), nullable=False)
     
-    # Foreign keys - use node_id and gateway_id strings for flexibility
-    # (allows data from nodes/gateways not yet registered)
-    node_id = Column(String, ForeignKey("sensor_nodes.node_id"), nullable=False, index=True)
-    gateway_id = Column(String, ForeignKey("gateways.gateway_id"), nullable=False, index=True)
-    
-    # Sensor data
-    temperature = Column(Float, nullable=False)
-    humidity = Column(Float, nullable=False)
-    soil_moisture = Column(Float, nullable=False)
+    # Sensor data (0.1-resolution measurements stored as centi-units)
+    temperature = Column(CentiUnits, nullable=False)
+    humidity = Column(CentiUnits, nullable=False)
+    soil_moisture = Column(CentiUnits, nullable=False)
     light_level = Column(Float, nullable=True)
     battery_level = Column(Integer, nullable=True)
     rssi = Column(Integer, nullable=True)  # Signal strength
     
     # Timestamp
-    timestamp = Column(DateTime, default=datetime.utcnow, index=True, nullable=False)
+    timestamp = Column("ts", EpochMillis, default=datetime.utcnow, nullable=False)
+
+    node_id = column_property(
+        select(SensorNode.node_id).where(SensorNode.id == node_key).correlate_except(SensorNode).scalar_subquery(),
+        comparator_factory=_dictionary_comparator(node_key, SensorNode.id, SensorNode.node_id)
+    )
+    gateway_id = column_property(
+        select(Gateway.gateway_id).where(Gateway.id == gateway_key).correlate_except(Gateway).scalar_subquery(),
+        comparator_factory=_dictionary_comparator(gateway_key, Gateway.id, Gateway.gateway_id)
+    )
     
     # Relationships
     gateway = relationship("Gateway", back_populates="readings")
     sensor_node = relationship("SensorNode", back_populates="readings")
 
+    __table_args__ = (
+        PrimaryKeyConstraint("node_key", "ts", "id"),
+        Index("ix_sensor_readings_id", "id", unique=True),
+        # Fleet-wide time ranges and per-gateway history
+        Index("ix_sensor_readings_ts", "ts"),
+        Index("ix_sensor_readings_gateway_ts", "gateway_key", "ts"),
+        {"sqlite_with_rowid": False},
+    )
+    __mapper_args__ = {"primary_key": [id]}
+
     def __repr__(self):
         return f"<SensorReading(id={self.id}, node_id={self.node_id}, temp={self.temperature})>"
 
 
-def init_db():
-    """Initialize the database by creating all tables and migrating if needed.
+class ReadingBlock(Base):
+    """One node's readings for one closed hour, packed into a compressed block.
     
-    This function:
-    1. Creates all tables if they don't exist
-    2. Migrates existing sensor_readings table to add gateway_id and node_id
-    3. Adds IP address columns to gateways table (local_ip, client_ip)
-    4. Handles backward compatibility with existing data
+    Written by services/reading_store.py when READING_BLOCKS_ENABLED is set:
+    readings older than READING_BLOCK_COMPACT_AFTER_HOURS are moved out of
+    sensor_readings into one row per node, gateway and hour. The block keeps the
+    original row ids. See models/ts_block.py for the encoding.
     """
-    Base.metadata.create_all(bind=engine)
+    __tablename__ = "reading_blocks"
+
+    node_id = Column(String, nullable=False)
+    hour_start = Column(DateTime, nullable=False)
+    gateway_id = Column(String, nullable=False)
+    count = Column(Integer, nullable=False)
+    max_id = Column(Integer, nullable=False, default=0)  # Highest row id in the block (id allocation)
+    first_ts = Column(DateTime, nullable=False)  # Timestamps of the first and last reading in the block
+    last_ts = Column(DateTime, nullable=False)
+    data = Column(LargeBinary, nullable=False)
+
+    __table_args__ = (
+        PrimaryKeyConstraint("node_id", "hour_start", "gateway_id"),
+        # Fleet-wide range scans
+        Index("ix_reading_blocks_hour_start", "hour_start"),
+        Index("ix_reading_blocks_max_id", "max_id"),
+    )
+
+    def __repr__(self):
+        return f"<ReadingBlock(node_id={self.node_id}, hour_start={self.hour_start}, count={self.count})>"
+
+
+class GatewayRateBucket(Base):
+    """Token bucket state for per-gateway ingest rate limiting.
     
-    # Migration: Add IP address columns to gateways table
-    with engine.connect() as conn:
-        try:
-            # Check if local_ip column exists
-            conn.execute(text("SELECT local_ip FROM gateways LIMIT 1"))
-            conn.commit()
-        except Exception:
-            # Add local_ip column
-            try:
-                conn.execute(text("ALTER TABLE gateways ADD COLUMN local_ip VARCHAR(15)"))
-                conn.commit()
-                logger.info("Added local_ip column to gateways table")
-            except Exception as e:
-                logger.warning(f"Could not add local_ip column (may already exist): {e}")
-        
-        try:
-            # Check if client_ip column exists
-            conn.execute(text("SELECT client_ip FROM gateways LIMIT 1"))
-            conn.commit()
-        except Exception:
-            # Add client_ip column
-            try:
-                conn.execute(text("ALTER TABLE gateways ADD COLUMN client_ip VARCHAR(15)"))
-                conn.commit()
-                logger.info("Added client_ip column to gateways table")
-            except Exception as e:
-                logger.warning(f"Could not add client_ip column (may already exist): {e}")
+    Stored in the database (rather than process memory) when RATE_LIMIT_BACKEND
+    is 'database', so that all worker processes share one budget per gateway.
+    """
+    __tablename__ = "gateway_rate_buckets"
+
+    gateway_id = Column(String, primary_key=True)
+    bucket = Column(String, primary_key=True)  # 'steady' or 'backfill'
+    tokens = Column(Float, nullable=False)
+    updated_at = Column(Float, nullable=False)  # Unix time of last refill
+
+    def __repr__(self):
+        return f"<GatewayRateBucket(gateway_id={self.gateway_id}, bucket={self.bucket}, tokens={self.tokens:.1f})>"
+
+
+class AnomalyEvent(Base):
+    """Anomaly detected on the ingest path by services/anomaly_detector.py.
     
-    # Migration logic for existing databases
-    with engine.connect() as conn:
-        # Check if sensor_readings table exists (old schema)
-        result = conn.execute(
-            text("SELECT name FROM sqlite_master WHERE type='table' AND name='sensor_readings'")
-        )
-        if result.fetchone():
-            # Table exists, check for new columns
-            try:
-                # Check if gateway_id column exists
-                conn.execute(text("SELECT gateway_id FROM sensor_readings LIMIT 1"))
-                conn.commit()
-            except Exception:
-                # Add gateway_id column (migrate existing data)
-                try:
-                    conn.execute(text("ALTER TABLE sensor_readings ADD COLUMN gateway_id VARCHAR"))
-                    conn.commit()
-                    # Set default gateway_id for existing records
-                    # Use 'gateway-01' as default (most common from firmware)
-                    conn.execute(
-                        text("UPDATE sensor_readings SET gateway_id = 'gateway-01' WHERE gateway_id IS NULL")
-                    )
-                    conn.commit()
-                except Exception:
-                    pass  # Column might already exist
-            
-            try:
-                # Check if node_id column exists (might be named sensor_id in old schema)
-                conn.execute(text("SELECT node_id FROM sensor_readings LIMIT 1"))
-                conn.commit()
-            except Exception:
-                # Check if sensor_id exists (old column name)
-                try:
-                    conn.execute(text("SELECT sensor_id FROM sensor_readings LIMIT 1"))
-                    conn.commit()
-                    # Rename sensor_id to node_id
-                    conn.execute(text("ALTER TABLE sensor_readings RENAME COLUMN sensor_id TO node_id"))
-                    conn.commit()
-                except Exception:
-                    # sensor_id doesn't exist, add node_id
-                    try:
-                        conn.execute(text("ALTER TABLE sensor_readings ADD COLUMN node_id VARCHAR"))
-                        conn.commit()
-                    except Exception:
-                        pass
-            
-            # Ensure other columns exist
-            for col_name, col_type in [
-                ("battery_level", "INTEGER"),
-                ("rssi", "INTEGER"),
-            ]:
-                try:
-                    conn.execute(text(f"SELECT {col_name} FROM sensor_readings LIMIT 1"))
-                    conn.commit()
-                except Exception:
-                    try:
-                        conn.execute(text(f"ALTER TABLE sensor_readings ADD COLUMN {col_name} {col_type}"))
-                        conn.commit()
-                    except Exception:
-                        pass
+    kind is 'spike' (single reading far from the recent median), 'level_shift'
+    (a jump that persisted, other than an irrigation rise in soil moisture), or
+    'drift_up' / 'drift_down' (sustained shift away from the node's baseline).
+    """
+    __tablename__ = "anomaly_events"
+
+    id = Column(Integer, primary_key=True, index=True)
+    node_id = Column(String, nullable=False)
+    gateway_id = Column(String, nullable=False)
+    metric = Column(String, nullable=False)
+    kind = Column(String, nullable=False)
+    value = Column(Float, nullable=False)  # Reading that triggered the event
+    baseline = Column(Float, nullable=False)  # Window median (spike) or EWMA baseline (drift)
+    score = Column(Float, nullable=False)  # Robust z-score (spike) or CUSUM statistic (drift)
+    timestamp = Column(DateTime, nullable=False, index=True)  # Reading timestamp
+    created_at = Column(DateTime, default=datetime.utcnow, nullable=False)
+
+    __table_args__ = (
+        Index("ix_anomaly_events_node_timestamp", "node_id", "timestamp"),
+    )
+
+    def __repr__(self):
+        return f"<AnomalyEvent(node_id={self.node_id}, metric={self.metric}, kind={self.kind})>"
+
+
+class Alert(Base):
+    """Alert raised by a threshold rule or a drift anomaly.
     
-    # Migration: Add IP address columns to gateways table
-    with engine.connect() as conn:
-        # Check if gateways table exists
-        result = conn.execute(
-            text("SELECT name FROM sqlite_master WHERE type='table' AND name='gateways'")
-        )
-        if result.fetchone():
-            # Table exists, check for new columns
-            try:
-                # Check if local_ip column exists
-                conn.execute(text("SELECT local_ip FROM gateways LIMIT 1"))
-                conn.commit()
-            except Exception:
-                # Add local_ip column
-                try:
-                    conn.execute(text("ALTER TABLE gateways ADD COLUMN local_ip VARCHAR(15)"))
-                    conn.commit()
-                    logger.info("Added local_ip column to gateways table")
-                except Exception as e:
-                    logger.warning(f"Could not add local_ip column (may already exist): {e}")
-            
-            try:
-                # Check if client_ip column exists
-                conn.execute(text("SELECT client_ip FROM gateways LIMIT 1"))
-                conn.commit()
-            except Exception:
-                # Add client_ip column
-                try:
-                    conn.execute(text("ALTER TABLE gateways ADD COLUMN client_ip VARCHAR(15)"))
-                    conn.commit()
-                    logger.info("Added client_ip column to gateways table")
-                except Exception as e:
-                    logger.warning(f"Could not add client_ip column (may already exist): {e}")
+    At most one unresolved alert exists per (node_id, alert_type); further
+    breaches of the same condition update it instead of opening a new one.
+    Lifecycle is managed by services/alert_manager.py.
+    """
+    __tablename__ = "alerts"
+
+    id = Column(Integer, primary_key=True, index=True)
+    node_id = Column(String, nullable=False)
+    gateway_id = Column(String, nullable=False)
+    alert_type = Column(String, nullable=False)  # Rule id, or anomaly_<metric>_<kind>
+    source = Column(String, nullable=False)  # 'rule' or 'anomaly'
+    severity = Column(String, nullable=False)  # 'low', 'medium', 'high'
+    status = Column(String, nullable=False, default="open")  # 'open', 'acknowledged', 'resolved'
+    message = Column(String, nullable=False)
+    value = Column(Float, nullable=True)  # Breaching value when opened
+    opened_at = Column(DateTime, nullable=False)  # When the condition started
+    acknowledged_at = Column(DateTime, nullable=True)
+    resolved_at = Column(DateTime, nullable=True)
+    updated_at = Column(DateTime, default=datetime.utcnow, nullable=False)
+
+    __table_args__ = (
+        # Dedup guarantee across worker processes
+        Index(
+            "ux_alerts_active_node_type", "node_id", "alert_type",
+            unique=True,
+            sqlite_where=text("status != 'resolved'"),
+            postgresql_where=text("status != 'resolved'")
+        ),
+        Index("ix_alerts_status_opened", "status", "opened_at"),
+    )
+
+    def __repr__(self):
+        return f"<Alert(id={self.id}, node_id={self.node_id}, type={self.alert_type}, status={self.status})>"
+
+
+class ZoneRollup(Base):
+    """Aggregate of all readings from a zone's nodes in one time bucket.
+    
+    Maintained by services/zones.py: readings are summed in memory at ingest and
+    merged into these rows additively, so several worker processes can write the
+    same bucket. Averages are sum / readings.
+    """
+    __tablename__ = "zone_rollups"
+
+    zone_id = Column(String, nullable=False)
+    bucket_start = Column(DateTime, nullable=False)  # Start of a ZONE_ROLLUP_BUCKET_SECONDS bucket
+    readings = Column(Integer, nullable=False)
+    temperature_sum = Column(Float, nullable=False)
+    temperature_min = Column(Float, nullable=False)
+    temperature_max = Column(Float, nullable=False)
+    humidity_sum = Column(Float, nullable=False)
+    humidity_min = Column(Float, nullable=False)
+    humidity_max = Column(Float, nullable=False)
+    soil_moisture_sum = Column(Float, nullable=False)
+    soil_moisture_min = Column(Float, nullable=False)
+    soil_moisture_max = Column(Float, nullable=False)
+
+    __table_args__ = (
+        PrimaryKeyConstraint("zone_id", "bucket_start"),
+    )
+
+    def __repr__(self):
+        return f"<ZoneRollup(zone_id={self.zone_id}, bucket_start={self.bucket_start}, readings={self.readings})>"
+
+
+class Insight(Base):
+    """Precomputed insight result, kept current by services/insight_scheduler.py.
+    
+    kind is 'node' (AIInsightsService.analyze_node: 24 h / 7 d history, with
+    window_minutes 0) or 'trend' (TrendInsightService.analyze_trends over
+    window_minutes). scope is a node id, or '*' for the fleet-wide trend.
+    result holds the response body as JSON, so a GET is a primary key lookup.
+    """
+    __tablename__ = "insights"
+
+    scope = Column(String, nullable=False)
+    kind = Column(String, nullable=False)
+    window_minutes = Column(Integer, nullable=False)
+    risk_level = Column(String, nullable=False)  # 'low', 'medium', 'high'
+    result = Column(Text, nullable=False)
+    computed_at = Column(DateTime, nullable=False)
+
+    __table_args__ = (
+        PrimaryKeyConstraint("scope", "kind", "window_minutes"),
+    )
+
+    def __repr__(self):
+        return f"<Insight(scope={self.scope}, kind={self.kind}, window_minutes={self.window_minutes})>"
+
+
+class SchemaVersion(Base):
+    """One applied schema migration step (see models/migrations.py)."""
+    __tablename__ = "schema_version"
+
+    version = Column(Integer, primary_key=True)
+    name = Column(String, nullable=False)
+    applied_at = Column(DateTime, default=datetime.utcnow, nullable=False)
+    duration_ms = Column(Float, nullable=True)
+
+    def __repr__(self):
+        return f"<SchemaVersion(version={self.version}, name={self.name})>"
+
+
+def init_db():
+    """Bring the database schema up to date.
+    
+    Runs the pending steps from models/migrations.py; an up-to-date database
+    only costs a read of the schema_version table. Index builds on existing
+    large tables are left to start_deferred_migrations.
+    
+    Returns:
+        MigrationReport with the schema version and the steps applied
+    """
+    from models.migrations import run_migrations
+    return run_migrations(engine)
 
 
 def get_db():
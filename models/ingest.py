@@ -0,0 +1,42 @@
+"""Internal representation of an incoming sensor reading.
+
+Every ingest transport (HTTP JSON, MQTT, ...) converts its payload into an
+IngestReading before it enters the shared validation, dedup and storage
+pipeline in services/ingest_service.py. Unlike SensorDataInput it has a
+single canonical field per value, so the pipeline never deals with the
+ESP32/standard field name aliases.
+"""
+from dataclasses import dataclass
+from typing import Optional
+from models.schemas import SensorDataInput
+
+
+@dataclass(slots=True)
+class IngestReading:
+    """A single sensor reading as accepted by the ingest pipeline."""
+    node_id: str
+    gateway_id: str
+    temperature: float
+    humidity: float
+    soil_moisture: float
+    light_level: Optional[float] = None
+    battery_level: Optional[int] = None
+    rssi: Optional[int] = None
+    timestamp: Optional[int] = None  # Unix timestamp reported by the device
+    local_ip: Optional[str] = None  # Gateway's self-reported local IP
+
+    @classmethod
+    def from_input(cls, sensor_data: SensorDataInput) -> "IngestReading":
+        """Build an IngestReading from a validated SensorDataInput."""
+        return cls(
+            node_id=sensor_data.get_sensor_id(),
+            gateway_id=sensor_data.get_gateway_id(),
+            temperature=sensor_data.temperature,
+            humidity=sensor_data.humidity,
+            soil_moisture=sensor_data.get_soil_moisture(),
+            light_level=sensor_data.light_level,
+            battery_level=sensor_data.batteryLevel,
+            rssi=sensor_data.rssi,
+            timestamp=sensor_data.timestamp,
+            local_ip=sensor_data.get_local_ip()
+        )
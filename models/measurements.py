@@ -0,0 +1,25 @@
+"""Fixed-point (centi-unit) encoding of sensor measurements.
+
+Temperature, humidity and soil moisture come from sensors with 0.1 resolution,
+so they do not need 8-byte floats. The database (SMALLINT columns), the
+compressed reading blocks, the anomaly detector's recent-value windows and the
+zone snapshots hold them as integers in hundredths of their unit (21.5 °C ->
+2150, 63.2 % -> 6320), the same scale the binary wire format uses
+(models/wire_format.py).
+
+The validated ranges (-50..100 °C, 0..100 %) fit a signed 16-bit integer. Any
+value with at most two decimals comes back exactly as it went in
+(from_centi(to_centi(x)) == x); further digits are rounded to 0.01.
+"""
+# Measurements stored in centi-units
+CENTI_METRICS = ("temperature", "humidity", "soil_moisture")
+MEASUREMENT_SCALE = 100
+
+
+def to_centi(value: float) -> int:
+    """Measurement in hundredths of its unit, rounded to the nearest one."""
+    return round(value * MEASUREMENT_SCALE)
+
+
+def from_centi(value: int) -> float:
+    return value / MEASUREMENT_SCALE
@@ -0,0 +1,376 @@
+"""Versioned schema migrations.
+
+Each step in MIGRATIONS has a fixed version number. The schema_version table
+records the steps that have been applied. At startup the table is read once, and
+only missing steps run, in order, so an up-to-date database costs two queries.
+
+Steps are idempotent: they inspect the live schema and skip work that is already
+done. A database created before versioning existed, or one that crashed halfway
+through a migration, therefore converges safely. Two workers racing on the same
+step both succeed, and the duplicate version row is ignored.
+
+Deferred steps are index builds on tables that can be large. They run in a
+background thread after startup, so the API serves and ingests while they build.
+- PostgreSQL uses CREATE INDEX CONCURRENTLY, which does not block writes. An
+  interrupted build leaves an INVALID index; it is dropped and rebuilt.
+- SQLite has no concurrent build. The build holds the write lock, so inserts
+  wait (up to the driver's busy timeout) until it finishes. Fresh databases get
+  these indexes from create_all, so only a one-time upgrade of a large existing
+  database pays this cost.
+
+To change the schema, append a step with the next version number. Never edit
+or renumber a step that has shipped.
+"""
+import logging
+import threading
+import time
+from dataclasses import dataclass, field
+from datetime import datetime
+from typing import Callable, List, Optional, Sequence, Set, Tuple
+from sqlalchemy import Integer, inspect, select, text
+from sqlalchemy.engine import Connection, Engine
+from sqlalchemy.exc import IntegrityError
+from models.database import Base, Insight, ReadingBlock, SchemaVersion, SensorReading, Zone, ZoneRollup
+from models.measurements import CENTI_METRICS, MEASUREMENT_SCALE
+from models.ts_block import decode_block
+
+logger = logging.getLogger(__name__)
+
+
+@dataclass(frozen=True)
+class Migration:
+    """An ordered, idempotent schema change."""
+    version: int
+    name: str
+    apply: Callable[[Connection], None]
+    deferred: bool = False  # Run in the background after startup (index builds)
+
+
+@dataclass
+class MigrationReport:
+    """Outcome of the startup schema check."""
+    version: int = 0
+    applied: List[str] = field(default_factory=list)
+    deferred_pending: int = 0
+    seconds: float = 0.0
+
+
+def _columns(conn: Connection, table: str) -> Set[str]:
+    return {column["name"] for column in inspect(conn).get_columns(table)}
+
+
+def _add_columns(conn: Connection, table: str, columns: Sequence[Tuple[str, str]]):
+    """Add columns (name, DDL type) that the table does not have yet."""
+    existing = _columns(conn, table)
+    for name, ddl in columns:
+        if name not in existing:
+            conn.execute(text(f"ALTER TABLE {table} ADD COLUMN {name} {ddl}"))
+            logger.info(f"Added {name} column to {table} table")
+
+
+# --- Steps --------------------------------------------------------------------
+
+def _create_tables(conn: Connection):
+    # Creates only missing tables (with their current columns and indexes)
+    Base.metadata.create_all(bind=conn)
+
+
+def _legacy_sensor_readings(conn: Connection):
+    """Bring pre-gateway sensor_readings tables up to the node/gateway schema."""
+    columns = _columns(conn, "sensor_readings")
+    if "node_key" in columns:
+        return  # Created in the keyed layout (step 8)
+    if "gateway_id" not in columns:
+        conn.execute(text("ALTER TABLE sensor_readings ADD COLUMN gateway_id VARCHAR"))
+        # Use 'gateway-01' as default (most common from firmware)
+        conn.execute(text("UPDATE sensor_readings SET gateway_id = 'gateway-01' WHERE gateway_id IS NULL"))
+        logger.info("Added gateway_id column to sensor_readings table")
+    if "node_id" not in columns:
+        if "sensor_id" in columns:
+            conn.execute(text("ALTER TABLE sensor_readings RENAME COLUMN sensor_id TO node_id"))
+            logger.info("Renamed sensor_readings.sensor_id to node_id")
+        else:
+            conn.execute(text("ALTER TABLE sensor_readings ADD COLUMN node_id VARCHAR"))
+    _add_columns(conn, "sensor_readings", [("battery_level", "INTEGER"), ("rssi", "INTEGER")])
+
+
+def _gateway_ip_columns(conn: Connection):
+    _add_columns(conn, "gateways", [("local_ip", "VARCHAR(15)"), ("client_ip", "VARCHAR(15)")])
+
+
+def _sensor_node_is_online(conn: Connection):
+    _add_columns(conn, "sensor_nodes", [("is_online", "BOOLEAN NOT NULL DEFAULT FALSE")])
+
+
+def _zones(conn: Connection):
+    Base.metadata.create_all(bind=conn, tables=[Zone.__table__, ZoneRollup.__table__])
+    _add_columns(conn, "sensor_nodes", [("zone_id", "VARCHAR REFERENCES zones (zone_id)")])
+    conn.execute(text("CREATE INDEX IF NOT EXISTS ix_sensor_nodes_zone_id ON sensor_nodes (zone_id)"))
+
+
+def _reading_blocks(conn: Connection):
+    Base.metadata.create_all(bind=conn, tables=[ReadingBlock.__table__])
+
+
+def _insights(conn: Connection):
+    Base.metadata.create_all(bind=conn, tables=[Insight.__table__])
+
+
+def _centi(column: str) -> str:
+    """SQL converting a float measurement to centi-units (models/measurements.py)."""
+    return f"CAST(ROUND({column} * {MEASUREMENT_SCALE}) AS SMALLINT)"
+
+
+def _rebuild_sensor_readings(conn: Connection, select_sql: str) -> int:
+    """Recreate sensor_readings from the current model, filled by `select_sql`.
+
+    The old table is renamed to sensor_readings_legacy for the SELECT to read
+    from (id, node_key, gateway_key, metrics, ts order), then dropped.
+
+    Returns:
+        Number of rows copied
+    """
+    for index in inspect(conn).get_indexes("sensor_readings"):
+        conn.execute(text(f"DROP INDEX {index['name']}"))
+    conn.execute(text("ALTER TABLE sensor_readings RENAME TO sensor_readings_legacy"))
+    SensorReading.__table__.create(bind=conn)
+    copied = conn.execute(text(
+        "INSERT INTO sensor_readings (id, node_key, gateway_key, temperature, humidity, soil_moisture, "
+        f"light_level, battery_level, rssi, ts) {select_sql}"
+    )).rowcount
+    conn.execute(text("DROP TABLE sensor_readings_legacy"))
+    return copied
+
+
+def _keyed_sensor_readings(conn: Connection):
+    """Rebuild sensor_readings with integer node/gateway keys and epoch-millisecond timestamps.
+
+    Copies the rows in (node, time) order into the clustered table, so a large
+    table takes a while (about 10 s per million rows on SQLite). Sub-millisecond
+    timestamp digits are dropped, and legacy rows without a node or gateway id
+    cannot be keyed and are not copied (their count is logged).
+    """
+    _add_columns(conn, "reading_blocks", [("max_id", "INTEGER NOT NULL DEFAULT 0")])
+    blocks = ReadingBlock.__table__
+    for node_id, hour_start, gateway_id, data in conn.execute(
+        select(blocks.c.node_id, blocks.c.hour_start, blocks.c.gateway_id, blocks.c.data).where(blocks.c.max_id == 0)
+    ).all():
+        conn.execute(blocks.update().where(
+            blocks.c.node_id == node_id, blocks.c.hour_start == hour_start, blocks.c.gateway_id == gateway_id
+        ).values(max_id=max(row[0] for row in decode_block(data, ("id",)))))
+    conn.execute(text("CREATE INDEX IF NOT EXISTS ix_reading_blocks_max_id ON reading_blocks (max_id)"))
+
+    if "node_key" in _columns(conn, "sensor_readings"):
+        return
+    unkeyed = conn.execute(text(
+        "SELECT COUNT(*) FROM sensor_readings WHERE node_id IS NULL OR gateway_id IS NULL"
+    )).scalar()
+    if unkeyed:
+        logger.warning(f"{unkeyed} sensor_readings rows have no node_id or gateway_id and will not be copied")
+    # Readings may name nodes and gateways that were never registered
+    conn.execute(text(
+        "INSERT INTO gateways (gateway_id, name, is_online, last_seen, created_at) "
+        "SELECT r.gateway_id, 'Gateway ' || r.gateway_id, FALSE, MAX(r.timestamp), MIN(r.timestamp) "
+        "FROM sensor_readings r WHERE r.gateway_id IS NOT NULL "
+        "AND NOT EXISTS (SELECT 1 FROM gateways g WHERE g.gateway_id = r.gateway_id) "
+        "GROUP BY r.gateway_id"
+    ))
+    conn.execute(text(
+        "INSERT INTO sensor_nodes (node_id, gateway_id, name, is_simulated, is_online, last_seen, created_at) "
+        "SELECT r.node_id, MAX(r.gateway_id), 'Node ' || r.node_id, FALSE, FALSE, MAX(r.timestamp), MIN(r.timestamp) "
+        "FROM sensor_readings r WHERE r.node_id IS NOT NULL AND r.gateway_id IS NOT NULL "
+        "AND NOT EXISTS (SELECT 1 FROM sensor_nodes n WHERE n.node_id = r.node_id) "
+        "GROUP BY r.node_id"
+    ))
+
+    if conn.dialect.name == "postgresql":
+        millis = "CAST(FLOOR(EXTRACT(EPOCH FROM r.timestamp) * 1000) AS BIGINT)"
+    else:
+        # SQLAlchemy stores 'YYYY-MM-DD HH:MM:SS.ffffff'
+        millis = (
+            "CAST(strftime('%s', r.timestamp) AS INTEGER) * 1000 + "
+            "CASE WHEN length(r.timestamp) > 20 THEN CAST(substr(r.timestamp, 21, 3) AS INTEGER) ELSE 0 END"
+        )
+    # The new table has the current column types: measurements in centi-units (step 9)
+    copied = _rebuild_sensor_readings(
+        conn,
+        f"SELECT r.id, n.id, g.id, {_centi('r.temperature')}, {_centi('r.humidity')}, {_centi('r.soil_moisture')}, "
+        f"r.light_level, r.battery_level, r.rssi, {millis} "
+        "FROM sensor_readings_legacy r "
+        "JOIN sensor_nodes n ON n.node_id = r.node_id JOIN gateways g ON g.gateway_id = r.gateway_id "
+        "WHERE r.node_id IS NOT NULL AND r.gateway_id IS NOT NULL "
+        "ORDER BY n.id, r.timestamp, r.id"
+    )
+    if conn.dialect.name == "postgresql":
+        conn.execute(text(
+            "SELECT setval('sensor_readings_id_seq', GREATEST("
+            "(SELECT COALESCE(MAX(id), 0) FROM sensor_readings), (SELECT COALESCE(MAX(max_id), 0) FROM reading_blocks)) + 1, false)"
+        ))
+    logger.info(f"Rebuilt sensor_readings with node/gateway keys and epoch-millisecond timestamps ({copied} rows)")
+
+
+def _centi_unit_measurements(conn: Connection):
+    """Store temperature, humidity and soil moisture as SMALLINT hundredths instead of floats.
+
+    SQLite cannot change a column type in place, so the table is rebuilt (in
+    its clustered order, about 9 s per million rows). Reading blocks written
+    earlier keep their float streams and stay readable.
+    """
+    types = {column["name"]: column["type"] for column in inspect(conn).get_columns("sensor_readings")}
+    if isinstance(types["temperature"], Integer):
+        return  # Created or rebuilt with centi-unit columns
+    if conn.dialect.name == "postgresql":
+        conn.execute(text(
+            "ALTER TABLE sensor_readings "
+            + ", ".join(f"ALTER COLUMN {m} TYPE SMALLINT USING {_centi(m)}" for m in CENTI_METRICS)
+        ))
+        logger.info("Converted sensor_readings measurements to centi-units")
+        return
+    copied = _rebuild_sensor_readings(
+        conn,
+        f"SELECT id, node_key, gateway_key, {', '.join(_centi(m) for m in CENTI_METRICS)}, "
+        "light_level, battery_level, rssi, ts FROM sensor_readings_legacy ORDER BY node_key, ts, id"
+    )
+    logger.info(f"Rebuilt sensor_readings with centi-unit measurements ({copied} rows)")
+
+
+def _build_index(name: str, table: str, columns: Sequence[str]) -> Callable[[Connection], None]:
+    """Step building an index without blocking writes where the database allows it."""
+    def apply(conn: Connection):
+        column_list = ", ".join(columns)
+        if conn.dialect.name == "postgresql":
+            invalid = conn.execute(text(
+                "SELECT 1 FROM pg_class c JOIN pg_index i ON i.indexrelid = c.oid "
+                "WHERE c.relname = :name AND NOT i.indisvalid"
+            ), {"name": name}).first()
+            if invalid:
+                conn.execute(text(f"DROP INDEX CONCURRENTLY IF EXISTS {name}"))
+            conn.execute(text(f"CREATE INDEX CONCURRENTLY IF NOT EXISTS {name} ON {table} ({column_list})"))
+        else:
+            conn.execute(text(f"CREATE INDEX IF NOT EXISTS {name} ON {table} ({column_list})"))
+    return apply
+
+
+def _unless_keyed(step: Callable[[Connection], None]) -> Callable[[Connection], None]:
+    """Skip a step written for the string-keyed sensor_readings layout once step 8 has run."""
+    def apply(conn: Connection):
+        if "node_key" not in _columns(conn, "sensor_readings"):
+            step(conn)
+    return apply
+
+
+MIGRATIONS: List[Migration] = [
+    Migration(1, "create_tables", _create_tables),
+    Migration(2, "legacy_sensor_readings_columns", _legacy_sensor_readings),
+    Migration(3, "gateway_ip_columns", _gateway_ip_columns),
+    Migration(4, "sensor_node_is_online", _sensor_node_is_online),
+    Migration(
+        5, "ix_sensor_readings_node_timestamp",
+        _unless_keyed(_build_index("ix_sensor_readings_node_timestamp", "sensor_readings", ("node_id", "timestamp"))),
+        deferred=True
+    ),
+    Migration(6, "zones", _zones),
+    Migration(7, "reading_blocks", _reading_blocks),
+    Migration(8, "keyed_sensor_readings", _keyed_sensor_readings),
+    Migration(9, "centi_unit_measurements", _centi_unit_measurements),
+    Migration(10, "insights", _insights),
+]
+
+LATEST_VERSION = max(m.version for m in MIGRATIONS)
+
+# Result of the last run_migrations call (exported as startup metrics)
+report = MigrationReport()
+
+
+def _applied_versions(engine: Engine) -> Set[int]:
+    with engine.begin() as conn:
+        SchemaVersion.__table__.create(bind=conn, checkfirst=True)
+        return {row[0] for row in conn.execute(text("SELECT version FROM schema_version"))}
+
+
+def _record(conn: Connection, migration: Migration, duration_ms: float):
+    conn.execute(
+        SchemaVersion.__table__.insert().values(
+            version=migration.version, name=migration.name,
+            applied_at=datetime.utcnow(), duration_ms=round(duration_ms, 1)
+        )
+    )
+
+
+def _apply(engine: Engine, migration: Migration) -> bool:
+    """Run one step and record it. Returns False if another process recorded it first."""
+    started = time.perf_counter()
+    if migration.deferred and engine.dialect.name == "postgresql":
+        # CONCURRENTLY cannot run inside a transaction block
+        with engine.connect().execution_options(isolation_level="AUTOCOMMIT") as conn:
+            migration.apply(conn)
+        try:
+            with engine.begin() as conn:
+                _record(conn, migration, (time.perf_counter() - started) * 1000)
+        except IntegrityError:
+            return False
+        return True
+
+    # Only a duplicate schema_version row means another process won; a failing
+    # step propagates (and rolls back) like any other error
+    with engine.connect() as conn:
+        with conn.begin() as transaction:
+            migration.apply(conn)
+            try:
+                _record(conn, migration, (time.perf_counter() - started) * 1000)
+            except IntegrityError:
+                transaction.rollback()
+                return False
+    return True
+
+
+def run_migrations(engine: Engine) -> MigrationReport:
+    """Apply pending inline steps; report deferred ones (see run_deferred_migrations)."""
+    started = time.perf_counter()
+    applied = _applied_versions(engine)
+    report.applied = []
+    for migration in MIGRATIONS:
+        if migration.version in applied or migration.deferred:
+            continue
+        step_started = time.perf_counter()
+        if _apply(engine, migration):
+            report.applied.append(migration.name)
+            applied.add(migration.version)
+            logger.info(
+                f"Applied schema migration {migration.version} ({migration.name}) "
+                f"in {(time.perf_counter() - step_started) * 1000:.0f} ms"
+            )
+
+    report.version = max((v for v in applied if v <= LATEST_VERSION), default=0)
+    report.deferred_pending = sum(1 for m in MIGRATIONS if m.deferred and m.version not in applied)
+    report.seconds = time.perf_counter() - started
+    return report
+
+
+def run_deferred_migrations(engine: Engine):
+    """Apply pending deferred steps (index builds) in order. Blocking."""
+    applied = _applied_versions(engine)
+    for migration in MIGRATIONS:
+        if not migration.deferred or migration.version in applied:
+            continue
+        started = time.perf_counter()
+        logger.info(f"Building deferred schema step {migration.version} ({migration.name})")
+        try:
+            _apply(engine, migration)
+        except Exception as e:
+            logger.error(f"Deferred schema step {migration.name} failed (retried next start): {e}", exc_info=True)
+            return
+        report.deferred_pending = max(0, report.deferred_pending - 1)
+        report.version = max(report.version, migration.version)
+        logger.info(f"Deferred schema step {migration.name} done in {time.perf_counter() - started:.1f} s")
+
+
+def start_deferred_migrations(engine: Engine) -> Optional[threading.Thread]:
+    """Run deferred steps on a background thread if any are pending."""
+    if not report.deferred_pending:
+        return None
+    thread = threading.Thread(
+        target=run_deferred_migrations, args=(engine,), name="schema-deferred", daemon=True
+    )
+    thread.start()
+    return thread
@@ -0,0 +1,51 @@
+"""Fast JSON encoding of sensor reading responses.
+
+Read endpoints that return many readings (/latest, /history) skip ORM objects
+and Pydantic entirely: they select plain row tuples with READING_COLUMNS and
+encode them here straight to bytes. The output is byte-for-byte identical to
+`HistoryResponse(...).model_dump_json()` / `LatestReadingsResponse(...)`, so the
+external schema does not change (benchmarks/bench_response_json.py checks this).
+
+orjson is used when installed; otherwise the standard json module produces the
+same bytes, only more slowly.
+"""
+import json
+from datetime import datetime
+from typing import Iterable, Sequence
+from models.database import SensorReading
+from models.schemas import SensorReadingResponse
+
+try:
+    import orjson
+except ImportError:  # pragma: no cover - optional dependency
+    orjson = None
+
+# Field order of SensorReadingResponse, which is also the JSON key order
+READING_FIELDS = tuple(SensorReadingResponse.model_fields)
+
+# Columns to select so that each result row lines up with READING_FIELDS
+READING_COLUMNS = tuple(getattr(SensorReading, name) for name in READING_FIELDS)
+
+
+def _default(value):
+    if isinstance(value, datetime):
+        return value.isoformat()
+    raise TypeError(f"Object of type {type(value).__name__} is not JSON serializable")
+
+
+def dumps(obj) -> bytes:
+    """Compact JSON bytes, matching Pydantic's model_dump_json formatting."""
+    if orjson is not None:
+        return orjson.dumps(obj)
+    return json.dumps(obj, separators=(",", ":"), ensure_ascii=False, default=_default).encode()
+
+
+def readings_json(rows: Iterable[Sequence], **fields) -> bytes:
+    """Encode reading rows as `{"readings": [...], "count": N, **fields}`.
+
+    Args:
+        rows: Result rows selected with READING_COLUMNS
+        **fields: Extra top-level fields, in schema order (e.g. hours=24)
+    """
+    readings = [dict(zip(READING_FIELDS, row)) for row in rows]
+    return dumps({"readings": readings, "count": len(readings), **fields})
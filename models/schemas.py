@@ -1,7 +1,7 @@
 """Pydantic models for request/response validation."""
 from pydantic import BaseModel, Field, model_validator
 from datetime import datetime
-from typing import Optional, List
+from typing import Dict, Optional, List
 
 
 class SensorDataInput(BaseModel):
@@ -297,6 +297,7 @@ class NodeInsightsResponse(BaseModel):
     risk_level: str = Field(..., description="Overall risk level: low, medium, or high")
     recommendations: List[str] = Field(..., description="List of actionable recommendations")
     metrics: NodeMetrics = Field(..., description="Calculated historical metrics")
+    computed_at: Optional[datetime] = Field(None, description="When a precomputed result was calculated (null if computed for this request)")
 
     class Config:
         json_schema_extra = {
@@ -348,6 +349,7 @@ class TrendInsightsResponse(BaseModel):
     analysis_period_minutes: int = Field(..., description="Number of minutes of data analyzed")
     readings_analyzed: int = Field(..., description="Number of sensor readings analyzed")
     node_id: Optional[str] = Field(None, description="Node ID if filtered to specific node")
+    computed_at: Optional[datetime] = Field(None, description="When a precomputed result was calculated (null if computed for this request)")
 
     class Config:
         json_schema_extra = {
@@ -373,3 +375,170 @@ class TrendInsightsResponse(BaseModel):
                 "node_id": "node-01"
             }
         }
+
+
+class RuleEventResponse(BaseModel):
+    """A threshold rule that matched an ingested reading."""
+    rule_id: str
+    severity: str = Field(..., description="Severity level: 'low', 'medium', 'high'")
+    node_id: str
+    gateway_id: str
+    metric: str
+    value: float
+    threshold: float
+    message: str
+    timestamp: datetime
+
+
+class RuleEventsResponse(BaseModel):
+    """Response model for GET /api/rules/events."""
+    events: List[RuleEventResponse]
+    count: int
+
+
+class AnomalyEventResponse(BaseModel):
+    """A spike or drift found by the streaming anomaly detector."""
+    id: int
+    node_id: str
+    gateway_id: str
+    metric: str = Field(..., description="temperature, humidity or soil_moisture")
+    kind: str = Field(..., description="spike, level_shift, drift_up or drift_down")
+    value: float = Field(..., description="Reading that triggered the event")
+    baseline: float = Field(..., description="Recent median (spike) or expected value for the time of day (drift)")
+    score: float = Field(..., description="Robust z-score (spike) or CUSUM statistic (drift)")
+    timestamp: datetime
+
+    class Config:
+        from_attributes = True
+
+
+class AnomalyEventsResponse(BaseModel):
+    """Response model for GET /api/ai/anomalies."""
+    anomalies: List[AnomalyEventResponse]
+    count: int
+    hours: int
+
+
+class MoistureForecastItem(BaseModel):
+    """Time-until-target forecast for one node."""
+    node_id: str
+    gateway_id: str
+    status: str = Field(..., description="drying, not_drying, below_target, learning or stale")
+    moisture: Optional[float] = Field(None, description="Current fitted soil moisture (%)")
+    drying_rate_per_hour: Optional[float] = Field(None, description="Current drying rate (percentage points per hour)")
+    hours_until_target: Optional[float] = Field(None, description="Hours until moisture reaches the target")
+    eta: Optional[datetime] = Field(None, description="When moisture is expected to reach the target")
+    last_reading: datetime
+    last_irrigation: Optional[datetime] = Field(None, description="Last detected irrigation event")
+    irrigations: int = Field(..., description="Irrigation events detected since this process started tracking the node")
+
+    class Config:
+        from_attributes = True
+
+
+class MoistureForecastResponse(BaseModel):
+    """Response model for GET /api/ai/moisture-forecast."""
+    target_percent: float
+    forecasts: List[MoistureForecastItem]
+    count: int
+    generated_at: datetime
+
+
+class AlertResponse(BaseModel):
+    """An alert raised by a threshold rule or a drift anomaly."""
+    id: int
+    node_id: str
+    gateway_id: str
+    alert_type: str = Field(..., description="Rule id, or anomaly_<metric>_<kind> for drift alerts")
+    source: str = Field(..., description="rule or anomaly")
+    severity: str = Field(..., description="low, medium or high")
+    status: str = Field(..., description="open, acknowledged or resolved")
+    message: str
+    value: Optional[float] = Field(None, description="Breaching value when the alert opened")
+    opened_at: datetime
+    acknowledged_at: Optional[datetime] = None
+    resolved_at: Optional[datetime] = None
+    updated_at: datetime
+
+    class Config:
+        from_attributes = True
+
+
+class AlertsResponse(BaseModel):
+    """Response model for GET /api/alerts."""
+    alerts: List[AlertResponse]
+    count: int
+
+
+class ZoneCreate(BaseModel):
+    """Input model for POST /api/zones."""
+    zone_id: str = Field(..., min_length=1, max_length=64)
+    kind: str = Field(..., description="greenhouse, bay or bench")
+    name: Optional[str] = None
+    parent_id: Optional[str] = Field(None, description="Enclosing zone (greenhouse for a bay, bay for a bench)")
+
+
+class ZoneResponse(BaseModel):
+    """A zone with its place in the hierarchy."""
+    zone_id: str
+    name: Optional[str] = None
+    kind: str
+    parent_id: Optional[str] = None
+    children: List[str] = []
+    direct_nodes: int = Field(0, description="Nodes assigned to this zone itself")
+    total_nodes: int = Field(0, description="Nodes in this zone and all zones below it")
+
+
+class ZonesResponse(BaseModel):
+    """Response model for GET /api/zones."""
+    zones: List[ZoneResponse]
+    count: int
+
+
+class ZoneNodesInput(BaseModel):
+    """Input model for POST /api/zones/{zone_id}/nodes."""
+    node_ids: List[str] = Field(..., min_length=1)
+
+
+class ZoneMetricStats(BaseModel):
+    """Average, minimum and maximum of one metric."""
+    avg: float
+    min: float
+    max: float
+
+
+class ZoneLatestResponse(BaseModel):
+    """Response model for GET /api/zones/{zone_id}/latest."""
+    zone_id: str
+    nodes_reporting: int = Field(..., description="Member nodes with a reading")
+    metrics: Dict[str, ZoneMetricStats] = Field(..., description="Over the newest reading of each member node")
+    newest_reading: datetime
+    oldest_reading: datetime
+
+    class Config:
+        from_attributes = True
+
+
+class ZoneHistoryBucket(BaseModel):
+    """Aggregate of a zone's readings in one time bucket."""
+    bucket_start: datetime
+    readings: int
+    metrics: Dict[str, ZoneMetricStats]
+
+
+class ZoneHistoryResponse(BaseModel):
+    """Response model for GET /api/zones/{zone_id}/history."""
+    zone_id: str
+    resolution_seconds: int
+    buckets: List[ZoneHistoryBucket]
+    count: int
+
+
+class ZoneInsightsResponse(BaseModel):
+    """Response model for GET /api/zones/{zone_id}/insights."""
+    zone_id: str
+    insights: List[InsightDetail]
+    overall_risk_level: str
+    summary: str
+    analysis_period_minutes: int
+    readings_analyzed: int
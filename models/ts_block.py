@@ -0,0 +1,495 @@
+"""Compressed time-series blocks (Gorilla-style) for closed hours of readings.
+
+One block holds the readings of one node (through one gateway) in one hour.
+Each column is a separate bit stream, so a reader can decode only the columns
+it needs:
+- timestamps and row ids: delta-of-delta, zigzag-encoded into a variable-width
+  code ('0' for an unchanged interval, then 7, 9, 12 or 64 bit payloads)
+- temperature, humidity and soil_moisture (in centi-units, models/measurements.py),
+  battery_level and rssi: integer deltas, divided by the block's common divisor
+  of the values (10 for 0.1-resolution sensors) and zigzag-encoded into a
+  variable-width code ('0' for an unchanged value, then 4, 7, 12 or 32 bit
+  payloads). The first value is stored in 32 bits.
+- light_level: each value's IEEE-754 bits XORed with the previous value's. An
+  unchanged value costs one bit, and a change that fits the previous value's run
+  of meaningful bits costs two bits plus that run.
+
+All integers are little-endian. Bit streams are big-endian within bytes.
+
+Block header:
+    magic        2 bytes  b"TB"
+    version      u8       BLOCK_VERSION
+    flags        u8       FLAG_* bits
+    count        u16      Readings in the block
+    null_mask    u8       Bit i set: metric i is missing in some readings (one presence bit per reading)
+    absent_mask  u8       Bit i set: metric i is missing in all readings (no stream)
+    first_second i64      Unix time (seconds) of the first reading
+    first_id     i64      Row id of the first reading
+    stream_len   8 x u16  Byte length of each stream (timestamps, ids, then METRICS)
+    divisor      6 x u16  Common divisor of each integer stream's values (0 for XOR streams)
+    min/max      12 x f64 Minimum and maximum of each metric (NaN if absent)
+
+The header alone answers count/min/max questions without decoding the streams.
+Readings with sub-second timestamps set FLAG_SUBSECOND; their timestamp stream
+then carries 20 bits of microseconds per reading.
+
+Version 1 blocks (no divisor field, every metric XOR-encoded as a float) are
+still decoded.
+"""
+import math
+import struct
+from array import array
+from datetime import datetime, timedelta
+from functools import reduce
+from typing import Dict, Iterable, List, NamedTuple, Optional, Sequence, Tuple
+from models.measurements import CENTI_METRICS, MEASUREMENT_SCALE
+
+BLOCK_MAGIC = b"TB"
+BLOCK_VERSION = 2
+
+FLAG_SUBSECOND = 0x01
+
+# Metric columns, in stream and header order
+METRICS = ("temperature", "humidity", "soil_moisture", "light_level", "battery_level", "rssi")
+# Metrics stored as integers (decoded back to int)
+INT_METRICS = frozenset(("battery_level", "rssi"))
+# Integer stream scale of each metric (0: XOR-encoded float stream)
+_SCALES = tuple(
+    MEASUREMENT_SCALE if metric in CENTI_METRICS else 1 if metric in INT_METRICS else 0 for metric in METRICS
+)
+
+# Column order of the row tuples accepted by encode_block and returned by decode_block
+BLOCK_COLUMNS = ("id", "timestamp") + METRICS
+
+_HEADER = struct.Struct("<2sBBHBBqq8H6H12d")
+_HEADER_V1 = struct.Struct("<2sBBHBBqq8H12d")
+_EPOCH = datetime(1970, 1, 1)
+_MICROSECOND_BITS = 20
+
+
+class BlockFormatError(ValueError):
+    """Raised when a block is malformed."""
+
+
+class BlockHeader(NamedTuple):
+    """Decoded block header."""
+    count: int
+    flags: int
+    null_mask: int
+    absent_mask: int
+    first_second: int
+    first_id: int
+    stream_lengths: Tuple[int, ...]
+    divisors: Tuple[int, ...]  # Per metric; 0 for XOR-encoded float streams
+    size: int  # Header length in bytes
+    minimums: Dict[str, Optional[float]]
+    maximums: Dict[str, Optional[float]]
+
+
+# --- Bit I/O --------------------------------------------------------------------
+
+class _BitWriter:
+    __slots__ = ("out", "acc", "bits")
+
+    def __init__(self):
+        self.out = bytearray()
+        self.acc = 0
+        self.bits = 0
+
+    def write(self, value: int, bits: int):
+        self.acc = (self.acc << bits) | value
+        self.bits += bits
+        if self.bits >= 64:
+            rest = self.bits & 7
+            self.out += (self.acc >> rest).to_bytes(self.bits >> 3, "big")
+            self.acc &= (1 << rest) - 1
+            self.bits = rest
+
+    def getvalue(self) -> bytes:
+        pad = -self.bits & 7
+        return bytes(self.out) + (self.acc << pad).to_bytes((self.bits + pad) >> 3, "big")
+
+
+def _zigzag(value: int) -> int:
+    return value << 1 if value >= 0 else (-value << 1) - 1
+
+
+def _write_delta_of_delta(writer: _BitWriter, values: Sequence[int], subsecond: Optional[Sequence[int]] = None):
+    previous, previous_delta = values[0], 0
+    for i in range(1, len(values)):
+        delta = values[i] - previous
+        z = _zigzag(delta - previous_delta)
+        if z == 0:
+            writer.write(0, 1)
+        elif z < 1 << 7:
+            writer.write(0b10, 2)
+            writer.write(z, 7)
+        elif z < 1 << 9:
+            writer.write(0b110, 3)
+            writer.write(z, 9)
+        elif z < 1 << 12:
+            writer.write(0b1110, 4)
+            writer.write(z, 12)
+        else:
+            writer.write(0b1111, 4)
+            writer.write(z, 64)
+        previous, previous_delta = values[i], delta
+    if subsecond is not None:
+        for micros in subsecond:
+            writer.write(micros, _MICROSECOND_BITS)
+
+
+def _write_xor(writer: _BitWriter, values: Sequence[Optional[float]], with_presence: bool):
+    to_bits = struct.Struct("<d").pack
+    from_bytes = int.from_bytes
+    previous = None
+    lead_window = trail_window = -1
+    for value in values:
+        if with_presence:
+            if value is None:
+                writer.write(0, 1)
+                continue
+            writer.write(1, 1)
+        bits = from_bytes(to_bits(float(value)), "little")
+        if previous is None:
+            writer.write(bits, 64)
+            previous = bits
+            continue
+        x = bits ^ previous
+        previous = bits
+        if x == 0:
+            writer.write(0, 1)
+            continue
+        lead = min(64 - x.bit_length(), 31)
+        trail = (x & -x).bit_length() - 1
+        if lead_window >= 0 and lead >= lead_window and trail >= trail_window:
+            writer.write(0b10, 2)
+            writer.write(x >> trail_window, 64 - lead_window - trail_window)
+        else:
+            significant = 64 - lead - trail
+            writer.write(0b11, 2)
+            writer.write(lead, 5)
+            writer.write(significant - 1, 6)
+            writer.write(x >> trail, significant)
+            lead_window, trail_window = lead, trail
+
+
+def _write_int_deltas(writer: _BitWriter, values: Sequence[Optional[int]], divisor: int, with_presence: bool):
+    previous = None
+    for value in values:
+        if with_presence:
+            if value is None:
+                writer.write(0, 1)
+                continue
+            writer.write(1, 1)
+        if previous is None:
+            writer.write(_zigzag(value), 32)
+            previous = value
+            continue
+        z = _zigzag((value - previous) // divisor)
+        previous = value
+        if z == 0:
+            writer.write(0, 1)
+        elif z < 1 << 4:
+            writer.write(0b10, 2)
+            writer.write(z, 4)
+        elif z < 1 << 7:
+            writer.write(0b110, 3)
+            writer.write(z, 7)
+        elif z < 1 << 12:
+            writer.write(0b1110, 4)
+            writer.write(z, 12)
+        else:
+            writer.write(0b1111, 4)
+            writer.write(z, 32)
+
+
+def encode_block(rows: Sequence[Sequence]) -> bytes:
+    """Encode rows (BLOCK_COLUMNS order, sorted by timestamp) into a block.
+
+    Raises:
+        BlockFormatError: If there are no rows or more than 65535
+    """
+    count = len(rows)
+    if not 0 < count <= 0xFFFF:
+        raise BlockFormatError(f"A block holds 1-65535 readings, got {count}")
+
+    ids = [row[0] for row in rows]
+    seconds, micros = [], []
+    for row in rows:
+        delta = row[1] - _EPOCH
+        seconds.append(delta.days * 86400 + delta.seconds)
+        micros.append(delta.microseconds)
+    subsecond = any(micros)
+
+    streams = []
+    writer = _BitWriter()
+    _write_delta_of_delta(writer, seconds, micros if subsecond else None)
+    streams.append(writer.getvalue())
+    writer = _BitWriter()
+    _write_delta_of_delta(writer, ids)
+    streams.append(writer.getvalue())
+
+    null_mask = absent_mask = 0
+    divisors, minimums, maximums = [], [], []
+    for i, metric in enumerate(METRICS):
+        values = [row[2 + i] for row in rows]
+        present = [v for v in values if v is not None]
+        if not present:
+            absent_mask |= 1 << i
+            streams.append(b"")
+            divisors.append(0)
+            minimums.append(math.nan)
+            maximums.append(math.nan)
+            continue
+        if len(present) != count:
+            null_mask |= 1 << i
+        writer = _BitWriter()
+        scale = _SCALES[i]
+        if scale:
+            ints = [None if v is None else round(v * scale) for v in values]
+            divisor = reduce(math.gcd, (v for v in ints if v is not None), 0)
+            if not 0 < divisor <= 0xFFFF:
+                divisor = 1
+            _write_int_deltas(writer, ints, divisor, len(present) != count)
+            divisors.append(divisor)
+            present = [v for v in ints if v is not None]
+            minimums.append(min(present) / scale)
+            maximums.append(max(present) / scale)
+        else:
+            _write_xor(writer, values, len(present) != count)
+            divisors.append(0)
+            minimums.append(float(min(present)))
+            maximums.append(float(max(present)))
+        streams.append(writer.getvalue())
+
+    if any(len(stream) > 0xFFFF for stream in streams):
+        raise BlockFormatError("Block stream exceeds 65535 bytes; use fewer readings per block")
+    header = _HEADER.pack(
+        BLOCK_MAGIC, BLOCK_VERSION, FLAG_SUBSECOND if subsecond else 0, count, null_mask, absent_mask,
+        seconds[0], ids[0], *(len(stream) for stream in streams), *divisors,
+        *(v for pair in zip(minimums, maximums) for v in pair)
+    )
+    return header + b"".join(streams)
+
+
+# --- Decoding -------------------------------------------------------------------
+
+def read_header(data: bytes) -> BlockHeader:
+    """Decode only the header (count, min/max per metric) of a block.
+
+    Raises:
+        BlockFormatError: If the block is truncated or has the wrong magic/version
+    """
+    if len(data) < 3:
+        raise BlockFormatError("Truncated block header")
+    if data[:2] != BLOCK_MAGIC:
+        raise BlockFormatError("Not a reading block (bad magic)")
+    version = data[2]
+    if version == BLOCK_VERSION:
+        layout = _HEADER
+    elif version == 1:
+        layout = _HEADER_V1
+    else:
+        raise BlockFormatError(f"Unsupported block version: {version}")
+    try:
+        fields = layout.unpack_from(data, 0)
+    except struct.error as e:
+        raise BlockFormatError(f"Truncated block header: {str(e)}")
+    flags, count, null_mask, absent_mask, first_second, first_id = fields[2:8]
+    stream_lengths = fields[8:16]
+    if layout.size + sum(stream_lengths) != len(data):
+        raise BlockFormatError("Block length does not match its header")
+    if version == 1:
+        divisors, bounds = (0,) * len(METRICS), fields[16:]
+    else:
+        divisors, bounds = fields[16:22], fields[22:]
+    minimums, maximums = {}, {}
+    for i, metric in enumerate(METRICS):
+        low, high = bounds[2 * i], bounds[2 * i + 1]
+        minimums[metric] = None if math.isnan(low) else low
+        maximums[metric] = None if math.isnan(high) else high
+    return BlockHeader(
+        count, flags, null_mask, absent_mask, first_second, first_id, stream_lengths, divisors, layout.size,
+        minimums, maximums
+    )
+
+
+def _read_delta_of_delta(data: bytes, count: int, first: int, subsecond: bool = False) -> Tuple[List[int], List[int]]:
+    # The stream is read as one big integer; `pos` counts the bits consumed so far
+    stream = int.from_bytes(data, "big")
+    total = len(data) << 3
+    pos = 0
+    values = [first]
+    value, delta = first, 0
+    for _ in range(count - 1):
+        pos += 1
+        if not (stream >> (total - pos)) & 1:
+            value += delta
+            values.append(value)
+            continue
+        pos += 1
+        if not (stream >> (total - pos)) & 1:
+            width = 7
+        else:
+            pos += 1
+            if not (stream >> (total - pos)) & 1:
+                width = 9
+            else:
+                pos += 1
+                width = 64 if (stream >> (total - pos)) & 1 else 12
+        pos += width
+        z = (stream >> (total - pos)) & ((1 << width) - 1)
+        delta += z >> 1 if not z & 1 else -((z + 1) >> 1)
+        value += delta
+        values.append(value)
+    micros = []
+    if subsecond:
+        mask = (1 << _MICROSECOND_BITS) - 1
+        for _ in range(count):
+            pos += _MICROSECOND_BITS
+            micros.append((stream >> (total - pos)) & mask)
+    if pos > total:
+        raise BlockFormatError("Truncated timestamp/id stream")
+    return values, micros
+
+
+def _read_xor(data: bytes, count: int, with_presence: bool) -> List[Optional[int]]:
+    """Decode a metric stream to raw IEEE-754 bit patterns (None where missing)."""
+    stream = int.from_bytes(data, "big")
+    total = len(data) << 3
+    pos = 0
+    out: List[Optional[int]] = []
+    previous = None
+    lead = trail = 0
+    for _ in range(count):
+        if with_presence:
+            pos += 1
+            if not (stream >> (total - pos)) & 1:
+                out.append(None)
+                continue
+        if previous is None:
+            pos += 64
+            previous = (stream >> (total - pos)) & 0xFFFFFFFFFFFFFFFF
+        else:
+            pos += 1
+            if (stream >> (total - pos)) & 1:
+                pos += 1
+                if (stream >> (total - pos)) & 1:
+                    pos += 11
+                    window = (stream >> (total - pos)) & 0x7FF
+                    lead = window >> 6
+                    trail = 64 - lead - (window & 63) - 1
+                width = 64 - lead - trail
+                pos += width
+                previous ^= ((stream >> (total - pos)) & ((1 << width) - 1)) << trail
+        out.append(previous)
+    if pos > total:
+        raise BlockFormatError("Truncated metric stream")
+    return out
+
+
+def _read_int_deltas(data: bytes, count: int, divisor: int, with_presence: bool) -> List[Optional[int]]:
+    stream = int.from_bytes(data, "big")
+    total = len(data) << 3
+    pos = 0
+    out: List[Optional[int]] = []
+    value = None
+    for _ in range(count):
+        if with_presence:
+            pos += 1
+            if not (stream >> (total - pos)) & 1:
+                out.append(None)
+                continue
+        if value is None:
+            pos += 32
+            z = (stream >> (total - pos)) & 0xFFFFFFFF
+            value = z >> 1 if not z & 1 else -((z + 1) >> 1)
+            out.append(value)
+            continue
+        pos += 1
+        if not (stream >> (total - pos)) & 1:
+            out.append(value)
+            continue
+        pos += 1
+        if not (stream >> (total - pos)) & 1:
+            width = 4
+        else:
+            pos += 1
+            if not (stream >> (total - pos)) & 1:
+                width = 7
+            else:
+                pos += 1
+                width = 32 if (stream >> (total - pos)) & 1 else 12
+        pos += width
+        z = (stream >> (total - pos)) & ((1 << width) - 1)
+        value += (z >> 1 if not z & 1 else -((z + 1) >> 1)) * divisor
+        out.append(value)
+    if pos > total:
+        raise BlockFormatError("Truncated metric stream")
+    return out
+
+
+def _bits_to_floats(bits: List[Optional[int]]) -> List[Optional[float]]:
+    present = [b for b in bits if b is not None]
+    floats = array("d", array("Q", present).tobytes())
+    if len(present) == len(bits):
+        return floats.tolist()
+    it = iter(floats)
+    return [None if b is None else next(it) for b in bits]
+
+
+def decode_block(data: bytes, columns: Optional[Iterable[str]] = None) -> List[Tuple]:
+    """Decode a block into row tuples.
+
+    Args:
+        data: Block bytes
+        columns: Columns to decode, in output order (default: BLOCK_COLUMNS).
+            Only the streams of these columns are decoded.
+
+    Raises:
+        BlockFormatError: If the block is malformed
+    """
+    header = read_header(data)
+    columns = tuple(columns) if columns is not None else BLOCK_COLUMNS
+    count = header.count
+    offsets = [header.size]
+    for length in header.stream_lengths:
+        offsets.append(offsets[-1] + length)
+
+    def stream(index):
+        return data[offsets[index]:offsets[index + 1]]
+
+    decoded = []
+    try:
+        for column in columns:
+            if column == "timestamp":
+                seconds, micros = _read_delta_of_delta(
+                    stream(0), count, header.first_second, bool(header.flags & FLAG_SUBSECOND)
+                )
+                if micros:
+                    decoded.append([_EPOCH + timedelta(seconds=s, microseconds=us) for s, us in zip(seconds, micros)])
+                else:
+                    decoded.append([_EPOCH + timedelta(seconds=s) for s in seconds])
+            elif column == "id":
+                decoded.append(_read_delta_of_delta(stream(1), count, header.first_id)[0])
+            else:
+                i = METRICS.index(column)
+                if header.absent_mask & 1 << i:
+                    decoded.append([None] * count)
+                    continue
+                with_presence = bool(header.null_mask & 1 << i)
+                divisor = header.divisors[i]
+                if divisor:
+                    values = _read_int_deltas(stream(2 + i), count, divisor, with_presence)
+                    scale = _SCALES[i]
+                    if scale != 1:
+                        values = [None if v is None else v / scale for v in values]
+                else:
+                    values = _bits_to_floats(_read_xor(stream(2 + i), count, with_presence))
+                    if column in INT_METRICS:
+                        values = [None if v is None else int(v) for v in values]
+                decoded.append(values)
+    except (IndexError, ValueError) as e:
+        raise BlockFormatError(f"Malformed block stream: {str(e)}")
+    return list(zip(*decoded))
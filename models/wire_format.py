@@ -0,0 +1,211 @@
+"""Compact binary wire format for gateway uploads.
+
+A fixed-layout alternative to the JSON accepted by POST /api/sensors/data,
+designed to be cheap to build on an ESP32 (no string formatting, no field
+name aliases) and cheap to decode on the backend (one struct unpack per
+reading, straight into IngestReading without a Pydantic round trip).
+
+All integers are little-endian.
+
+Frame header:
+    magic       2 bytes  b"GH"
+    version     u8       FRAME_VERSION
+    flags       u8       FLAG_* bits
+    seq         u32      Frame sequence number (per gateway, wraps at 2^32)
+    count       u16      Number of records that follow
+    gw_len      u8       Length of gateway_id
+    gateway_id  gw_len bytes, UTF-8
+    local_ip    4 bytes  Gateway's IPv4 address (0.0.0.0 = not reported)
+
+Record (repeated `count` times):
+    node_len    u8       Length of node_id
+    node_id     node_len bytes, UTF-8
+    timestamp   u32      Unix timestamp (0 = not set, server time is used)
+    temperature i16      Hundredths of °C
+    humidity    u16      Hundredths of %
+    soil        u16      Hundredths of %
+    light_level f32      Lux (NaN = not reported)
+    battery     u8       Percent (0xFF = not reported)
+    rssi        i8       dBm (-128 = not reported)
+
+The server replies with an ack (when requested via Accept or FLAG_ACK_REQUESTED):
+    magic       2 bytes  b"GA"
+    version     u8       FRAME_VERSION
+    status      u8       ACK_* code
+    seq         u32      Sequence number of the acknowledged frame
+    accepted    u16      Readings stored
+    duplicates  u16      Readings already stored earlier
+    rejected    u16      Readings that failed validation
+    retry_after u16      Seconds to wait before resending (ACK_THROTTLED only, else 0;
+                         RETRY_NEVER if the frame exceeds the gateway's burst size)
+
+Statuses ACK_THROTTLED and ACK_ERROR are retryable: nothing in the frame was
+processed and the same frame may be resent (after retry_after). ACK_REJECTED
+is final; resending the same readings fails validation again.
+"""
+import math
+import socket
+import struct
+from typing import List, NamedTuple, Optional
+from models.ingest import IngestReading
+
+BINARY_CONTENT_TYPE = "application/vnd.greenhouse.readings.v1"
+
+FRAME_MAGIC = b"GH"
+ACK_MAGIC = b"GA"
+FRAME_VERSION = 1
+
+# Header flags
+FLAG_ACK_REQUESTED = 0x01
+
+# Ack status codes
+ACK_OK = 0
+ACK_PARTIAL = 1
+ACK_REJECTED = 2
+ACK_ERROR = 3
+ACK_THROTTLED = 4  # Gateway over its rate limit; resend after retry_after
+
+# retry_after of a frame that can never fit the rate limit (split it instead)
+RETRY_NEVER = 0xFFFF
+
+# Sentinels for optional fields
+NO_TIMESTAMP = 0
+NO_BATTERY = 0xFF
+NO_RSSI = -128
+
+_HEADER = struct.Struct("<2sBBIHB")
+_IPV4 = struct.Struct("<4s")
+_RECORD = struct.Struct("<IhHHfBb")
+_ACK = struct.Struct("<2sBBIHHHH")
+
+
+class WireFormatError(ValueError):
+    """Raised when a binary frame is malformed."""
+
+
+class Frame(NamedTuple):
+    """A decoded binary frame."""
+    seq: int
+    flags: int
+    gateway_id: str
+    readings: List[IngestReading]
+
+
+class Ack(NamedTuple):
+    """A decoded ack."""
+    status: int
+    seq: int
+    accepted: int
+    duplicates: int
+    rejected: int
+    retry_after: int = 0
+
+
+def decode_frame(data: bytes) -> Frame:
+    """Decode a binary frame into IngestReadings.
+
+    Raises:
+        WireFormatError: If the frame is truncated, has the wrong magic/version
+            or contains trailing bytes
+    """
+    view = memoryview(data)
+    try:
+        magic, version, flags, seq, count, gw_len = _HEADER.unpack_from(view, 0)
+        if magic != FRAME_MAGIC:
+            raise WireFormatError("Not a greenhouse readings frame (bad magic)")
+        if version != FRAME_VERSION:
+            raise WireFormatError(f"Unsupported frame version: {version}")
+
+        offset = _HEADER.size
+        gateway_id = bytes(view[offset:offset + gw_len]).decode("utf-8")
+        if len(gateway_id.encode("utf-8")) != gw_len or not gateway_id:
+            raise WireFormatError("Truncated or empty gateway_id")
+        offset += gw_len
+
+        (ip_bytes,) = _IPV4.unpack_from(view, offset)
+        offset += _IPV4.size
+        local_ip = socket.inet_ntoa(ip_bytes) if ip_bytes != b"\x00\x00\x00\x00" else None
+
+        readings = []
+        unpack_record = _RECORD.unpack_from
+        record_size = _RECORD.size
+        for _ in range(count):
+            node_len = view[offset]
+            offset += 1
+            node_id = bytes(view[offset:offset + node_len]).decode("utf-8")
+            if not node_id or len(node_id.encode("utf-8")) != node_len:
+                raise WireFormatError("Truncated or empty node_id")
+            offset += node_len
+
+            timestamp, temp, humidity, soil, light, battery, rssi = unpack_record(view, offset)
+            offset += record_size
+
+            readings.append(IngestReading(
+                node_id=node_id,
+                gateway_id=gateway_id,
+                temperature=temp / 100.0,
+                humidity=humidity / 100.0,
+                soil_moisture=soil / 100.0,
+                light_level=None if math.isnan(light) else light,
+                battery_level=None if battery == NO_BATTERY else battery,
+                rssi=None if rssi == NO_RSSI else rssi,
+                timestamp=None if timestamp == NO_TIMESTAMP else timestamp,
+                local_ip=local_ip
+            ))
+    except (struct.error, IndexError, UnicodeDecodeError) as e:
+        raise WireFormatError(f"Truncated or malformed frame: {str(e)}")
+
+    if offset != len(view):
+        raise WireFormatError(f"Unexpected {len(view) - offset} trailing bytes after {count} records")
+
+    return Frame(seq=seq, flags=flags, gateway_id=gateway_id, readings=readings)
+
+
+def encode_frame(
+    readings: List[IngestReading],
+    gateway_id: str,
+    seq: int = 0,
+    flags: int = 0,
+    local_ip: Optional[str] = None
+) -> bytes:
+    """Encode readings into a binary frame (reference encoder for clients and tools)."""
+    gw = gateway_id.encode("utf-8")
+    ip = socket.inet_aton(local_ip) if local_ip else b"\x00\x00\x00\x00"
+    parts = [_HEADER.pack(FRAME_MAGIC, FRAME_VERSION, flags, seq & 0xFFFFFFFF, len(readings), len(gw)), gw, ip]
+
+    for r in readings:
+        node = r.node_id.encode("utf-8")
+        parts.append(bytes((len(node),)))
+        parts.append(node)
+        parts.append(_RECORD.pack(
+            r.timestamp or NO_TIMESTAMP,
+            round(r.temperature * 100),
+            round(r.humidity * 100),
+            round(r.soil_moisture * 100),
+            math.nan if r.light_level is None else r.light_level,
+            NO_BATTERY if r.battery_level is None else r.battery_level,
+            NO_RSSI if r.rssi is None else r.rssi
+        ))
+    return b"".join(parts)
+
+
+def encode_ack(
+    status: int, seq: int, accepted: int, duplicates: int, rejected: int, retry_after: float = 0
+) -> bytes:
+    """Encode an ack for a received frame (retry_after in seconds, rounded up; inf = RETRY_NEVER)."""
+    retry = RETRY_NEVER if math.isinf(retry_after) else min(math.ceil(retry_after), RETRY_NEVER - 1)
+    return _ACK.pack(
+        ACK_MAGIC, FRAME_VERSION, status, seq & 0xFFFFFFFF,
+        min(accepted, 0xFFFF), min(duplicates, 0xFFFF), min(rejected, 0xFFFF), retry
+    )
+
+
+def decode_ack(data: bytes) -> Ack:
+    """Decode an ack (reference decoder for clients and tools)."""
+    try:
+        magic, version, status, seq, accepted, duplicates, rejected, retry_after = _ACK.unpack(data)
+    except struct.error as e:
+        raise WireFormatError(f"Malformed ack: {str(e)}")
+    if magic != ACK_MAGIC or version != FRAME_VERSION:
+        raise WireFormatError("Not a greenhouse ack")
+    return Ack(status, seq, accepted, duplicates, rejected, retry_after)
@@ -0,0 +1,328 @@
+// Native numeric kernels for services/kernels.py (module greenhouse_kernels).
+//
+// mean(values)                    -> arithmetic mean, or None
+// summary(values)                 -> (count, mean, stdev, min, max) or None
+// median_mad(values, start, count) -> (median, mad) of values[start:start+count]
+//
+// Inputs are contiguous buffers (array('d'), array('f'), array('h'), array('i'),
+// array('q'), bytes-like of those formats) or sequences of numbers. Reductions
+// are written as OpenMP SIMD loops (-fopenmp-simd, no OpenMP runtime needed),
+// and the GIL is released while large buffers are processed. Results match the
+// pure-Python versions in services/kernels.py (see benchmarks/bench_kernels.py).
+#define PY_SSIZE_T_CLEAN
+#include <Python.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <vector>
+
+namespace {
+
+// Inputs at least this long are processed with the GIL released
+constexpr Py_ssize_t kReleaseGilAbove = 4096;
+
+struct Stats {
+    Py_ssize_t count = 0;
+    double mean = 0.0;
+    double stdev = 0.0;
+    double min = 0.0;
+    double max = 0.0;
+};
+
+// Sum, minimum and maximum in one vectorized pass; then the squared deviations
+// from the mean in a second pass (numerically stable sample variance).
+template <typename T>
+Stats compute_stats(const T* data, Py_ssize_t n) {
+    Stats stats;
+    stats.count = n;
+    double sum = 0.0;
+    double lo = static_cast<double>(data[0]);
+    double hi = lo;
+#pragma omp simd reduction(+ : sum) reduction(min : lo) reduction(max : hi)
+    for (Py_ssize_t i = 0; i < n; ++i) {
+        const double x = static_cast<double>(data[i]);
+        sum += x;
+        lo = x < lo ? x : lo;
+        hi = x > hi ? x : hi;
+    }
+    const double mean = sum / static_cast<double>(n);
+    double squares = 0.0;
+#pragma omp simd reduction(+ : squares)
+    for (Py_ssize_t i = 0; i < n; ++i) {
+        const double d = static_cast<double>(data[i]) - mean;
+        squares += d * d;
+    }
+    stats.mean = mean;
+    stats.stdev = n > 1 ? std::sqrt(squares / static_cast<double>(n - 1)) : 0.0;
+    stats.min = lo;
+    stats.max = hi;
+    return stats;
+}
+
+template <typename T>
+double compute_mean(const T* data, Py_ssize_t n) {
+    double sum = 0.0;
+#pragma omp simd reduction(+ : sum)
+    for (Py_ssize_t i = 0; i < n; ++i) {
+        sum += static_cast<double>(data[i]);
+    }
+    return sum / static_cast<double>(n);
+}
+
+template <typename T>
+double mean_released(const T* data, Py_ssize_t n) {
+    if (n < kReleaseGilAbove) {
+        return compute_mean(data, n);
+    }
+    double mean;
+    Py_BEGIN_ALLOW_THREADS
+    mean = compute_mean(data, n);
+    Py_END_ALLOW_THREADS
+    return mean;
+}
+
+template <typename T>
+Stats stats_released(const T* data, Py_ssize_t n) {
+    if (n < kReleaseGilAbove) {
+        return compute_stats(data, n);
+    }
+    Stats stats;
+    Py_BEGIN_ALLOW_THREADS
+    stats = compute_stats(data, n);
+    Py_END_ALLOW_THREADS
+    return stats;
+}
+
+// Upper median (sorted[n / 2]) and the upper median of absolute deviations,
+// the same elements the Python version picks from sorted lists.
+void median_mad_of(std::vector<int64_t>& values, int64_t* median, int64_t* mad) {
+    const size_t mid = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + mid, values.end());
+    const int64_t m = values[mid];
+    for (int64_t& v : values) {
+        v = v > m ? v - m : m - v;
+    }
+    std::nth_element(values.begin(), values.begin() + mid, values.end());
+    *median = m;
+    *mad = values[mid];
+}
+
+// Buffer formats accepted as contiguous numeric arrays
+enum class Kind { kDouble, kFloat, kInt16, kInt32, kInt64, kUnsupported };
+
+Kind buffer_kind(const Py_buffer& view) {
+    const char* format = view.format ? view.format : "B";
+    if (*format == '@' || *format == '=' || *format == '<') {
+        ++format;
+    }
+    if (format[0] == '\0' || format[1] != '\0') {
+        return Kind::kUnsupported;
+    }
+    switch (format[0]) {
+        case 'd': return Kind::kDouble;
+        case 'f': return Kind::kFloat;
+        case 'h': return Kind::kInt16;
+        case 'i': return view.itemsize == 4 ? Kind::kInt32 : Kind::kUnsupported;
+        case 'l': return view.itemsize == 8 ? Kind::kInt64 : (view.itemsize == 4 ? Kind::kInt32 : Kind::kUnsupported);
+        case 'q': return Kind::kInt64;
+        default: return Kind::kUnsupported;
+    }
+}
+
+// Holds a contiguous 1-D buffer for the duration of a call, if the object exports one
+class Buffer {
+public:
+    explicit Buffer(PyObject* obj) {
+        if (PyObject_CheckBuffer(obj) && PyObject_GetBuffer(obj, &view_, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) == 0) {
+            held_ = true;
+            kind_ = view_.ndim <= 1 ? buffer_kind(view_) : Kind::kUnsupported;
+        } else {
+            PyErr_Clear();
+        }
+    }
+    ~Buffer() {
+        if (held_) {
+            PyBuffer_Release(&view_);
+        }
+    }
+    Buffer(const Buffer&) = delete;
+    Buffer& operator=(const Buffer&) = delete;
+
+    bool usable() const { return held_ && kind_ != Kind::kUnsupported; }
+    Kind kind() const { return kind_; }
+    const void* data() const { return view_.buf; }
+    Py_ssize_t length() const { return view_.itemsize ? view_.len / view_.itemsize : 0; }
+
+private:
+    Py_buffer view_{};
+    bool held_ = false;
+    Kind kind_ = Kind::kUnsupported;
+};
+
+// Copies a sequence of numbers into doubles (needs the GIL); false with an exception set on failure
+bool sequence_to_doubles(PyObject* obj, std::vector<double>* out) {
+    PyObject* seq = PySequence_Fast(obj, "expected a buffer or a sequence of numbers");
+    if (seq == nullptr) {
+        return false;
+    }
+    const Py_ssize_t n = PySequence_Fast_GET_SIZE(seq);
+    PyObject** items = PySequence_Fast_ITEMS(seq);
+    out->resize(static_cast<size_t>(n));
+    for (Py_ssize_t i = 0; i < n; ++i) {
+        PyObject* item = items[i];
+        const double x = PyFloat_CheckExact(item) ? PyFloat_AS_DOUBLE(item) : PyFloat_AsDouble(item);
+        if (x == -1.0 && PyErr_Occurred()) {
+            Py_DECREF(seq);
+            return false;
+        }
+        (*out)[static_cast<size_t>(i)] = x;
+    }
+    Py_DECREF(seq);
+    return true;
+}
+
+PyObject* stats_tuple(const Stats& stats) {
+    return Py_BuildValue("(ndddd)", stats.count, stats.mean, stats.stdev, stats.min, stats.max);
+}
+
+// Applies `reduce` (a generic lambda over (const T*, n)) to a buffer or a sequence of numbers:
+// None for no values, nullptr with an exception set on bad input
+template <typename Reduce>
+PyObject* reduce_values(PyObject* obj, Reduce reduce) {
+    Buffer buffer(obj);
+    if (buffer.usable()) {
+        const Py_ssize_t n = buffer.length();
+        if (n == 0) {
+            Py_RETURN_NONE;
+        }
+        switch (buffer.kind()) {
+            case Kind::kDouble: return reduce(static_cast<const double*>(buffer.data()), n);
+            case Kind::kFloat: return reduce(static_cast<const float*>(buffer.data()), n);
+            case Kind::kInt16: return reduce(static_cast<const int16_t*>(buffer.data()), n);
+            case Kind::kInt32: return reduce(static_cast<const int32_t*>(buffer.data()), n);
+            case Kind::kInt64: return reduce(static_cast<const int64_t*>(buffer.data()), n);
+            case Kind::kUnsupported: break;
+        }
+    }
+    std::vector<double> values;
+    if (!sequence_to_doubles(obj, &values)) {
+        return nullptr;
+    }
+    if (values.empty()) {
+        Py_RETURN_NONE;
+    }
+    return reduce(static_cast<const double*>(values.data()), static_cast<Py_ssize_t>(values.size()));
+}
+
+PyObject* mean(PyObject*, PyObject* const* args, Py_ssize_t nargs) {
+    if (nargs != 1) {
+        PyErr_SetString(PyExc_TypeError, "mean() takes exactly one argument");
+        return nullptr;
+    }
+    return reduce_values(args[0], [](const auto* data, Py_ssize_t n) {
+        return PyFloat_FromDouble(mean_released(data, n));
+    });
+}
+
+PyObject* summary(PyObject*, PyObject* const* args, Py_ssize_t nargs) {
+    if (nargs != 1) {
+        PyErr_SetString(PyExc_TypeError, "summary() takes exactly one argument");
+        return nullptr;
+    }
+    return reduce_values(args[0], [](const auto* data, Py_ssize_t n) {
+        return stats_tuple(stats_released(data, n));
+    });
+}
+
+template <typename T>
+void copy_range(const void* data, Py_ssize_t start, Py_ssize_t count, std::vector<int64_t>* out) {
+    const T* typed = static_cast<const T*>(data) + start;
+    out->assign(typed, typed + count);
+}
+
+PyObject* median_mad(PyObject*, PyObject* const* args, Py_ssize_t nargs) {
+    if (nargs != 3) {
+        PyErr_SetString(PyExc_TypeError, "median_mad() takes exactly three arguments (values, start, count)");
+        return nullptr;
+    }
+    const Py_ssize_t start = PyLong_AsSsize_t(args[1]);
+    if (start == -1 && PyErr_Occurred()) {
+        return nullptr;
+    }
+    const Py_ssize_t count = PyLong_AsSsize_t(args[2]);
+    if (count == -1 && PyErr_Occurred()) {
+        return nullptr;
+    }
+    if (start < 0 || count <= 0) {
+        PyErr_SetString(PyExc_ValueError, "median_mad() needs start >= 0 and count > 0");
+        return nullptr;
+    }
+
+    std::vector<int64_t> values;
+    Buffer buffer(args[0]);
+    if (buffer.usable() && buffer.kind() != Kind::kDouble && buffer.kind() != Kind::kFloat) {
+        if (start + count > buffer.length()) {
+            PyErr_SetString(PyExc_IndexError, "median_mad() range is outside the buffer");
+            return nullptr;
+        }
+        switch (buffer.kind()) {
+            case Kind::kInt16: copy_range<int16_t>(buffer.data(), start, count, &values); break;
+            case Kind::kInt32: copy_range<int32_t>(buffer.data(), start, count, &values); break;
+            default: copy_range<int64_t>(buffer.data(), start, count, &values); break;
+        }
+    } else {
+        PyObject* seq = PySequence_Fast(args[0], "median_mad() expects integers");
+        if (seq == nullptr) {
+            return nullptr;
+        }
+        if (start + count > PySequence_Fast_GET_SIZE(seq)) {
+            Py_DECREF(seq);
+            PyErr_SetString(PyExc_IndexError, "median_mad() range is outside the sequence");
+            return nullptr;
+        }
+        PyObject** items = PySequence_Fast_ITEMS(seq);
+        values.resize(static_cast<size_t>(count));
+        for (Py_ssize_t i = 0; i < count; ++i) {
+            const long long v = PyLong_AsLongLong(items[start + i]);
+            if (v == -1 && PyErr_Occurred()) {
+                Py_DECREF(seq);
+                return nullptr;
+            }
+            values[static_cast<size_t>(i)] = v;
+        }
+        Py_DECREF(seq);
+    }
+
+    int64_t median = 0;
+    int64_t mad = 0;
+    // Detector windows are small; the selection is cheaper than a GIL round trip
+    median_mad_of(values, &median, &mad);
+    return Py_BuildValue("(LL)", static_cast<long long>(median), static_cast<long long>(mad));
+}
+
+PyMethodDef kMethods[] = {
+    {"mean", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(mean)), METH_FASTCALL,
+     "mean(values) -> arithmetic mean, or None if values is empty."},
+    {"summary", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(summary)), METH_FASTCALL,
+     "summary(values) -> (count, mean, stdev, min, max), or None if values is empty.\n\n"
+     "stdev is the sample standard deviation (0.0 for a single value)."},
+    {"median_mad", reinterpret_cast<PyCFunction>(reinterpret_cast<void (*)(void)>(median_mad)), METH_FASTCALL,
+     "median_mad(values, start, count) -> (median, mad) of the integers values[start:start + count].\n\n"
+     "Both are upper medians (element n // 2 of the sorted values)."},
+    {nullptr, nullptr, 0, nullptr},
+};
+
+PyModuleDef kModule = {
+    PyModuleDef_HEAD_INIT,
+    "greenhouse_kernels",
+    "Native numeric kernels for the greenhouse backend (see services/kernels.py).",
+    -1,
+    kMethods,
+};
+
+}  // namespace
+
+PyMODINIT_FUNC PyInit_greenhouse_kernels(void) {
+    return PyModule_Create(&kModule);
+}
@@ -0,0 +1,37 @@
+"""Build script for the optional native kernels (module greenhouse_kernels).
+
+    pip install ./native                          # into the active environment
+    python native/setup.py build_ext --inplace    # next to the sources, for development
+
+The backend runs without it (services/kernels.py falls back to Python).
+"""
+import os
+import sys
+from setuptools import Extension, setup
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+
+if sys.platform == "win32":
+    compile_args = ["/O2", "/std:c++17", "/openmp:experimental"]
+else:
+    # -fopenmp-simd honours the SIMD pragmas without linking an OpenMP runtime
+    compile_args = ["-O3", "-std=c++17", "-fopenmp-simd", "-fvisibility=hidden"]
+    # e.g. GREENHOUSE_KERNELS_MARCH=native for AVX2 on the build machine itself
+    march = os.getenv("GREENHOUSE_KERNELS_MARCH")
+    if march:
+        compile_args.append(f"-march={march}")
+
+setup(
+    name="greenhouse-kernels",
+    version="1.0.0",
+    description="Native numeric kernels for the greenhouse sensor backend",
+    ext_modules=[
+        Extension(
+            "greenhouse_kernels",
+            sources=[os.path.relpath(os.path.join(HERE, "greenhouse_kernels.cpp"))],
+            language="c++",
+            extra_compile_args=compile_args,
+        )
+    ],
+    zip_safe=False,
+)
@@ -0,0 +1,112 @@
+"""Admin diagnostics endpoints: CPU profiles and allocation snapshots of the running process."""
+import asyncio
+from datetime import datetime
+from typing import Literal
+from fastapi import APIRouter, Depends, HTTPException, Query, Response
+from middleware.auth import get_current_token
+from services.profiling import (
+    PROFILER_MAX_SECONDS,
+    TRACEMALLOC_MAX_FRAMES,
+    TRACEMALLOC_MAX_SECONDS,
+    ProfilerBusyError,
+    TracingStateError,
+    allocation_tracer,
+    sampling_profiler,
+)
+
+router = APIRouter(prefix="/api/admin", tags=["admin"])
+
+GroupBy = Literal["lineno", "filename", "traceback"]
+
+
+@router.get("/profile")
+async def get_profile(
+    seconds: float = Query(10.0, gt=0, le=PROFILER_MAX_SECONDS, description="Profile length"),
+    interval_ms: float = Query(10.0, ge=1, le=1000, description="Target time between samples"),
+    format: Literal["collapsed", "svg"] = Query("collapsed", description="Collapsed stacks or SVG flame graph"),
+    include_idle: bool = Query(False, description="Keep samples of threads waiting for work"),
+    token: str = Depends(get_current_token)
+):
+    """
+    Sample the stacks of all threads for `seconds` and return them as a file.
+
+    `collapsed` is the folded-stack text read by flamegraph.pl and speedscope;
+    `svg` is a flame graph to open in a browser. The sample rate is lowered
+    automatically to keep sampling under PROFILER_MAX_OVERHEAD of the interpreter.
+    Only one profile runs at a time (409 otherwise).
+    """
+    try:
+        profile = await asyncio.to_thread(sampling_profiler.profile, seconds, interval_ms / 1000.0, include_idle)
+    except ProfilerBusyError as e:
+        raise HTTPException(status_code=409, detail=str(e))
+    stamp = datetime.utcnow().strftime("%Y%m%dT%H%M%SZ")
+    if format == "svg":
+        content, media_type, suffix = profile.flamegraph_svg(f"CPU profile {stamp}"), "image/svg+xml", "svg"
+    else:
+        content, media_type, suffix = profile.collapsed(), "text/plain; charset=utf-8", "txt"
+    return Response(
+        content=content,
+        media_type=media_type,
+        headers={
+            "Content-Disposition": f'attachment; filename="profile-{stamp}.{suffix}"',
+            "X-Profile-Samples": str(profile.samples),
+            "X-Profile-Interval-Ms": f"{profile.interval_ms:.2f}",
+            "X-Profile-Overhead": f"{profile.overhead:.4f}",
+        }
+    )
+
+
+@router.get("/tracemalloc")
+async def get_tracemalloc_status(token: str = Depends(get_current_token)):
+    """Whether allocation tracing is running, and how much it has traced and costs."""
+    return allocation_tracer.status()
+
+
+@router.post("/tracemalloc/start")
+async def start_tracemalloc(
+    frames: int = Query(1, ge=1, le=TRACEMALLOC_MAX_FRAMES, description="Frames kept per allocation traceback"),
+    seconds: float = Query(300.0, gt=0, le=TRACEMALLOC_MAX_SECONDS, description="Stop automatically after"),
+    token: str = Depends(get_current_token)
+):
+    """
+    Start tracing allocations.
+
+    Tracing slows allocation-heavy code and costs memory per live allocation;
+    it stops by itself after `seconds` or when its memory exceeds TRACEMALLOC_MAX_MEMORY_MB.
+    """
+    try:
+        return await allocation_tracer.start(frames, seconds)
+    except TracingStateError as e:
+        raise HTTPException(status_code=409, detail=str(e))
+
+
+@router.post("/tracemalloc/stop")
+async def stop_tracemalloc(token: str = Depends(get_current_token)):
+    """Stop tracing allocations and free the traces."""
+    return allocation_tracer.stop()
+
+
+@router.post("/tracemalloc/snapshot")
+async def take_tracemalloc_snapshot(
+    group_by: GroupBy = Query("lineno", description="Group allocations by line, file or full traceback"),
+    limit: int = Query(25, ge=1, le=500, description="Allocation sites to return"),
+    token: str = Depends(get_current_token)
+):
+    """Top allocation sites by size. The snapshot becomes the baseline for `/tracemalloc/diff`."""
+    try:
+        return await asyncio.to_thread(allocation_tracer.snapshot, group_by, limit)
+    except TracingStateError as e:
+        raise HTTPException(status_code=409, detail=str(e))
+
+
+@router.get("/tracemalloc/diff")
+async def get_tracemalloc_diff(
+    group_by: GroupBy = Query("lineno", description="Group allocations by line, file or full traceback"),
+    limit: int = Query(25, ge=1, le=500, description="Allocation sites to return"),
+    token: str = Depends(get_current_token)
+):
+    """Allocation sites whose size changed most since the baseline snapshot (growth first)."""
+    try:
+        return await asyncio.to_thread(allocation_tracer.diff, group_by, limit)
+    except TracingStateError as e:
+        raise HTTPException(status_code=409, detail=str(e))
@@ -1,13 +1,20 @@
 """API routes for AI insights endpoint."""
-from fastapi import APIRouter, Depends, HTTPException, Query
+from fastapi import APIRouter, Depends, HTTPException, Query, Response
 from sqlalchemy.orm import Session
 from datetime import datetime
 from typing import List, Optional
 from models.database import get_db
-from models.schemas import AIInsightsResponse, NodeInsightsResponse, TrendInsightsResponse, InsightDetail
+from models.schemas import (
+    AIInsightsResponse, NodeInsightsResponse, TrendInsightsResponse, InsightDetail,
+    AnomalyEventResponse, AnomalyEventsResponse, MoistureForecastItem, MoistureForecastResponse
+)
 from services.sensor_service import SensorService
 from services.ai_insights import AIInsightsService
 from services.trend_insights_service import TrendInsightService
+from services.analytics import run_analytics
+from services.insight_scheduler import FLEET_SCOPE, NODE_KIND, TREND_KIND, InsightService
+from services.anomaly_detector import AnomalyService, ANOMALY_METRICS
+from services.moisture_forecast import FORECAST_TARGET_PERCENT, moisture_forecaster
 from ai.ai_insights_analyzer import AIInsightsAnalyzer
 
 router = APIRouter(prefix="/api/ai", tags=["ai"])
@@ -22,6 +29,10 @@ async def get_ai_insights(
     """
     Get AI-generated insights based on sensor trend analysis.
     
+    Windows in INSIGHT_TREND_WINDOWS (default: 60 minutes) are precomputed in
+    the background and served from the insights table; `computed_at` tells when.
+    Other windows are analyzed for the request.
+    
     Analyzes recent sensor trends (last N minutes) and detects:
     - **Drought risk**: Low soil moisture and declining trends
     - **Overwatering risk**: High soil moisture with poor drainage
@@ -67,9 +78,14 @@ async def get_ai_insights(
     replaced with machine learning models while maintaining the same API interface.
     """
     try:
-        # Use comprehensive trend analysis service
-        analysis_result = TrendInsightService.analyze_trends(
-            db=db,
+        if InsightService.is_precomputed(TREND_KIND, minutes):
+            stored = InsightService.get(db, node_id or FLEET_SCOPE, TREND_KIND, minutes)
+            if stored is not None:
+                return Response(content=stored.result, media_type="application/json")
+
+        # Use comprehensive trend analysis service (on a read snapshot, off the event loop)
+        analysis_result = await run_analytics(
+            TrendInsightService.analyze_trends,
             node_id=node_id,
             minutes=minutes
         )
@@ -94,14 +110,74 @@ async def get_ai_insights(
         )
 
 
-@router.get("/insights/{node_id}", response_model=NodeInsightsResponse)
-async def get_node_insights(
-    node_id: str,
+@router.get("/anomalies", response_model=AnomalyEventsResponse)
+async def get_anomalies(
+    node_id: Optional[str] = Query(None, description="Filter anomalies for specific node ID"),
+    metric: Optional[str] = Query(None, description="temperature, humidity or soil_moisture"),
+    hours: int = Query(24, ge=1, le=720, description="Number of hours to look back (1-720, default: 24)"),
+    limit: int = Query(100, ge=1, le=1000, description="Maximum number of events"),
     db: Session = Depends(get_db)
 ):
+    """
+    Get anomalies found by the streaming detector, newest first.
+
+    Every ingested reading is checked as it arrives, per node and metric:
+    - **spike**: a single reading far from the recent median (robust z-score)
+    - **level_shift**: a jump that persisted (soil moisture rises from irrigation
+      are not reported)
+    - **drift_up / drift_down**: a sustained departure from the node's usual
+      value for that time of day (CUSUM), typically flagged hours before a
+      hard threshold is crossed
+    """
+    if metric is not None and metric not in ANOMALY_METRICS:
+        raise HTTPException(
+            status_code=400,
+            detail=f"Unknown metric '{metric}'. Expected one of: {', '.join(ANOMALY_METRICS)}"
+        )
+    events = AnomalyService.get_events(db, node_id=node_id, metric=metric, hours=hours, limit=limit)
+    return AnomalyEventsResponse(
+        anomalies=[AnomalyEventResponse.model_validate(event) for event in events],
+        count=len(events),
+        hours=hours
+    )
+
+
+@router.get("/moisture-forecast", response_model=MoistureForecastResponse)
+async def get_moisture_forecast(
+    target: float = Query(FORECAST_TARGET_PERCENT, ge=0, le=100, description="Soil moisture level (%) to forecast"),
+    gateway_id: Optional[str] = Query(None, description="Only nodes of this gateway")
+):
+    """
+    Hours until each node's soil moisture reaches `target`, soonest first.
+
+    Served from per-node depletion models updated on every ingested reading
+    (no database query). The model fits the current drying segment, restarts at
+    each detected irrigation, and applies the node's learned hour-of-day drying
+    rate, so forecasts account for faster drying in daylight.
+
+    `status` is `drying`, `not_drying` (no depletion within 14 days),
+    `below_target`, `learning` (fewer than 30 minutes since irrigation or
+    first contact) or `stale` (no recent readings).
+    """
+    now = datetime.utcnow()
+    forecasts = moisture_forecaster.fleet(target=target, gateway_id=gateway_id, now=now)
+    return MoistureForecastResponse(
+        target_percent=target,
+        forecasts=[MoistureForecastItem.model_validate(f) for f in forecasts],
+        count=len(forecasts),
+        generated_at=now
+    )
+
+
+@router.get("/insights/{node_id}", response_model=NodeInsightsResponse)
+async def get_node_insights(node_id: str, db: Session = Depends(get_db)):
     """
     Get AI insights for a specific sensor node based on historical data analysis.
     
+    Results are precomputed in the background after the node stores new
+    readings (see `computed_at`). Nodes without a stored result yet are
+    analyzed for the request.
+    
     Analyzes historical sensor data (24 hours and 7 days) to provide:
     - Summary of detected conditions
     - Risk level assessment (low, medium, high)
@@ -149,8 +225,13 @@ async def get_node_insights(
     - All metrics are optional and will be null if insufficient data
     """
     try:
-        # Perform analysis
-        analysis_result = AIInsightsService.analyze_node(db, node_id)
+        if InsightService.is_precomputed(NODE_KIND):
+            stored = InsightService.get(db, node_id, NODE_KIND)
+            if stored is not None:
+                return Response(content=stored.result, media_type="application/json")
+
+        # Perform analysis (on a read snapshot, off the event loop)
+        analysis_result = await run_analytics(AIInsightsService.analyze_node, node_id)
         
         # Convert to response model
         return NodeInsightsResponse(**analysis_result)
@@ -0,0 +1,66 @@
+"""API routes for the alert lifecycle."""
+from fastapi import APIRouter, Depends, HTTPException, Query
+from sqlalchemy.orm import Session
+from typing import Optional
+from middleware.auth import get_current_token
+from models.database import get_db
+from models.schemas import AlertResponse, AlertsResponse
+from services.alert_manager import AlertService, AlertStateError, alert_manager
+from services.webhook_dispatcher import webhook_dispatcher
+
+router = APIRouter(prefix="/api/alerts", tags=["alerts"])
+
+ALERT_STATUSES = ("active", "open", "acknowledged", "resolved")
+
+
+@router.get("", response_model=AlertsResponse)
+async def get_alerts(
+    status: Optional[str] = Query("active", description="active (open or acknowledged), open, acknowledged or resolved"),
+    node_id: Optional[str] = Query(None, description="Only alerts for this node"),
+    limit: int = Query(100, ge=1, le=1000, description="Maximum number of alerts"),
+    db: Session = Depends(get_db)
+):
+    """
+    Alerts raised by threshold rules and drift anomalies, most recently opened first.
+
+    An alert opens once its condition has held for the minimum duration, stays
+    a single record while the condition persists, and resolves once the value
+    is back past the threshold by the hysteresis margin for long enough.
+    """
+    if status is not None and status not in ALERT_STATUSES:
+        raise HTTPException(
+            status_code=400,
+            detail=f"Unknown status '{status}'. Expected one of: {', '.join(ALERT_STATUSES)}"
+        )
+    alerts = AlertService.get_alerts(db, status=status, node_id=node_id, limit=limit)
+    return AlertsResponse(alerts=alerts, count=len(alerts))
+
+
+@router.post("/{alert_id}/ack", response_model=AlertResponse)
+async def acknowledge_alert(alert_id: int, db: Session = Depends(get_db), token: str = Depends(get_current_token)):
+    """Acknowledge an open alert. It stays active until its condition clears."""
+    try:
+        alert = alert_manager.acknowledge(db, alert_id)
+    except AlertStateError as e:
+        raise HTTPException(status_code=409, detail=str(e))
+    if alert is None:
+        raise HTTPException(status_code=404, detail=f"Alert {alert_id} not found")
+    return alert
+
+
+@router.post("/{alert_id}/resolve", response_model=AlertResponse)
+async def resolve_alert(alert_id: int, db: Session = Depends(get_db), token: str = Depends(get_current_token)):
+    """Resolve an alert by hand. A condition that still holds will raise a new alert."""
+    alert = alert_manager.resolve(db, alert_id)
+    if alert is None:
+        raise HTTPException(status_code=404, detail=f"Alert {alert_id} not found")
+    return alert
+
+
+@router.post("/test-webhook")
+async def test_webhook(token: str = Depends(get_current_token)):
+    """Send an `alert.test` event to every configured webhook endpoint."""
+    if not webhook_dispatcher.urls:
+        raise HTTPException(status_code=400, detail="No webhook endpoints configured (set WEBHOOK_URLS)")
+    webhook_dispatcher.enqueue("alert.test", {"message": "Test event from the greenhouse backend"})
+    return {"status": "queued", "endpoints": len(webhook_dispatcher.urls)}
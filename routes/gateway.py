@@ -5,8 +5,12 @@ from typing import Optional, List
 from datetime import datetime
 from models.database import get_db
 from services.gateway_service import GatewayService
+from services.liveness import liveness_tracker
+from services import data_versions
+from middleware.http_cache import cached_json_response
 from pydantic import BaseModel
 import logging
+import time
 
 logger = logging.getLogger(__name__)
 router = APIRouter(prefix="/api/gateway", tags=["gateway"])
@@ -15,6 +19,9 @@ router = APIRouter(prefix="/api/gateway", tags=["gateway"])
 # Key: gateway_id, Value: dict with status info
 _gateway_status_cache: dict[str, dict] = {}
 
+# Maximum age of a cached /list body (bounds staleness of last_seen_seconds_ago)
+GATEWAY_LIST_CACHE_SECONDS = 10
+
 
 @router.get("/status")
 async def get_gateway_status(
@@ -49,8 +56,8 @@ async def get_gateway_status(
     ```
     
     **Online Status Logic:**
-    - Gateway is considered online if last_seen is within the last 5 minutes
-    - Automatically updated when gateway sends sensor data
+    - Gateway goes offline GATEWAY_OFFLINE_SECONDS (default 5 minutes) after its last message
+    - Comes back online as soon as it sends sensor data or a status update
     - Active node count is updated when gateway sends status updates
     """
     try:
@@ -131,6 +138,7 @@ async def update_gateway_status(
             "backend_reachable": data.get("backendReachable", False),
             "last_updated": datetime.utcnow().isoformat()
         }
+        data_versions.bump_gateway_meta()
         
         logger.info(
             f"Gateway status updated: {gateway_id}, "
@@ -155,34 +163,79 @@ async def update_gateway_status(
 
 
 @router.get("/list")
-async def list_gateways(db: Session = Depends(get_db)):
+async def list_gateways(request: Request, db: Session = Depends(get_db)):
     """
     List all registered gateways.
     
     Returns a list of all gateways with their status information.
     Useful for monitoring multiple gateways in a network.
+    
+    Responses carry a strong ETag. Since `last_seen_seconds_ago` changes continuously,
+    the list is re-rendered at most every GATEWAY_LIST_CACHE_SECONDS unless gateway
+    data changes; polls in between are answered with 304 or the cached body.
     """
-    try:
+    def build():
         gateways = GatewayService.get_all_gateways(db)
         
         result = []
         for gateway in gateways:
-            status = GatewayService.get_gateway_status(db, gateway.gateway_id)
-            if status:
-                # Add cached status info if available
-                if gateway.gateway_id in _gateway_status_cache:
-                    cached = _gateway_status_cache[gateway.gateway_id]
-                    status["active_node_count"] = cached.get("active_node_count", 0)
-                    status["network_mode"] = cached.get("network_mode", "UNKNOWN")
-                result.append(status)
+            status = GatewayService.gateway_status(gateway)
+            # Add cached status info if available
+            if gateway.gateway_id in _gateway_status_cache:
+                cached = _gateway_status_cache[gateway.gateway_id]
+                status["active_node_count"] = cached.get("active_node_count", 0)
+                status["network_mode"] = cached.get("network_mode", "UNKNOWN")
+            result.append(status)
         
         return {
             "gateways": result,
             "count": len(result)
         }
+    
+    try:
+        return cached_json_response(
+            request,
+            key=("gateway_list",),
+            versions=(
+                data_versions.global_version(),
+                data_versions.gateway_meta_version(),
+                int(time.time()) // GATEWAY_LIST_CACHE_SECONDS
+            ),
+            build=build
+        )
     except Exception as e:
         raise HTTPException(
             status_code=500,
             detail=f"Error listing gateways: {str(e)}"
         )
 
+
+@router.get("/nodes")
+async def list_node_liveness(
+    gateway_id: Optional[str] = Query(None, description="Only nodes of this gateway")
+):
+    """
+    Online/offline state of every known sensor node.
+
+    Served from the in-memory liveness tracker. A node goes offline
+    NODE_OFFLINE_SECONDS (default 10 minutes) after its last reading; transitions
+    are also pushed to stream subscribers as `{"type": "liveness", ...}`.
+
+    **Example Response:**
+    ```json
+    {
+        "nodes": [
+            {"kind": "node", "id": "node-01", "gateway_id": "gateway-01",
+             "is_online": true, "last_seen": "2024-01-15T10:30:00"}
+        ],
+        "count": 1,
+        "online": 1
+    }
+    ```
+    """
+    records = sorted(liveness_tracker.records("node", gateway_id=gateway_id), key=lambda r: r.entity_id)
+    return {
+        "nodes": [record.to_dict() for record in records],
+        "count": len(records),
+        "online": sum(1 for record in records if record.online)
+    }
@@ -1,9 +1,8 @@
 """API routes for AI insights endpoint."""
-from fastapi import APIRouter, Depends, HTTPException
-from sqlalchemy.orm import Session
+from fastapi import APIRouter, HTTPException
 from datetime import datetime
-from models.database import get_db
 from models.schemas import InsightsResponse
+from services.analytics import run_analytics
 from services.sensor_service import SensorService
 from ai.analyzer import SensorAnalyzer
 
@@ -11,7 +10,7 @@ router = APIRouter(prefix="/api/insights", tags=["insights"])
 
 
 @router.get("", response_model=InsightsResponse)
-async def get_insights(db: Session = Depends(get_db)):
+async def get_insights():
     """
     Get AI-generated insights based on latest sensor readings.
     
@@ -44,8 +43,8 @@ async def get_insights(db: Session = Depends(get_db)):
     ```
     """
     try:
-        # Get latest reading from each sensor
-        latest_readings = SensorService.get_latest_per_sensor(db)
+        # Get latest reading from each sensor (on a read snapshot, off the event loop)
+        latest_readings = await run_analytics(SensorService.get_latest_per_node)
         
         if not latest_readings:
             raise HTTPException(
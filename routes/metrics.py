@@ -0,0 +1,122 @@
+"""Prometheus metrics endpoint."""
+from fastapi import APIRouter, Response
+from models import migrations
+from services import metrics, mqtt_ingest, udp_ingest
+from services.stream_hub import stream_hub
+from services.alert_manager import alert_manager
+from services.webhook_dispatcher import webhook_dispatcher
+from services.liveness import liveness_tracker
+from services.zones import zone_aggregator
+from services.reading_store import block_compactor
+from services.insight_scheduler import insight_scheduler
+from services.profiling import allocation_tracer
+
+router = APIRouter(tags=["metrics"])
+
+
+def _mqtt_queue_depth():
+    service = mqtt_ingest.mqtt_ingest
+    return service.queue_depth if service else None
+
+
+def _udp_queue_depth():
+    protocol = udp_ingest.udp_ingest
+    return protocol.queue_depth if protocol else None
+
+
+metrics.register_gauge(
+    "greenhouse_stream_subscribers",
+    "Active WebSocket/SSE stream subscriptions",
+    lambda: stream_hub.subscriber_count
+)
+metrics.register_gauge(
+    "greenhouse_stream_queue_depth",
+    "Messages waiting in stream subscriber queues",
+    lambda: stream_hub.queue_depth
+)
+metrics.register_gauge(
+    "greenhouse_mqtt_queue_depth",
+    "MQTT messages received but not yet stored",
+    _mqtt_queue_depth
+)
+metrics.register_gauge(
+    "greenhouse_udp_queue_depth",
+    "UDP frames received but not yet stored",
+    _udp_queue_depth
+)
+metrics.register_gauge(
+    "greenhouse_alerts_active",
+    "Open or acknowledged alerts tracked by this process",
+    lambda: alert_manager.active_count
+)
+metrics.register_gauge(
+    "greenhouse_webhook_queue_depth",
+    "Alert events waiting for webhook delivery (summed over endpoints)",
+    lambda: webhook_dispatcher.queue_depth
+)
+metrics.register_gauge(
+    "greenhouse_gateways_online",
+    "Gateways currently online",
+    lambda: liveness_tracker.online_count("gateway")
+)
+metrics.register_gauge(
+    "greenhouse_nodes_online",
+    "Sensor nodes currently online",
+    lambda: liveness_tracker.online_count("node")
+)
+metrics.register_gauge(
+    "greenhouse_insight_queue_depth",
+    "Insight recomputations waiting for a worker",
+    lambda: insight_scheduler.queue_depth
+)
+metrics.register_gauge(
+    "greenhouse_insight_oldest_age_seconds",
+    "Age of the least recently computed stored insight",
+    insight_scheduler.oldest_age
+)
+metrics.register_gauge(
+    "greenhouse_tracemalloc_overhead_bytes",
+    "Memory used by allocation tracing (0 when it is off)",
+    lambda: allocation_tracer.overhead_bytes
+)
+metrics.register_gauge(
+    "greenhouse_startup_seconds",
+    "Time from application startup to serving requests",
+    lambda: metrics.startup_timings.get("total")
+)
+metrics.register_gauge(
+    "greenhouse_startup_schema_seconds",
+    "Time spent checking and migrating the schema at startup",
+    lambda: metrics.startup_timings.get("schema")
+)
+metrics.register_gauge(
+    "greenhouse_startup_migrations_applied",
+    "Schema migration steps applied at the last startup",
+    lambda: len(migrations.report.applied)
+)
+metrics.register_gauge(
+    "greenhouse_schema_version",
+    "Highest applied schema migration step",
+    lambda: migrations.report.version
+)
+metrics.register_gauge(
+    "greenhouse_schema_deferred_pending",
+    "Deferred schema steps (background index builds) not yet applied",
+    lambda: migrations.report.deferred_pending
+)
+metrics.register_gauge(
+    "greenhouse_zone_rollup_pending_buckets",
+    "Zone rollup buckets summed in memory and not yet flushed",
+    lambda: zone_aggregator.pending_buckets
+)
+metrics.register_gauge(
+    "greenhouse_reading_blocks_compacted_readings",
+    "Readings moved into compressed blocks by this process",
+    lambda: block_compactor.readings_compacted
+)
+
+
+@router.get("/metrics", include_in_schema=False)
+async def get_metrics():
+    """Expose metrics in the Prometheus text format."""
+    return Response(content=metrics.registry.render(), media_type=metrics.CONTENT_TYPE)
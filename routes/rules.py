@@ -0,0 +1,53 @@
+"""API routes for declarative threshold rules."""
+from fastapi import APIRouter, Depends, HTTPException, Query
+from typing import Optional
+from middleware.auth import get_current_token
+from models.schemas import RuleEventResponse, RuleEventsResponse
+from services.rule_engine import RuleConfigError, rule_engine
+
+router = APIRouter(prefix="/api/rules", tags=["rules"])
+
+
+@router.get("")
+async def list_rules():
+    """List the loaded threshold rules, the named limits per metric and the file they were read from."""
+    rules = rule_engine.rules
+    return {
+        "rules": [rule.model_dump() for rule in rules],
+        "limits": rule_engine.limits,
+        "count": len(rules),
+        "path": rule_engine.path
+    }
+
+
+@router.get("/events", response_model=RuleEventsResponse)
+async def get_rule_events(
+    node_id: Optional[str] = Query(None, description="Only events for this node"),
+    gateway_id: Optional[str] = Query(None, description="Only events for this gateway"),
+    limit: int = Query(100, ge=1, le=500, description="Maximum number of events")
+):
+    """
+    Recent rule events, newest first.
+
+    Events are kept in memory only; subscribe to `/api/stream/ws` or
+    `/api/stream/sse` to receive them live (messages with `"type": "rule_event"`).
+    """
+    events = rule_engine.recent_events(node_id=node_id, gateway_id=gateway_id, limit=limit)
+    return RuleEventsResponse(
+        events=[RuleEventResponse(**event.to_dict()) for event in events],
+        count=len(events)
+    )
+
+
+@router.post("/reload")
+async def reload_rules(token: str = Depends(get_current_token)):
+    """
+    Reload the rule file without restarting the server.
+
+    An invalid file is rejected with 400 and the previously loaded rules stay active.
+    """
+    try:
+        count = rule_engine.load()
+    except RuleConfigError as e:
+        raise HTTPException(status_code=400, detail=str(e))
+    return {"status": "reloaded", "count": count}
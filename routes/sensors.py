@@ -1,14 +1,29 @@
 """API routes for sensor data endpoints."""
 import asyncio
+import json
 import logging
+import time
+import math
 import httpx
-from fastapi import APIRouter, Depends, HTTPException, Query, Request
+from fastapi import APIRouter, Depends, HTTPException, Query, Request, Response
+from fastapi.exceptions import RequestValidationError
+from pydantic import ValidationError
 from sqlalchemy.orm import Session
-from typing import Optional
-from datetime import datetime, timedelta
-from slowapi import Limiter
-from slowapi.util import get_remote_address
+from typing import Iterable, Optional
+from datetime import datetime
 from models.database import get_db
+from models.ingest import IngestReading
+from models.response_json import readings_json
+from models.wire_format import (
+    BINARY_CONTENT_TYPE,
+    WireFormatError,
+    decode_frame,
+    encode_ack,
+    ACK_OK,
+    ACK_PARTIAL,
+    ACK_REJECTED,
+    FLAG_ACK_REQUESTED
+)
 from models.schemas import (
     SensorDataInput,
     SensorReadingResponse,
@@ -18,26 +33,101 @@ from models.schemas import (
     HistoryResponse
 )
 from services.sensor_service import SensorService
-from services.gateway_service import GatewayService
-from services.system_stats import get_system_stats, increment_message_count, fetch_gateway_active_nodes
+from services.ingest_service import IngestService, IngestValidationError
+from services.rate_limiter import RateLimitExceeded
+from services import data_versions
+from services import metrics, tracing
+from middleware.http_cache import cached_json_response
+from services.system_stats import get_system_stats, fetch_gateway_active_nodes
 from routes.gateway import _gateway_status_cache
 
 logger = logging.getLogger(__name__)
 # Router with both v1 and legacy support
 router = APIRouter(prefix="/api/sensors", tags=["sensors"])
 # Note: V1 API uses /api/v1/sensors (can be added separately if needed)
-limiter = Limiter(key_func=get_remote_address)
 
 # Simple in-memory cache to store ESP32 IP addresses by gateway_id
 # This is updated when ESP32 sends sensor data
 _esp32_ip_cache: dict[str, str] = {}
 
+# Granularity of the /history window start (see get_sensor_history)
+HISTORY_WINDOW_BUCKET_SECONDS = 60
+
+
+def _remember_gateway_ip(gateway_id: str, local_ip: Optional[str], client_ip: Optional[str]):
+    """Update the ESP32 IP cache from an upload."""
+    # Store ESP32's actual local IP (source of truth)
+    if local_ip and local_ip != "0.0.0.0":
+        _esp32_ip_cache[gateway_id] = local_ip
+        logger.info(f"ESP32 {gateway_id} reports local IP: {local_ip} (backend sees client IP: {client_ip})")
+    elif client_ip:
+        # Fallback: use client IP if ESP32 didn't send local_ip (legacy support)
+        _esp32_ip_cache[gateway_id] = client_ip
+        logger.warning(f"ESP32 {gateway_id} didn't send local_ip, using client IP: {client_ip}")
+
+
+async def parse_sensor_data(request: Request) -> SensorDataInput:
+    """Decode and validate a POST /api/sensors/data body, timed as the ingest parse stage.
+
+    Replaces FastAPI's own body parsing for that route (whose cost is otherwise
+    invisible) and fails with the same 422 errors.
+    """
+    body = await request.body()
+    started = time.perf_counter()
+    try:
+        data = json.loads(body)
+    except ValueError as e:
+        raise RequestValidationError([{
+            "type": "json_invalid", "loc": ("body", getattr(e, "pos", 0)),
+            "msg": "JSON decode error", "input": {}, "ctx": {"error": getattr(e, "msg", str(e))}
+        }])
+    try:
+        sensor_data = SensorDataInput.model_validate(data)
+    except ValidationError as e:
+        raise RequestValidationError([
+            {**error, "loc": ("body",) + tuple(error["loc"])} for error in e.errors(include_url=False)
+        ])
+    finally:
+        metrics.INGEST_PARSE.observe(time.perf_counter() - started)
+    return sensor_data
+
+
+def _enforce_rate_limit(readings: Iterable[IngestReading]):
+    """Charge an upload to the per-gateway token buckets (see IngestService.admit).
+
+    Each reading costs one token. Buffered (old) readings may draw on the
+    gateway's backfill reserve once the steady budget is spent.
+
+    Raises:
+        HTTPException: 429 with a Retry-After header if any gateway is over its limit
+    """
+    try:
+        IngestService.admit(list(readings))
+    except RateLimitExceeded as e:
+        if math.isinf(e.retry_after):
+            raise HTTPException(
+                status_code=413,
+                detail=f"Upload of {e.cost} readings exceeds the per-gateway burst size; split it into smaller batches"
+            )
+        raise HTTPException(
+            status_code=429,
+            detail=str(e),
+            headers={"Retry-After": str(max(1, math.ceil(e.retry_after)))}
+        )
 
-@router.post("/data", response_model=SensorReadingResponse, status_code=201)
-@limiter.limit("100/minute")  # Rate limit: 100 requests per minute per IP
+
+@router.post(
+    "/data",
+    response_model=SensorReadingResponse,
+    status_code=201,
+    openapi_extra={"requestBody": {
+        "required": True,
+        "content": {"application/json": {"schema": SensorDataInput.model_json_schema()}}
+    }}
+)
 async def receive_sensor_data(
     request: Request,
-    sensor_data: SensorDataInput,
+    sensor_data: SensorDataInput = Depends(parse_sensor_data),
     db: Session = Depends(get_db)
 ):
     """
@@ -78,94 +168,17 @@ async def receive_sensor_data(
     # Also store client IP for diagnostics (what backend sees)
     client_ip = request.client.host if request.client else None
     
-    # Store ESP32's actual local IP (source of truth)
-    if local_ip and local_ip != "0.0.0.0":
-        _esp32_ip_cache[gateway_id] = local_ip
-        logger.info(f"ESP32 {gateway_id} reports local IP: {local_ip} (backend sees client IP: {client_ip})")
-    elif client_ip:
-        # Fallback: use client IP if ESP32 didn't send local_ip (legacy support)
-        _esp32_ip_cache[gateway_id] = client_ip
-        logger.warning(f"ESP32 {gateway_id} didn't send local_ip, using client IP: {client_ip}")
+    reading = IngestReading.from_input(sensor_data)
+    _enforce_rate_limit([reading])
+    _remember_gateway_ip(gateway_id, local_ip, client_ip)
     
     try:
-        # Register/update gateway with IP addresses
-        GatewayService.register_or_update_gateway(
-            db, 
-            gateway_id,
-            local_ip=local_ip,
-            client_ip=client_ip
-        )
-        
-        # Strict validation of sensor payload
-        if sensor_data.temperature < -50 or sensor_data.temperature > 100:
-            logger.warning(
-                f"Invalid temperature: {sensor_data.temperature}",
-                extra={"gateway_id": gateway_id, "node_id": node_id}
-            )
-            raise HTTPException(
-                status_code=400,
-                detail=f"Temperature out of valid range (-50 to 100°C): {sensor_data.temperature}"
-            )
-        
-        if sensor_data.humidity < 0 or sensor_data.humidity > 100:
-            logger.warning(
-                f"Invalid humidity: {sensor_data.humidity}",
-                extra={"gateway_id": gateway_id, "node_id": node_id}
-            )
-            raise HTTPException(
-                status_code=400,
-                detail=f"Humidity out of valid range (0-100%): {sensor_data.humidity}"
-            )
-        
-        # Check for duplicate/late data
-        reading_timestamp = datetime.utcnow()
-        if sensor_data.timestamp:
-            try:
-                reading_timestamp = datetime.fromtimestamp(sensor_data.timestamp)
-                # Check if data is too old (more than 24 hours)
-                age = datetime.utcnow() - reading_timestamp
-                if age > timedelta(hours=24):
-                    logger.warning(
-                        f"Late data received: {age.total_seconds() / 3600:.1f} hours old",
-                        extra={"gateway_id": gateway_id, "node_id": node_id}
-                    )
-                    # Still accept it but log warning
-                elif age < timedelta(seconds=-60):
-                    logger.warning(
-                        f"Future timestamp detected: {abs(age.total_seconds())} seconds in future",
-                        extra={"gateway_id": gateway_id, "node_id": node_id}
-                    )
-                    # Use current time instead
-                    reading_timestamp = datetime.utcnow()
-            except (ValueError, OSError) as e:
-                logger.warning(
-                    f"Invalid timestamp: {sensor_data.timestamp}, using current time",
-                    extra={"gateway_id": gateway_id, "node_id": node_id}
-                )
-                reading_timestamp = datetime.utcnow()
-        
-        # Check for duplicate (same node_id, similar timestamp within 5 seconds)
-        recent_reading = SensorService.check_duplicate(
-            db, node_id, gateway_id, reading_timestamp, window_seconds=5
-        )
-        if recent_reading:
-            logger.info(
-                f"Duplicate data detected (within 5s window), returning existing reading",
-                extra={"gateway_id": gateway_id, "node_id": node_id}
-            )
-            return SensorReadingResponse.model_validate(recent_reading)
-        
-        # Create new reading
-        reading = SensorService.create_reading(db, sensor_data)
-        increment_message_count()
-        
-        logger.info(
-            f"Sensor data received: node_id={node_id}, temp={sensor_data.temperature:.1f}°C, "
-            f"humidity={sensor_data.humidity:.1f}%, timestamp={reading_timestamp.isoformat()}",
-            extra={"gateway_id": gateway_id, "node_id": node_id}
-        )
-        
-        return reading
+        result = IngestService.ingest(db, reading, client_ip=client_ip)
+        if result.duplicate:
+            return SensorReadingResponse.model_validate(result.reading)
+        return result.reading
+    except IngestValidationError as e:
+        raise HTTPException(status_code=400, detail=str(e))
     except HTTPException:
         raise
     except Exception as e:
@@ -177,6 +190,117 @@ async def receive_sensor_data(
         raise HTTPException(status_code=500, detail=f"Error storing sensor data: {str(e)}")
 
 
+@router.post("/data/batch", status_code=200)
+async def receive_sensor_data_batch(
+    request: Request,
+    db: Session = Depends(get_db)
+):
+    """
+    Receive one or more sensor readings in a single upload.
+    
+    The request body is content-negotiated on `Content-Type`:
+    - `application/json`: a JSON array of objects in the `POST /api/sensors/data` format
+      (a single object is also accepted)
+    - `application/vnd.greenhouse.readings.v1`: the compact binary frame described in
+      `models/wire_format.py`, decoded directly without JSON/Pydantic parsing
+    
+    Every reading goes through the same validation, dedup and storage pipeline as
+    `POST /api/sensors/data`. Invalid readings are rejected individually without
+    failing the rest of the batch.
+    
+    If the `Accept` header asks for the binary content type, or a binary frame has
+    FLAG_ACK_REQUESTED set, the response is a 16-byte binary ack instead of JSON.
+    
+    **Example Response:**
+    ```json
+    {
+        "seq": 42,
+        "accepted": 10,
+        "duplicates": 1,
+        "rejected": 1,
+        "errors": [{"index": 3, "detail": "Humidity out of valid range (0-100%): 120.0"}]
+    }
+    ```
+    """
+    content_type = request.headers.get("content-type", "").split(";")[0].strip().lower()
+    body = await request.body()
+    client_ip = request.client.host if request.client else None
+    
+    seq = None
+    binary_ack = BINARY_CONTENT_TYPE in request.headers.get("accept", "")
+    errors = []
+    parse_started = time.perf_counter()
+    if content_type == BINARY_CONTENT_TYPE:
+        try:
+            frame = decode_frame(body)
+        except WireFormatError as e:
+            raise HTTPException(status_code=400, detail=f"Invalid binary frame: {str(e)}")
+        seq = frame.seq
+        binary_ack = binary_ack or bool(frame.flags & FLAG_ACK_REQUESTED)
+        readings = list(enumerate(frame.readings))
+    elif content_type in ("application/json", ""):
+        try:
+            data = json.loads(body)
+        except ValueError as e:
+            raise HTTPException(status_code=400, detail=f"Invalid JSON: {str(e)}")
+        items = data if isinstance(data, list) else [data]
+        readings = []
+        for index, item in enumerate(items):
+            try:
+                readings.append((index, IngestReading.from_input(SensorDataInput.model_validate(item))))
+            except (ValidationError, ValueError) as e:
+                errors.append({"index": index, "detail": str(e)})
+    else:
+        raise HTTPException(
+            status_code=415,
+            detail=f"Unsupported content type '{content_type}'. Use application/json or {BINARY_CONTENT_TYPE}"
+        )
+    metrics.INGEST_PARSE.observe(time.perf_counter() - parse_started)
+    
+    if readings:
+        _enforce_rate_limit(reading for _, reading in readings)
+        first = readings[0][1]
+        _remember_gateway_ip(first.gateway_id, first.local_ip, client_ip)
+    
+    accepted = duplicates = 0
+    try:
+        for index, reading in readings:
+            try:
+                result = IngestService.ingest(db, reading, client_ip=client_ip)
+            except IngestValidationError as e:
+                errors.append({"index": index, "detail": str(e)})
+                continue
+            if result.duplicate:
+                duplicates += 1
+            else:
+                accepted += 1
+    except Exception as e:
+        logger.error(f"Error storing sensor data batch: {str(e)}", exc_info=True)
+        raise HTTPException(status_code=500, detail=f"Error storing sensor data: {str(e)}")
+    
+    rejected = len(errors)
+    errors.sort(key=lambda error: error["index"])
+    if binary_ack:
+        if rejected == 0:
+            status = ACK_OK
+        elif accepted or duplicates:
+            status = ACK_PARTIAL
+        else:
+            status = ACK_REJECTED
+        return Response(
+            content=encode_ack(status, seq or 0, accepted, duplicates, rejected),
+            media_type=BINARY_CONTENT_TYPE
+        )
+    
+    return {
+        "seq": seq,
+        "accepted": accepted,
+        "duplicates": duplicates,
+        "rejected": rejected,
+        "errors": errors
+    }
+
+
 @router.head("/data")
 async def check_connectivity():
     """
@@ -190,6 +314,7 @@ async def check_connectivity():
 
 @router.get("/latest", response_model=LatestReadingsResponse)
 async def get_latest_readings(
+    request: Request,
     limit: int = Query(10, ge=1, le=100, description="Maximum number of readings to return"),
     sensor_id: Optional[str] = Query(None, description="Filter by sensor/node ID"),
     db: Session = Depends(get_db)
@@ -227,30 +352,24 @@ async def get_latest_readings(
     **Errors:**
     - 404: No sensor data exists yet
     """
-    try:
-        # Get the latest readings with optional filtering
-        latest = SensorService.get_latest_readings(
+    def build():
+        # Get the latest readings with optional filtering; an empty list (not 404)
+        # is returned when there is no data, for better compatibility.
+        # Rows are encoded straight to LatestReadingsResponse JSON, without Pydantic.
+        latest = SensorService.get_latest_rows(
             db,
             limit=limit,
             node_id=sensor_id
         )
-        
-        if not latest or len(latest) == 0:
-            # Return empty list instead of 404 for better compatibility
-            return LatestReadingsResponse(
-                readings=[],
-                count=0
-            )
-        
-        # Convert to response models
-        reading_responses = [
-            SensorReadingResponse.model_validate(reading)
-            for reading in latest
-        ]
-        
-        return LatestReadingsResponse(
-            readings=reading_responses,
-            count=len(reading_responses)
+        return readings_json(latest)
+    
+    try:
+        # Unchanged data is answered from memory (304 or cached body) without a DB query
+        return cached_json_response(
+            request,
+            key=("latest", limit, sensor_id),
+            versions=(data_versions.readings_version(node_id=sensor_id),),
+            build=build
         )
     except HTTPException:
         raise
@@ -326,6 +445,7 @@ async def get_system_status(db: Session = Depends(get_db)):
 
 @router.get("/history", response_model=HistoryResponse)
 async def get_sensor_history(
+    request: Request,
     hours: int = Query(24, ge=1, le=168, description="Number of hours of history (1-168)"),
     node_id: Optional[str] = Query(None, description="Filter by node ID"),
     gateway_id: Optional[str] = Query(None, description="Filter by gateway ID"),
@@ -362,12 +482,25 @@ async def get_sensor_history(
     }
     ```
     """
+    # The window start is aligned to a bucket so that readings aging out of the
+    # window change the ETag at most once per bucket
+    window_end = datetime.utcfromtimestamp(
+        int(time.time()) // HISTORY_WINDOW_BUCKET_SECONDS * HISTORY_WINDOW_BUCKET_SECONDS
+    )
+    
+    def build():
+        # Encoded straight to HistoryResponse JSON from row tuples (no ORM objects or Pydantic)
+        readings = SensorService.get_history_rows(
+            db, hours=hours, node_id=node_id, gateway_id=gateway_id, now=window_end
+        )
+        return readings_json(readings, hours=hours)
+    
     try:
-        readings = SensorService.get_history(db, hours=hours, node_id=node_id, gateway_id=gateway_id)
-        return HistoryResponse(
-            readings=[SensorReadingResponse.model_validate(r) for r in readings],
-            count=len(readings),
-            hours=hours
+        return cached_json_response(
+            request,
+            key=("history", hours, node_id, gateway_id),
+            versions=(data_versions.readings_version(node_id, gateway_id), window_end.isoformat()),
+            build=build
         )
     except Exception as e:
         raise HTTPException(status_code=500, detail=f"Error fetching history: {str(e)}")
@@ -431,12 +564,14 @@ async def get_gateway_network_status(
     if '192.168.4.1' not in ips_to_try:
         ips_to_try.append('192.168.4.1')
     
-    async with httpx.AsyncClient(timeout=httpx.Timeout(2.0)) as client:
+    async with httpx.AsyncClient(timeout=httpx.Timeout(2.0), transport=tracing.http_transport()) as client:
         for ip in ips_to_try:
             try:
                 url = f"http://{ip}/api/system/network"
                 logger.info(f"Attempting to fetch network status from {url}")
-                response = await client.get(url)
+                with metrics.probe_timer("network") as probe:
+                    response = await client.get(url)
+                    probe.outcome = str(response.status_code)
                 
                 if response.status_code == 200:
                     logger.info(f"Successfully fetched network status from {ip}")
@@ -0,0 +1,116 @@
+"""API routes for real-time sensor data streaming (WebSocket with SSE fallback)."""
+import asyncio
+import logging
+from typing import List, Optional
+from fastapi import APIRouter, Query, Request, WebSocket, WebSocketDisconnect
+from fastapi.responses import StreamingResponse
+from services.stream_hub import stream_hub
+
+logger = logging.getLogger(__name__)
+router = APIRouter(prefix="/api/stream", tags=["stream"])
+
+# Interval for SSE keep-alive comments (keeps proxies from closing idle streams)
+SSE_KEEPALIVE_SECONDS = 15.0
+
+
+def _split_filter(values: Optional[List[str]]) -> Optional[List[str]]:
+    """Accept both repeated (?node_id=a&node_id=b) and comma-separated (?node_id=a,b) filters."""
+    if not values:
+        return None
+    return [part for value in values for part in value.split(",")]
+
+
+@router.websocket("/ws")
+async def stream_websocket(
+    websocket: WebSocket,
+    node_id: Optional[List[str]] = Query(None, description="Only stream readings from these node IDs"),
+    gateway_id: Optional[List[str]] = Query(None, description="Only stream readings from these gateway IDs"),
+    throttle_ms: int = Query(0, ge=0, le=60000, description="Coalesce readings and send at most once per interval")
+):
+    """
+    Stream new sensor readings over a WebSocket as they are ingested.
+
+    Replaces polling of `/api/sensors/latest`. Each message is a JSON object:
+    ```json
+    {"type": "reading", "data": {"id": 1, "node_id": "node-01", "temperature": 25.5, ...}}
+    ```
+
+    **Query Parameters:**
+    - `node_id`: Optional node filter (repeat or comma-separate for multiple)
+    - `gateway_id`: Optional gateway filter (repeat or comma-separate for multiple)
+    - `throttle_ms`: Optional rate limit; only the latest reading per node is sent each interval
+    """
+    await websocket.accept()
+    subscription = stream_hub.subscribe(
+        node_ids=_split_filter(node_id),
+        gateway_ids=_split_filter(gateway_id),
+        throttle_seconds=throttle_ms / 1000.0
+    )
+
+    async def drain_client():
+        # Consume (and ignore) client frames so a close is noticed promptly
+        while True:
+            await websocket.receive_text()
+
+    receiver = asyncio.create_task(drain_client())
+    try:
+        while True:
+            batch_task = asyncio.create_task(subscription.next_batch())
+            done, _ = await asyncio.wait(
+                {batch_task, receiver},
+                return_when=asyncio.FIRST_COMPLETED
+            )
+            if receiver in done:
+                batch_task.cancel()
+                break
+            for message in batch_task.result():
+                await websocket.send_text(message)
+    except WebSocketDisconnect:
+        pass
+    except Exception as e:
+        logger.warning(f"WebSocket stream closed with error: {str(e)}")
+    finally:
+        receiver.cancel()
+        stream_hub.unsubscribe(subscription)
+
+
+@router.get("/sse")
+async def stream_sse(
+    request: Request,
+    node_id: Optional[List[str]] = Query(None, description="Only stream readings from these node IDs"),
+    gateway_id: Optional[List[str]] = Query(None, description="Only stream readings from these gateway IDs"),
+    throttle_ms: int = Query(0, ge=0, le=60000, description="Coalesce readings and send at most once per interval")
+):
+    """
+    Stream new sensor readings as Server-Sent Events.
+
+    Fallback for clients that cannot use WebSockets. Accepts the same filters as
+    `/api/stream/ws` and emits each reading as a `data:` event with the same JSON body.
+    """
+    subscription = stream_hub.subscribe(
+        node_ids=_split_filter(node_id),
+        gateway_ids=_split_filter(gateway_id),
+        throttle_seconds=throttle_ms / 1000.0
+    )
+
+    async def event_source():
+        try:
+            while not await request.is_disconnected():
+                try:
+                    batch = await asyncio.wait_for(
+                        subscription.next_batch(),
+                        timeout=SSE_KEEPALIVE_SECONDS
+                    )
+                except asyncio.TimeoutError:
+                    yield ": keep-alive\n\n"
+                    continue
+                for message in batch:
+                    yield f"data: {message}\n\n"
+        finally:
+            stream_hub.unsubscribe(subscription)
+
+    return StreamingResponse(
+        event_source(),
+        media_type="text/event-stream",
+        headers={"Cache-Control": "no-cache", "X-Accel-Buffering": "no"}
+    )
@@ -0,0 +1,147 @@
+"""API routes for the zone hierarchy and zone-level aggregates."""
+from datetime import datetime, timedelta
+from fastapi import APIRouter, Depends, HTTPException, Query
+from sqlalchemy.orm import Session
+from typing import Optional
+from middleware.auth import get_current_token
+from models.database import get_db
+from models.schemas import (
+    ZoneCreate, ZoneResponse, ZonesResponse, ZoneNodesInput, ZoneLatestResponse,
+    ZoneHistoryBucket, ZoneHistoryResponse, ZoneInsightsResponse, InsightDetail
+)
+from services.analytics import run_analytics_thread
+from services.zones import ZoneError, ZoneService, zone_aggregator
+
+router = APIRouter(prefix="/api/zones", tags=["zones"])
+
+
+def _require_zone(db: Session, zone_id: str):
+    if ZoneService.get_zone(db, zone_id) is None:
+        raise HTTPException(status_code=404, detail=f"Zone {zone_id} not found")
+
+
+@router.get("", response_model=ZonesResponse)
+async def list_zones(db: Session = Depends(get_db)):
+    """All zones, outermost first, with their children and member node counts."""
+    zones = ZoneService.list_zones(db)
+    return ZonesResponse(zones=zones, count=len(zones))
+
+
+@router.post("", response_model=ZoneResponse, status_code=201)
+async def create_zone(zone: ZoneCreate, db: Session = Depends(get_db), token: str = Depends(get_current_token)):
+    """
+    Create a zone. Greenhouses are top-level, bays go in a greenhouse and
+    benches in a bay.
+    """
+    try:
+        created = ZoneService.create_zone(db, zone.zone_id, zone.kind, name=zone.name, parent_id=zone.parent_id)
+    except ZoneError as e:
+        status = 409 if "already exists" in str(e) else 400
+        raise HTTPException(status_code=status, detail=str(e))
+    return ZoneResponse(zone_id=created.zone_id, name=created.name, kind=created.kind, parent_id=created.parent_id)
+
+
+@router.delete("/{zone_id}")
+async def delete_zone(zone_id: str, db: Session = Depends(get_db), token: str = Depends(get_current_token)):
+    """Delete a zone without child zones or nodes, together with its rollups."""
+    try:
+        deleted = ZoneService.delete_zone(db, zone_id)
+    except ZoneError as e:
+        raise HTTPException(status_code=409, detail=str(e))
+    if not deleted:
+        raise HTTPException(status_code=404, detail=f"Zone {zone_id} not found")
+    return {"status": "deleted", "zone_id": zone_id}
+
+
+@router.post("/{zone_id}/nodes")
+async def assign_nodes(
+    zone_id: str,
+    body: ZoneNodesInput,
+    db: Session = Depends(get_db),
+    token: str = Depends(get_current_token)
+):
+    """
+    Move nodes into this zone (from any zone they were in).
+
+    Readings stored from now on count towards the zone and the zones above it.
+    Call `POST /api/zones/{zone_id}/rebuild` to include earlier readings.
+    """
+    _require_zone(db, zone_id)
+    assigned = ZoneService.assign_nodes(db, zone_id, body.node_ids)
+    unknown = sorted(set(body.node_ids) - set(assigned))
+    return {"zone_id": zone_id, "assigned": assigned, "unknown": unknown}
+
+
+@router.get("/{zone_id}/latest", response_model=ZoneLatestResponse)
+async def get_zone_latest(zone_id: str, db: Session = Depends(get_db)):
+    """
+    Current average, minimum and maximum per metric over the newest reading of
+    every node in the zone and the zones below it. Served from memory.
+    """
+    snapshot = zone_aggregator.latest(zone_id)
+    if snapshot is None:
+        _require_zone(db, zone_id)
+        raise HTTPException(status_code=404, detail=f"No readings from nodes in zone {zone_id} yet")
+    return snapshot
+
+
+@router.get("/{zone_id}/history", response_model=ZoneHistoryResponse)
+async def get_zone_history(
+    zone_id: str,
+    hours: int = Query(24, ge=1, le=24 * 90, description="Hours of history"),
+    resolution_minutes: Optional[int] = Query(
+        None, ge=1, le=1440, description="Bucket width (rounded to the rollup bucket; default: one rollup bucket)"
+    ),
+    db: Session = Depends(get_db)
+):
+    """
+    Zone aggregates per time bucket, oldest first, read from the zone rollups
+    (no scan of member node readings).
+    """
+    _require_zone(db, zone_id)
+    resolution = resolution_minutes * 60 if resolution_minutes else zone_aggregator.bucket_seconds
+    resolution = max(1, round(resolution / zone_aggregator.bucket_seconds)) * zone_aggregator.bucket_seconds
+    buckets = zone_aggregator.history(
+        db, zone_id, datetime.utcnow() - timedelta(hours=hours), resolution_seconds=resolution
+    )
+    return ZoneHistoryResponse(
+        zone_id=zone_id,
+        resolution_seconds=resolution,
+        buckets=[
+            ZoneHistoryBucket(bucket_start=bucket_start, readings=aggregate.readings, metrics=aggregate.stats())
+            for bucket_start, aggregate in buckets
+        ],
+        count=len(buckets)
+    )
+
+
+@router.get("/{zone_id}/insights", response_model=ZoneInsightsResponse)
+async def get_zone_insights(
+    zone_id: str,
+    minutes: int = Query(60, ge=5, le=1440, description="Number of minutes of data to analyze"),
+    db: Session = Depends(get_db)
+):
+    """
+    Drought, overwatering and temperature-stress insights for a whole zone,
+    computed from its rollup buckets.
+    """
+    _require_zone(db, zone_id)
+    result = await run_analytics_thread(ZoneService.analyze, zone_id, minutes=minutes)
+    result["insights"] = [InsightDetail(**insight) for insight in result["insights"]]
+    return ZoneInsightsResponse(**result)
+
+
+@router.post("/{zone_id}/rebuild")
+async def rebuild_zone_rollups(
+    zone_id: str,
+    hours: int = Query(24 * 7, ge=1, le=24 * 365, description="Hours of history to recompute"),
+    db: Session = Depends(get_db),
+    token: str = Depends(get_current_token)
+):
+    """
+    Recompute the rollups of this zone and the zones below it from raw
+    readings, using the current node assignments.
+    """
+    _require_zone(db, zone_id)
+    buckets = zone_aggregator.rebuild(db, zone_id, datetime.utcnow() - timedelta(hours=hours))
+    return {"zone_id": zone_id, "buckets": buckets, "hours": hours}
@@ -7,19 +7,21 @@ from sqlalchemy.orm import Session
 from sqlalchemy import func, and_
 from typing import Dict, List, Optional, Tuple
 from datetime import datetime, timedelta
+from operator import attrgetter
 from models.database import SensorReading
+from services import kernels, reading_store, tracing
+from services.rule_engine import rule_engine
 
 
+@tracing.traced
 class AIInsightsService:
     """Service for generating AI insights from historical sensor data."""
     
-    # Thresholds for analysis
-    TEMP_OVERHEAT_THRESHOLD = 35.0  # °C
+    # Rates of change for analysis; level thresholds are the named limits
+    # of the rule config (temperature critical_high/severe_high, soil_moisture
+    # dry, humidity optimal_max/high)
     TEMP_RATE_HIGH = 1.0  # °C per hour
-    SOIL_MOISTURE_LOW = 30.0  # %
     SOIL_MOISTURE_DROP_HIGH = 5.0  # % per day
-    HUMIDITY_HIGH = 75.0  # %
-    HUMIDITY_FUNGAL_RISK = 70.0  # % with temp 20-30°C
     
     @staticmethod
     def get_historical_metrics(
@@ -51,13 +53,19 @@ class AIInsightsService:
             )
         ).order_by(SensorReading.timestamp).all()
         
-        # Get readings for 7 days
+        # Get readings for 7 days (older hours usually come from compressed blocks)
         readings_7d = db.query(SensorReading).filter(
             and_(
                 SensorReading.node_id == node_id,
                 SensorReading.timestamp >= cutoff_7d
             )
         ).order_by(SensorReading.timestamp).all()
+        compacted = [reading_store.to_reading(row) for row in reading_store.block_rows(db, since=cutoff_7d, node_ids=node_id)]
+        by_time = attrgetter("timestamp")
+        readings_7d = reading_store.merge_by_time(compacted, readings_7d, by_time)
+        readings_24h = reading_store.merge_by_time(
+            [r for r in compacted if r.timestamp >= cutoff_24h], readings_24h, by_time
+        )
         
         metrics = {
             "avg_temp_24h": None,
@@ -72,7 +80,7 @@ class AIInsightsService:
         if readings_24h:
             temps_24h = [r.temperature for r in readings_24h if r.temperature is not None]
             if temps_24h:
-                metrics["avg_temp_24h"] = sum(temps_24h) / len(temps_24h)
+                metrics["avg_temp_24h"] = kernels.mean(temps_24h)
             
             # Calculate temperature rate of change (°C per hour)
             if len(readings_24h) >= 2:
@@ -85,18 +93,18 @@ class AIInsightsService:
             # Calculate average humidity
             humidities = [r.humidity for r in readings_24h if r.humidity is not None]
             if humidities:
-                metrics["avg_humidity_24h"] = sum(humidities) / len(humidities)
+                metrics["avg_humidity_24h"] = kernels.mean(humidities)
             
             # Calculate average soil moisture
             soil_moistures = [r.soil_moisture for r in readings_24h if r.soil_moisture is not None]
             if soil_moistures:
-                metrics["avg_soil_moisture_24h"] = sum(soil_moistures) / len(soil_moistures)
+                metrics["avg_soil_moisture_24h"] = kernels.mean(soil_moistures)
         
         # Calculate 7-day average temperature
         if readings_7d:
             temps_7d = [r.temperature for r in readings_7d if r.temperature is not None]
             if temps_7d:
-                metrics["avg_temp_7d"] = sum(temps_7d) / len(temps_7d)
+                metrics["avg_temp_7d"] = kernels.mean(temps_7d)
         
         # Calculate soil moisture drop rate per day
         if readings_24h and len(readings_24h) >= 2:
@@ -120,16 +128,17 @@ class AIInsightsService:
             List of tuples (condition_name, severity) where severity is 'low', 'medium', or 'high'
         """
         conditions = []
+        limits = rule_engine.limits
         
         # Overheating trend detection
         avg_temp_24h = metrics.get("avg_temp_24h")
         temp_rate = metrics.get("temp_rate_per_hour")
         
         if avg_temp_24h is not None:
-            if avg_temp_24h > AIInsightsService.TEMP_OVERHEAT_THRESHOLD:
-                if avg_temp_24h > 38.0:
+            if avg_temp_24h > limits["temperature"]["critical_high"]:
+                if avg_temp_24h > limits["temperature"]["severe_high"]:
                     conditions.append(("overheating", "high"))
-                elif avg_temp_24h > 36.0:
+                elif avg_temp_24h > limits["temperature"]["elevated_high"]:
                     conditions.append(("overheating", "medium"))
                 else:
                     conditions.append(("overheating", "low"))
@@ -148,7 +157,7 @@ class AIInsightsService:
         avg_soil = metrics.get("avg_soil_moisture_24h")
         
         if soil_drop is not None and soil_drop > 0:
-            if soil_drop > 10.0 or (avg_soil is not None and avg_soil < AIInsightsService.SOIL_MOISTURE_LOW):
+            if soil_drop > 10.0 or (avg_soil is not None and avg_soil < limits["soil_moisture"]["dry"]):
                 conditions.append(("soil_depletion", "high"))
             elif soil_drop > AIInsightsService.SOIL_MOISTURE_DROP_HIGH:
                 conditions.append(("soil_depletion", "medium"))
@@ -158,9 +167,9 @@ class AIInsightsService:
         # Fungal risk: High humidity + moderate temperature
         avg_humidity = metrics.get("avg_humidity_24h")
         if avg_temp_24h is not None and avg_humidity is not None:
-            if (avg_humidity >= AIInsightsService.HUMIDITY_FUNGAL_RISK and 
+            if (avg_humidity >= limits["humidity"]["optimal_max"] and 
                 20.0 <= avg_temp_24h <= 30.0):
-                if avg_humidity >= AIInsightsService.HUMIDITY_HIGH:
+                if avg_humidity >= limits["humidity"]["high"]:
                     conditions.append(("fungal_risk", "high"))
                 else:
                     conditions.append(("fungal_risk", "medium"))
@@ -213,10 +222,10 @@ class AIInsightsService:
         # Overheating recommendations
         if "overheating" in condition_names:
             avg_temp = metrics.get("avg_temp_24h", 0)
-            if avg_temp > 38.0:
+            if avg_temp > rule_engine.limit("temperature", "severe_high"):
                 recommendations.append("Activate emergency cooling systems immediately")
                 recommendations.append("Increase ventilation to maximum capacity")
-            elif avg_temp > 36.0:
+            elif avg_temp > rule_engine.limit("temperature", "elevated_high"):
                 recommendations.append("Start ventilation 30 minutes earlier than usual")
                 recommendations.append("Increase ventilation frequency by 50%")
             else:
@@ -239,7 +248,7 @@ class AIInsightsService:
             soil_drop = metrics.get("soil_moisture_drop_per_day", 0)
             avg_soil = metrics.get("avg_soil_moisture_24h", 0)
             
-            if soil_drop > 10.0 or (avg_soil is not None and avg_soil < AIInsightsService.SOIL_MOISTURE_LOW):
+            if soil_drop > 10.0 or (avg_soil is not None and avg_soil < rule_engine.limit("soil_moisture", "dry")):
                 recommendations.append("Increase irrigation frequency by 30%")
                 recommendations.append("Check irrigation system for blockages")
             elif soil_drop > AIInsightsService.SOIL_MOISTURE_DROP_HIGH:
@@ -251,7 +260,7 @@ class AIInsightsService:
         # Fungal risk recommendations
         if "fungal_risk" in condition_names:
             avg_humidity = metrics.get("avg_humidity_24h", 0)
-            if avg_humidity >= AIInsightsService.HUMIDITY_HIGH:
+            if avg_humidity >= rule_engine.limit("humidity", "high"):
                 recommendations.append("Improve airflow immediately to reduce humidity")
                 recommendations.append("Consider dehumidification system")
                 recommendations.append("Increase ventilation to prevent fungal growth")
@@ -328,7 +337,7 @@ class AIInsightsService:
         # Check if node exists
         node_exists = db.query(SensorReading).filter(
             SensorReading.node_id == node_id
-        ).first()
+        ).first() or reading_store.node_has_blocks(db, node_id)
         
         if not node_exists:
             return {
@@ -0,0 +1,370 @@
+"""Alert lifecycle for threshold rules and drift anomalies.
+
+Rule events (services/rule_engine.py) and drift anomalies
+(services/anomaly_detector.py) are instantaneous: they say a reading breached
+something. This module turns them into alerts with a lifecycle:
+
+    pending --(condition held for min duration)--> open --ack--> acknowledged
+       |                                             |               |
+       +--(condition gone)--> dropped                +--(cleared)----+--> resolved
+
+- Dedup: at most one unresolved alert per (node, alert type). Repeated
+  breaches keep the existing alert alive instead of opening new ones. A partial
+  unique index on the alerts table enforces this across worker processes.
+- Minimum duration: a rule must keep matching for ALERT_MIN_DURATION_SECONDS
+  (or the rule's min_duration_seconds) before an alert opens, so a single noisy
+  reading does not page anyone.
+- Hysteresis: a rule alert only starts clearing once the value is back past the
+  threshold by the rule's hysteresis margin (or a per-metric default). It
+  resolves after staying clear for ALERT_CLEAR_SECONDS. Values inside the band
+  neither breach nor clear, so readings hovering at the threshold do not flap.
+- Drift alerts resolve after ALERT_ANOMALY_QUIET_SECONDS without a new drift event.
+
+Readings older than ALERT_STALE_SECONDS (offline-buffer backfill) do not drive
+alerts. Open, acknowledge and resolve transitions are sent to the webhook
+dispatcher.
+"""
+import logging
+import os
+import threading
+from dataclasses import dataclass
+from datetime import datetime, timedelta
+from typing import Dict, Iterable, List, Optional
+from sqlalchemy.exc import IntegrityError
+from sqlalchemy.orm import Session
+from models.database import Alert, SessionLocal
+from models.ingest import IngestReading
+from models.schemas import AlertResponse
+from services.rule_engine import RuleDefinition, RuleEvent, rule_engine
+from services.webhook_dispatcher import webhook_dispatcher
+from services import metrics, tracing
+
+logger = logging.getLogger(__name__)
+
+ALERT_MIN_DURATION_SECONDS = float(os.getenv("ALERT_MIN_DURATION_SECONDS", "120"))
+ALERT_CLEAR_SECONDS = float(os.getenv("ALERT_CLEAR_SECONDS", "300"))
+ALERT_ANOMALY_QUIET_SECONDS = float(os.getenv("ALERT_ANOMALY_QUIET_SECONDS", "7200"))
+ALERT_STALE_SECONDS = float(os.getenv("ALERT_STALE_SECONDS", "900"))
+
+# Hysteresis margin per metric when a rule does not set one
+DEFAULT_HYSTERESIS = {
+    "temperature": 1.0,
+    "humidity": 3.0,
+    "soil_moisture": 3.0,
+    "light_level": 500.0,
+    "battery_level": 5.0,
+    "rssi": 5.0,
+}
+
+UNRESOLVED_STATUSES = ("open", "acknowledged")
+
+
+class AlertStateError(ValueError):
+    """Raised for a lifecycle transition that is not allowed (e.g. acking a resolved alert)."""
+
+
+@dataclass(slots=True)
+class AlertState:
+    """In-memory tracking of one (node, alert type) condition."""
+    node_id: str
+    gateway_id: str
+    alert_type: str
+    source: str
+    severity: str
+    message: str
+    value: Optional[float]
+    status: str  # 'pending', 'open' or 'acknowledged'
+    first_breach: datetime
+    last_breach: datetime
+    clear_since: Optional[datetime] = None
+    alert_id: Optional[int] = None
+
+
+def alert_payload(alert: Alert) -> Dict:
+    """JSON-ready representation used by the API and webhooks."""
+    return AlertResponse.model_validate(alert).model_dump(mode="json")
+
+
+def _is_clear(rule: RuleDefinition, reading: IngestReading) -> Optional[bool]:
+    """Whether a reading is past the rule's threshold by the hysteresis margin.
+
+    Returns None when the reading has no value for the rule's metric.
+    """
+    value = getattr(reading, rule.metric)
+    if value is None:
+        return None
+    margin = rule.hysteresis if rule.hysteresis is not None else DEFAULT_HYSTERESIS.get(rule.metric, 0.0)
+    if rule.op in (">", ">="):
+        return value < rule.threshold - margin
+    return value > rule.threshold + margin
+
+
+class AlertManager:
+    """Tracks alert conditions per node and persists lifecycle transitions."""
+
+    def __init__(self):
+        self._states: Dict[str, Dict[str, AlertState]] = {}
+        self._lock = threading.Lock()
+
+    @property
+    def active_count(self) -> int:
+        """Open or acknowledged alerts tracked by this process."""
+        return sum(
+            1 for states in list(self._states.values()) for state in list(states.values())
+            if state.status != "pending"
+        )
+
+    def load_active(self, db: Session) -> int:
+        """Resume tracking of unresolved alerts after a restart."""
+        alerts = db.query(Alert).filter(Alert.status.in_(UNRESOLVED_STATUSES)).all()
+        with self._lock:
+            for alert in alerts:
+                self._states.setdefault(alert.node_id, {})[alert.alert_type] = AlertState(
+                    alert.node_id, alert.gateway_id, alert.alert_type, alert.source, alert.severity,
+                    alert.message, alert.value, alert.status, alert.opened_at, alert.updated_at,
+                    alert_id=alert.id
+                )
+        return len(alerts)
+
+    def observe(
+        self,
+        db: Session,
+        reading: IngestReading,
+        timestamp: datetime,
+        rule_events: Iterable[RuleEvent] = (),
+        anomalies: Iterable = ()
+    ):
+        """Advance alert state for a newly stored reading.
+
+        Args:
+            db: Database session (used only when an alert changes state)
+            reading: The stored reading
+            timestamp: Its resolved timestamp
+            rule_events: Rules the reading matched
+            anomalies: Anomalies the reading triggered
+        """
+        node_id = reading.node_id
+        drifts = [a for a in anomalies if a.kind in ("drift_up", "drift_down")]
+        if not rule_events and not drifts and node_id not in self._states:
+            return
+        if timestamp < datetime.utcnow() - timedelta(seconds=ALERT_STALE_SECONDS):
+            return
+
+        with self._lock:
+            states = self._states.setdefault(node_id, {})
+            breached = set()
+
+            for event in rule_events:
+                breached.add(event.rule_id)
+                rule = rule_engine.rule(event.rule_id)
+                min_duration = ALERT_MIN_DURATION_SECONDS
+                if rule is not None and rule.min_duration_seconds is not None:
+                    min_duration = rule.min_duration_seconds
+                self._breach(
+                    db, states, reading.gateway_id, node_id, event.rule_id, "rule",
+                    event.severity, event.message, event.value, timestamp, min_duration
+                )
+
+            for anomaly in drifts:
+                alert_type = f"anomaly_{anomaly.metric}_{anomaly.kind}"
+                breached.add(alert_type)
+                direction = "up" if anomaly.kind == "drift_up" else "down"
+                message = (
+                    f"{anomaly.metric.replace('_', ' ').capitalize()} drifting {direction} at {node_id}: "
+                    f"{anomaly.value:.1f} vs {anomaly.baseline:.1f} usual for this time of day"
+                )
+                self._breach(
+                    db, states, reading.gateway_id, node_id, alert_type, "anomaly",
+                    "medium", message, anomaly.value, timestamp, 0.0
+                )
+
+            for alert_type, state in list(states.items()):
+                if alert_type in breached:
+                    continue
+                if state.source == "rule":
+                    rule = rule_engine.rule(alert_type)
+                    clear = True if rule is None or not rule.enabled else _is_clear(rule, reading)
+                    if clear is None:
+                        continue  # Reading lacks this metric; no information either way
+                    hold = ALERT_CLEAR_SECONDS
+                else:
+                    clear = (timestamp - state.last_breach).total_seconds() >= ALERT_ANOMALY_QUIET_SECONDS
+                    hold = 0.0
+
+                if state.status == "pending":
+                    # The minimum duration requires an unbroken run of breaches
+                    del states[alert_type]
+                elif not clear:
+                    state.clear_since = None
+                else:
+                    if state.clear_since is None:
+                        state.clear_since = timestamp
+                    if (timestamp - state.clear_since).total_seconds() >= hold:
+                        self._resolve(db, state, timestamp, "cleared")
+                        del states[alert_type]
+
+            if not states:
+                del self._states[node_id]
+
+    def _breach(
+        self, db: Session, states: Dict[str, AlertState], gateway_id: str, node_id: str, alert_type: str,
+        source: str, severity: str, message: str, value: Optional[float], timestamp: datetime, min_duration: float
+    ):
+        state = states.get(alert_type)
+        if state is None:
+            state = AlertState(
+                node_id, gateway_id, alert_type, source, severity, message, value,
+                "pending", timestamp, timestamp
+            )
+            states[alert_type] = state
+        state.last_breach = timestamp
+        state.value = value
+        state.message = message
+        state.clear_since = None
+        if state.status == "pending" and (timestamp - state.first_breach).total_seconds() >= min_duration:
+            self._open(db, state)
+
+    def _open(self, db: Session, state: AlertState):
+        alert = Alert(
+            node_id=state.node_id, gateway_id=state.gateway_id, alert_type=state.alert_type,
+            source=state.source, severity=state.severity, status="open", message=state.message,
+            value=state.value, opened_at=state.first_breach, updated_at=datetime.utcnow()
+        )
+        db.add(alert)
+        try:
+            db.commit()
+        except IntegrityError:
+            # Another worker process opened it first; adopt its alert (it notified)
+            db.rollback()
+            existing = db.query(Alert).filter(
+                Alert.node_id == state.node_id,
+                Alert.alert_type == state.alert_type,
+                Alert.status.in_(UNRESOLVED_STATUSES)
+            ).first()
+            if existing is not None:
+                state.alert_id = existing.id
+                state.status = existing.status
+            return
+
+        state.alert_id = alert.id
+        state.status = "open"
+        metrics.ALERT_TRANSITIONS_TOTAL.labels("opened").inc()
+        logger.warning(
+            f"Alert opened: {state.alert_type} ({state.severity}) - {state.message}",
+            extra={"gateway_id": state.gateway_id, "node_id": state.node_id}
+        )
+        webhook_dispatcher.enqueue("alert.opened", alert_payload(alert))
+
+    def _resolve(self, db: Session, state: AlertState, timestamp: datetime, reason: str):
+        alert = db.get(Alert, state.alert_id) if state.alert_id is not None else None
+        if alert is None or alert.status == "resolved":
+            return
+        alert.status = "resolved"
+        alert.resolved_at = timestamp
+        alert.updated_at = datetime.utcnow()
+        db.commit()
+        metrics.ALERT_TRANSITIONS_TOTAL.labels("resolved").inc()
+        logger.info(
+            f"Alert resolved ({reason}): {state.alert_type}",
+            extra={"gateway_id": state.gateway_id, "node_id": state.node_id}
+        )
+        webhook_dispatcher.enqueue("alert.resolved", alert_payload(alert))
+
+    def acknowledge(self, db: Session, alert_id: int) -> Optional[Alert]:
+        """Acknowledge an open alert. Acknowledging twice is a no-op.
+
+        Returns:
+            The alert, or None if it does not exist
+
+        Raises:
+            AlertStateError: If the alert is already resolved
+        """
+        with self._lock:
+            alert = db.get(Alert, alert_id)
+            if alert is None:
+                return None
+            if alert.status == "resolved":
+                raise AlertStateError(f"Alert {alert_id} is already resolved")
+            if alert.status == "acknowledged":
+                return alert
+
+            now = datetime.utcnow()
+            alert.status = "acknowledged"
+            alert.acknowledged_at = now
+            alert.updated_at = now
+            db.commit()
+            state = self._states.get(alert.node_id, {}).get(alert.alert_type)
+            if state is not None:
+                state.status = "acknowledged"
+            metrics.ALERT_TRANSITIONS_TOTAL.labels("acknowledged").inc()
+            webhook_dispatcher.enqueue("alert.acknowledged", alert_payload(alert))
+            return alert
+
+    def resolve(self, db: Session, alert_id: int) -> Optional[Alert]:
+        """Resolve an alert manually.
+
+        If the condition still holds, a new alert opens after the minimum duration.
+
+        Returns:
+            The alert, or None if it does not exist
+        """
+        with self._lock:
+            alert = db.get(Alert, alert_id)
+            if alert is None:
+                return None
+            if alert.status == "resolved":
+                return alert
+            states = self._states.get(alert.node_id, {})
+            state = states.pop(alert.alert_type, None)
+            if state is None:
+                state = AlertState(
+                    alert.node_id, alert.gateway_id, alert.alert_type, alert.source, alert.severity,
+                    alert.message, alert.value, alert.status, alert.opened_at, alert.updated_at,
+                    alert_id=alert.id
+                )
+            self._resolve(db, state, datetime.utcnow(), "manual")
+            return alert
+
+
+# Process-wide manager fed by the ingest pipeline
+alert_manager = AlertManager()
+
+
+def load_active_alerts():
+    """Load unresolved alerts into the manager at startup."""
+    db = SessionLocal()
+    try:
+        count = alert_manager.load_active(db)
+        if count:
+            logger.info(f"Tracking {count} unresolved alert(s)")
+    finally:
+        db.close()
+
+
+@tracing.traced
+class AlertService:
+    """Queries over stored alerts."""
+
+    @staticmethod
+    def get_alerts(
+        db: Session,
+        status: Optional[str] = None,
+        node_id: Optional[str] = None,
+        limit: int = 100
+    ) -> List[Alert]:
+        """Alerts, most recently opened first.
+
+        Args:
+            db: Database session
+            status: 'active' (open or acknowledged), 'open', 'acknowledged' or 'resolved'
+            node_id: Only alerts for this node
+            limit: Maximum number of alerts
+        """
+        query = db.query(Alert)
+        if status == "active":
+            query = query.filter(Alert.status.in_(UNRESOLVED_STATUSES))
+        elif status:
+            query = query.filter(Alert.status == status)
+        if node_id:
+            query = query.filter(Alert.node_id == node_id)
+        return query.order_by(Alert.opened_at.desc()).limit(limit).all()
@@ -0,0 +1,116 @@
+"""Isolated execution of analytics queries (insights and trend analysis).
+
+Analytics read long time ranges (a node's 7-day history, every node's last
+hour). Two things keep them and the ingest path out of each other's way:
+- Snapshot: each job gets its own session from the read-only analytics engine
+  (models/database.py). On SQLite in WAL mode, that session is a read
+  transaction on a dedicated connection, so every query of the job sees the same
+  snapshot. The transaction does not block ingest commits and does not wait for
+  them. It ends when the job returns, so the WAL can be checkpointed.
+  ANALYTICS_DATABASE_URL can point the jobs at a replica instead.
+- Execution: the blocking work runs off the event loop, on ANALYTICS_WORKERS
+  dedicated threads, so a long scan does not stall request handling. At most
+  ANALYTICS_WORKERS jobs run at once; further jobs queue. Threads still share
+  the interpreter lock with ingest. With ANALYTICS_PROCESSES > 0, database-only
+  jobs run in that many worker processes instead, and only the scheduler is
+  shared with ingest.
+"""
+import asyncio
+import contextvars
+import functools
+import logging
+import multiprocessing
+import os
+import time
+from concurrent.futures import Executor, ProcessPoolExecutor, ThreadPoolExecutor
+from concurrent.futures.process import BrokenProcessPool
+from typing import Callable, Optional, TypeVar
+from models.database import AnalyticsSessionLocal
+from services import metrics, tracing
+
+logger = logging.getLogger(__name__)
+
+ANALYTICS_WORKERS = int(os.getenv("ANALYTICS_WORKERS", "2"))
+# Worker processes for database-only jobs (0: run them on the analytics threads)
+ANALYTICS_PROCESSES = int(os.getenv("ANALYTICS_PROCESSES", "0"))
+
+T = TypeVar("T")
+
+_threads = ThreadPoolExecutor(max_workers=max(1, ANALYTICS_WORKERS), thread_name_prefix="analytics")
+_processes: Optional[ProcessPoolExecutor] = None
+
+
+def _run(job: Callable[..., T], args, kwargs) -> T:
+    db = AnalyticsSessionLocal()
+    try:
+        return job(db, *args, **kwargs)
+    finally:
+        db.close()  # Ends the read transaction
+
+
+def _ready() -> bool:
+    return True
+
+
+def _process_pool() -> ProcessPoolExecutor:
+    # Spawned, not forked: the parent holds threads and open database connections
+    return ProcessPoolExecutor(max_workers=ANALYTICS_PROCESSES, mp_context=multiprocessing.get_context("spawn"))
+
+
+async def _submit(executor: Executor, job: Callable[..., T], args, kwargs) -> T:
+    started = time.perf_counter()
+    loop = asyncio.get_running_loop()
+    try:
+        with tracing.span(f"analytics {job.__qualname__}", **{"analytics.process": executor is not _threads}):
+            if executor is _threads:
+                # Carry the request context (SQL statement counter, current span) into the thread
+                call = functools.partial(contextvars.copy_context().run, _run, job, args, kwargs)
+            else:
+                call = functools.partial(_run, job, args, kwargs)
+            return await loop.run_in_executor(executor, call)
+    finally:
+        metrics.ANALYTICS_SECONDS.labels(job.__qualname__).observe(time.perf_counter() - started)
+
+
+async def run_analytics(job: Callable[..., T], *args, **kwargs) -> T:
+    """Call job(db, *args, **kwargs) with a snapshot session, off the event loop.
+
+    The job may only use the database: with ANALYTICS_PROCESSES it runs in a
+    worker process, and its arguments and result are pickled. ORM objects
+    returned by the job are detached; their loaded columns stay readable, but
+    lazy relationships cannot be loaded.
+    """
+    global _processes
+    if _processes is None:
+        return await _submit(_threads, job, args, kwargs)
+    try:
+        return await _submit(_processes, job, args, kwargs)
+    except BrokenProcessPool:
+        logger.error("Analytics worker process died; restarting the process pool")
+        _processes = _process_pool()
+        raise
+
+
+async def run_analytics_thread(job: Callable[..., T], *args, **kwargs) -> T:
+    """Like run_analytics, but always on an analytics thread, for jobs that also read this process's memory."""
+    return await _submit(_threads, job, args, kwargs)
+
+
+async def start_analytics():
+    """Start the worker processes if ANALYTICS_PROCESSES is set (they import the app's modules once)."""
+    global _processes
+    if ANALYTICS_PROCESSES <= 0:
+        return
+    _processes = _process_pool()
+    loop = asyncio.get_running_loop()
+    # Spawn the workers now rather than on the first request
+    for _ in range(ANALYTICS_PROCESSES):
+        loop.run_in_executor(_processes, _ready)
+    logger.info(f"Analytics running in {ANALYTICS_PROCESSES} worker process(es)")
+
+
+def stop_analytics():
+    """Drop queued jobs and let running ones finish in the background."""
+    _threads.shutdown(wait=False, cancel_futures=True)
+    if _processes is not None:
+        _processes.shutdown(wait=False, cancel_futures=True)
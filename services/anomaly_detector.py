@@ -0,0 +1,401 @@
+"""Streaming per-node anomaly detection on the ingest path.
+
+Every stored reading updates, per node and metric, in O(1):
+- an hour-of-day baseline profile (24 EWMA buckets, linearly interpolated), so
+  the normal diurnal cycle is expected rather than flagged
+- an EWMA of the squared residual against that profile (its variance)
+- a two-sided CUSUM of the standardized residual, which catches drift (a
+  failing probe, a stuck vent or heater) hours before a fixed threshold would
+- a short ring buffer of recent values whose median/MAD gives a robust z-score
+  for single-reading spikes
+
+A spike is confirmed one reading later, once the series is back to normal. Two
+outliers in a row on the same side are a level shift. A soil moisture rise is
+irrigation refilling the soil: the profile moves to the new level without an
+event. Any other shift is reported as a level_shift event and left to the
+CUSUM, which keeps accumulating, so a step change still ends in a drift event.
+Either way the recent-value window restarts at the new level.
+
+State is kept as a struct of arrays: each node gets a slot, and each statistic
+is one flat `array('d')` indexed by `slot * len(ANOMALY_METRICS) + metric`
+(times 24 for the profile, times ANOMALY_WINDOW for the ring buffer). The ring
+buffer holds centi-units in an `array('h')` (models/measurements.py), so the
+median/MAD work on exact small integers. A node costs about 0.9 KB and there
+are no per-node Python objects.
+
+State lives in process memory. The first time a node is seen after a restart,
+its last ANOMALY_BOOTSTRAP_HOURS of history are replayed (one indexed query), so
+detection resumes immediately instead of after a day of warmup. Detected
+anomalies are written to the anomaly_events table, pushed to stream subscribers
+and exposed via GET /api/ai/anomalies.
+"""
+import json
+import logging
+import math
+import os
+import threading
+from array import array
+from dataclasses import dataclass
+from datetime import datetime, timedelta
+from operator import itemgetter
+from typing import Dict, List, Optional, Sequence
+from sqlalchemy.orm import Session
+from models.database import AnomalyEvent, SensorReading
+from models.ingest import IngestReading
+from models.measurements import MEASUREMENT_SCALE, to_centi
+from services.stream_hub import stream_hub
+from services import kernels, metrics, reading_store, tracing
+
+logger = logging.getLogger(__name__)
+
+ANOMALY_DETECTION_ENABLED = os.getenv("ANOMALY_DETECTION_ENABLED", "true").lower() in ("1", "true", "yes")
+# Per-reading learning rate of the hour-of-day profile
+ANOMALY_PROFILE_RATE = float(os.getenv("ANOMALY_PROFILE_RATE", "0.03"))
+# EWMA smoothing factor for the residual variance
+ANOMALY_EWMA_ALPHA = float(os.getenv("ANOMALY_EWMA_ALPHA", "0.02"))
+# CUSUM slack and decision threshold, in residual standard deviations
+ANOMALY_CUSUM_K = float(os.getenv("ANOMALY_CUSUM_K", "1.0"))
+ANOMALY_CUSUM_H = float(os.getenv("ANOMALY_CUSUM_H", "25"))
+# Robust z-score (0.6745 * deviation / MAD) above which a reading is a spike
+ANOMALY_SPIKE_Z = float(os.getenv("ANOMALY_SPIKE_Z", "6"))
+# Recent values kept per node and metric for the median/MAD
+ANOMALY_WINDOW = int(os.getenv("ANOMALY_WINDOW", "15"))
+# History a node needs (bootstrap included) before events are emitted
+ANOMALY_WARMUP_HOURS = float(os.getenv("ANOMALY_WARMUP_HOURS", "20"))
+# History replayed when a node is first seen by this process
+ANOMALY_BOOTSTRAP_HOURS = int(os.getenv("ANOMALY_BOOTSTRAP_HOURS", "48"))
+# A node silent for longer than this restarts its CUSUM (its profile is kept)
+ANOMALY_RESET_GAP_SECONDS = float(os.getenv("ANOMALY_RESET_GAP_SECONDS", "3600"))
+
+ANOMALY_METRICS = ("temperature", "humidity", "soil_moisture")
+# Metrics that follow the clock and get drift detection. Soil moisture follows
+# irrigation cycles instead, so it only gets spike detection (thresholds are
+# covered by the rule engine).
+DRIFT_METRICS = ("temperature", "humidity")
+# Metrics whose upward level shifts are expected (irrigation) and absorbed silently
+ABSORBED_RISE_METRICS = ("soil_moisture",)
+
+# Sensor resolution per metric: lower bound for sigma and MAD, so a perfectly
+# flat series does not turn the next 0.1 step into an "anomaly"
+NOISE_FLOOR = {"temperature": 0.2, "humidity": 1.0, "soil_moisture": 0.5}
+
+PROFILE_BUCKETS = 24
+_METRIC_COUNT = len(ANOMALY_METRICS)
+_FLOORS = tuple(NOISE_FLOOR[m] for m in ANOMALY_METRICS)
+_CENTI_FLOORS = tuple(to_centi(NOISE_FLOOR[m]) for m in ANOMALY_METRICS)
+_DRIFT = tuple(m in DRIFT_METRICS for m in ANOMALY_METRICS)
+_ABSORB_RISE = tuple(m in ABSORBED_RISE_METRICS for m in ANOMALY_METRICS)
+_EPOCH = datetime(1970, 1, 1)
+_NAN = float("nan")
+
+
+@dataclass(slots=True)
+class DetectedAnomaly:
+    """One anomaly found for a node/metric."""
+    node_id: str
+    gateway_id: str
+    metric: str
+    kind: str
+    value: float
+    baseline: float
+    score: float
+    timestamp: datetime
+
+    def to_dict(self) -> Dict:
+        return {
+            "node_id": self.node_id,
+            "gateway_id": self.gateway_id,
+            "metric": self.metric,
+            "kind": self.kind,
+            "value": self.value,
+            "baseline": round(self.baseline, 3),
+            "score": round(self.score, 2),
+            "timestamp": self.timestamp.isoformat()
+        }
+
+
+class AnomalyStateTable:
+    """Struct-of-arrays detector state, one slot per node."""
+
+    def __init__(self, window: int = ANOMALY_WINDOW):
+        self.window = window
+        self.slots: Dict[str, int] = {}
+        # Per node
+        self.first_seen = array("d")
+        self.last_seen = array("d")
+        # Per node * metric
+        self.count = array("q")
+        self.var = array("d")
+        self.cusum_high = array("d")
+        self.cusum_low = array("d")
+        self.pending_z = array("d")  # Unconfirmed spike (0.0 = none)
+        self.pending_value = array("d")
+        self.pending_median = array("d")
+        self.pending_ts = array("d")
+        self.ring_pos = array("q")
+        # Per node * metric * PROFILE_BUCKETS (NaN until the hour is first seen)
+        self.profile = array("d")
+        # Per node * metric * window, in centi-units
+        self.ring = array("h")
+
+    def _columns(self):
+        return (self.count, self.var, self.cusum_high, self.cusum_low, self.pending_z,
+                self.pending_value, self.pending_median, self.pending_ts, self.ring_pos)
+
+    def slot(self, node_id: str) -> Optional[int]:
+        return self.slots.get(node_id)
+
+    def allocate(self, node_id: str) -> int:
+        """Add a slot for a new node."""
+        slot = len(self.slots)
+        self.slots[node_id] = slot
+        self.first_seen.append(0.0)
+        self.last_seen.append(0.0)
+        for column in self._columns():
+            column.extend(array(column.typecode, bytes(column.itemsize * _METRIC_COUNT)))
+        self.profile.extend(array("d", [_NAN]) * (_METRIC_COUNT * PROFILE_BUCKETS))
+        self.ring.extend(array("h", bytes(2 * _METRIC_COUNT * self.window)))
+        return slot
+
+    @property
+    def nbytes(self) -> int:
+        """Approximate memory held by the state arrays."""
+        columns = self._columns() + (self.first_seen, self.last_seen, self.profile, self.ring)
+        return sum(column.itemsize * len(column) for column in columns)
+
+
+class AnomalyDetector:
+    """Updates detector state per reading and reports spikes and drifts."""
+
+    def __init__(self):
+        self.state = AnomalyStateTable()
+        self._lock = threading.Lock()
+
+    def update(self, reading: IngestReading, timestamp: datetime) -> List[DetectedAnomaly]:
+        """Feed one stored reading through the detectors.
+
+        Readings older than the node's newest one (offline-buffer backfill) are
+        skipped: the detectors assume each node's series arrives in time order.
+        """
+        values = (reading.temperature, reading.humidity, reading.soil_moisture)
+        with self._lock:
+            slot = self.state.slot(reading.node_id)
+            if slot is None:
+                slot = self.state.allocate(reading.node_id)
+            hits = self._observe(slot, values, (timestamp - _EPOCH).total_seconds())
+        return [
+            DetectedAnomaly(
+                reading.node_id, reading.gateway_id, ANOMALY_METRICS[m], kind, value, baseline, score,
+                _EPOCH + timedelta(seconds=at)
+            )
+            for m, kind, value, baseline, score, at in hits
+        ]
+
+    def bootstrap(self, node_id: str, rows: Sequence[Sequence]) -> bool:
+        """Replay a node's recent history (timestamp, temperature, humidity, soil_moisture) silently.
+
+        Returns False if the node already has state (another thread got there first).
+        """
+        with self._lock:
+            if self.state.slot(node_id) is not None:
+                return False
+            slot = self.state.allocate(node_id)
+            for timestamp, *values in rows:
+                self._observe(slot, values, (timestamp - _EPOCH).total_seconds())
+        return True
+
+    def _observe(self, slot: int, values: Sequence[float], ts: float) -> list:
+        state = self.state
+        last_seen = state.last_seen[slot]
+        if ts < last_seen:
+            return []
+        if not last_seen:
+            state.first_seen[slot] = ts
+        state.last_seen[slot] = ts
+        reset_cusum = last_seen and ts - last_seen > ANOMALY_RESET_GAP_SECONDS
+        warm = ts - state.first_seen[slot] >= ANOMALY_WARMUP_HOURS * 3600
+
+        # Hour-of-day profile position, interpolated between bucket centres
+        position = (ts % 86400) / 3600.0 - 0.5
+        lower = math.floor(position)
+        upper_weight = position - lower
+        lower_bucket = lower % PROFILE_BUCKETS
+        upper_bucket = (lower + 1) % PROFILE_BUCKETS
+
+        hits = []
+        for m in range(_METRIC_COUNT):
+            i = slot * _METRIC_COUNT + m
+            base = i * PROFILE_BUCKETS
+            for hit in self._update_metric(
+                i, values[m], ts, _FLOORS[m], _CENTI_FLOORS[m], base, base + lower_bucket, base + upper_bucket,
+                upper_weight, warm and _DRIFT[m], warm, reset_cusum, _ABSORB_RISE[m]
+            ):
+                hits.append((m,) + hit)
+        return hits
+
+    def _update_metric(
+        self, i: int, x: float, ts: float, floor: float, centi_floor: int, base: int, lower: int, upper: int,
+        upper_weight: float, drift: bool, warm: bool, reset_cusum: bool, absorb_rise: bool
+    ) -> list:
+        state = self.state
+        profile = state.profile
+        window = state.window
+        n = state.count[i]
+        results = []
+
+        # Spike: robust z-score against the median/MAD of the recent window (in centi-units)
+        robust_z = median = 0.0
+        centi = round(x * MEASUREMENT_SCALE)
+        filled = n if n < window else window
+        if filled >= window // 2 + 1:
+            start = i * window
+            centi_median, mad = kernels.median_mad(state.ring, start, filled)
+            robust_z = 0.6745 * (centi - centi_median) / max(mad, centi_floor)
+            median = centi_median / MEASUREMENT_SCALE
+        outlier = abs(robust_z) > ANOMALY_SPIKE_Z
+
+        if profile[lower] != profile[lower]:  # NaN: first visit to this hour
+            profile[lower] = x
+        if profile[upper] != profile[upper]:
+            profile[upper] = x
+        expected = profile[lower] + upper_weight * (profile[upper] - profile[lower])
+        residual = x - expected
+
+        pending = state.pending_z[i]
+        if pending:
+            state.pending_z[i] = 0.0
+            if outlier and (robust_z > 0) == (pending > 0):
+                if absorb_rise and robust_z > 0:
+                    # Irrigation: move the whole profile to the new level, no event
+                    for b in range(base, base + PROFILE_BUCKETS):
+                        profile[b] += residual
+                    state.cusum_high[i] = state.cusum_low[i] = 0.0
+                    residual = 0.0
+                elif warm:
+                    results.append(("level_shift", x, state.pending_median[i], robust_z, state.pending_ts[i]))
+                # Restart the recent-value window at the new level so the
+                # readings after the shift are not outliers against the old one
+                start = i * window
+                state.ring[start:start + window] = array("h", [centi]) * window
+                outlier = False
+            elif warm:
+                results.append(("spike", state.pending_value[i], state.pending_median[i], pending, state.pending_ts[i]))
+
+        if outlier:
+            # Kept out of the baseline until confirmed either way
+            state.pending_z[i] = robust_z
+            state.pending_value[i] = x
+            state.pending_median[i] = median
+            state.pending_ts[i] = ts
+        else:
+            # Drift: CUSUM of the standardized residual against the profile
+            if reset_cusum:
+                state.cusum_high[i] = state.cusum_low[i] = 0.0
+            sigma = max(math.sqrt(state.var[i]), floor)
+            z = residual / sigma
+            high = max(0.0, state.cusum_high[i] + z - ANOMALY_CUSUM_K)
+            low = max(0.0, state.cusum_low[i] - z - ANOMALY_CUSUM_K)
+            if drift and (high > ANOMALY_CUSUM_H or low > ANOMALY_CUSUM_H):
+                if high > low:
+                    results.append(("drift_up", x, expected, high, ts))
+                else:
+                    results.append(("drift_down", x, expected, -low, ts))
+                high = low = 0.0
+            state.cusum_high[i] = high
+            state.cusum_low[i] = low
+
+            # Large residuals (the drift itself) are kept out of sigma so it
+            # does not widen to swallow the drift being detected
+            if abs(z) < 3.0:
+                alpha = ANOMALY_EWMA_ALPHA
+                state.var[i] = (1.0 - alpha) * state.var[i] + alpha * residual * residual
+            rate = ANOMALY_PROFILE_RATE
+            profile[lower] += rate * (1.0 - upper_weight) * residual
+            profile[upper] += rate * upper_weight * residual
+
+        pos = state.ring_pos[i]
+        state.ring[i * window + pos] = centi
+        state.ring_pos[i] = (pos + 1) % window
+        state.count[i] = n + 1
+        return results
+
+    def process(self, db: Session, reading: IngestReading, timestamp: datetime) -> List[DetectedAnomaly]:
+        """Update state for a stored reading and persist/publish any anomalies."""
+        if not ANOMALY_DETECTION_ENABLED:
+            return []
+        if self.state.slot(reading.node_id) is None:
+            self._bootstrap_from_history(db, reading.node_id, timestamp)
+
+        anomalies = self.update(reading, timestamp)
+        if not anomalies:
+            return anomalies
+
+        db.add_all([
+            AnomalyEvent(
+                node_id=a.node_id, gateway_id=a.gateway_id, metric=a.metric, kind=a.kind,
+                value=a.value, baseline=a.baseline, score=a.score, timestamp=a.timestamp
+            )
+            for a in anomalies
+        ])
+        db.commit()
+
+        for a in anomalies:
+            metrics.ANOMALY_EVENTS_TOTAL.labels(a.kind).inc()
+            logger.warning(
+                f"Anomaly {a.kind} on {a.metric}: {a.value} (baseline {a.baseline:.2f}, score {a.score:.1f})",
+                extra={"gateway_id": a.gateway_id, "node_id": a.node_id}
+            )
+            stream_hub.publish(a.node_id, a.gateway_id, json.dumps({"type": "anomaly", "data": a.to_dict()}))
+        return anomalies
+
+    def _bootstrap_from_history(self, db: Session, node_id: str, timestamp: datetime):
+        since = timestamp - timedelta(hours=ANOMALY_BOOTSTRAP_HOURS)
+        rows = db.query(
+            SensorReading.timestamp, SensorReading.temperature,
+            SensorReading.humidity, SensorReading.soil_moisture
+        ).filter(
+            SensorReading.node_id == node_id,
+            SensorReading.timestamp >= since,
+            SensorReading.timestamp < timestamp
+        ).order_by(SensorReading.timestamp).all()
+        compacted = reading_store.block_rows(
+            db, ("timestamp", "temperature", "humidity", "soil_moisture"), since=since, until=timestamp, node_ids=node_id
+        )
+        rows = reading_store.merge_by_time(compacted, rows, itemgetter(0))
+        if self.bootstrap(node_id, rows) and rows:
+            logger.info(f"Anomaly detector bootstrapped from {len(rows)} readings", extra={"node_id": node_id})
+
+
+# Process-wide detector fed by the ingest pipeline
+anomaly_detector = AnomalyDetector()
+
+
+@tracing.traced
+class AnomalyService:
+    """Queries over stored anomaly events."""
+
+    @staticmethod
+    def get_events(
+        db: Session,
+        node_id: Optional[str] = None,
+        metric: Optional[str] = None,
+        hours: int = 24,
+        limit: int = 100
+    ) -> List[AnomalyEvent]:
+        """Most recent anomaly events first.
+
+        Args:
+            db: Database session
+            node_id: Only events for this node
+            metric: Only events for this metric
+            hours: How far back to look
+            limit: Maximum number of events
+        """
+        query = db.query(AnomalyEvent).filter(
+            AnomalyEvent.timestamp >= datetime.utcnow() - timedelta(hours=hours)
+        )
+        if node_id:
+            query = query.filter(AnomalyEvent.node_id == node_id)
+        if metric:
+            query = query.filter(AnomalyEvent.metric == metric)
+        return query.order_by(AnomalyEvent.timestamp.desc()).limit(limit).all()
@@ -0,0 +1,75 @@
+"""Monotonic data version counters used to drive HTTP ETags.
+
+Every stored reading bumps the version of its node, its gateway and the
+global version. Read endpoints derive their ETag from the versions of the data
+they depend on, so an unchanged poll can be answered with 304 Not Modified
+from memory, without touching the database.
+
+Counters live in process memory and the boot ID is part of every ETag, so a
+restart never produces a false match. This assumes a single worker process
+(the deployment default); with multiple workers each process only sees the
+writes it handled itself.
+"""
+import secrets
+import threading
+from typing import Dict, List, Optional
+
+# Distinguishes ETags issued by this process from those of a previous run
+BOOT_ID = secrets.token_hex(4)
+
+_lock = threading.Lock()
+_global_version = 0
+_gateway_meta_version = 0
+_node_versions: Dict[str, int] = {}
+_gateway_versions: Dict[str, int] = {}
+
+
+def bump(node_id: str, gateway_id: str):
+    """Record that a new reading was stored for a node/gateway."""
+    global _global_version
+    with _lock:
+        _global_version += 1
+        _node_versions[node_id] = _global_version
+        _gateway_versions[gateway_id] = _global_version
+
+
+def bump_gateway_meta():
+    """Record a change to gateway metadata that is not a new reading (status reports, liveness)."""
+    global _gateway_meta_version
+    with _lock:
+        _gateway_meta_version += 1
+
+
+def global_version() -> int:
+    """Version of the newest reading across all nodes."""
+    return _global_version
+
+
+def gateway_meta_version() -> int:
+    """Version of gateway metadata changes."""
+    return _gateway_meta_version
+
+
+def node_version(node_id: str) -> int:
+    """Version of the newest reading for a node (0 if none seen since startup)."""
+    return _node_versions.get(node_id, 0)
+
+
+def nodes_changed_since(version: int) -> List[str]:
+    """Nodes that stored a reading after the given global version."""
+    with _lock:
+        return [node_id for node_id, node_version in _node_versions.items() if node_version > version]
+
+
+def gateway_version(gateway_id: str) -> int:
+    """Version of the newest reading for a gateway (0 if none seen since startup)."""
+    return _gateway_versions.get(gateway_id, 0)
+
+
+def readings_version(node_id: Optional[str] = None, gateway_id: Optional[str] = None) -> int:
+    """Version of the readings selected by optional node/gateway filters."""
+    if node_id:
+        return node_version(node_id)
+    if gateway_id:
+        return gateway_version(gateway_id)
+    return _global_version
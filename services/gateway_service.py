@@ -4,17 +4,23 @@ This service handles:
 - Gateway registration and status tracking
 - Online/offline status updates
 - Last seen timestamp management
+
+Online/offline state lives in services/liveness.py; every registration here
+counts as contact and re-arms the gateway's or node's offline deadline.
 """
 from sqlalchemy.orm import Session
 from sqlalchemy import desc
 from typing import List, Optional
-from datetime import datetime, timedelta
+from datetime import datetime
 import logging
 from models.database import Gateway, SensorNode
+from services.liveness import liveness_tracker
+from services import tracing
 
 logger = logging.getLogger(__name__)
 
 
+@tracing.traced
 class GatewayService:
     """Service for managing gateway operations."""
 
@@ -94,6 +100,7 @@ class GatewayService:
             db.refresh(gateway)
             logger.warning(f"Gateway updated without IP fields (migration may not have run): {e}")
         
+        liveness_tracker.touch("gateway", gateway_id, seen_at=gateway.last_seen)
         return gateway
     
     @staticmethod
@@ -137,6 +144,7 @@ class GatewayService:
         if node:
             # Update existing node
             node.last_seen = datetime.utcnow()
+            node.is_online = True
             node.gateway_id = gateway_id
             if name:
                 node.name = name
@@ -147,12 +155,14 @@ class GatewayService:
                 gateway_id=gateway_id,
                 name=name or f"Node {node_id}",
                 is_simulated=is_simulated,
+                is_online=True,
                 last_seen=datetime.utcnow()
             )
             db.add(node)
         
         db.commit()
         db.refresh(node)
+        liveness_tracker.touch("node", node_id, gateway_id=gateway_id, seen_at=node.last_seen)
         return node
 
     @staticmethod
@@ -170,21 +180,36 @@ class GatewayService:
         
         if not gateway:
             return None
+        return GatewayService.gateway_status(gateway)
+
+    @staticmethod
+    def gateway_status(gateway: Gateway) -> dict:
+        """Build the status dictionary for a loaded gateway row.
         
-        # Check if gateway is considered online (seen in last 5 minutes)
-        time_since_last_seen = (datetime.utcnow() - gateway.last_seen).total_seconds()
-        is_online = time_since_last_seen < 300  # 5 minutes threshold
+        Online state and last contact come from the liveness tracker; the row
+        only supplies descriptive fields, so this never writes.
         
-        # Update online status if changed
-        if gateway.is_online != is_online:
-            gateway.is_online = is_online
-            db.commit()
+        Args:
+            gateway: Gateway object
+            
+        Returns:
+            Dictionary with gateway status
+        """
+        record = liveness_tracker.get("gateway", gateway.gateway_id)
+        if record is not None:
+            is_online = record.online
+            last_seen = max(record.last_seen, gateway.last_seen)
+        else:
+            # Tracker not running (e.g. scripts): derive from the stored last_seen
+            last_seen = gateway.last_seen
+            is_online = (datetime.utcnow() - last_seen).total_seconds() < liveness_tracker.timeouts["gateway"]
+        time_since_last_seen = (datetime.utcnow() - last_seen).total_seconds()
         
         return {
             "gateway_id": gateway.gateway_id,
             "name": gateway.name,
             "is_online": is_online,
-            "last_seen": gateway.last_seen.isoformat(),
+            "last_seen": last_seen.isoformat(),
             "last_seen_seconds_ago": int(time_since_last_seen),
             "created_at": gateway.created_at.isoformat(),
             "local_ip": gateway.local_ip,  # ESP32's self-reported IP (source of truth)
@@ -202,36 +227,3 @@ class GatewayService:
             List of Gateway objects
         """
         return db.query(Gateway).order_by(desc(Gateway.last_seen)).all()
-
-    @staticmethod
-    def mark_gateway_offline(db: Session, gateway_id: str):
-        """Mark a gateway as offline.
-        
-        Args:
-            db: Database session
-            gateway_id: Gateway identifier
-        """
-        gateway = db.query(Gateway).filter(Gateway.gateway_id == gateway_id).first()
-        if gateway:
-            gateway.is_online = False
-            db.commit()
-
-    @staticmethod
-    def cleanup_offline_gateways(db: Session, minutes_threshold: int = 10):
-        """Mark gateways as offline if they haven't been seen recently.
-        
-        Args:
-            db: Database session
-            minutes_threshold: Minutes since last_seen to consider offline
-        """
-        threshold_time = datetime.utcnow() - timedelta(minutes=minutes_threshold)
-        gateways = db.query(Gateway).filter(
-            Gateway.is_online == True,
-            Gateway.last_seen < threshold_time
-        ).all()
-        
-        for gateway in gateways:
-            gateway.is_online = False
-        
-        db.commit()
-
@@ -0,0 +1,240 @@
+"""Shared ingest pipeline for sensor readings.
+
+All transports (HTTP, MQTT, ...) feed readings through IngestService.ingest so
+that validation, late/future timestamp handling, duplicate detection, storage
+and real-time fan-out behave identically regardless of how a gateway uploads.
+Each upload is first charged to the per-gateway rate limits with
+IngestService.admit.
+"""
+from sqlalchemy.orm import Session
+from typing import NamedTuple, Optional, Sequence
+from datetime import datetime, timedelta
+import logging
+import math
+from models.database import SensorReading
+from models.ingest import IngestReading
+from services.sensor_service import SensorService
+from services.system_stats import increment_message_count
+from services import data_versions, tracing
+from services.stream_hub import stream_hub
+from services import metrics
+from services.rule_engine import rule_engine
+from services.anomaly_detector import anomaly_detector
+from services.alert_manager import alert_manager
+from services.moisture_forecast import moisture_forecaster
+from services.zones import zone_aggregator
+from services.rate_limiter import RateLimitExceeded, gateway_rate_limiter
+
+logger = logging.getLogger(__name__)
+
+# Readings within this many seconds of an existing one for the same node are duplicates
+DUPLICATE_WINDOW_SECONDS = 5
+
+
+class IngestValidationError(ValueError):
+    """Raised when a reading fails validation and must be rejected."""
+
+
+class IngestResult(NamedTuple):
+    """Outcome of ingesting a single reading."""
+    reading: SensorReading
+    duplicate: bool
+
+
+@tracing.traced
+class IngestService:
+    """Validation, dedup and storage pipeline shared by all ingest transports."""
+
+    @staticmethod
+    def admit(readings: Sequence[IngestReading]):
+        """Charge one upload (HTTP request, MQTT message, UDP frame) to its gateways' rate limits.
+
+        Raises:
+            RateLimitExceeded: If a gateway is over its limit; nothing is charged
+        """
+        try:
+            gateway_rate_limiter.charge_upload(list(readings))
+        except RateLimitExceeded as e:
+            metrics.INGEST_RATE_LIMITED.inc(len(readings))
+            retry = "larger than the burst size" if math.isinf(e.retry_after) else f"retry after {e.retry_after:.1f}s"
+            logger.warning(
+                f"Rate limit exceeded: {e.cost} reading(s), {retry}",
+                extra={"gateway_id": e.gateway_id}
+            )
+            raise
+
+    @staticmethod
+    def validate(reading: IngestReading):
+        """Strict validation of a sensor payload.
+
+        Raises:
+            IngestValidationError: If any value is outside its valid range
+        """
+        extra = {"gateway_id": reading.gateway_id, "node_id": reading.node_id}
+
+        if reading.temperature < -50 or reading.temperature > 100:
+            logger.warning(f"Invalid temperature: {reading.temperature}", extra=extra)
+            raise IngestValidationError(
+                f"Temperature out of valid range (-50 to 100°C): {reading.temperature}"
+            )
+
+        if reading.humidity < 0 or reading.humidity > 100:
+            logger.warning(f"Invalid humidity: {reading.humidity}", extra=extra)
+            raise IngestValidationError(
+                f"Humidity out of valid range (0-100%): {reading.humidity}"
+            )
+
+        if reading.soil_moisture < 0 or reading.soil_moisture > 100:
+            logger.warning(f"Invalid soil moisture: {reading.soil_moisture}", extra=extra)
+            raise IngestValidationError(
+                f"Soil moisture out of valid range (0-100%): {reading.soil_moisture}"
+            )
+
+        if reading.light_level is not None and reading.light_level < 0:
+            logger.warning(f"Invalid light level: {reading.light_level}", extra=extra)
+            raise IngestValidationError(
+                f"Light level must not be negative: {reading.light_level}"
+            )
+
+    @staticmethod
+    def resolve_timestamp(reading: IngestReading) -> datetime:
+        """Determine the stored timestamp for a reading.
+
+        Uses the device timestamp when present. Late data (more than 24 hours old)
+        is accepted with a warning; future timestamps fall back to the current time.
+        """
+        extra = {"gateway_id": reading.gateway_id, "node_id": reading.node_id}
+        reading_timestamp = datetime.utcnow()
+        if not reading.timestamp:
+            return reading_timestamp
+
+        try:
+            reading_timestamp = datetime.fromtimestamp(reading.timestamp)
+            # Check if data is too old (more than 24 hours)
+            age = datetime.utcnow() - reading_timestamp
+            if age > timedelta(hours=24):
+                logger.warning(
+                    f"Late data received: {age.total_seconds() / 3600:.1f} hours old",
+                    extra=extra
+                )
+                # Still accept it but log warning
+            elif age < timedelta(seconds=-60):
+                logger.warning(
+                    f"Future timestamp detected: {abs(age.total_seconds())} seconds in future",
+                    extra=extra
+                )
+                # Use current time instead
+                reading_timestamp = datetime.utcnow()
+        except (ValueError, OSError, OverflowError):
+            logger.warning(
+                f"Invalid timestamp: {reading.timestamp}, using current time",
+                extra=extra
+            )
+            reading_timestamp = datetime.utcnow()
+
+        return reading_timestamp
+
+    @staticmethod
+    def ingest(
+        db: Session,
+        reading: IngestReading,
+        client_ip: Optional[str] = None
+    ) -> IngestResult:
+        """Run a reading through the full ingest pipeline.
+
+        Args:
+            db: Database session
+            reading: Reading to store
+            client_ip: IP address the reading was received from (for diagnostics)
+
+        Returns:
+            IngestResult with the stored (or previously stored duplicate) reading
+
+        Raises:
+            IngestValidationError: If the reading fails validation
+        """
+        gateway_id = reading.gateway_id
+        node_id = reading.node_id
+        extra = {"gateway_id": gateway_id, "node_id": node_id}
+
+        # Register/update gateway (with IP addresses) and node; a gateway or node
+        # sending rejected or duplicate readings is still alive
+        with metrics.INGEST_REGISTRY_UPSERT.time():
+            source = SensorService.register_source(db, reading, client_ip=client_ip)
+
+        try:
+            with metrics.INGEST_VALIDATE.time():
+                IngestService.validate(reading)
+                reading_timestamp = IngestService.resolve_timestamp(reading)
+        except IngestValidationError:
+            metrics.INGEST_REJECTED.inc()
+            raise
+
+        # Check for duplicate (same node_id, similar timestamp within 5 seconds)
+        with metrics.INGEST_DEDUP.time():
+            recent_reading = SensorService.check_duplicate(
+                db, node_id, gateway_id, reading_timestamp,
+                window_seconds=DUPLICATE_WINDOW_SECONDS
+            )
+        if recent_reading:
+            metrics.INGEST_DUPLICATE.inc()
+            logger.info(
+                f"Duplicate data detected (within {DUPLICATE_WINDOW_SECONDS}s window), returning existing reading",
+                extra=extra
+            )
+            return IngestResult(recent_reading, True)
+
+        # Insert and commit stages are timed inside create_reading
+        stored = SensorService.create_reading(db, reading, timestamp=reading_timestamp, source=source)
+        metrics.INGEST_STORED.inc()
+        increment_message_count()
+        data_versions.bump(node_id, gateway_id)
+
+        # Push to real-time stream subscribers (WebSocket/SSE)
+        stream_hub.publish_reading(stored)
+
+        # Threshold rules; a failing rule or listener must never reject a stored reading
+        rule_events = anomalies = ()
+        try:
+            with metrics.INGEST_RULES.time():
+                rule_events = rule_engine.process(reading, reading_timestamp)
+        except Exception as e:
+            logger.error(f"Rule evaluation failed: {str(e)}", extra=extra, exc_info=True)
+
+        # Streaming spike/drift detection (same isolation as the rules)
+        try:
+            with metrics.INGEST_ANOMALY.time():
+                anomalies = anomaly_detector.process(db, reading, reading_timestamp)
+        except Exception as e:
+            db.rollback()
+            logger.error(f"Anomaly detection failed: {str(e)}", extra=extra, exc_info=True)
+
+        # Time-until-irrigation model (same isolation as the rules)
+        try:
+            with metrics.INGEST_FORECAST.time():
+                moisture_forecaster.process(db, reading, reading_timestamp)
+        except Exception as e:
+            db.rollback()
+            logger.error(f"Moisture forecast update failed: {str(e)}", extra=extra, exc_info=True)
+
+        # Zone snapshots and rollups (in memory; flushed to zone_rollups in the background)
+        try:
+            with metrics.INGEST_ZONES.time():
+                zone_aggregator.observe(reading, reading_timestamp)
+        except Exception as e:
+            logger.error(f"Zone rollup update failed: {str(e)}", extra=extra, exc_info=True)
+
+        # Alert lifecycle (dedup, min duration, hysteresis) on top of rule and drift events
+        try:
+            with metrics.INGEST_ALERTS.time():
+                alert_manager.observe(db, reading, reading_timestamp, rule_events, anomalies)
+        except Exception as e:
+            db.rollback()
+            logger.error(f"Alert tracking failed: {str(e)}", extra=extra, exc_info=True)
+
+        logger.info(
+            f"Sensor data received: node_id={node_id}, temp={reading.temperature:.1f}°C, "
+            f"humidity={reading.humidity:.1f}%, timestamp={reading_timestamp.isoformat()}",
+            extra=extra
+        )
+        return IngestResult(stored, False)
@@ -0,0 +1,345 @@
+"""Background precomputation of insights into the insights table.
+
+GET /api/ai/insights and /api/ai/insights/{node_id} read one stored row, so
+their latency does not depend on the window or the number of nodes. The
+scheduler keeps those rows current:
+- What: for every node, the 24 h / 7 d node analysis plus the trend analysis
+  over each window in INSIGHT_TREND_WINDOWS; the same trend windows are kept
+  for the whole fleet (scope '*').
+- When: after a node stores new readings (seen through services/data_versions.py),
+  at most once per INSIGHT_TREND_REFRESH_SECONDS for trends and once per
+  INSIGHT_NODE_REFRESH_SECONDS for the node analysis. Every result is also
+  recomputed after INSIGHT_MAX_AGE_SECONDS without new data, so a silent node
+  gets its stale-data insight. A result computed without current data (no
+  readings in the window, or stale data) is recomputed as soon as new readings
+  arrive, at most once per INSIGHT_PROVISIONAL_REFRESH_SECONDS.
+- Order: due work is queued by the scope's last risk level (high, medium,
+  not computed yet, low), then by how long ago it was last computed.
+- Where: INSIGHT_WORKERS workers share the queue and each takes the next job as
+  soon as it finishes one. Jobs run through services/analytics.py: on a
+  snapshot session, on the analytics threads or worker processes.
+
+Trend windows that are not precomputed are still analyzed on request.
+
+Change tracking uses the in-process counters of services/data_versions.py, so
+with several worker processes only one of them runs the scheduler (guarded by
+a file lock per database) and readings ingested by the others are picked up
+after INSIGHT_MAX_AGE_SECONDS. The lock covers workers on one host; run the
+scheduler on one host only (INSIGHT_PRECOMPUTE_ENABLED=false elsewhere).
+"""
+import asyncio
+import hashlib
+import logging
+import math
+import os
+import tempfile
+import time
+from dataclasses import dataclass
+from datetime import datetime
+from typing import Dict, Iterator, List, Optional, Tuple
+from sqlalchemy.orm import Session
+from models.database import DATABASE_URL, Insight, SensorNode, SessionLocal
+from models.schemas import NodeInsightsResponse, TrendInsightsResponse
+from services import data_versions, tracing
+from services.ai_insights import AIInsightsService
+from services.analytics import ANALYTICS_PROCESSES, ANALYTICS_WORKERS, run_analytics
+from services.trend_insights_service import TrendInsightService
+
+logger = logging.getLogger(__name__)
+
+INSIGHT_PRECOMPUTE_ENABLED = os.getenv("INSIGHT_PRECOMPUTE_ENABLED", "true").lower() in ("1", "true", "yes")
+# Trend windows (minutes) kept precomputed; GET /api/ai/insights defaults to 60
+INSIGHT_TREND_WINDOWS = tuple(
+    int(minutes) for minutes in os.getenv("INSIGHT_TREND_WINDOWS", "60").split(",") if minutes.strip()
+)
+INSIGHT_TREND_REFRESH_SECONDS = float(os.getenv("INSIGHT_TREND_REFRESH_SECONDS", "60"))
+INSIGHT_NODE_REFRESH_SECONDS = float(os.getenv("INSIGHT_NODE_REFRESH_SECONDS", "600"))
+INSIGHT_MAX_AGE_SECONDS = float(os.getenv("INSIGHT_MAX_AGE_SECONDS", "900"))
+# Minimum time between recomputations of a result computed without current data, after new readings
+INSIGHT_PROVISIONAL_REFRESH_SECONDS = float(os.getenv("INSIGHT_PROVISIONAL_REFRESH_SECONDS", "5"))
+# Concurrent jobs; keep below the analytics pool size so requests for other windows are not queued behind them
+INSIGHT_WORKERS = int(os.getenv("INSIGHT_WORKERS", "1"))
+
+# Held by the one worker process that runs the scheduler
+INSIGHT_SCHEDULER_LOCK_FILE = os.getenv(
+    "INSIGHT_SCHEDULER_LOCK_FILE",
+    os.path.join(tempfile.gettempdir(), f"greenhouse-insights-{hashlib.sha1(DATABASE_URL.encode()).hexdigest()[:12]}.lock")
+)
+
+# Scope of the fleet-wide trend insights
+FLEET_SCOPE = "*"
+NODE_KIND = "node"
+TREND_KIND = "trend"
+
+# Sensor failure patterns that new readings resolve
+_NO_CURRENT_DATA = ("no_data", "stale_data")
+
+# Queue order by last risk level; results not computed yet go before known-low ones
+_RISK_RANK = {"high": 0, "medium": 1, "low": 3}
+_NEW_RANK = 2
+_DISPATCH_INTERVAL_SECONDS = 1.0
+
+# (scope, kind, window_minutes), the primary key of the insights table
+InsightKey = Tuple[str, str, int]
+
+
+def compute_insight(db: Session, scope: str, kind: str, window_minutes: int) -> Tuple[str, datetime, str, bool]:
+    """Run one analysis on a snapshot session.
+
+    Returns:
+        (risk level in lower case, computation time, response body as JSON,
+        whether it was computed without current data)
+    """
+    computed_at = datetime.utcnow()
+    if kind == NODE_KIND:
+        response = NodeInsightsResponse(**AIInsightsService.analyze_node(db, scope), computed_at=computed_at)
+        risk_level = response.risk_level
+        provisional = response.metrics.avg_temp_24h is None
+    else:
+        result = TrendInsightService.analyze_trends(
+            db, node_id=None if scope == FLEET_SCOPE else scope, minutes=window_minutes
+        )
+        response = TrendInsightsResponse(**result, computed_at=computed_at)
+        risk_level = response.overall_risk_level
+        provisional = any(insight.get("failure_pattern") in _NO_CURRENT_DATA for insight in result["insights"])
+    return risk_level.lower(), computed_at, response.model_dump_json(), provisional
+
+
+@tracing.traced
+class InsightService:
+    """Stored insight results."""
+
+    @staticmethod
+    def is_precomputed(kind: str, window_minutes: int = 0) -> bool:
+        """Whether the scheduler keeps results of this kind and window."""
+        return INSIGHT_PRECOMPUTE_ENABLED and (kind == NODE_KIND or window_minutes in INSIGHT_TREND_WINDOWS)
+
+    @staticmethod
+    def get(db: Session, scope: str, kind: str, window_minutes: int = 0) -> Optional[Insight]:
+        return db.get(Insight, (scope, kind, window_minutes))
+
+    @staticmethod
+    def save(key: InsightKey, risk_level: str, computed_at: datetime, result: str):
+        db = SessionLocal()
+        try:
+            scope, kind, window_minutes = key
+            db.merge(Insight(
+                scope=scope, kind=kind, window_minutes=window_minutes,
+                risk_level=risk_level, result=result, computed_at=computed_at
+            ))
+            db.commit()
+        except Exception:
+            db.rollback()
+            raise
+        finally:
+            db.close()
+
+
+@dataclass(slots=True)
+class _Task:
+    """Scheduling state of one stored result."""
+    dirty: bool = True  # New readings since the last computation started
+    computed: float = -math.inf  # time.monotonic() when the last computation started
+    risk: int = _NEW_RANK
+    queued: bool = False  # In the queue or running
+    provisional: bool = False  # Last result was computed without current data
+
+
+class InsightScheduler:
+    """Recomputes stored insights of nodes with new data, highest risk first."""
+
+    def __init__(self):
+        self._tasks: Dict[InsightKey, _Task] = {}
+        self._queue: Optional[asyncio.PriorityQueue] = None
+        self._version = 0
+        self._runners: List[asyncio.Task] = []
+        self.computed = 0
+        self.failed = 0
+
+    @property
+    def queue_depth(self) -> int:
+        return self._queue.qsize() if self._queue is not None else 0
+
+    def oldest_age(self) -> Optional[float]:
+        """Seconds since the least recently computed result started computing (None if none yet)."""
+        computed = [task.computed for task in self._tasks.values() if task.computed > -math.inf]
+        return time.monotonic() - min(computed) if computed else None
+
+    @staticmethod
+    def _keys(scope: str) -> Iterator[InsightKey]:
+        if scope != FLEET_SCOPE:
+            yield scope, NODE_KIND, 0
+        for window_minutes in INSIGHT_TREND_WINDOWS:
+            yield scope, TREND_KIND, window_minutes
+
+    def _scope_rank(self, scope: str) -> int:
+        return min(self._tasks[key].risk for key in self._keys(scope))
+
+    def mark_changed(self, scope: str):
+        """Record new readings for a node (or the fleet)."""
+        for key in self._keys(scope):
+            task = self._tasks.get(key)
+            if task is None:
+                self._tasks[key] = _Task()
+            else:
+                task.dirty = True
+
+    def load(self, db: Session) -> int:
+        """Track every known node, starting from its stored results.
+
+        All nodes count as changed, so results older than their refresh
+        interval are recomputed first thing.
+
+        Returns:
+            Number of nodes tracked
+        """
+        now, wall_now = time.monotonic(), datetime.utcnow()
+        stored = {
+            (row.scope, row.kind, row.window_minutes): row
+            for row in db.query(Insight.scope, Insight.kind, Insight.window_minutes, Insight.risk_level, Insight.computed_at)
+        }
+        scopes = [FLEET_SCOPE] + [node_id for (node_id,) in db.query(SensorNode.node_id)]
+        for scope in scopes:
+            for key in self._keys(scope):
+                task = _Task()
+                row = stored.get(key)
+                if row is not None:
+                    task.computed = now - max(0.0, (wall_now - row.computed_at).total_seconds())
+                    task.risk = _RISK_RANK.get(row.risk_level, _NEW_RANK)
+                self._tasks[key] = task
+        self._version = data_versions.global_version()
+        return len(scopes) - 1
+
+    def _collect_changes(self):
+        version = data_versions.global_version()
+        if version == self._version:
+            return
+        changed = data_versions.nodes_changed_since(self._version)
+        self._version = version
+        for node_id in changed:
+            self.mark_changed(node_id)
+        self.mark_changed(FLEET_SCOPE)
+
+    def _enqueue_due(self, now: float):
+        for key, task in self._tasks.items():
+            if task.queued:
+                continue
+            age = now - task.computed
+            if task.provisional:
+                refresh = INSIGHT_PROVISIONAL_REFRESH_SECONDS
+            elif key[1] == NODE_KIND:
+                refresh = INSIGHT_NODE_REFRESH_SECONDS
+            else:
+                refresh = INSIGHT_TREND_REFRESH_SECONDS
+            if (task.dirty and age >= refresh) or age >= INSIGHT_MAX_AGE_SECONDS:
+                task.queued = True
+                self._queue.put_nowait((self._scope_rank(key[0]), task.computed, key))
+
+    async def _dispatch(self):
+        while True:
+            try:
+                self._collect_changes()
+                self._enqueue_due(time.monotonic())
+            except Exception as e:
+                logger.error(f"Insight scheduling failed: {str(e)}", exc_info=True)
+            await asyncio.sleep(_DISPATCH_INTERVAL_SECONDS)
+
+    async def _work(self):
+        while True:
+            _, _, key = await self._queue.get()
+            task = self._tasks[key]
+            # Readings stored from here on mark the result dirty again
+            task.dirty = False
+            task.computed = time.monotonic()
+            try:
+                with tracing.trace(
+                    f"insight {key[1]}", kind=tracing.INTERNAL,
+                    node_id=key[0] if key[0] != FLEET_SCOPE else None, window_minutes=key[2]
+                ):
+                    risk_level, computed_at, result, provisional = await run_analytics(compute_insight, *key)
+                    await asyncio.to_thread(InsightService.save, key, risk_level, computed_at, result)
+                task.risk = _RISK_RANK.get(risk_level, _NEW_RANK)
+                task.provisional = provisional
+                self.computed += 1
+            except Exception as e:
+                # Retried after the refresh interval
+                task.dirty = True
+                self.failed += 1
+                logger.error(
+                    f"Insight computation failed ({key[1]}, {key[2]} min): {str(e)}",
+                    extra={"node_id": key[0]}, exc_info=True
+                )
+            finally:
+                task.queued = False
+
+    async def start(self, workers: int = INSIGHT_WORKERS):
+        """Start the dispatcher and workers. Must be called from the event loop."""
+        self._queue = asyncio.PriorityQueue()
+        self._runners = [asyncio.create_task(self._dispatch())]
+        self._runners.extend(asyncio.create_task(self._work()) for _ in range(max(1, workers)))
+
+    async def stop(self):
+        for runner in self._runners:
+            runner.cancel()
+        await asyncio.gather(*self._runners, return_exceptions=True)
+        self._runners = []
+
+
+# Process-wide scheduler (runs only with INSIGHT_PRECOMPUTE_ENABLED)
+insight_scheduler = InsightScheduler()
+
+# Open while this process holds the scheduler lock
+_lock_file = None
+
+
+def _acquire_scheduler_lock() -> bool:
+    """Take the per-database scheduler lock without waiting (always succeeds where flock is unavailable)."""
+    global _lock_file
+    try:
+        import fcntl
+    except ImportError:
+        return True
+    lock_file = open(INSIGHT_SCHEDULER_LOCK_FILE, "a")
+    try:
+        fcntl.flock(lock_file, fcntl.LOCK_EX | fcntl.LOCK_NB)
+    except OSError:
+        lock_file.close()
+        return False
+    _lock_file = lock_file
+    return True
+
+
+def _release_scheduler_lock():
+    global _lock_file
+    if _lock_file is not None:
+        _lock_file.close()
+        _lock_file = None
+
+
+async def start_insight_scheduler():
+    """Load stored results and start precomputing if INSIGHT_PRECOMPUTE_ENABLED is set.
+
+    Only the first worker process to start runs the scheduler; the others serve
+    the results it stores.
+    """
+    if not INSIGHT_PRECOMPUTE_ENABLED:
+        return
+    if not _acquire_scheduler_lock():
+        logger.info(f"Insight precomputation runs in another worker process ({INSIGHT_SCHEDULER_LOCK_FILE})")
+        return
+    db = SessionLocal()
+    try:
+        nodes = insight_scheduler.load(db)
+    finally:
+        db.close()
+    await insight_scheduler.start()
+    pool = f"{ANALYTICS_PROCESSES} process(es)" if ANALYTICS_PROCESSES > 0 else f"{ANALYTICS_WORKERS} thread(s)"
+    logger.info(
+        f"Insight precomputation active for {nodes} node(s), trend windows {list(INSIGHT_TREND_WINDOWS)} min "
+        f"({INSIGHT_WORKERS} worker(s) on {pool})"
+    )
+
+
+async def stop_insight_scheduler():
+    await insight_scheduler.stop()
+    _release_scheduler_lock()
@@ -0,0 +1,85 @@
+"""Numeric kernels of the insight detectors and the anomaly detector.
+
+- mean(values): average of a window of readings (node analysis)
+- summary(values): count, mean, sample standard deviation, min and max of a
+  window of readings, in one call (trend detectors)
+- median_mad(values, start, count): median and median absolute deviation of
+  integers in a buffer range (the anomaly detector's recent-value window)
+
+When the optional C++ extension in native/ is installed (`pip install ./native`),
+these run natively: one vectorized pass over contiguous buffers such as
+array('d') / array('h') or lists, with the GIL released on large inputs.
+Otherwise the pure-Python versions below are used. median_mad returns the same
+integers either way; mean and summary agree to floating-point rounding.
+benchmarks/bench_kernels.py checks parity and measures both.
+
+Set NATIVE_KERNELS=false to use the Python versions even when the extension is
+installed.
+"""
+import logging
+import math
+import os
+from typing import NamedTuple, Optional, Sequence, Tuple
+
+logger = logging.getLogger(__name__)
+
+NATIVE_KERNELS = os.getenv("NATIVE_KERNELS", "true").lower() in ("1", "true", "yes")
+
+
+class Summary(NamedTuple):
+    """Summary statistics of a non-empty window."""
+    count: int
+    mean: float
+    stdev: float  # Sample standard deviation (0.0 for a single value)
+    min: float
+    max: float
+
+
+def py_mean(values: Sequence[float]) -> Optional[float]:
+    """Mean of values (None if empty), in Python."""
+    return sum(values) / len(values) if len(values) else None
+
+
+def py_summary(values: Sequence[float]) -> Optional[Summary]:
+    """Summary of values (None if empty), in Python."""
+    n = len(values)
+    if n == 0:
+        return None
+    mean = math.fsum(values) / n
+    stdev = math.sqrt(math.fsum((x - mean) ** 2 for x in values) / (n - 1)) if n > 1 else 0.0
+    return Summary(n, mean, stdev, float(min(values)), float(max(values)))
+
+
+def py_median_mad(values: Sequence[int], start: int, count: int) -> Tuple[int, int]:
+    """Upper median and upper median absolute deviation of values[start:start + count], in Python."""
+    recent = sorted(values[start:start + count])
+    median = recent[count // 2]
+    return median, sorted([abs(v - median) for v in recent])[count // 2]
+
+
+_native = None
+if NATIVE_KERNELS:
+    try:
+        import greenhouse_kernels as _native
+    except ImportError:
+        _native = None
+
+if _native is not None:
+    _native_summary = _native.summary
+
+    def summary(values: Sequence[float]) -> Optional[Summary]:
+        """Summary of values (None if empty)."""
+        result = _native_summary(values)
+        return Summary._make(result) if result is not None else None
+
+    mean = _native.mean
+    median_mad = _native.median_mad
+else:
+    mean = py_mean
+    summary = py_summary
+    median_mad = py_median_mad
+
+
+def implementation() -> str:
+    """'native' or 'python'."""
+    return "native" if _native is not None else "python"
@@ -0,0 +1,324 @@
+"""In-memory liveness tracking for gateways and nodes.
+
+Every message from a gateway or node calls `touch`, which moves that entity's
+deadline to last contact + GATEWAY_OFFLINE_SECONDS (or NODE_OFFLINE_SECONDS).
+A single timer task sleeps until the earliest deadline in a heap and marks the
+entity offline when it expires. A message from an offline or unknown entity
+marks it online immediately.
+
+The heap holds at most one entry per entity. Touching an entity that already
+has an entry only updates the deadline on its record; when the stale heap entry
+comes due it is pushed back with the current deadline. A message therefore
+costs a dict lookup, not a heap operation.
+
+Transitions are:
+- kept in memory, so status reads (is_online, last_seen) never query or write
+  the database
+- written to gateways.is_online / sensor_nodes.is_online in batches by the timer
+  task, off the request path
+- published to stream subscribers as {"type": "liveness", "data": {...}} and
+  passed to registered listeners
+"""
+import asyncio
+import heapq
+import json
+import logging
+import os
+import threading
+import time
+from dataclasses import dataclass
+from datetime import datetime
+from typing import Callable, Dict, List, Optional, Tuple
+from sqlalchemy import update
+from models.database import Gateway, SensorNode, SessionLocal
+from services import data_versions
+from services import metrics
+from services.stream_hub import stream_hub
+
+logger = logging.getLogger(__name__)
+
+GATEWAY_OFFLINE_SECONDS = float(os.getenv("GATEWAY_OFFLINE_SECONDS", "300"))
+NODE_OFFLINE_SECONDS = float(os.getenv("NODE_OFFLINE_SECONDS", "600"))
+
+LIVENESS_KINDS = ("gateway", "node")
+
+
+@dataclass(slots=True)
+class LivenessRecord:
+    """Current liveness of one gateway or node."""
+    kind: str  # 'gateway' or 'node'
+    entity_id: str
+    gateway_id: Optional[str]  # Owning gateway (nodes only)
+    online: bool
+    last_seen: datetime  # UTC wall clock of the last message
+    deadline: float  # time.monotonic() at which the entity goes offline
+    armed: bool = False  # Whether the heap holds an entry for this entity
+
+    def to_dict(self) -> Dict:
+        return {
+            "kind": self.kind,
+            "id": self.entity_id,
+            "gateway_id": self.gateway_id,
+            "is_online": self.online,
+            "last_seen": self.last_seen.isoformat(),
+        }
+
+
+@dataclass(slots=True)
+class LivenessTransition:
+    """An online/offline change of one gateway or node."""
+    kind: str
+    entity_id: str
+    gateway_id: Optional[str]
+    online: bool
+    last_seen: datetime
+    at: datetime
+
+    def to_dict(self) -> Dict:
+        return {
+            "kind": self.kind,
+            "id": self.entity_id,
+            "gateway_id": self.gateway_id,
+            "is_online": self.online,
+            "last_seen": self.last_seen.isoformat(),
+            "at": self.at.isoformat(),
+        }
+
+
+class LivenessTracker:
+    """Deadline-driven online/offline state for gateways and nodes."""
+
+    def __init__(self, gateway_timeout: float = GATEWAY_OFFLINE_SECONDS, node_timeout: float = NODE_OFFLINE_SECONDS):
+        self.timeouts = {"gateway": gateway_timeout, "node": node_timeout}
+        self._records: Dict[Tuple[str, str], LivenessRecord] = {}
+        self._heap: List[Tuple[float, str, str]] = []
+        self._online = {kind: 0 for kind in LIVENESS_KINDS}
+        self._unpersisted: List[LivenessTransition] = []
+        self._listeners: List[Callable[[LivenessTransition], None]] = []
+        self._lock = threading.Lock()
+        self._loop: Optional[asyncio.AbstractEventLoop] = None
+        self._wakeup: Optional[asyncio.Event] = None
+        self._task: Optional[asyncio.Task] = None
+
+    @property
+    def running(self) -> bool:
+        return self._task is not None
+
+    def add_listener(self, listener: Callable[[LivenessTransition], None]):
+        """Register a callback invoked for every transition."""
+        self._listeners.append(listener)
+
+    def online_count(self, kind: str) -> int:
+        return self._online[kind]
+
+    def get(self, kind: str, entity_id: str) -> Optional[LivenessRecord]:
+        """Liveness of one gateway or node, or None if it has never been seen."""
+        return self._records.get((kind, entity_id))
+
+    def records(self, kind: str, gateway_id: Optional[str] = None) -> List[LivenessRecord]:
+        """All tracked entities of a kind, optionally only the nodes of one gateway."""
+        with self._lock:
+            records = [r for (k, _), r in self._records.items() if k == kind]
+        if gateway_id:
+            records = [r for r in records if r.gateway_id == gateway_id]
+        return records
+
+    def touch(self, kind: str, entity_id: str, gateway_id: Optional[str] = None, seen_at: Optional[datetime] = None):
+        """Record a message from a gateway or node. Safe to call from any thread."""
+        now = time.monotonic()
+        seen_at = seen_at or datetime.utcnow()
+        deadline = now + self.timeouts[kind]
+        transition = None
+        with self._lock:
+            record = self._records.get((kind, entity_id))
+            if record is None:
+                record = LivenessRecord(kind, entity_id, gateway_id, False, seen_at, deadline)
+                self._records[(kind, entity_id)] = record
+            record.last_seen = seen_at
+            record.deadline = deadline
+            if gateway_id:
+                record.gateway_id = gateway_id
+            if not record.online:
+                record.online = True
+                self._online[kind] += 1
+                transition = LivenessTransition(kind, entity_id, record.gateway_id, True, seen_at, seen_at)
+                self._unpersisted.append(transition)
+            wake = transition is not None
+            if not record.armed:
+                record.armed = True
+                heapq.heappush(self._heap, (deadline, kind, entity_id))
+                wake = wake or self._heap[0][0] == deadline
+
+        if transition is not None:
+            self._emit(transition)
+        if wake:
+            self._wake()
+
+    def load(self, db) -> int:
+        """Seed state from the stored last_seen times (called once at startup).
+
+        Entities whose timeout already passed while the server was down start
+        offline; a stored is_online that disagrees is corrected on the next flush.
+        """
+        now_wall = datetime.utcnow()
+        now = time.monotonic()
+        rows = [
+            ("gateway", gateway_id, None, is_online, last_seen)
+            for gateway_id, is_online, last_seen in db.query(Gateway.gateway_id, Gateway.is_online, Gateway.last_seen)
+        ] + [
+            ("node", node_id, gateway_id, is_online, last_seen)
+            for node_id, gateway_id, is_online, last_seen in db.query(
+                SensorNode.node_id, SensorNode.gateway_id, SensorNode.is_online, SensorNode.last_seen
+            )
+        ]
+        with self._lock:
+            for kind, entity_id, gateway_id, stored_online, last_seen in rows:
+                deadline = now + self.timeouts[kind] - (now_wall - last_seen).total_seconds()
+                online = deadline > now
+                record = LivenessRecord(kind, entity_id, gateway_id, online, last_seen, deadline)
+                self._records[(kind, entity_id)] = record
+                if online:
+                    self._online[kind] += 1
+                    record.armed = True
+                    self._heap.append((deadline, kind, entity_id))
+                if online != bool(stored_online):
+                    self._unpersisted.append(
+                        LivenessTransition(kind, entity_id, gateway_id, online, last_seen, now_wall)
+                    )
+            heapq.heapify(self._heap)
+        return len(rows)
+
+    async def start(self):
+        """Start the deadline timer. Must be called from the event loop."""
+        self._loop = asyncio.get_running_loop()
+        self._wakeup = asyncio.Event()
+        self._task = asyncio.create_task(self._run())
+
+    async def stop(self):
+        """Stop the timer and persist any outstanding transitions."""
+        if self._task is None:
+            return
+        self._task.cancel()
+        await asyncio.gather(self._task, return_exceptions=True)
+        self._task = None
+        self._loop = None
+        await self._flush()
+
+    def _wake(self):
+        loop = self._loop
+        if loop is None or loop.is_closed():
+            return
+        try:
+            running = asyncio.get_running_loop()
+        except RuntimeError:
+            running = None
+        if running is loop:
+            self._wakeup.set()
+        else:
+            loop.call_soon_threadsafe(self._wakeup.set)
+
+    async def _run(self):
+        while True:
+            # Clear before reading the heap so a deadline pushed meanwhile still wakes us
+            self._wakeup.clear()
+            with self._lock:
+                delay = self._heap[0][0] - time.monotonic() if self._heap else None
+            if delay is None or delay > 0:
+                try:
+                    await asyncio.wait_for(self._wakeup.wait(), timeout=delay)
+                except asyncio.TimeoutError:
+                    pass
+
+            for transition in self._expire(time.monotonic()):
+                self._emit(transition)
+            if self._unpersisted:
+                await self._flush()
+
+    def _expire(self, now: float) -> List[LivenessTransition]:
+        """Pop due deadlines, re-arming entries whose entity was touched since."""
+        expired = []
+        at = datetime.utcnow()
+        with self._lock:
+            while self._heap and self._heap[0][0] <= now:
+                _, kind, entity_id = heapq.heappop(self._heap)
+                record = self._records.get((kind, entity_id))
+                if record is None:
+                    continue
+                if record.deadline > now:
+                    heapq.heappush(self._heap, (record.deadline, kind, entity_id))
+                    continue
+                record.armed = False
+                if record.online:
+                    record.online = False
+                    self._online[kind] -= 1
+                    transition = LivenessTransition(kind, entity_id, record.gateway_id, False, record.last_seen, at)
+                    self._unpersisted.append(transition)
+                    expired.append(transition)
+        return expired
+
+    def _emit(self, transition: LivenessTransition):
+        state = "online" if transition.online else "offline"
+        metrics.LIVENESS_TRANSITIONS_TOTAL.labels(transition.kind, state).inc()
+        log = logger.info if transition.online else logger.warning
+        log(
+            f"{transition.kind.capitalize()} {transition.entity_id} is {state}",
+            extra={"gateway_id": transition.gateway_id or transition.entity_id, "node_id": transition.entity_id}
+        )
+        if transition.kind == "gateway":
+            data_versions.bump_gateway_meta()
+        stream_hub.publish(
+            transition.entity_id, transition.gateway_id or transition.entity_id,
+            json.dumps({"type": "liveness", "data": transition.to_dict()})
+        )
+        for listener in self._listeners:
+            try:
+                listener(transition)
+            except Exception as e:
+                logger.error(f"Liveness listener failed: {str(e)}", exc_info=True)
+
+    async def _flush(self):
+        with self._lock:
+            batch, self._unpersisted = self._unpersisted, []
+        if batch:
+            await asyncio.to_thread(self._persist, batch)
+
+    @staticmethod
+    def _persist(batch: List[LivenessTransition]):
+        # Only the final state per entity matters
+        final = {(t.kind, t.entity_id): t.online for t in batch}
+        db = SessionLocal()
+        try:
+            for (kind, entity_id), online in final.items():
+                if kind == "gateway":
+                    db.execute(update(Gateway).where(Gateway.gateway_id == entity_id).values(is_online=online))
+                else:
+                    db.execute(update(SensorNode).where(SensorNode.node_id == entity_id).values(is_online=online))
+            db.commit()
+        except Exception as e:
+            db.rollback()
+            logger.error(f"Could not persist {len(final)} liveness transition(s): {str(e)}", exc_info=True)
+        finally:
+            db.close()
+
+
+# Process-wide tracker fed by GatewayService on every gateway/node contact
+liveness_tracker = LivenessTracker()
+
+
+async def start_liveness_tracker():
+    """Load stored liveness and start the deadline timer."""
+    db = SessionLocal()
+    try:
+        count = liveness_tracker.load(db)
+    finally:
+        db.close()
+    await liveness_tracker.start()
+    logger.info(
+        f"Liveness tracking {count} gateway(s)/node(s); "
+        f"{liveness_tracker.online_count('gateway')} gateway(s) and {liveness_tracker.online_count('node')} node(s) online"
+    )
+
+
+async def stop_liveness_tracker():
+    """Stop the timer and flush pending transitions."""
+    await liveness_tracker.stop()
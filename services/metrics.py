@@ -0,0 +1,498 @@
+"""In-process Prometheus metrics (text exposition format).
+
+Recording is designed to stay enabled in production:
+- Every counter/histogram child keeps one shard per thread. The recording
+  thread is the only writer of its shard, so observe()/inc() take no lock;
+  a lock is only taken the first time a thread touches a metric.
+- Shards are summed when /metrics is scraped.
+- Gauges are callbacks evaluated at scrape time (queue depths, subscribers),
+  so the hot path never updates them.
+
+Database query counts per request use a SQLAlchemy cursor event plus a
+context variable set by the request logging middleware in main.py.
+"""
+import bisect
+import contextvars
+import functools
+import math
+import threading
+import time
+from typing import Callable, Dict, List, Optional, Sequence, Tuple
+from sqlalchemy import event
+from sqlalchemy.engine import Engine
+
+# Latency buckets in seconds (100 µs .. 10 s)
+LATENCY_BUCKETS = (
+    0.0001, 0.00025, 0.0005, 0.001, 0.0025, 0.005, 0.01, 0.025,
+    0.05, 0.1, 0.25, 0.5, 1.0, 2.5, 5.0, 10.0
+)
+# Query-count buckets for per-request DB query histograms
+COUNT_BUCKETS = (0, 1, 2, 3, 5, 10, 20, 50, 100, 250)
+
+
+def _format_value(value: float) -> str:
+    if value == math.inf:
+        return "+Inf"
+    if float(value).is_integer():
+        return str(int(value))
+    return repr(float(value))
+
+
+def _escape(value: str) -> str:
+    return str(value).replace("\\", "\\\\").replace("\n", "\\n").replace('"', '\\"')
+
+
+def _format_labels(names: Sequence[str], values: Sequence[str], extra: str = "") -> str:
+    parts = [f'{name}="{_escape(value)}"' for name, value in zip(names, values)]
+    if extra:
+        parts.append(extra)
+    return "{" + ",".join(parts) + "}" if parts else ""
+
+
+class _CounterShard:
+    __slots__ = ("value",)
+
+    def __init__(self):
+        self.value = 0.0
+
+
+class _HistogramShard:
+    __slots__ = ("counts", "sum")
+
+    def __init__(self, size: int):
+        self.counts = [0] * size
+        self.sum = 0.0
+
+
+class _Sharded:
+    """Base for metric children holding one shard per recording thread."""
+
+    def __init__(self):
+        self._local = threading.local()
+        self._shards = []
+        self._shards_lock = threading.Lock()
+
+    def _new_shard(self):
+        raise NotImplementedError
+
+    def _shard(self):
+        shard = getattr(self._local, "shard", None)
+        if shard is None:
+            shard = self._new_shard()
+            with self._shards_lock:
+                self._shards.append(shard)
+            self._local.shard = shard
+        return shard
+
+
+class CounterChild(_Sharded):
+    """A single labelled counter series."""
+
+    def _new_shard(self):
+        return _CounterShard()
+
+    def inc(self, amount: float = 1.0):
+        self._shard().value += amount
+
+    def value(self) -> float:
+        return sum(shard.value for shard in list(self._shards))
+
+
+class _Timer:
+    """Context manager observing elapsed wall time into a histogram child."""
+    __slots__ = ("child", "start")
+
+    def __init__(self, child: "HistogramChild"):
+        self.child = child
+
+    def __enter__(self):
+        self.start = time.perf_counter()
+        return self
+
+    def __exit__(self, exc_type, exc, tb):
+        self.child.observe(time.perf_counter() - self.start)
+        return False
+
+
+class HistogramChild(_Sharded):
+    """A single labelled histogram series."""
+
+    def __init__(self, buckets: Tuple[float, ...]):
+        super().__init__()
+        self.buckets = buckets
+
+    def _new_shard(self):
+        return _HistogramShard(len(self.buckets) + 1)
+
+    def observe(self, value: float):
+        shard = self._shard()
+        shard.counts[bisect.bisect_left(self.buckets, value)] += 1
+        shard.sum += value
+
+    def time(self) -> _Timer:
+        """Time a block: `with histogram.labels("insert").time(): ...`"""
+        return _Timer(self)
+
+    def snapshot(self) -> Tuple[List[int], float]:
+        """Per-bucket (non-cumulative) counts and the sum over all shards."""
+        counts = [0] * (len(self.buckets) + 1)
+        total = 0.0
+        for shard in list(self._shards):
+            for i, count in enumerate(shard.counts):
+                counts[i] += count
+            total += shard.sum
+        return counts, total
+
+
+class _Metric:
+    """Metric family with labelled children."""
+    type_name = ""
+
+    def __init__(self, name: str, documentation: str, labelnames: Sequence[str] = ()):
+        self.name = name
+        self.documentation = documentation
+        self.labelnames = tuple(labelnames)
+        self._children: Dict[Tuple[str, ...], _Sharded] = {}
+        self._lock = threading.Lock()
+        registry.register(self)
+
+    def _new_child(self) -> _Sharded:
+        raise NotImplementedError
+
+    def labels(self, *values) -> _Sharded:
+        """Get (or create) the child for a set of label values.
+
+        Hot paths should call this once and keep the child.
+        """
+        key = tuple(str(value) for value in values)
+        child = self._children.get(key)
+        if child is None:
+            if len(key) != len(self.labelnames):
+                raise ValueError(f"{self.name} expects labels {self.labelnames}, got {key}")
+            with self._lock:
+                child = self._children.setdefault(key, self._new_child())
+        return child
+
+    def render(self) -> List[str]:
+        lines = [
+            f"# HELP {self.name} {self.documentation}",
+            f"# TYPE {self.name} {self.type_name}",
+        ]
+        for key, child in sorted(self._children.items()):
+            lines.extend(self._render_child(key, child))
+        return lines
+
+    def _render_child(self, key, child) -> List[str]:
+        raise NotImplementedError
+
+
+class Counter(_Metric):
+    """Monotonically increasing counter."""
+    type_name = "counter"
+
+    def _new_child(self):
+        return CounterChild()
+
+    def inc(self, amount: float = 1.0):
+        self.labels().inc(amount)
+
+    def _render_child(self, key, child):
+        return [f"{self.name}{_format_labels(self.labelnames, key)} {_format_value(child.value())}"]
+
+
+class Histogram(_Metric):
+    """Bucketed distribution of observed values."""
+    type_name = "histogram"
+
+    def __init__(
+        self,
+        name: str,
+        documentation: str,
+        labelnames: Sequence[str] = (),
+        buckets: Sequence[float] = LATENCY_BUCKETS
+    ):
+        self.buckets = tuple(sorted(buckets))
+        super().__init__(name, documentation, labelnames)
+
+    def _new_child(self):
+        return HistogramChild(self.buckets)
+
+    def observe(self, value: float):
+        self.labels().observe(value)
+
+    def time(self) -> _Timer:
+        return self.labels().time()
+
+    def _render_child(self, key, child):
+        counts, total = child.snapshot()
+        lines = []
+        cumulative = 0
+        for bound, count in zip(self.buckets + (math.inf,), counts):
+            cumulative += count
+            le = f'le="{_format_value(bound)}"'
+            lines.append(f"{self.name}_bucket{_format_labels(self.labelnames, key, le)} {cumulative}")
+        labels = _format_labels(self.labelnames, key)
+        lines.append(f"{self.name}_sum{labels} {_format_value(total)}")
+        lines.append(f"{self.name}_count{labels} {cumulative}")
+        return lines
+
+
+class Gauge:
+    """Gauge whose value is read from a callback at scrape time."""
+
+    def __init__(self, name: str, documentation: str, callback: Callable[[], Optional[float]]):
+        self.name = name
+        self.documentation = documentation
+        self.callback = callback
+        registry.register(self)
+
+    def render(self) -> List[str]:
+        try:
+            value = self.callback()
+        except Exception:
+            value = None
+        if value is None:
+            return []
+        return [
+            f"# HELP {self.name} {self.documentation}",
+            f"# TYPE {self.name} gauge",
+            f"{self.name} {_format_value(value)}",
+        ]
+
+
+class Registry:
+    """Collection of metrics rendered by the /metrics endpoint."""
+
+    def __init__(self):
+        self._metrics: List = []
+        self._lock = threading.Lock()
+
+    def register(self, metric):
+        with self._lock:
+            self._metrics.append(metric)
+
+    def render(self) -> str:
+        with self._lock:
+            metrics = list(self._metrics)
+        lines = []
+        for metric in metrics:
+            lines.extend(metric.render())
+        return "\n".join(lines) + "\n"
+
+
+registry = Registry()
+
+CONTENT_TYPE = "text/plain; version=0.0.4; charset=utf-8"
+
+
+def timed(child: HistogramChild):
+    """Decorator observing a function's runtime into a histogram child."""
+    def decorator(func):
+        @functools.wraps(func)
+        def wrapper(*args, **kwargs):
+            start = time.perf_counter()
+            try:
+                return func(*args, **kwargs)
+            finally:
+                child.observe(time.perf_counter() - start)
+        return wrapper
+    return decorator
+
+
+# --- Ingest -----------------------------------------------------------------
+
+INGEST_STAGE_SECONDS = Histogram(
+    "greenhouse_ingest_stage_seconds",
+    "Time spent in each stage of the ingest pipeline",
+    ["stage"]
+)
+INGEST_PARSE = INGEST_STAGE_SECONDS.labels("parse")
+INGEST_VALIDATE = INGEST_STAGE_SECONDS.labels("validate")
+INGEST_DEDUP = INGEST_STAGE_SECONDS.labels("dedup")
+INGEST_REGISTRY_UPSERT = INGEST_STAGE_SECONDS.labels("registry_upsert")
+INGEST_INSERT = INGEST_STAGE_SECONDS.labels("insert")
+INGEST_COMMIT = INGEST_STAGE_SECONDS.labels("commit")
+INGEST_RULES = INGEST_STAGE_SECONDS.labels("rules")
+INGEST_ANOMALY = INGEST_STAGE_SECONDS.labels("anomaly")
+INGEST_ALERTS = INGEST_STAGE_SECONDS.labels("alerts")
+INGEST_FORECAST = INGEST_STAGE_SECONDS.labels("forecast")
+INGEST_ZONES = INGEST_STAGE_SECONDS.labels("zones")
+
+INGEST_READINGS_TOTAL = Counter(
+    "greenhouse_ingest_readings_total",
+    "Readings processed by the ingest pipeline",
+    ["result"]
+)
+INGEST_STORED = INGEST_READINGS_TOTAL.labels("stored")
+INGEST_DUPLICATE = INGEST_READINGS_TOTAL.labels("duplicate")
+INGEST_REJECTED = INGEST_READINGS_TOTAL.labels("rejected")
+INGEST_RATE_LIMITED = INGEST_READINGS_TOTAL.labels("rate_limited")
+
+INGEST_TRANSPORT_EVENTS_TOTAL = Counter(
+    "greenhouse_ingest_transport_events_total",
+    "MQTT and UDP transport events: storage retries, forced reconnects, dropped messages",
+    ["transport", "event"]
+)
+MQTT_STORE_RETRIED = INGEST_TRANSPORT_EVENTS_TOTAL.labels("mqtt", "store_retried")
+MQTT_RECONNECTED = INGEST_TRANSPORT_EVENTS_TOTAL.labels("mqtt", "forced_reconnect")
+MQTT_QUEUE_FULL = INGEST_TRANSPORT_EVENTS_TOTAL.labels("mqtt", "queue_full")
+MQTT_THROTTLED = INGEST_TRANSPORT_EVENTS_TOTAL.labels("mqtt", "throttled")
+UDP_QUEUE_FULL = INGEST_TRANSPORT_EVENTS_TOTAL.labels("udp", "queue_full")
+UDP_FRAMES_LOST_TOTAL = Counter(
+    "greenhouse_udp_frames_lost_total",
+    "UDP frames detected as lost from gateway sequence numbers"
+)
+UDP_MALFORMED_TOTAL = Counter(
+    "greenhouse_udp_malformed_datagrams_total",
+    "UDP datagrams that could not be decoded"
+)
+
+ANOMALY_EVENTS_TOTAL = Counter(
+    "greenhouse_anomaly_events_total",
+    "Anomalies found by the streaming detector",
+    ["kind"]
+)
+
+# --- Alerts ------------------------------------------------------------------
+
+ALERT_TRANSITIONS_TOTAL = Counter(
+    "greenhouse_alert_transitions_total",
+    "Alert lifecycle transitions",
+    ["transition"]
+)
+WEBHOOK_EVENTS_TOTAL = Counter(
+    "greenhouse_webhook_events_total",
+    "Alert events by webhook delivery outcome (per endpoint)",
+    ["outcome"]
+)
+WEBHOOK_DELIVERED = WEBHOOK_EVENTS_TOTAL.labels("delivered")
+WEBHOOK_FAILED = WEBHOOK_EVENTS_TOTAL.labels("failed")
+WEBHOOK_DROPPED = WEBHOOK_EVENTS_TOTAL.labels("dropped")
+WEBHOOK_RETRIED = WEBHOOK_EVENTS_TOTAL.labels("retried_batches")
+
+# --- Liveness ----------------------------------------------------------------
+
+LIVENESS_TRANSITIONS_TOTAL = Counter(
+    "greenhouse_liveness_transitions_total",
+    "Gateway and node online/offline transitions",
+    ["kind", "state"]
+)
+
+# --- Tracing -----------------------------------------------------------------
+
+TRACES_TOTAL = Counter(
+    "greenhouse_traces_total",
+    "Finished request traces by sampling/export outcome",
+    ["outcome"]
+)
+TRACES_EXPORTED = TRACES_TOTAL.labels("exported")
+TRACES_DISCARDED = TRACES_TOTAL.labels("not_sampled")
+TRACES_DROPPED = TRACES_TOTAL.labels("dropped")
+
+# --- Startup -----------------------------------------------------------------
+
+# Filled in by the application lifespan in main.py
+startup_timings: Dict[str, float] = {}
+
+# --- HTTP and database ------------------------------------------------------
+
+HTTP_REQUEST_SECONDS = Histogram(
+    "greenhouse_http_request_duration_seconds",
+    "HTTP request latency by route template",
+    ["method", "route", "status"]
+)
+DB_QUERIES_PER_REQUEST = Histogram(
+    "greenhouse_db_queries_per_request",
+    "Number of SQL statements executed per HTTP request",
+    ["method", "route"],
+    buckets=COUNT_BUCKETS
+)
+DB_QUERIES_TOTAL = Counter(
+    "greenhouse_db_queries_total",
+    "SQL statements executed (all sources)"
+)
+_DB_QUERIES = DB_QUERIES_TOTAL.labels()
+
+# --- Analyzers and gateway probes -------------------------------------------
+
+ANALYZER_SECONDS = Histogram(
+    "greenhouse_analyzer_seconds",
+    "Runtime of trend analyzers",
+    ["detector"]
+)
+ANALYTICS_SECONDS = Histogram(
+    "greenhouse_analytics_seconds",
+    "Time from submitting an analytics job to its result, including queueing",
+    ["job"]
+)
+GATEWAY_PROBE_SECONDS = Histogram(
+    "greenhouse_gateway_probe_seconds",
+    "Latency of HTTP probes to gateways",
+    ["endpoint", "outcome"]
+)
+
+
+class _QueryCounter:
+    __slots__ = ("count",)
+
+    def __init__(self):
+        self.count = 0
+
+
+_request_queries: contextvars.ContextVar[Optional[_QueryCounter]] = contextvars.ContextVar(
+    "request_queries", default=None
+)
+
+
+def begin_request() -> _QueryCounter:
+    """Start counting SQL statements for the current request context."""
+    counter = _QueryCounter()
+    _request_queries.set(counter)
+    return counter
+
+
+def _before_cursor_execute(conn, cursor, statement, parameters, context, executemany):
+    _DB_QUERIES.inc()
+    counter = _request_queries.get()
+    if counter is not None:
+        counter.count += 1
+
+
+def instrument_engine(engine: Engine):
+    """Count SQL statements executed through an engine."""
+    if not event.contains(engine, "before_cursor_execute", _before_cursor_execute):
+        event.listen(engine, "before_cursor_execute", _before_cursor_execute)
+
+
+def observe_request(method: str, route: str, status: int, seconds: float, queries: _QueryCounter):
+    """Record latency and query count of a finished HTTP request."""
+    HTTP_REQUEST_SECONDS.labels(method, route, status).observe(seconds)
+    DB_QUERIES_PER_REQUEST.labels(method, route).observe(queries.count)
+
+
+def register_gauge(name: str, documentation: str, callback: Callable[[], Optional[float]]) -> Gauge:
+    """Expose a value computed at scrape time (return None to omit it)."""
+    return Gauge(name, documentation, callback)
+
+
+class probe_timer:
+    """Time a gateway probe, labelled with its outcome.
+
+    The caller sets `outcome` (e.g. the HTTP status code) on success; failures
+    are recorded as "timeout" or "error".
+    """
+    __slots__ = ("endpoint", "outcome", "start")
+
+    def __init__(self, endpoint: str):
+        self.endpoint = endpoint
+        self.outcome = "ok"
+
+    def __enter__(self):
+        self.start = time.perf_counter()
+        return self
+
+    def __exit__(self, exc_type, exc, tb):
+        if exc_type is not None:
+            self.outcome = "timeout" if "Timeout" in exc_type.__name__ else "error"
+        GATEWAY_PROBE_SECONDS.labels(self.endpoint, self.outcome).observe(time.perf_counter() - self.start)
+        return False
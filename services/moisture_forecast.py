@@ -0,0 +1,275 @@
+"""Incremental soil-moisture depletion forecasting (time until a moisture level).
+
+Soil dries between irrigations in a piecewise sawtooth, faster in daylight than
+at night. For each node, every stored reading updates in O(1):
+- a linear fit of the current drying segment, weighted by recency (exponential
+  forgetting, time constant FORECAST_FIT_TAU_MINUTES). It gives the denoised
+  current level and the current drying rate. The sums are kept relative to the
+  newest reading, so the intercept is the level "now".
+- a 24-bucket hour-of-day profile of the drying rate (EWMA), so a forecast made
+  in the morning expects the faster afternoon drying and the slow night.
+
+A reading more than FORECAST_IRRIGATION_JUMP above the fitted level is an
+irrigation event. It restarts the segment fit and keeps the profile. A gap
+longer than FORECAST_RESET_GAP_SECONDS also restarts the fit.
+
+"Hours until X%" walks the drying profile forward from the current level, one
+hour bucket at a time. The result for FORECAST_TARGET_PERCENT is computed at
+ingest and stored, so the fleet endpoint (GET /api/ai/moisture-forecast) reads
+it from memory; other targets cost one walk per node per request.
+
+As with the anomaly detector, the first reading from a node after a restart
+replays its last FORECAST_BOOTSTRAP_HOURS of history (one indexed query).
+"""
+import logging
+import math
+import os
+import threading
+from array import array
+from dataclasses import dataclass, field
+from datetime import datetime, timedelta
+from operator import itemgetter
+from typing import Dict, List, Optional, Sequence
+from sqlalchemy.orm import Session
+from models.database import SensorReading
+from models.ingest import IngestReading
+from services import reading_store
+
+logger = logging.getLogger(__name__)
+
+FORECAST_ENABLED = os.getenv("FORECAST_ENABLED", "true").lower() in ("1", "true", "yes")
+# Moisture level whose ETA is precomputed for every node (usual irrigation trigger)
+FORECAST_TARGET_PERCENT = float(os.getenv("FORECAST_TARGET_PERCENT", "30"))
+# Forgetting time constant of the level/rate fit
+FORECAST_FIT_TAU_MINUTES = float(os.getenv("FORECAST_FIT_TAU_MINUTES", "90"))
+# Per-reading learning rate of the hour-of-day drying profile
+FORECAST_PROFILE_RATE = float(os.getenv("FORECAST_PROFILE_RATE", "0.02"))
+# Rise above the fitted level (percentage points) treated as irrigation
+FORECAST_IRRIGATION_JUMP = float(os.getenv("FORECAST_IRRIGATION_JUMP", "5"))
+# Segment length needed before the fit is trusted
+FORECAST_MIN_FIT_MINUTES = float(os.getenv("FORECAST_MIN_FIT_MINUTES", "30"))
+# Forecasts further out than this are reported as "not drying"
+FORECAST_HORIZON_HOURS = float(os.getenv("FORECAST_HORIZON_HOURS", "336"))
+# History replayed when a node is first seen by this process
+FORECAST_BOOTSTRAP_HOURS = int(os.getenv("FORECAST_BOOTSTRAP_HOURS", "48"))
+# A node silent for longer than this restarts its segment fit (the profile is kept)
+FORECAST_RESET_GAP_SECONDS = float(os.getenv("FORECAST_RESET_GAP_SECONDS", "10800"))
+
+# Drying slower than this (percentage points per hour) counts as not drying
+MIN_DRYING_RATE = 0.02
+PROFILE_BUCKETS = 24
+_EPOCH = datetime(1970, 1, 1)
+_NAN = float("nan")
+
+
+@dataclass(slots=True)
+class DepletionState:
+    """Per-node depletion model."""
+    gateway_id: str
+    last_ts: float = 0.0  # Epoch seconds of the newest reading
+    segment_start: float = 0.0
+    # Recency-weighted regression sums, with t measured from last_ts
+    s0: float = 0.0
+    st: float = 0.0
+    stt: float = 0.0
+    sm: float = 0.0
+    stm: float = 0.0
+    level: float = _NAN  # Fitted moisture at last_ts
+    rate: float = _NAN  # Current drying rate, percentage points per hour
+    profile: array = field(default_factory=lambda: array("d", [_NAN] * PROFILE_BUCKETS))
+    target_hours: Optional[float] = None  # Hours from last_ts until FORECAST_TARGET_PERCENT
+    irrigations: int = 0
+    last_irrigation: Optional[float] = None
+
+    def reset_fit(self, ts: float):
+        self.segment_start = ts
+        self.s0 = self.st = self.stt = self.sm = self.stm = 0.0
+        self.rate = _NAN
+
+    @property
+    def fitted(self) -> bool:
+        return not math.isnan(self.rate)
+
+
+@dataclass(slots=True)
+class MoistureForecast:
+    """Forecast for one node as of a given time."""
+    node_id: str
+    gateway_id: str
+    status: str  # 'drying', 'not_drying', 'below_target', 'learning' or 'stale'
+    moisture: Optional[float]
+    drying_rate_per_hour: Optional[float]
+    hours_until_target: Optional[float]
+    eta: Optional[datetime]
+    last_reading: datetime
+    last_irrigation: Optional[datetime]
+    irrigations: int
+
+
+def _hours_until(state: DepletionState, target: float, start: float) -> Optional[float]:
+    """Walk the hour-of-day drying profile from `start` until the level reaches target."""
+    remaining = state.level - target
+    if remaining <= 0:
+        return 0.0
+    profile = state.profile
+    learned = [r for r in profile if not math.isnan(r)]
+    fallback = sum(learned) / len(learned) if learned else state.rate
+    if not fallback > MIN_DRYING_RATE:
+        return None
+
+    hours = 0.0
+    t = start
+    while hours < FORECAST_HORIZON_HOURS:
+        rate = profile[int(t % 86400) // 3600]
+        if math.isnan(rate):
+            rate = fallback
+        step = (3600.0 - t % 3600) / 3600.0
+        drop = rate * step
+        if drop >= remaining:
+            return hours + remaining / rate
+        remaining -= drop
+        hours += step
+        t += step * 3600.0
+    return None
+
+
+class MoistureForecaster:
+    """Maintains depletion models for all nodes and answers ETA queries."""
+
+    def __init__(self):
+        self._states: Dict[str, DepletionState] = {}
+        self._lock = threading.Lock()
+        self._decay_per_second = 1.0 / (FORECAST_FIT_TAU_MINUTES * 60.0)
+
+    def update(self, node_id: str, gateway_id: str, moisture: float, timestamp: datetime):
+        """Feed one stored soil-moisture reading (older-than-newest readings are skipped)."""
+        with self._lock:
+            state = self._states.get(node_id)
+            if state is None:
+                state = self._states[node_id] = DepletionState(gateway_id)
+            state.gateway_id = gateway_id
+            self._observe(state, moisture, (timestamp - _EPOCH).total_seconds())
+
+    def bootstrap(self, node_id: str, gateway_id: str, rows: Sequence[Sequence]) -> bool:
+        """Replay a node's recent history (timestamp, soil_moisture) silently.
+
+        Returns False if the node already has state (another thread got there first).
+        """
+        with self._lock:
+            if node_id in self._states:
+                return False
+            state = self._states[node_id] = DepletionState(gateway_id)
+            for timestamp, moisture in rows:
+                self._observe(state, moisture, (timestamp - _EPOCH).total_seconds())
+        return True
+
+    def _observe(self, state: DepletionState, x: float, ts: float):
+        if ts <= state.last_ts:
+            return
+        gap = ts - state.last_ts
+        if not state.last_ts or gap > FORECAST_RESET_GAP_SECONDS:
+            state.reset_fit(ts)
+        elif x - state.level > FORECAST_IRRIGATION_JUMP:
+            state.irrigations += 1
+            state.last_irrigation = ts
+            state.reset_fit(ts)
+        else:
+            # Move the origin to ts, then apply the forgetting factor
+            s0, st = state.s0, state.st
+            weight = math.exp(-gap * self._decay_per_second)
+            state.stt = (state.stt - 2 * gap * st + gap * gap * s0) * weight
+            state.stm = (state.stm - gap * state.sm) * weight
+            state.st = (st - gap * s0) * weight
+            state.s0 = s0 * weight
+            state.sm *= weight
+        state.last_ts = ts
+
+        # Add the new point at t = 0 (st, stt and stm are unchanged)
+        state.s0 += 1.0
+        state.sm += x
+        denominator = state.s0 * state.stt - state.st * state.st
+        if ts - state.segment_start >= FORECAST_MIN_FIT_MINUTES * 60 and denominator > 1e-9:
+            slope = (state.s0 * state.stm - state.st * state.sm) / denominator
+            state.level = (state.sm - slope * state.st) / state.s0
+            rate = max(0.0, -slope * 3600.0)
+            state.rate = rate
+            bucket = int(ts % 86400) // 3600
+            previous = state.profile[bucket]
+            state.profile[bucket] = rate if math.isnan(previous) else previous + FORECAST_PROFILE_RATE * (rate - previous)
+        else:
+            state.level = state.sm / state.s0
+
+        state.target_hours = _hours_until(state, FORECAST_TARGET_PERCENT, ts) if state.fitted else None
+
+    def process(self, db: Session, reading: IngestReading, timestamp: datetime):
+        """Update the model for a stored reading, bootstrapping the node after a restart."""
+        if not FORECAST_ENABLED:
+            return
+        if reading.node_id not in self._states:
+            since = timestamp - timedelta(hours=FORECAST_BOOTSTRAP_HOURS)
+            rows = db.query(SensorReading.timestamp, SensorReading.soil_moisture).filter(
+                SensorReading.node_id == reading.node_id,
+                SensorReading.timestamp >= since,
+                SensorReading.timestamp < timestamp
+            ).order_by(SensorReading.timestamp).all()
+            compacted = reading_store.block_rows(
+                db, ("timestamp", "soil_moisture"), since=since, until=timestamp, node_ids=reading.node_id
+            )
+            rows = reading_store.merge_by_time(compacted, rows, itemgetter(0))
+            if self.bootstrap(reading.node_id, reading.gateway_id, rows) and rows:
+                logger.info(f"Moisture forecast bootstrapped from {len(rows)} readings", extra={"node_id": reading.node_id})
+        self.update(reading.node_id, reading.gateway_id, reading.soil_moisture, timestamp)
+
+    def forecast(self, node_id: str, state: DepletionState, target: float, now: float) -> MoistureForecast:
+        """Forecast for one node; reuses the stored ETA when target is the default."""
+        if target == FORECAST_TARGET_PERCENT:
+            hours = state.target_hours
+        else:
+            hours = _hours_until(state, target, state.last_ts) if state.fitted else None
+
+        if now - state.last_ts > FORECAST_RESET_GAP_SECONDS:
+            status, hours = "stale", None
+        elif not state.fitted:
+            status, hours = "learning", None
+        elif hours is None:
+            status = "not_drying"
+        elif hours == 0.0:
+            status = "below_target"
+        else:
+            status = "drying"
+            hours = max(0.0, hours - (now - state.last_ts) / 3600.0)
+
+        return MoistureForecast(
+            node_id=node_id,
+            gateway_id=state.gateway_id,
+            status=status,
+            moisture=None if math.isnan(state.level) else round(state.level, 2),
+            drying_rate_per_hour=round(state.rate, 3) if state.fitted else None,
+            hours_until_target=round(hours, 2) if hours is not None else None,
+            eta=_EPOCH + timedelta(seconds=now + hours * 3600) if hours is not None else None,
+            last_reading=_EPOCH + timedelta(seconds=state.last_ts),
+            last_irrigation=_EPOCH + timedelta(seconds=state.last_irrigation) if state.last_irrigation else None,
+            irrigations=state.irrigations
+        )
+
+    def fleet(
+        self,
+        target: float = FORECAST_TARGET_PERCENT,
+        gateway_id: Optional[str] = None,
+        now: Optional[datetime] = None
+    ) -> List[MoistureForecast]:
+        """Forecasts for every node, soonest to reach the target first."""
+        now_ts = ((now or datetime.utcnow()) - _EPOCH).total_seconds()
+        with self._lock:
+            states = list(self._states.items())
+        forecasts = [
+            self.forecast(node_id, state, target, now_ts)
+            for node_id, state in states
+            if not gateway_id or state.gateway_id == gateway_id
+        ]
+        forecasts.sort(key=lambda f: (f.hours_until_target is None, f.hours_until_target or 0.0, f.node_id))
+        return forecasts
+
+
+# Process-wide forecaster fed by the ingest pipeline
+moisture_forecaster = MoistureForecaster()
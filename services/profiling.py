@@ -0,0 +1,383 @@
+"""On-demand diagnostics for a live instance: sampling CPU profiles and allocation snapshots.
+
+Sampling profiler: for the requested number of seconds, a thread reads the
+current stack of every other thread (sys._current_frames) at a fixed interval
+and counts each distinct stack. Nothing is hooked into the profiled code (no
+sys.setprofile), so the only cost is the sampling itself, which holds the
+interpreter lock while it walks the stacks. That cost is capped: each sample is
+timed, and the sampler sleeps long enough that it holds the lock at most
+PROFILER_MAX_OVERHEAD of the time, lowering the sample rate on processes with
+many threads or deep stacks. One profile runs at a time, for at most
+PROFILER_MAX_SECONDS. Analytics worker processes (ANALYTICS_PROCESSES) are not
+sampled.
+
+Allocation tracing: tracemalloc records a traceback for every allocation while
+it runs, which costs memory and slows allocation-heavy code. It therefore only
+runs when started explicitly, with at most TRACEMALLOC_MAX_FRAMES frames per
+traceback, and stops by itself after TRACEMALLOC_MAX_SECONDS or once its own
+bookkeeping exceeds TRACEMALLOC_MAX_MEMORY_MB.
+"""
+import asyncio
+import html
+import logging
+import os
+import sys
+import threading
+import time
+import tracemalloc
+import zlib
+from collections import Counter
+from dataclasses import dataclass, field
+from typing import Dict, List, Optional, Tuple
+
+logger = logging.getLogger(__name__)
+
+PROFILER_MAX_SECONDS = float(os.getenv("PROFILER_MAX_SECONDS", "60"))
+# Fraction of wall time the sampler may hold the interpreter lock
+PROFILER_MAX_OVERHEAD = float(os.getenv("PROFILER_MAX_OVERHEAD", "0.02"))
+TRACEMALLOC_MAX_FRAMES = int(os.getenv("TRACEMALLOC_MAX_FRAMES", "25"))
+TRACEMALLOC_MAX_SECONDS = float(os.getenv("TRACEMALLOC_MAX_SECONDS", "900"))
+TRACEMALLOC_MAX_MEMORY_MB = float(os.getenv("TRACEMALLOC_MAX_MEMORY_MB", "256"))
+
+# Leaf frames of threads that are waiting rather than running (event loop, idle pool workers)
+_IDLE_LEAVES = {
+    ("selectors.py", "select"),
+    ("threading.py", "wait"),
+    ("queue.py", "get"),
+    ("thread.py", "_worker"),
+}
+
+# Allocations made by the tracing machinery itself
+_TRACE_FILTERS = (
+    tracemalloc.Filter(False, tracemalloc.__file__),
+    tracemalloc.Filter(False, "<frozen importlib._bootstrap>"),
+    tracemalloc.Filter(False, "<frozen importlib._bootstrap_external>"),
+    tracemalloc.Filter(False, "<unknown>"),
+)
+
+
+class ProfilerBusyError(Exception):
+    """Raised when a profile is requested while another one is running."""
+
+
+class TracingStateError(Exception):
+    """Raised when an allocation tracing operation does not fit the current state."""
+
+
+@dataclass
+class Profile:
+    """Stacks counted by one profiling run."""
+    stacks: Counter = field(default_factory=Counter)  # (thread, frame, ..., leaf) -> samples
+    samples: int = 0
+    seconds: float = 0.0
+    sampling_seconds: float = 0.0  # Time spent taking samples
+
+    @property
+    def overhead(self) -> float:
+        return self.sampling_seconds / self.seconds if self.seconds else 0.0
+
+    @property
+    def interval_ms(self) -> float:
+        """Average time between samples."""
+        return self.seconds / self.samples * 1000.0 if self.samples else 0.0
+
+    def collapsed(self) -> str:
+        """Collapsed-stack text (`frame;frame;leaf count` per line) for flamegraph.pl, speedscope etc."""
+        return "".join(f"{';'.join(stack)} {count}\n" for stack, count in self.stacks.most_common())
+
+    def flamegraph_svg(self, title: str = "CPU profile", width: int = 1200) -> str:
+        """Self-contained SVG flame graph of the profile (hover a frame for its share)."""
+        return _render_flamegraph(self, title, width)
+
+
+class SamplingProfiler:
+    """Samples the stacks of all threads of this process, one run at a time."""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._labels: Dict[object, str] = {}
+
+    @property
+    def running(self) -> bool:
+        return self._lock.locked()
+
+    def profile(self, seconds: float, interval: float, include_idle: bool = False) -> Profile:
+        """
+        Sample every thread except the caller's for `seconds`.
+
+        Blocks for the whole run; call it off the event loop (asyncio.to_thread).
+
+        Args:
+            seconds: Profile length, capped at PROFILER_MAX_SECONDS
+            interval: Target time between samples in seconds; stretched when needed
+                to stay within PROFILER_MAX_OVERHEAD
+            include_idle: Keep samples of threads waiting in a selector, lock or queue
+
+        Raises:
+            ProfilerBusyError: Another profile is running
+        """
+        if not self._lock.acquire(blocking=False):
+            raise ProfilerBusyError("A profile is already running")
+        try:
+            return self._sample(min(seconds, PROFILER_MAX_SECONDS), interval, include_idle)
+        finally:
+            self._lock.release()
+
+    def _sample(self, seconds: float, interval: float, include_idle: bool) -> Profile:
+        profile = Profile()
+        own = threading.get_ident()
+        names: Dict[int, str] = {}
+        started = time.monotonic()
+        deadline = started + seconds
+        while True:
+            sample_started = time.perf_counter()
+            for ident, frame in sys._current_frames().items():
+                if ident == own:
+                    continue
+                if ident not in names:
+                    names = {thread.ident: thread.name for thread in threading.enumerate()}
+                if not include_idle and self._is_idle(frame):
+                    continue
+                profile.stacks[self._stack(names.get(ident, f"thread-{ident}"), frame)] += 1
+            cost = time.perf_counter() - sample_started
+            profile.sampling_seconds += cost
+            profile.samples += 1
+            remaining = deadline - time.monotonic()
+            if remaining <= 0:
+                break
+            # Sleeping cost * (1 - overhead) / overhead keeps cost / (cost + sleep) <= overhead
+            pause = max(interval - cost, cost * (1.0 - PROFILER_MAX_OVERHEAD) / PROFILER_MAX_OVERHEAD)
+            time.sleep(min(pause, remaining))
+        profile.seconds = time.monotonic() - started
+        logger.info(
+            f"Profiled {profile.seconds:.1f} s: {profile.samples} samples every {profile.interval_ms:.1f} ms, "
+            f"{profile.overhead * 100:.2f}% sampling overhead"
+        )
+        return profile
+
+    @staticmethod
+    def _is_idle(frame) -> bool:
+        code = frame.f_code
+        return (os.path.basename(code.co_filename), code.co_name) in _IDLE_LEAVES
+
+    def _stack(self, thread: str, frame) -> Tuple[str, ...]:
+        labels = self._labels
+        stack = []
+        while frame is not None:
+            code = frame.f_code
+            label = labels.get(code)
+            if label is None:
+                label = labels[code] = self._label(code)
+            stack.append(label)
+            frame = frame.f_back
+        stack.append(thread.replace(";", ":"))
+        stack.reverse()
+        return tuple(stack)
+
+    @staticmethod
+    def _label(code) -> str:
+        """`qualname (module/path.py:line)`, with the path relative to sys.path."""
+        filename = code.co_filename
+        for root in sorted((p for p in sys.path if p), key=len, reverse=True):
+            if filename.startswith(root + os.sep):
+                filename = filename[len(root) + 1:]
+                break
+        name = getattr(code, "co_qualname", code.co_name)
+        return f"{name} ({filename}:{code.co_firstlineno})".replace(";", ":")
+
+
+class AllocationTracer:
+    """tracemalloc sessions with a bounded depth, lifetime and memory footprint."""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._baseline: Optional[tracemalloc.Snapshot] = None
+        self._watchdog: Optional[asyncio.Task] = None
+        self.started_at: Optional[float] = None
+        self.deadline: Optional[float] = None
+
+    @property
+    def overhead_bytes(self) -> int:
+        """Memory used by tracemalloc itself (0 when not tracing)."""
+        return tracemalloc.get_tracemalloc_memory() if tracemalloc.is_tracing() else 0
+
+    def status(self) -> dict:
+        tracing = tracemalloc.is_tracing()
+        current, peak = tracemalloc.get_traced_memory() if tracing else (0, 0)
+        now = time.monotonic()
+        return {
+            "tracing": tracing,
+            "frames": tracemalloc.get_traceback_limit() if tracing else None,
+            "running_seconds": round(now - self.started_at, 1) if tracing and self.started_at else None,
+            "stops_in_seconds": round(max(0.0, self.deadline - now), 1) if tracing and self.deadline else None,
+            "traced_bytes": current,
+            "traced_peak_bytes": peak,
+            "overhead_bytes": self.overhead_bytes,
+            "has_baseline": self._baseline is not None,
+        }
+
+    async def start(self, frames: int, seconds: float) -> dict:
+        """
+        Start tracing allocations; stops automatically after `seconds`.
+
+        Raises:
+            TracingStateError: Tracing is already running
+        """
+        if tracemalloc.is_tracing():
+            raise TracingStateError("Allocation tracing is already running")
+        seconds = min(seconds, TRACEMALLOC_MAX_SECONDS)
+        tracemalloc.start(min(frames, TRACEMALLOC_MAX_FRAMES))
+        self.started_at = time.monotonic()
+        self.deadline = self.started_at + seconds
+        self._baseline = None
+        self._watchdog = asyncio.create_task(self._watch())
+        logger.info(f"Allocation tracing started ({frames} frame(s), stops within {seconds:.0f} s)")
+        return self.status()
+
+    def stop(self) -> dict:
+        """Stop tracing and drop the recorded traces and baseline (no-op when not tracing)."""
+        if self._watchdog is not None:
+            if self._watchdog is not asyncio.current_task():
+                self._watchdog.cancel()
+            self._watchdog = None
+        if tracemalloc.is_tracing():
+            tracemalloc.stop()
+            logger.info("Allocation tracing stopped")
+        with self._lock:
+            self._baseline = None
+        self.started_at = self.deadline = None
+        return self.status()
+
+    async def _watch(self):
+        while tracemalloc.is_tracing():
+            if time.monotonic() >= self.deadline:
+                logger.info("Allocation tracing reached its time limit")
+                break
+            if self.overhead_bytes > TRACEMALLOC_MAX_MEMORY_MB * 1024 * 1024:
+                logger.warning("Allocation tracing reached TRACEMALLOC_MAX_MEMORY_MB, stopping")
+                break
+            await asyncio.sleep(1.0)
+        self.stop()
+
+    def snapshot(self, group_by: str, limit: int) -> dict:
+        """
+        Top allocation sites now; the snapshot becomes the baseline for diff().
+
+        Blocking (copies every trace); call it off the event loop.
+
+        Raises:
+            TracingStateError: Tracing is not running
+        """
+        snapshot = self._take()
+        stats = snapshot.statistics(group_by)
+        with self._lock:
+            self._baseline = snapshot
+        return {
+            "group_by": group_by,
+            "total_bytes": sum(stat.size for stat in stats),
+            "top": [
+                {"traceback": self._frames(stat.traceback), "size_bytes": stat.size, "count": stat.count}
+                for stat in stats[:limit]
+            ],
+        }
+
+    def diff(self, group_by: str, limit: int) -> dict:
+        """
+        Allocation sites that grew or shrank most since the baseline snapshot.
+
+        Blocking; call it off the event loop. The baseline is kept, so repeated
+        diffs show growth since the same point.
+
+        Raises:
+            TracingStateError: Tracing is not running, or no baseline snapshot exists
+        """
+        with self._lock:
+            baseline = self._baseline
+        if baseline is None:
+            raise TracingStateError("No baseline snapshot; take one with POST /api/admin/tracemalloc/snapshot")
+        snapshot = self._take()
+        stats = snapshot.compare_to(baseline, group_by)
+        return {
+            "group_by": group_by,
+            "total_bytes": sum(stat.size for stat in stats),
+            "total_diff_bytes": sum(stat.size_diff for stat in stats),
+            "top": [
+                {
+                    "traceback": self._frames(stat.traceback),
+                    "size_bytes": stat.size,
+                    "size_diff_bytes": stat.size_diff,
+                    "count": stat.count,
+                    "count_diff": stat.count_diff,
+                }
+                for stat in stats[:limit]
+            ],
+        }
+
+    @staticmethod
+    def _take() -> tracemalloc.Snapshot:
+        if not tracemalloc.is_tracing():
+            raise TracingStateError("Allocation tracing is not running; start it with POST /api/admin/tracemalloc/start")
+        return tracemalloc.take_snapshot().filter_traces(_TRACE_FILTERS)
+
+    @staticmethod
+    def _frames(traceback: tracemalloc.Traceback) -> List[str]:
+        # Most recent call first
+        return [f"{frame.filename}:{frame.lineno}" for frame in reversed(traceback)]
+
+
+def _render_flamegraph(profile: Profile, title: str, width: int) -> str:
+    row, pad, font = 16, 10, 11
+    total = sum(profile.stacks.values())
+    # Merge stacks into a tree of [samples, children]
+    root: list = [total, {}]
+    depth = 0
+    for stack, count in profile.stacks.items():
+        node = root
+        for frame in stack:
+            node = node[1].setdefault(frame, [0, {}])
+            node[0] += count
+        depth = max(depth, len(stack))
+    height = (depth + 1) * row + 3 * pad + font
+    scale = (width - 2 * pad) / total if total else 0.0
+    parts = [
+        f'<svg xmlns="http://www.w3.org/2000/svg" width="{width}" height="{height}" '
+        f'font-family="monospace" font-size="{font}">',
+        '<rect width="100%" height="100%" fill="#f8f8f8"/>',
+        f'<text x="{pad}" y="{pad + font}">{html.escape(title)}: {profile.samples} samples over '
+        f'{profile.seconds:.1f} s, {profile.overhead * 100:.2f}% sampling overhead</text>',
+    ]
+
+    def draw(name: str, node: list, x: float, level: int):
+        w = node[0] * scale
+        if w < 0.5:
+            return
+        y = height - pad - (level + 1) * row
+        hue = zlib.crc32(name.encode()) % 60
+        label = f"{name} ({node[0]} samples, {node[0] / total * 100:.2f}%)"
+        parts.append(
+            f'<g><title>{html.escape(label)}</title>'
+            f'<rect x="{x:.1f}" y="{y}" width="{w:.1f}" height="{row - 1}" fill="hsl({hue},90%,62%)"/>'
+        )
+        chars = int(w / (font * 0.6)) - 1
+        if chars >= 3:
+            text = name if len(name) <= chars else name[:chars - 2] + ".."
+            parts.append(f'<text x="{x + 3:.1f}" y="{y + row - 4}">{html.escape(text)}</text>')
+        parts.append("</g>")
+        for child_name, child in sorted(node[1].items()):
+            draw(child_name, child, x, level + 1)
+            x += child[0] * scale
+
+    if total:
+        draw("all", root, pad, 0)
+    parts.append("</svg>")
+    return "\n".join(parts)
+
+
+# Global instances
+sampling_profiler = SamplingProfiler()
+allocation_tracer = AllocationTracer()
+
+
+def stop_allocation_tracing():
+    """Stop allocation tracing if an operator left it running."""
+    allocation_tracer.stop()
@@ -0,0 +1,230 @@
+"""Per-gateway token-bucket rate limiting for sensor data ingest.
+
+Limits are keyed on the gateway ID rather than the client IP, so gateways
+sharing a farm NAT each get their own budget and one misbehaving gateway
+cannot starve the others.
+
+Each gateway has two buckets, measured in readings:
+- steady: sized for normal live traffic, refilled continuously
+- backfill: a large reserve that only old (buffered) readings may draw from,
+  so a gateway coming back online can flush its offline buffer without being
+  throttled to the live rate. Eligibility is per reading: in a mixed upload
+  only the readings older than RATE_LIMIT_BACKFILL_AGE_SECONDS can be paid
+  from the reserve, the rest must fit the steady bucket.
+
+An upload is charged all or nothing: if any gateway it names is over its
+limit, the buckets already charged for the others are refunded. Every
+transport (HTTP, MQTT, UDP) is charged through IngestService.admit.
+
+Bucket state lives in process memory by default. Set RATE_LIMIT_BACKEND=database
+to keep it in the gateway_rate_buckets table instead, so the budget is shared by
+every worker process. Each check is then a single atomic UPDATE.
+"""
+import math
+import os
+import threading
+import time
+from collections import Counter
+from typing import Dict, List, NamedTuple, Tuple
+from sqlalchemy import text
+from models.database import engine
+from models.ingest import IngestReading
+
+RATE_LIMIT_BACKEND = os.getenv("RATE_LIMIT_BACKEND", "memory")
+
+# Steady-state budget: sustained readings per minute and burst size per gateway
+RATE_LIMIT_STEADY_PER_MINUTE = float(os.getenv("RATE_LIMIT_STEADY_PER_MINUTE", "120"))
+RATE_LIMIT_STEADY_BURST = float(os.getenv("RATE_LIMIT_STEADY_BURST", "120"))
+
+# Backfill budget: reserve for flushing buffered readings after an outage
+RATE_LIMIT_BACKFILL_PER_HOUR = float(os.getenv("RATE_LIMIT_BACKFILL_PER_HOUR", "20000"))
+RATE_LIMIT_BACKFILL_CAPACITY = float(os.getenv("RATE_LIMIT_BACKFILL_CAPACITY", "10000"))
+
+# Readings at least this old may be paid from the backfill reserve
+RATE_LIMIT_BACKFILL_AGE_SECONDS = int(os.getenv("RATE_LIMIT_BACKFILL_AGE_SECONDS", "300"))
+
+
+class Bucket(NamedTuple):
+    """Token bucket parameters."""
+    name: str
+    capacity: float
+    rate: float  # tokens per second
+
+
+STEADY = Bucket("steady", RATE_LIMIT_STEADY_BURST, RATE_LIMIT_STEADY_PER_MINUTE / 60.0)
+BACKFILL = Bucket("backfill", RATE_LIMIT_BACKFILL_CAPACITY, RATE_LIMIT_BACKFILL_PER_HOUR / 3600.0)
+BUCKETS = {bucket.name: bucket for bucket in (STEADY, BACKFILL)}
+
+
+class RateLimitDecision(NamedTuple):
+    """Result of a rate limit check."""
+    allowed: bool
+    charges: Tuple[Tuple[str, float], ...]  # (bucket, tokens) charged, if allowed
+    retry_after: float  # seconds until the request would be allowed
+
+
+class RateLimitExceeded(Exception):
+    """An upload does not fit a gateway's budget (nothing was charged)."""
+
+    def __init__(self, gateway_id: str, cost: int, retry_after: float):
+        super().__init__(f"Rate limit exceeded for gateway {gateway_id}")
+        self.gateway_id = gateway_id
+        self.cost = cost
+        self.retry_after = retry_after  # math.inf if the upload can never fit
+
+
+def _seconds_until(tokens: float, cost: float, bucket: Bucket) -> float:
+    """Seconds until a bucket holding `tokens` can pay `cost`."""
+    if cost > bucket.capacity or bucket.rate <= 0:
+        return math.inf
+    return max(0.0, (cost - tokens) / bucket.rate)
+
+
+class MemoryBucketStore:
+    """Bucket state in process memory (single worker)."""
+
+    def __init__(self):
+        self._lock = threading.Lock()
+        self._state: Dict[Tuple[str, str], Tuple[float, float]] = {}
+
+    def try_consume(self, gateway_id: str, bucket: Bucket, cost: float, now: float) -> Tuple[bool, float]:
+        """Consume tokens if available. Returns (allowed, tokens left or available)."""
+        key = (gateway_id, bucket.name)
+        with self._lock:
+            tokens, updated = self._state.get(key, (bucket.capacity, now))
+            tokens = min(bucket.capacity, tokens + (now - updated) * bucket.rate)
+            if tokens >= cost:
+                self._state[key] = (tokens - cost, now)
+                return True, tokens - cost
+            self._state[key] = (tokens, now)
+            return False, tokens
+
+    def refund(self, gateway_id: str, bucket: Bucket, cost: float):
+        """Give back tokens charged by try_consume."""
+        key = (gateway_id, bucket.name)
+        with self._lock:
+            if key in self._state:
+                tokens, updated = self._state[key]
+                self._state[key] = (min(bucket.capacity, tokens + cost), updated)
+
+
+class DatabaseBucketStore:
+    """Bucket state in the gateway_rate_buckets table (shared by all workers)."""
+
+    # Refill and charge in one statement so concurrent workers cannot both spend the same tokens
+    _CONSUME = text("""
+        UPDATE gateway_rate_buckets
+        SET tokens = (CASE WHEN tokens + (:now - updated_at) * :rate > :capacity
+                           THEN :capacity
+                           ELSE tokens + (:now - updated_at) * :rate END) - :cost,
+            updated_at = :now
+        WHERE gateway_id = :gateway_id AND bucket = :bucket
+          AND (CASE WHEN tokens + (:now - updated_at) * :rate > :capacity
+                    THEN :capacity
+                    ELSE tokens + (:now - updated_at) * :rate END) >= :cost
+    """)
+    _CREATE = text("""
+        INSERT INTO gateway_rate_buckets (gateway_id, bucket, tokens, updated_at)
+        SELECT :gateway_id, :bucket, :capacity, :now
+        WHERE NOT EXISTS (
+            SELECT 1 FROM gateway_rate_buckets WHERE gateway_id = :gateway_id AND bucket = :bucket
+        )
+    """)
+    _REFUND = text("""
+        UPDATE gateway_rate_buckets
+        SET tokens = CASE WHEN tokens + :cost > :capacity THEN :capacity ELSE tokens + :cost END
+        WHERE gateway_id = :gateway_id AND bucket = :bucket
+    """)
+    _AVAILABLE = text("""
+        SELECT tokens, updated_at FROM gateway_rate_buckets
+        WHERE gateway_id = :gateway_id AND bucket = :bucket
+    """)
+
+    def try_consume(self, gateway_id: str, bucket: Bucket, cost: float, now: float) -> Tuple[bool, float]:
+        """Consume tokens if available. Returns (allowed, tokens available before the attempt)."""
+        params = {
+            "gateway_id": gateway_id,
+            "bucket": bucket.name,
+            "capacity": bucket.capacity,
+            "rate": bucket.rate,
+            "cost": cost,
+            "now": now,
+        }
+        with engine.begin() as conn:
+            conn.execute(self._CREATE, params)
+            if conn.execute(self._CONSUME, params).rowcount == 1:
+                return True, 0.0
+            row = conn.execute(self._AVAILABLE, params).fetchone()
+        tokens = min(bucket.capacity, row[0] + (now - row[1]) * bucket.rate) if row else 0.0
+        return False, tokens
+
+    def refund(self, gateway_id: str, bucket: Bucket, cost: float):
+        """Give back tokens charged by try_consume."""
+        with engine.begin() as conn:
+            conn.execute(self._REFUND, {
+                "gateway_id": gateway_id, "bucket": bucket.name, "capacity": bucket.capacity, "cost": cost
+            })
+
+
+class GatewayRateLimiter:
+    """Steady + backfill token buckets per gateway."""
+
+    def __init__(self, backend: str = RATE_LIMIT_BACKEND):
+        self.store = DatabaseBucketStore() if backend == "database" else MemoryBucketStore()
+
+    def acquire(self, gateway_id: str, cost: int = 1, backfill_cost: int = 0) -> RateLimitDecision:
+        """Charge `cost` readings to a gateway's budget.
+
+        The steady bucket is tried first for the whole cost. If it does not
+        fit, the `backfill_cost` old readings are paid from the backfill
+        reserve and only the rest from the steady bucket.
+        """
+        now = time.time()
+        allowed, steady_tokens = self.store.try_consume(gateway_id, STEADY, cost, now)
+        if allowed:
+            return RateLimitDecision(True, ((STEADY.name, cost),), 0.0)
+
+        retry_after = _seconds_until(steady_tokens, cost, STEADY)
+        backfill_cost = min(backfill_cost, cost)
+        if backfill_cost:
+            live_cost = cost - backfill_cost
+            if live_cost:
+                allowed, live_tokens = self.store.try_consume(gateway_id, STEADY, live_cost, now)
+                if not allowed:
+                    return RateLimitDecision(False, (), _seconds_until(live_tokens, live_cost, STEADY))
+            allowed, backfill_tokens = self.store.try_consume(gateway_id, BACKFILL, backfill_cost, now)
+            if allowed:
+                return RateLimitDecision(True, ((STEADY.name, live_cost), (BACKFILL.name, backfill_cost)), 0.0)
+            if live_cost:
+                self.store.refund(gateway_id, STEADY, live_cost)
+            retry_after = min(retry_after, _seconds_until(backfill_tokens, backfill_cost, BACKFILL))
+
+        return RateLimitDecision(False, (), retry_after)
+
+    def charge_upload(self, readings: List[IngestReading]):
+        """Charge an upload to every gateway it names, all or nothing.
+
+        Raises:
+            RateLimitExceeded: For the first gateway over its limit; gateways
+                charged before it are refunded
+        """
+        cutoff = time.time() - RATE_LIMIT_BACKFILL_AGE_SECONDS
+        costs = Counter(reading.gateway_id for reading in readings)
+        # Only readings that are themselves old may use the reserve
+        backfill = Counter(
+            reading.gateway_id for reading in readings if reading.timestamp and reading.timestamp < cutoff
+        )
+        charged: List[Tuple[str, RateLimitDecision]] = []
+        for gateway_id, cost in costs.items():
+            decision = self.acquire(gateway_id, cost=cost, backfill_cost=backfill[gateway_id])
+            if not decision.allowed:
+                for charged_gateway, charged_decision in charged:
+                    for bucket, tokens in charged_decision.charges:
+                        if tokens:
+                            self.store.refund(charged_gateway, BUCKETS[bucket], tokens)
+                raise RateLimitExceeded(gateway_id, cost, decision.retry_after)
+            charged.append((gateway_id, decision))
+
+
+# Process-wide limiter used by the ingest routes
+gateway_rate_limiter = GatewayRateLimiter()
@@ -0,0 +1,304 @@
+"""Compressed storage of closed hours of readings (reading_blocks).
+
+With READING_BLOCKS_ENABLED, a background compactor moves readings older than
+READING_BLOCK_COMPACT_AFTER_HOURS (rounded down to the hour) out of
+sensor_readings. Each node's hour goes into one compressed block (see
+models/ts_block.py). Each hour is compacted in its own transaction: its rows are
+grouped by node and gateway, merged into any block already written for that
+hour (late readings), then deleted. Blocks keep the original row ids.
+
+Readers never need to know where a reading lives. The history, latest-reading,
+bootstrap and analytics queries call the helpers below, which merge block
+readings with row readings. Blocks are decoded lazily:
+- only blocks whose time range overlaps the query are fetched
+- only the streams of the requested columns are decoded
+- counts come from the block rows without decoding at all; the block header
+  also carries min/max per metric (models/ts_block.read_header)
+
+Readers merge blocks even when the mode is disabled, so turning it off later
+loses nothing. Blocks already written stay where they are.
+"""
+import asyncio
+import heapq
+import logging
+import os
+from datetime import datetime, timedelta
+from itertools import groupby
+from operator import itemgetter
+from typing import Callable, Dict, List, Optional, Sequence, Tuple, Union
+from sqlalchemy import desc, func
+from sqlalchemy.orm import Session
+from models.database import ReadingBlock, SensorReading, SessionLocal
+from models.response_json import READING_FIELDS
+from models.ts_block import BLOCK_COLUMNS, METRICS, decode_block, encode_block
+
+logger = logging.getLogger(__name__)
+
+READING_BLOCKS_ENABLED = os.getenv("READING_BLOCKS_ENABLED", "false").lower() in ("1", "true", "yes")
+# Readings become eligible for compaction once their hour ended this long ago
+READING_BLOCK_COMPACT_AFTER_HOURS = int(os.getenv("READING_BLOCK_COMPACT_AFTER_HOURS", "2"))
+READING_BLOCK_COMPACT_INTERVAL_SECONDS = float(os.getenv("READING_BLOCK_COMPACT_INTERVAL_SECONDS", "300"))
+# Upper bound on hours compacted per pass (a backlog is worked off over several passes)
+READING_BLOCK_HOURS_PER_PASS = int(os.getenv("READING_BLOCK_HOURS_PER_PASS", "24"))
+
+# Row tuple layout of the history readers (lines up with READING_COLUMNS rows)
+ROW_COLUMNS = READING_FIELDS
+
+NodeFilter = Union[None, str, Sequence[str]]
+
+
+def _floor_hour(when: datetime) -> datetime:
+    return when.replace(minute=0, second=0, microsecond=0)
+
+
+def compaction_horizon(now: Optional[datetime] = None) -> datetime:
+    """Start of the oldest hour that is not compacted yet; older readings may be in blocks."""
+    return _floor_hour((now or datetime.utcnow()) - timedelta(hours=READING_BLOCK_COMPACT_AFTER_HOURS))
+
+
+def _block_query(db: Session, node_ids: NodeFilter, gateway_id: Optional[str]):
+    query = db.query(ReadingBlock.node_id, ReadingBlock.gateway_id, ReadingBlock.data)
+    if isinstance(node_ids, str):
+        query = query.filter(ReadingBlock.node_id == node_ids)
+    elif node_ids is not None:
+        query = query.filter(ReadingBlock.node_id.in_(list(node_ids)))
+    if gateway_id:
+        query = query.filter(ReadingBlock.gateway_id == gateway_id)
+    return query
+
+
+def _row_builder(columns: Sequence[str]):
+    """Streams to decode, and a function turning (decoded row, node, gateway) into a `columns` tuple."""
+    streams = [c for c in BLOCK_COLUMNS if c in columns or c == "timestamp"]
+    positions = {c: i for i, c in enumerate(streams)}
+    positions["node_id"] = len(streams)
+    positions["gateway_id"] = len(streams) + 1
+    pick = itemgetter(*(positions[c] for c in columns))
+    if len(columns) == 1:
+        return streams, lambda row: (pick(row),)
+    return streams, pick
+
+
+def block_rows(
+    db: Session,
+    columns: Sequence[str] = ROW_COLUMNS,
+    since: Optional[datetime] = None,
+    until: Optional[datetime] = None,
+    node_ids: NodeFilter = None,
+    gateway_id: Optional[str] = None
+) -> List[Tuple]:
+    """Readings stored in blocks with since <= timestamp < until, oldest first.
+
+    Args:
+        db: Database session
+        columns: Names from ROW_COLUMNS; the tuples hold these, in this order
+        since: Inclusive lower bound (default: no bound)
+        until: Exclusive upper bound (default: no bound)
+        node_ids: One node ID, a list of node IDs, or None for all nodes
+        gateway_id: Optional filter by gateway ID
+    """
+    query = _block_query(db, node_ids, gateway_id)
+    if since is not None:
+        query = query.filter(ReadingBlock.hour_start >= _floor_hour(since), ReadingBlock.last_ts >= since)
+    if until is not None:
+        query = query.filter(ReadingBlock.hour_start < until, ReadingBlock.first_ts < until)
+
+    streams, build = _row_builder(columns)
+    ts_index = streams.index("timestamp")
+    out = []
+    for node_id, block_gateway, data in query:
+        for row in decode_block(data, streams):
+            ts = row[ts_index]
+            if (since is None or ts >= since) and (until is None or ts < until):
+                out.append(build(row + (node_id, block_gateway)))
+    if "timestamp" in columns:
+        # Same order as the timestamp index scan of sensor_readings (ties by row id)
+        order = [columns.index("timestamp")] + ([columns.index("id")] if "id" in columns else [])
+        out.sort(key=itemgetter(*order))
+    return out
+
+
+def latest_block_rows(
+    db: Session,
+    limit: int,
+    node_ids: NodeFilter = None,
+    gateway_id: Optional[str] = None,
+    columns: Sequence[str] = ROW_COLUMNS
+) -> List[Tuple]:
+    """The newest `limit` readings stored in blocks, newest first.
+
+    Blocks are read hour by hour going back, until an hour completes the limit.
+    """
+    streams, build = _row_builder(columns)
+    ts_index = streams.index("timestamp")
+    query = _block_query(db, node_ids, gateway_id).add_columns(ReadingBlock.hour_start)
+    out = []
+    for _, blocks in groupby(query.order_by(desc(ReadingBlock.hour_start)).yield_per(256), key=itemgetter(3)):
+        for node_id, block_gateway, data, _ in blocks:
+            out.extend(
+                (row[ts_index], build(row + (node_id, block_gateway)))
+                for row in decode_block(data, streams)
+            )
+        # Older hours only hold older readings
+        if len(out) >= limit:
+            break
+    out.sort(key=itemgetter(0), reverse=True)
+    return [row for _, row in out[:limit]]
+
+
+def merge_by_time(rows: Sequence, extra: Sequence, key: Callable, newest_first: bool = False) -> List:
+    """Merge two lists that are each sorted by timestamp (`key` returns it)."""
+    if not extra:
+        return list(rows)
+    if not rows:
+        return list(extra)
+    return list(heapq.merge(rows, extra, key=key, reverse=newest_first))
+
+
+def to_reading(row: Sequence) -> SensorReading:
+    """Transient (never added to a session) SensorReading for a ROW_COLUMNS tuple."""
+    return SensorReading(**dict(zip(ROW_COLUMNS, row)))
+
+
+def block_node_ids(db: Session) -> List[str]:
+    """Nodes with at least one block."""
+    return [row[0] for row in db.query(ReadingBlock.node_id).distinct()]
+
+
+def node_has_blocks(db: Session, node_id: str) -> bool:
+    return db.query(ReadingBlock.node_id).filter(ReadingBlock.node_id == node_id).first() is not None
+
+
+def block_reading_count(db: Session) -> int:
+    """Readings stored in blocks (header-level, nothing is decoded)."""
+    return db.query(func.coalesce(func.sum(ReadingBlock.count), 0)).scalar() or 0
+
+
+class BlockCompactor:
+    """Moves closed hours of readings from sensor_readings into reading_blocks."""
+
+    def __init__(self):
+        self._task: Optional[asyncio.Task] = None
+        self.readings_compacted = 0
+        self.blocks_written = 0
+
+    def compact_hour(self, db: Session, hour_start: datetime) -> Tuple[int, int]:
+        """Compact one hour in the session's transaction (caller commits).
+
+        Returns:
+            (readings moved, blocks written)
+        """
+        hour_end = hour_start + timedelta(hours=1)
+        rows = db.query(
+            SensorReading.node_id, SensorReading.gateway_id, SensorReading.id, SensorReading.timestamp,
+            *(getattr(SensorReading, metric) for metric in METRICS)
+        ).filter(
+            SensorReading.timestamp >= hour_start, SensorReading.timestamp < hour_end
+        ).order_by(SensorReading.node_key, SensorReading.gateway_key, SensorReading.timestamp, SensorReading.id).all()
+        if not rows:
+            return 0, 0
+
+        existing: Dict[Tuple[str, str], bytes] = {
+            (node_id, block_gateway): data
+            for node_id, block_gateway, data in _block_query(db, None, None).filter(ReadingBlock.hour_start == hour_start)
+        }
+        blocks = []
+        for (node_id, block_gateway), group in groupby(rows, key=itemgetter(0, 1)):
+            readings = [tuple(row[2:]) for row in group]
+            previous = existing.get((node_id, block_gateway))
+            if previous is not None:
+                seen = {row[0] for row in readings}
+                readings.extend(row for row in decode_block(previous) if row[0] not in seen)
+                readings.sort(key=itemgetter(1, 0))
+            blocks.append({
+                "node_id": node_id,
+                "hour_start": hour_start,
+                "gateway_id": block_gateway,
+                "count": len(readings),
+                "max_id": max(row[0] for row in readings),
+                "first_ts": readings[0][1],
+                "last_ts": readings[-1][1],
+                "data": encode_block(readings),
+            })
+
+        for block in blocks:
+            if (block["node_id"], block["gateway_id"]) in existing:
+                db.query(ReadingBlock).filter(
+                    ReadingBlock.node_id == block["node_id"],
+                    ReadingBlock.hour_start == hour_start,
+                    ReadingBlock.gateway_id == block["gateway_id"]
+                ).delete(synchronize_session=False)
+        db.execute(ReadingBlock.__table__.insert(), blocks)
+        # Rows stored while this ran have larger ids and are picked up by the next pass
+        db.query(SensorReading).filter(
+            SensorReading.timestamp >= hour_start, SensorReading.timestamp < hour_end,
+            SensorReading.id <= max(row[2] for row in rows)
+        ).delete(synchronize_session=False)
+        return len(rows), len(blocks)
+
+    def run_once(self, max_hours: int = READING_BLOCK_HOURS_PER_PASS, now: Optional[datetime] = None) -> int:
+        """Compact up to max_hours of the oldest eligible hours. Blocking.
+
+        Returns:
+            Number of readings moved into blocks
+        """
+        horizon = compaction_horizon(now)
+        moved = 0
+        db = SessionLocal()
+        try:
+            for _ in range(max_hours):
+                oldest = db.query(func.min(SensorReading.timestamp)).filter(SensorReading.timestamp < horizon).scalar()
+                if oldest is None:
+                    break
+                hour_start = _floor_hour(oldest)
+                try:
+                    readings, blocks = self.compact_hour(db, hour_start)
+                    db.commit()
+                except Exception:
+                    db.rollback()
+                    raise
+                moved += readings
+                self.readings_compacted += readings
+                self.blocks_written += blocks
+                logger.info(f"Compacted {readings} reading(s) from {hour_start:%Y-%m-%d %H}:00 into {blocks} block(s)")
+        finally:
+            db.close()
+        return moved
+
+    async def start(self):
+        """Start periodic compaction. Must be called from the event loop."""
+        self._task = asyncio.create_task(self._run())
+
+    async def stop(self):
+        if self._task is None:
+            return
+        self._task.cancel()
+        await asyncio.gather(self._task, return_exceptions=True)
+        self._task = None
+
+    async def _run(self):
+        while True:
+            try:
+                await asyncio.to_thread(self.run_once)
+            except Exception as e:
+                logger.error(f"Reading block compaction failed: {str(e)}", exc_info=True)
+            await asyncio.sleep(READING_BLOCK_COMPACT_INTERVAL_SECONDS)
+
+
+# Process-wide compactor (runs only with READING_BLOCKS_ENABLED)
+block_compactor = BlockCompactor()
+
+
+async def start_block_compactor():
+    """Start compacting closed hours if READING_BLOCKS_ENABLED is set."""
+    if not READING_BLOCKS_ENABLED:
+        return
+    await block_compactor.start()
+    logger.info(
+        f"Reading block compaction active (hours older than {READING_BLOCK_COMPACT_AFTER_HOURS} h, "
+        f"every {READING_BLOCK_COMPACT_INTERVAL_SECONDS:.0f} s)"
+    )
+
+
+async def stop_block_compactor():
+    await block_compactor.stop()
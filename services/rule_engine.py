@@ -0,0 +1,361 @@
+"""Declarative threshold rules evaluated on every ingested reading.
+
+Rules are loaded from a JSON file (RULES_CONFIG_PATH, default config/rules.json):
+
+    {"limits": {"temperature": {"optimal_max": 28.0, "critical_high": 35.0}},
+     "rules": [
+        {"id": "temperature_critical_high", "metric": "temperature", "op": ">",
+         "threshold": "critical_high", "severity": "high",
+         "message": "Temperature {value:.1f}°C at {node_id}",
+         "gateways": ["gateway-01"]}
+    ]}
+
+`limits` names the levels of each metric; a rule's threshold is either a number
+or the name of one of its metric's limits. The insight analyzers read the same
+limits through RuleEngine.limit(), so the config file is the only place
+thresholds are set. Limits missing from a custom file come from the bundled
+config/rules.json.
+
+`gateways`, `nodes` and `zones` optionally restrict a rule to some gateways,
+nodes, or nodes placed in some zones (a zone includes the zones below it, so
+"zones": ["house-3"] covers every bench in house 3).
+The whole rule set is compiled into a single Python function, with the rules
+grouped by scope, so each reading costs one call plus a few comparisons.
+Matching rules emit RuleEvents. Each event is kept in a small in-memory
+buffer, pushed to stream subscribers and passed to registered listeners. Only
+transitions are logged: a rule starting or stopping to match a node, not every
+matching reading (alert lifecycles are services/alert_manager.py's job).
+"""
+import json
+import logging
+import os
+import threading
+from collections import deque
+from dataclasses import asdict, dataclass
+from datetime import datetime
+from functools import lru_cache
+from typing import Callable, Deque, Dict, List, Literal, Optional, Set, Tuple, Union
+from pydantic import BaseModel, Field, FiniteFloat, ValidationError
+from models.ingest import IngestReading
+from services.stream_hub import stream_hub
+from services.zones import zone_aggregator
+
+logger = logging.getLogger(__name__)
+
+DEFAULT_RULES_CONFIG_PATH = os.path.join(
+    os.path.dirname(os.path.dirname(os.path.abspath(__file__))), "config", "rules.json"
+)
+RULES_CONFIG_PATH = os.getenv("RULES_CONFIG_PATH", DEFAULT_RULES_CONFIG_PATH)
+
+# Number of recent rule events kept in memory for GET /api/rules/events
+RULE_EVENTS_BUFFER = 500
+
+# Reading fields rules may test, in the compiled function's argument order
+RULE_METRICS = ("temperature", "humidity", "soil_moisture", "light_level", "battery_level", "rssi")
+# Metrics that may be missing from a reading (rules never match a missing value)
+OPTIONAL_METRICS = {"light_level", "battery_level", "rssi"}
+
+Metric = Literal["temperature", "humidity", "soil_moisture", "light_level", "battery_level", "rssi"]
+
+
+class RuleDefinition(BaseModel):
+    """One threshold rule as written in the config file."""
+    id: str
+    metric: Metric
+    op: Literal["<", "<=", ">", ">="]
+    threshold: Union[FiniteFloat, str] = Field(
+        ...,
+        description="A finite number, or the name of one of the metric's limits (a number once loaded)"
+    )
+    severity: Literal["low", "medium", "high"] = "medium"
+    message: str = "{metric} {op} {threshold} at {node_id} (value {value})"
+    gateways: Optional[List[str]] = Field(None, description="Only evaluate for these gateways")
+    nodes: Optional[List[str]] = Field(None, description="Only evaluate for these nodes")
+    zones: Optional[List[str]] = Field(None, description="Only evaluate for nodes in these zones (or zones below them)")
+    enabled: bool = True
+    hysteresis: Optional[float] = Field(
+        None, ge=0, allow_inf_nan=False,
+        description="Margin past the threshold before an alert resolves (default per metric)"
+    )
+    min_duration_seconds: Optional[float] = Field(
+        None, ge=0, allow_inf_nan=False,
+        description="How long the condition must hold before an alert opens (default ALERT_MIN_DURATION_SECONDS)"
+    )
+
+
+class RuleConfig(BaseModel):
+    """The whole config file."""
+    limits: Dict[Metric, Dict[str, FiniteFloat]] = Field(default_factory=dict)
+    rules: List[RuleDefinition] = Field(default_factory=list)
+
+
+class RuleConfigError(ValueError):
+    """Raised when the rule configuration cannot be loaded."""
+
+
+@dataclass(slots=True)
+class RuleEvent:
+    """A rule that matched a reading."""
+    rule_id: str
+    severity: str
+    node_id: str
+    gateway_id: str
+    metric: str
+    value: float
+    threshold: float
+    message: str
+    timestamp: datetime
+
+    def to_dict(self) -> Dict:
+        data = asdict(self)
+        data["timestamp"] = self.timestamp.isoformat()
+        return data
+
+
+def compile_rules(rules: List[RuleDefinition]) -> Callable[..., List[int]]:
+    """Compile rules into one function returning the indexes of matching rules.
+
+    Rules sharing a scope are emitted under a single scope check. Only
+    validated metric names, operators and float literals reach the generated
+    source; thresholds are validated finite, so their repr is a valid literal.
+    """
+    namespace: Dict[str, object] = {}
+    scopes: Dict[Tuple, List[int]] = {}
+    for index, rule in enumerate(rules):
+        if rule.enabled:
+            key = (
+                tuple(sorted(rule.gateways)) if rule.gateways else None,
+                tuple(sorted(rule.nodes)) if rule.nodes else None,
+                tuple(sorted(rule.zones)) if rule.zones else None,
+            )
+            scopes.setdefault(key, []).append(index)
+
+    # `zones` is the node's zone and its ancestors (see ZoneTree.chain)
+    lines = [f"def evaluate(node_id, gateway_id, zones, {', '.join(RULE_METRICS)}):", "    hits = []"]
+    for scope_number, ((gateways, nodes, zones), indexes) in enumerate(scopes.items()):
+        conditions = []
+        if gateways:
+            namespace[f"_gateways_{scope_number}"] = frozenset(gateways)
+            conditions.append(f"gateway_id in _gateways_{scope_number}")
+        if nodes:
+            namespace[f"_nodes_{scope_number}"] = frozenset(nodes)
+            conditions.append(f"node_id in _nodes_{scope_number}")
+        if zones:
+            namespace[f"_zones_{scope_number}"] = frozenset(zones)
+            conditions.append(f"not _zones_{scope_number}.isdisjoint(zones)")
+
+        indent = "    "
+        if conditions:
+            lines.append(f"    if {' and '.join(conditions)}:")
+            indent = "        "
+        for index in indexes:
+            rule = rules[index]
+            test = f"{rule.metric} {rule.op} {float(rule.threshold)!r}"
+            if rule.metric in OPTIONAL_METRICS:
+                test = f"{rule.metric} is not None and {test}"
+            lines.append(f"{indent}if {test}:")
+            lines.append(f"{indent}    hits.append({index})")
+    lines.append("    return hits")
+
+    exec(compile("\n".join(lines), "<rules>", "exec"), namespace)
+    return namespace["evaluate"]
+
+
+def load_config(
+    path: str,
+    base_limits: Optional[Dict[str, Dict[str, float]]] = None
+) -> Tuple[List[RuleDefinition], Dict[str, Dict[str, float]]]:
+    """Read and validate a rule file.
+
+    Args:
+        path: Config file
+        base_limits: Limits the file's own limits are merged over
+
+    Returns:
+        The rules, with named thresholds resolved to numbers, and the merged limits
+
+    Raises:
+        RuleConfigError: If the file is unreadable or a rule is invalid
+    """
+    try:
+        with open(path, encoding="utf-8") as f:
+            config = RuleConfig.model_validate(json.load(f))
+    except (OSError, ValueError, ValidationError) as e:
+        raise RuleConfigError(f"Invalid rule config {path}: {e}")
+
+    limits = {metric: dict(levels) for metric, levels in (base_limits or {}).items()}
+    for metric, levels in config.limits.items():
+        limits.setdefault(metric, {}).update(levels)
+
+    rules = config.rules
+    for rule in rules:
+        if isinstance(rule.threshold, str):
+            if rule.threshold not in limits.get(rule.metric, {}):
+                raise RuleConfigError(
+                    f"Rule {rule.id} in {path} uses unknown limit {rule.metric}.{rule.threshold}"
+                )
+            rule.threshold = limits[rule.metric][rule.threshold]
+
+    ids = [rule.id for rule in rules]
+    duplicates = {rule_id for rule_id in ids if ids.count(rule_id) > 1}
+    if duplicates:
+        raise RuleConfigError(f"Duplicate rule ids in {path}: {sorted(duplicates)}")
+    return rules, limits
+
+
+@lru_cache(maxsize=1)
+def default_limits() -> Dict[str, Dict[str, float]]:
+    """Limits of the bundled config/rules.json."""
+    return load_config(DEFAULT_RULES_CONFIG_PATH)[1]
+
+
+class RuleEngine:
+    """Holds the compiled rule set and fans out rule events."""
+
+    def __init__(self, path: str = RULES_CONFIG_PATH):
+        self.path = path
+        self._compiled: Tuple[List[RuleDefinition], Callable[..., List[int]]] = ([], compile_rules([]))
+        self._by_id: Dict[str, RuleDefinition] = {}
+        self._limits: Dict[str, Dict[str, float]] = {}
+        self._listeners: List[Callable[[RuleEvent], None]] = []
+        self._recent: Deque[RuleEvent] = deque(maxlen=RULE_EVENTS_BUFFER)
+        # Rule ids currently matching each node, to log only match/clear edges
+        self._matching: Dict[str, Set[str]] = {}
+        self._lock = threading.Lock()
+
+    @property
+    def rules(self) -> List[RuleDefinition]:
+        return self._compiled[0]
+
+    def rule(self, rule_id: str) -> Optional[RuleDefinition]:
+        """Look up a loaded rule by id."""
+        return self._by_id.get(rule_id)
+
+    @property
+    def limits(self) -> Dict[str, Dict[str, float]]:
+        """Named limits per metric (the bundled ones until a config is loaded)."""
+        return self._limits or default_limits()
+
+    def limit(self, metric: str, name: str) -> float:
+        """A named limit of a metric, e.g. limit("temperature", "optimal_max").
+
+        Raises:
+            KeyError: If neither the loaded nor the bundled config defines it
+        """
+        return self.limits[metric][name]
+
+    def load(self) -> int:
+        """(Re)load and compile the rule file. Returns the number of rules.
+
+        Raises:
+            RuleConfigError: If the config is invalid (the previous rules stay active)
+        """
+        if os.path.abspath(self.path) == DEFAULT_RULES_CONFIG_PATH:
+            rules, limits = load_config(self.path)
+        else:
+            rules, limits = load_config(self.path, default_limits())
+        # Swap rules and function together so readers never see a mismatched pair
+        self._compiled = (rules, compile_rules(rules))
+        self._by_id = {rule.id: rule for rule in rules}
+        self._limits = limits
+        logger.info(f"Loaded {len(rules)} rule(s) from {self.path}")
+        return len(rules)
+
+    def add_listener(self, listener: Callable[[RuleEvent], None]):
+        """Register a callback invoked for every rule event."""
+        self._listeners.append(listener)
+
+    def evaluate(self, reading: IngestReading, timestamp: datetime) -> List[RuleEvent]:
+        """Return the events a reading triggers (without emitting them)."""
+        rules, evaluate = self._compiled
+        hits = evaluate(
+            reading.node_id, reading.gateway_id, zone_aggregator.tree.chain(reading.node_id),
+            reading.temperature, reading.humidity,
+            reading.soil_moisture, reading.light_level, reading.battery_level, reading.rssi
+        )
+        events = []
+        for index in hits:
+            rule = rules[index]
+            value = getattr(reading, rule.metric)
+            try:
+                message = rule.message.format(
+                    value=value, threshold=rule.threshold, metric=rule.metric, op=rule.op,
+                    node_id=reading.node_id, gateway_id=reading.gateway_id
+                )
+            except (KeyError, ValueError, IndexError):
+                message = rule.message
+            events.append(RuleEvent(
+                rule.id, rule.severity, reading.node_id, reading.gateway_id,
+                rule.metric, value, rule.threshold, message, timestamp
+            ))
+        return events
+
+    def process(self, reading: IngestReading, timestamp: datetime) -> List[RuleEvent]:
+        """Evaluate a newly stored reading and emit any rule events."""
+        events = self.evaluate(reading, timestamp)
+        self._log_transitions(reading, events)
+        for event in events:
+            self._emit(event)
+        return events
+
+    def _log_transitions(self, reading: IngestReading, events: List[RuleEvent]):
+        """Log rules that started or stopped matching the reading's node."""
+        matched = {event.rule_id for event in events}
+        with self._lock:
+            previous = self._matching.get(reading.node_id, set())
+            if matched == previous:
+                return
+            if matched:
+                self._matching[reading.node_id] = matched
+            else:
+                self._matching.pop(reading.node_id, None)
+        extra = {"gateway_id": reading.gateway_id, "node_id": reading.node_id}
+        for event in events:
+            if event.rule_id not in previous:
+                logger.warning(f"Rule {event.rule_id} ({event.severity}) matched: {event.message}", extra=extra)
+        for rule_id in previous - matched:
+            logger.info(f"Rule {rule_id} no longer matches {reading.node_id}", extra=extra)
+
+    def recent_events(
+        self,
+        node_id: Optional[str] = None,
+        gateway_id: Optional[str] = None,
+        limit: int = 100
+    ) -> List[RuleEvent]:
+        """Most recent events first, optionally filtered."""
+        with self._lock:
+            events = list(self._recent)
+        events.reverse()
+        if node_id:
+            events = [e for e in events if e.node_id == node_id]
+        if gateway_id:
+            events = [e for e in events if e.gateway_id == gateway_id]
+        return events[:limit]
+
+    def _emit(self, event: RuleEvent):
+        with self._lock:
+            self._recent.append(event)
+        stream_hub.publish(
+            event.node_id, event.gateway_id,
+            json.dumps({"type": "rule_event", "data": event.to_dict()})
+        )
+        for listener in self._listeners:
+            try:
+                listener(event)
+            except Exception as e:
+                logger.error(f"Rule event listener failed: {str(e)}", exc_info=True)
+
+
+# Process-wide engine used by the ingest pipeline
+rule_engine = RuleEngine()
+
+
+def load_rule_engine():
+    """Load the configured rules at startup (a bad config disables rules instead of failing startup)."""
+    if not os.path.exists(rule_engine.path):
+        logger.warning(f"No rule config at {rule_engine.path}; threshold rules disabled")
+        return
+    try:
+        rule_engine.load()
+    except RuleConfigError as e:
+        logger.error(str(e))
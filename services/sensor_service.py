@@ -1,62 +1,110 @@
 """Service layer for sensor data operations."""
 from sqlalchemy.orm import Session
-from sqlalchemy import desc
-from typing import List, Optional
+from sqlalchemy import desc, exists
+from typing import List, Optional, Sequence, Tuple, Union
 from datetime import datetime, timedelta
-from models.database import SensorReading
+from operator import attrgetter, itemgetter
+from models.database import Gateway, SensorNode, SensorReading, next_reading_id
 from models.schemas import SensorDataInput, SensorReadingResponse
+from models.ingest import IngestReading
+from models.response_json import READING_COLUMNS
 from services.gateway_service import GatewayService
+from services import metrics, reading_store, tracing
 
+_BY_TIMESTAMP = attrgetter("timestamp")
+# Position of the timestamp in READING_COLUMNS rows
+_TS = len(READING_COLUMNS) - 1
 
+
+@tracing.traced
 class SensorService:
     """Service for managing sensor data operations."""
 
     @staticmethod
-    def create_reading(db: Session, sensor_data: SensorDataInput) -> SensorReading:
+    def register_source(
+        db: Session,
+        sensor_data: IngestReading,
+        client_ip: Optional[str] = None
+    ) -> Tuple[Gateway, SensorNode]:
+        """Register/update the gateway (with its IP addresses) and node a reading came from.
+
+        Unknown gateways and nodes are created, so the system works with data
+        from devices that were never registered.
+
+        Args:
+            db: Database session
+            sensor_data: Reading naming the gateway and node
+            client_ip: IP address the reading was received from (for diagnostics)
+        """
+        gateway_id = sensor_data.gateway_id
+        node_id = sensor_data.node_id
+        gateway = GatewayService.register_or_update_gateway(
+            db, gateway_id, local_ip=sensor_data.local_ip, client_ip=client_ip
+        )
+
+        # Determine if node is simulated (for now, assume simulated if gateway is 'gateway-01'
+        # and node_id matches common simulation patterns)
+        is_simulated = gateway_id == "gateway-01" and ("sim" in node_id.lower() or "test" in node_id.lower())
+        node = GatewayService.register_or_update_node(db, node_id, gateway_id, is_simulated=is_simulated)
+        return gateway, node
+
+    @staticmethod
+    def create_reading(
+        db: Session,
+        sensor_data: Union[SensorDataInput, IngestReading],
+        timestamp: Optional[datetime] = None,
+        source: Optional[Tuple[Gateway, SensorNode]] = None
+    ) -> SensorReading:
         """Create a new sensor reading in the database.
         
         This method:
-        1. Registers/updates the gateway (if not exists)
-        2. Registers/updates the sensor node (if not exists)
-        3. Creates the sensor reading with proper foreign key relationships
+        1. Registers/updates the gateway and sensor node (unless `source` is given)
+        2. Creates the sensor reading with proper foreign key relationships
         
         Works with both real and simulated data.
-        """
-        # Get gateway and node IDs
-        gateway_id = sensor_data.get_gateway_id()
-        node_id = sensor_data.get_sensor_id()
         
-        # Register/update gateway and node (creates if doesn't exist)
-        # This allows the system to work with data from unknown gateways/nodes
-        GatewayService.register_or_update_gateway(db, gateway_id)
+        Args:
+            db: Database session
+            sensor_data: Validated API payload or internal ingest reading
+            timestamp: Resolved reading timestamp (derived from the payload if omitted)
+            source: Gateway and node already registered for this reading (see register_source)
+        """
+        if isinstance(sensor_data, SensorDataInput):
+            sensor_data = IngestReading.from_input(sensor_data)
         
-        # Determine if node is simulated (for now, assume simulated if gateway is 'gateway-01'
-        # and node_id matches common simulation patterns)
-        is_simulated = gateway_id == "gateway-01" and ("sim" in node_id.lower() or "test" in node_id.lower())
-        GatewayService.register_or_update_node(db, node_id, gateway_id, is_simulated=is_simulated)
+        if source is None:
+            source = SensorService.register_source(db, sensor_data)
+        gateway, node = source
         
         # Use timestamp from ESP32 if provided, otherwise use current time
-        reading_timestamp = datetime.utcnow()
-        if sensor_data.timestamp:
-            try:
-                reading_timestamp = datetime.fromtimestamp(sensor_data.timestamp)
-            except (ValueError, OSError):
-                reading_timestamp = datetime.utcnow()
+        reading_timestamp = timestamp
+        if reading_timestamp is None:
+            reading_timestamp = datetime.utcnow()
+            if sensor_data.timestamp:
+                try:
+                    reading_timestamp = datetime.fromtimestamp(sensor_data.timestamp)
+                except (ValueError, OSError):
+                    reading_timestamp = datetime.utcnow()
         
         db_reading = SensorReading(
-            node_id=node_id,
-            gateway_id=gateway_id,
+            node_key=node.id,
+            gateway_key=gateway.id,
             temperature=sensor_data.temperature,
             humidity=sensor_data.humidity,
-            soil_moisture=sensor_data.get_soil_moisture(),
+            soil_moisture=sensor_data.soil_moisture,
             light_level=sensor_data.light_level,
-            battery_level=sensor_data.batteryLevel,
+            battery_level=sensor_data.battery_level,
             rssi=sensor_data.rssi,
             timestamp=reading_timestamp
         )
-        db.add(db_reading)
-        db.commit()
-        db.refresh(db_reading)
+        if db.bind.dialect.name == "sqlite":
+            db_reading.id = next_reading_id()
+        with metrics.INGEST_INSERT.time():
+            db.add(db_reading)
+            db.flush()
+        with metrics.INGEST_COMMIT.time():
+            db.commit()
+            db.refresh(db_reading)
         return db_reading
 
     @staticmethod
@@ -84,13 +132,49 @@ class SensorService:
         if gateway_id:
             query = query.filter(SensorReading.gateway_id == gateway_id)
 
-        return query.order_by(desc(SensorReading.timestamp)).limit(limit).all()
+        readings = query.order_by(desc(SensorReading.timestamp)).limit(limit).all()
+        if len(readings) < limit or readings[-1].timestamp < reading_store.compaction_horizon():
+            # Older readings may be in compressed blocks
+            compacted = reading_store.latest_block_rows(db, limit, node_ids=node_id, gateway_id=gateway_id)
+            readings = reading_store.merge_by_time(
+                readings, [reading_store.to_reading(row) for row in compacted], _BY_TIMESTAMP, newest_first=True
+            )[:limit]
+        return readings
+
+    @staticmethod
+    def get_latest_rows(
+        db: Session,
+        limit: int = 10,
+        node_id: Optional[str] = None,
+        gateway_id: Optional[str] = None
+    ) -> List[Sequence]:
+        """Like get_latest_readings, but returns plain row tuples (READING_COLUMNS).
+
+        Used by read endpoints that encode rows directly with models/response_json.py.
+        """
+        query = db.query(*READING_COLUMNS)
+
+        if node_id:
+            query = query.filter(SensorReading.node_id == node_id)
+        if gateway_id:
+            query = query.filter(SensorReading.gateway_id == gateway_id)
+
+        rows = query.order_by(desc(SensorReading.timestamp)).limit(limit).all()
+        if len(rows) < limit or rows[-1][_TS] < reading_store.compaction_horizon():
+            compacted = reading_store.latest_block_rows(db, limit, node_ids=node_id, gateway_id=gateway_id)
+            rows = reading_store.merge_by_time(rows, compacted, itemgetter(_TS), newest_first=True)[:limit]
+        return rows
 
     @staticmethod
     def get_all_node_ids(db: Session) -> List[str]:
-        """Get all unique node IDs."""
-        node_ids = db.query(SensorReading.node_id).distinct().all()
-        return [node_id[0] for node_id in node_ids]
+        """Get all unique node IDs (including nodes whose readings are all compacted)."""
+        node_ids = {
+            node_id for node_id, in db.query(SensorNode.node_id).filter(
+                exists().where(SensorReading.node_key == SensorNode.id)
+            )
+        }
+        node_ids.update(reading_store.block_node_ids(db))
+        return sorted(node_ids)
 
     @staticmethod
     def get_latest_per_node(db: Session) -> List[SensorReading]:
@@ -105,6 +189,9 @@ class SensorService:
                 .order_by(desc(SensorReading.timestamp))
                 .first()
             )
+            if latest is None:
+                compacted = reading_store.latest_block_rows(db, 1, node_ids=node_id)
+                latest = reading_store.to_reading(compacted[0]) if compacted else None
             if latest:
                 latest_readings.append(latest)
 
@@ -115,7 +202,8 @@ class SensorService:
         db: Session,
         hours: int = 24,
         node_id: Optional[str] = None,
-        gateway_id: Optional[str] = None
+        gateway_id: Optional[str] = None,
+        now: Optional[datetime] = None
     ) -> List[SensorReading]:
         """Get sensor readings from the last N hours.
         
@@ -124,11 +212,12 @@ class SensorService:
             hours: Number of hours of history to retrieve
             node_id: Optional filter by node ID
             gateway_id: Optional filter by gateway ID
+            now: End of the window the N hours are counted back from (default: current time)
             
         Returns:
             List of SensorReading objects ordered by timestamp
         """
-        cutoff_time = datetime.utcnow() - timedelta(hours=hours)
+        cutoff_time = (now or datetime.utcnow()) - timedelta(hours=hours)
         query = db.query(SensorReading).filter(
             SensorReading.timestamp >= cutoff_time
         )
@@ -138,7 +227,37 @@ class SensorService:
         if gateway_id:
             query = query.filter(SensorReading.gateway_id == gateway_id)
 
-        return query.order_by(SensorReading.timestamp).all()
+        readings = query.order_by(SensorReading.timestamp).all()
+        compacted = reading_store.block_rows(db, since=cutoff_time, node_ids=node_id, gateway_id=gateway_id)
+        return reading_store.merge_by_time(
+            [reading_store.to_reading(row) for row in compacted], readings, _BY_TIMESTAMP
+        )
+
+    @staticmethod
+    def get_history_rows(
+        db: Session,
+        hours: int = 24,
+        node_id: Optional[str] = None,
+        gateway_id: Optional[str] = None,
+        now: Optional[datetime] = None
+    ) -> List[Sequence]:
+        """Like get_history, but returns plain row tuples (READING_COLUMNS).
+
+        Skips ORM object construction, which dominates the cost of large histories.
+        """
+        cutoff_time = (now or datetime.utcnow()) - timedelta(hours=hours)
+        query = db.query(*READING_COLUMNS).filter(
+            SensorReading.timestamp >= cutoff_time
+        )
+
+        if node_id:
+            query = query.filter(SensorReading.node_id == node_id)
+        if gateway_id:
+            query = query.filter(SensorReading.gateway_id == gateway_id)
+
+        rows = query.order_by(SensorReading.timestamp).all()
+        compacted = reading_store.block_rows(db, since=cutoff_time, node_ids=node_id, gateway_id=gateway_id)
+        return reading_store.merge_by_time(compacted, rows, itemgetter(_TS))
     
     @staticmethod
     def check_duplicate(
@@ -171,6 +290,14 @@ class SensorService:
             .filter(SensorReading.timestamp <= window_end)
             .first()
         )
+        if existing is None and window_start < reading_store.compaction_horizon():
+            # A late reading for an hour that may already be compacted
+            compacted = reading_store.block_rows(
+                db, since=window_start, until=window_end + timedelta(microseconds=1),
+                node_ids=node_id, gateway_id=gateway_id
+            )
+            if compacted:
+                existing = reading_store.to_reading(compacted[0])
         
         return existing
 
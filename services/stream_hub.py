@@ -0,0 +1,175 @@
+"""Fan-out hub for pushing new sensor readings to connected dashboard clients.
+
+Readings are published by the ingest path and delivered to every WebSocket/SSE
+subscriber whose node/gateway filters match. Each reading is serialized once,
+no matter how many subscribers receive it.
+
+Slow consumers never block ingest: every subscriber has a bounded queue that
+drops the oldest message when full. Subscribers that request a throttle rate
+get the latest reading per node coalesced and flushed at most once per interval.
+"""
+import asyncio
+import json
+import logging
+import os
+import time
+from collections import deque
+from typing import Dict, Iterable, List, Optional, Set
+
+from models.schemas import SensorReadingResponse
+
+logger = logging.getLogger(__name__)
+
+# Maximum number of undelivered messages buffered per subscriber
+STREAM_QUEUE_SIZE = int(os.getenv("STREAM_QUEUE_SIZE", "256"))
+
+
+def _normalize_filter(values: Optional[Iterable[str]]) -> Optional[Set[str]]:
+    """Turn a list of filter values into a set, or None when no filter is given."""
+    if not values:
+        return None
+    result = {v.strip() for v in values if v and v.strip()}
+    return result or None
+
+
+class StreamSubscription:
+    """A single client subscription with filters and a bounded delivery queue."""
+
+    def __init__(
+        self,
+        node_ids: Optional[Iterable[str]] = None,
+        gateway_ids: Optional[Iterable[str]] = None,
+        throttle_seconds: float = 0.0,
+        max_queue: int = STREAM_QUEUE_SIZE
+    ):
+        self.node_ids = _normalize_filter(node_ids)
+        self.gateway_ids = _normalize_filter(gateway_ids)
+        self.throttle_seconds = max(0.0, throttle_seconds)
+        self.dropped = 0
+        self._queue: deque = deque(maxlen=max_queue)
+        # Throttled subscribers only keep the latest message per node
+        self._pending: Dict[str, str] = {}
+        self._event = asyncio.Event()
+        self._last_flush = 0.0
+
+    def matches(self, node_id: str, gateway_id: str) -> bool:
+        """Check whether a reading passes this subscription's filters."""
+        if self.node_ids is not None and node_id not in self.node_ids:
+            return False
+        if self.gateway_ids is not None and gateway_id not in self.gateway_ids:
+            return False
+        return True
+
+    def offer(self, key: str, message: str):
+        """Queue a message for delivery, dropping the oldest one if the queue is full."""
+        if self.throttle_seconds:
+            self._pending[key] = message
+        else:
+            if len(self._queue) == self._queue.maxlen:
+                self.dropped += 1
+            self._queue.append(message)
+        self._event.set()
+
+    @property
+    def queue_depth(self) -> int:
+        """Number of messages waiting to be delivered."""
+        return len(self._queue) + len(self._pending)
+
+    async def next_batch(self) -> List[str]:
+        """Wait for and return the next batch of messages to send to the client."""
+        while True:
+            await self._event.wait()
+
+            if self.throttle_seconds:
+                wait = self._last_flush + self.throttle_seconds - time.monotonic()
+                if wait > 0:
+                    await asyncio.sleep(wait)
+                self._last_flush = time.monotonic()
+
+            self._event.clear()
+            batch = list(self._queue)
+            self._queue.clear()
+            if self._pending:
+                batch.extend(self._pending.values())
+                self._pending.clear()
+
+            if batch:
+                return batch
+
+
+class StreamHub:
+    """Registry of active subscriptions and fan-out point for new readings."""
+
+    def __init__(self):
+        self._subscriptions: Set[StreamSubscription] = set()
+        self._loop: Optional[asyncio.AbstractEventLoop] = None
+
+    def subscribe(
+        self,
+        node_ids: Optional[Iterable[str]] = None,
+        gateway_ids: Optional[Iterable[str]] = None,
+        throttle_seconds: float = 0.0
+    ) -> StreamSubscription:
+        """Register a new subscription. Must be called from the event loop."""
+        self._loop = asyncio.get_running_loop()
+        subscription = StreamSubscription(node_ids, gateway_ids, throttle_seconds)
+        self._subscriptions.add(subscription)
+        logger.info(f"Stream subscriber connected ({len(self._subscriptions)} active)")
+        return subscription
+
+    def unsubscribe(self, subscription: StreamSubscription):
+        """Remove a subscription (no-op if already removed)."""
+        if subscription in self._subscriptions:
+            self._subscriptions.discard(subscription)
+            logger.info(
+                f"Stream subscriber disconnected ({len(self._subscriptions)} active, "
+                f"{subscription.dropped} messages dropped)"
+            )
+
+    @property
+    def subscriber_count(self) -> int:
+        """Number of active subscriptions."""
+        return len(self._subscriptions)
+
+    @property
+    def queue_depth(self) -> int:
+        """Messages waiting across all subscriptions."""
+        return sum(subscription.queue_depth for subscription in list(self._subscriptions))
+
+    def publish_reading(self, reading) -> None:
+        """Publish a stored SensorReading to all matching subscribers.
+
+        Safe to call from any thread. Does nothing when nobody is subscribed,
+        so the ingest path pays no serialization cost without listeners.
+        """
+        if not self._subscriptions:
+            return
+
+        payload = SensorReadingResponse.model_validate(reading).model_dump(mode="json")
+        message = json.dumps({"type": "reading", "data": payload})
+        self.publish(reading.node_id, reading.gateway_id, message)
+
+    def publish(self, node_id: str, gateway_id: str, message: str) -> None:
+        """Deliver an already-serialized message to all matching subscribers."""
+        loop = self._loop
+        if loop is None or loop.is_closed():
+            return
+
+        try:
+            running = asyncio.get_running_loop()
+        except RuntimeError:
+            running = None
+
+        if running is loop:
+            self._dispatch(node_id, gateway_id, message)
+        else:
+            loop.call_soon_threadsafe(self._dispatch, node_id, gateway_id, message)
+
+    def _dispatch(self, node_id: str, gateway_id: str, message: str):
+        for subscription in list(self._subscriptions):
+            if subscription.matches(node_id, gateway_id):
+                subscription.offer(node_id, message)
+
+
+# Process-wide hub shared by the ingest path and the stream routes
+stream_hub = StreamHub()
@@ -2,7 +2,10 @@
 from datetime import datetime, timedelta
 from sqlalchemy.orm import Session
 from sqlalchemy import func
-from models.database import SensorReading
+from models.database import ReadingBlock, SensorReading
+from services import reading_store, tracing
+from services.metrics import probe_timer
+from services.liveness import liveness_tracker
 import httpx
 import logging
 
@@ -35,11 +38,13 @@ async def fetch_gateway_active_nodes(gateway_ip: str = None) -> int | None:
         ips_to_try.append('192.168.4.1')
     
     # Use shorter timeout to avoid blocking the API response
-    async with httpx.AsyncClient(timeout=httpx.Timeout(0.5)) as client:
+    async with httpx.AsyncClient(timeout=httpx.Timeout(0.5), transport=tracing.http_transport()) as client:
         for ip in ips_to_try:
             try:
                 url = f"http://{ip}/nodes"
-                response = await client.get(url)
+                with probe_timer("nodes") as probe:
+                    response = await client.get(url)
+                    probe.outcome = str(response.status_code)
                 
                 if response.status_code == 200:
                     data = response.json()
@@ -69,24 +74,31 @@ def get_system_stats(db: Session, gateway_ip: str = None) -> dict:
         .first()
     )
     
+    last_timestamp = last_reading.timestamp if last_reading else None
+    if last_timestamp is None:
+        # Everything may be compacted into blocks
+        last_timestamp = db.query(func.max(ReadingBlock.last_ts)).scalar()
+    
     last_data_received_seconds = None
-    if last_reading:
+    if last_timestamp:
         last_data_received_seconds = int(
-            (datetime.utcnow() - last_reading.timestamp).total_seconds()
+            (datetime.utcnow() - last_timestamp).total_seconds()
         )
     
     # Get total messages from database (more accurate than counter)
-    total_messages = db.query(func.count(SensorReading.id)).scalar() or 0
+    total_messages = (db.query(func.count(SensorReading.id)).scalar() or 0) + reading_store.block_reading_count(db)
     
-    # Try to get active nodes from gateway first, fallback to database
-    # Note: This is a sync function, so we'll calculate from DB for now
-    # The gateway active nodes will be fetched in the async endpoint
-    one_hour_ago = datetime.utcnow() - timedelta(hours=1)
-    active_nodes = (
-        db.query(func.count(func.distinct(SensorReading.node_id)))
-        .filter(SensorReading.timestamp >= one_hour_ago)
-        .scalar() or 0
-    )
+    # Try to get active nodes from gateway first, fallback to the liveness tracker
+    # Note: This is a sync function; the gateway active nodes are fetched in the async endpoint
+    if liveness_tracker.running:
+        active_nodes = liveness_tracker.online_count("node")
+    else:
+        one_hour_ago = datetime.utcnow() - timedelta(hours=1)
+        active_nodes = (
+            db.query(func.count(func.distinct(SensorReading.node_key)))
+            .filter(SensorReading.timestamp >= one_hour_ago)
+            .scalar() or 0
+        )
     
     return {
         "backend": "online",
@@ -0,0 +1,536 @@
+"""Request tracing: per-span timings across routes, services, SQL statements and outbound HTTP.
+
+Spans follow the OpenTelemetry data model (trace and span ids, parent links,
+kinds, attributes, error status). They are exported as OTLP/JSON, so an
+OpenTelemetry collector, Jaeger or Tempo reads them as they are:
+- TRACING_OTLP_ENDPOINT: POST batches to a collector's OTLP/HTTP endpoint,
+  e.g. http://localhost:4318/v1/traces
+- TRACING_FILE: append one OTLP/JSON batch per line to a file (the format
+  the collector's file exporter writes and its otlpjsonfile receiver reads)
+
+Where spans come from:
+- The request middleware in main.py opens a root span per request and continues
+  an incoming W3C `traceparent`. The insight scheduler, MQTT batches and UDP
+  frames open their own roots.
+- @traced on the service classes puts a span around every public method, with
+  `gateway_id` / `node_id` attributes taken from its arguments.
+- SQLAlchemy cursor events put a span around every SQL statement. The time a
+  service method spends outside its SQL spans is ORM hydration and Python work.
+- TracedTransport puts a span around every outbound httpx request (gateway
+  probes, webhooks) and forwards `traceparent`.
+Spans started outside a trace (startup, background loops) are not recorded, and
+jobs running in analytics worker processes (ANALYTICS_PROCESSES) appear as one
+span.
+
+Sampling:
+- Head: a trace is kept from its start with probability TRACING_SAMPLE_RATIO,
+  or when the caller's `traceparent` marks it sampled.
+- Tail: with TRACING_TAIL_LATENCY_MS > 0 the other traces are recorded too, and
+  kept only when the root took at least that long or a span failed. With 0,
+  nothing is recorded for traces head sampling drops.
+A trace keeps at most TRACING_MAX_SPANS spans. Finished traces are exported in
+batches by a background task; when its queue is full they are dropped, so
+export never blocks a request.
+
+With TRACING_ENABLED=false (the default) nothing is installed: service
+classes, engines and httpx clients stay unwrapped.
+"""
+import asyncio
+import functools
+import inspect
+import json
+import logging
+import os
+import random
+import re
+import time
+from collections import deque
+from contextlib import contextmanager
+from contextvars import ContextVar
+from typing import Dict, Iterator, List, Optional, Union
+
+import httpx
+from sqlalchemy import event
+from sqlalchemy.engine import Engine
+
+from services import metrics
+
+logger = logging.getLogger(__name__)
+
+TRACING_ENABLED = os.getenv("TRACING_ENABLED", "false").lower() in ("1", "true", "yes")
+TRACING_SAMPLE_RATIO = float(os.getenv("TRACING_SAMPLE_RATIO", "0.01"))
+TRACING_TAIL_LATENCY_MS = float(os.getenv("TRACING_TAIL_LATENCY_MS", "500"))
+TRACING_MAX_SPANS = int(os.getenv("TRACING_MAX_SPANS", "1000"))
+TRACING_OTLP_ENDPOINT = os.getenv("TRACING_OTLP_ENDPOINT")
+TRACING_FILE = os.getenv("TRACING_FILE")
+TRACING_SERVICE_NAME = os.getenv("TRACING_SERVICE_NAME", "greenhouse-backend")
+TRACING_EXPORT_INTERVAL_MS = int(os.getenv("TRACING_EXPORT_INTERVAL_MS", "1000"))
+# Finished traces waiting for export
+TRACING_QUEUE_SIZE = int(os.getenv("TRACING_QUEUE_SIZE", "1000"))
+
+# OTLP span kinds
+INTERNAL, SERVER, CLIENT, CONSUMER = 1, 2, 3, 5
+_STATUS_ERROR = 2
+
+_EXPORT_BATCH = 256
+_MAX_STATEMENT = 2048
+_TRACEPARENT = re.compile(r"^00-([0-9a-f]{32})-([0-9a-f]{16})-([0-9a-f]{2})$")
+# Service method arguments recorded as span attributes, directly or as attributes of a reading
+_ID_ARGUMENTS = ("gateway_id", "node_id")
+_CARRIER_ARGUMENTS = ("reading",)
+_SQL_SPANS = "trace_sql_spans"
+
+
+class _Trace:
+    __slots__ = ("trace_id", "sampled", "spans", "closed", "failed", "dropped_spans")
+
+    def __init__(self, trace_id: str, sampled: bool):
+        self.trace_id = trace_id
+        self.sampled = sampled
+        self.spans: List["Span"] = []
+        self.closed = False
+        self.failed = False
+        self.dropped_spans = 0
+
+
+class Span:
+    """One timed operation within a trace."""
+    __slots__ = ("trace", "span_id", "parent_id", "name", "kind", "attributes", "start_ns", "end_ns", "error", "_started")
+
+    def __init__(self, trace: _Trace, parent_id: Optional[str], name: str, kind: int, attributes: Dict):
+        self.trace = trace
+        self.span_id = f"{random.getrandbits(64):016x}"
+        self.parent_id = parent_id
+        self.name = name
+        self.kind = kind
+        self.attributes = attributes
+        self.start_ns = time.time_ns()
+        self.end_ns = 0
+        self.error: Optional[str] = None
+        self._started = time.perf_counter_ns()
+
+    def set(self, key: str, value):
+        """Set an attribute (None is ignored)."""
+        if value is not None:
+            self.attributes[key] = value
+
+    def fail(self, error: Union[BaseException, str]):
+        """Mark the span, and so its trace, as failed."""
+        self.error = error if isinstance(error, str) else f"{type(error).__name__}: {error}"
+        self.trace.failed = True
+
+    def end(self):
+        self.end_ns = self.start_ns + (time.perf_counter_ns() - self._started)
+        trace = self.trace
+        if trace.closed:
+            return
+        if len(trace.spans) < TRACING_MAX_SPANS:
+            trace.spans.append(self)
+        else:
+            trace.dropped_spans += 1
+
+    @property
+    def traceparent(self) -> str:
+        """W3C traceparent header naming this span as the parent."""
+        return f"00-{self.trace.trace_id}-{self.span_id}-{'01' if self.trace.sampled else '00'}"
+
+
+_current: ContextVar[Optional[Span]] = ContextVar("trace_span", default=None)
+
+
+def current_span() -> Optional[Span]:
+    """The innermost recording span of this context, if any."""
+    return _current.get()
+
+
+def _child(name: str, kind: int, attributes: Dict) -> Optional[Span]:
+    parent = _current.get()
+    if parent is None or parent.trace.closed:
+        return None
+    return Span(parent.trace, parent.span_id, name, kind, attributes)
+
+
+@contextmanager
+def trace(name: str, kind: int = SERVER, traceparent: Optional[str] = None, **attributes) -> Iterator[Optional[Span]]:
+    """
+    Root span of a new trace (a child span when already inside one).
+
+    Yields None when tracing is disabled or the trace is not recorded.
+
+    Args:
+        name: Span name (rename it once the route template is known)
+        kind: SERVER for requests, CONSUMER for message batches, INTERNAL for jobs
+        traceparent: Incoming W3C traceparent header to continue
+        **attributes: Span attributes (None values are skipped)
+    """
+    if not TRACING_ENABLED:
+        yield None
+        return
+    attributes = {key: value for key, value in attributes.items() if value is not None}
+    if _current.get() is not None:
+        with span(name, kind, **attributes) as child:
+            yield child
+        return
+
+    match = _TRACEPARENT.match(traceparent) if traceparent else None
+    if match:
+        trace_id, parent_id, sampled = match.group(1), match.group(2), int(match.group(3), 16) & 1 == 1
+    else:
+        trace_id, parent_id, sampled = f"{random.getrandbits(128):032x}", None, random.random() < TRACING_SAMPLE_RATIO
+    if not sampled and TRACING_TAIL_LATENCY_MS <= 0:
+        metrics.TRACES_DISCARDED.inc()
+        yield None
+        return
+
+    current = _Trace(trace_id, sampled)
+    root = Span(current, parent_id, name, kind, attributes)
+    token = _current.set(root)
+    try:
+        yield root
+    except BaseException as e:
+        root.fail(e)
+        raise
+    finally:
+        _current.reset(token)
+        root.end()
+        _finish(current, root)
+
+
+@contextmanager
+def span(name: str, kind: int = INTERNAL, **attributes) -> Iterator[Optional[Span]]:
+    """Child span of the current span; yields None outside a recorded trace."""
+    child = _child(name, kind, attributes)
+    if child is None:
+        yield None
+        return
+    token = _current.set(child)
+    try:
+        yield child
+    except BaseException as e:
+        child.fail(e)
+        raise
+    finally:
+        _current.reset(token)
+        child.end()
+
+
+def _finish(current: _Trace, root: Span):
+    current.closed = True
+    if current.dropped_spans:
+        root.set("tracing.dropped_spans", current.dropped_spans)
+    slow = (root.end_ns - root.start_ns) / 1e6 >= TRACING_TAIL_LATENCY_MS
+    if current.sampled or (TRACING_TAIL_LATENCY_MS > 0 and (slow or current.failed)):
+        trace_exporter.offer(current)
+    else:
+        metrics.TRACES_DISCARDED.inc()
+
+
+# --- Service methods ---------------------------------------------------------
+
+def _argument_reader(func):
+    """Build args, kwargs -> {gateway_id, node_id} for a function's signature."""
+    try:
+        parameters = list(inspect.signature(func).parameters)
+    except (TypeError, ValueError):
+        return None
+    direct = [(name, parameters.index(name)) for name in _ID_ARGUMENTS if name in parameters]
+    carriers = [(name, parameters.index(name)) for name in _CARRIER_ARGUMENTS if name in parameters]
+    if not direct and not carriers:
+        return None
+
+    def read(args, kwargs) -> Dict:
+        attributes = {}
+        for name, position in carriers:
+            carrier = kwargs.get(name) if name in kwargs else args[position] if position < len(args) else None
+            for key in _ID_ARGUMENTS:
+                value = getattr(carrier, key, None)
+                if isinstance(value, (str, int)):
+                    attributes[key] = value
+        for name, position in direct:
+            value = kwargs.get(name) if name in kwargs else args[position] if position < len(args) else None
+            if isinstance(value, (str, int)):
+                attributes[name] = value
+        return attributes
+
+    return read
+
+
+def _wrap(func, name: str):
+    read = _argument_reader(func)
+
+    if inspect.iscoroutinefunction(func):
+        @functools.wraps(func)
+        async def async_wrapper(*args, **kwargs):
+            if _current.get() is None:
+                return await func(*args, **kwargs)
+            child = _child(name, INTERNAL, read(args, kwargs) if read else {})
+            if child is None:
+                return await func(*args, **kwargs)
+            token = _current.set(child)
+            try:
+                return await func(*args, **kwargs)
+            except BaseException as e:
+                child.fail(e)
+                raise
+            finally:
+                _current.reset(token)
+                child.end()
+        return async_wrapper
+
+    @functools.wraps(func)
+    def wrapper(*args, **kwargs):
+        if _current.get() is None:
+            return func(*args, **kwargs)
+        child = _child(name, INTERNAL, read(args, kwargs) if read else {})
+        if child is None:
+            return func(*args, **kwargs)
+        token = _current.set(child)
+        try:
+            return func(*args, **kwargs)
+        except BaseException as e:
+            child.fail(e)
+            raise
+        finally:
+            _current.reset(token)
+            child.end()
+    return wrapper
+
+
+def traced(cls):
+    """Class decorator: a span named `Class.method` around every public method."""
+    if not TRACING_ENABLED:
+        return cls
+    for attr, member in list(vars(cls).items()):
+        if attr.startswith("_"):
+            continue
+        name = f"{cls.__name__}.{attr}"
+        if isinstance(member, staticmethod):
+            setattr(cls, attr, staticmethod(_wrap(member.__func__, name)))
+        elif isinstance(member, classmethod):
+            setattr(cls, attr, classmethod(_wrap(member.__func__, name)))
+        elif inspect.isfunction(member) and not inspect.isgeneratorfunction(member):
+            setattr(cls, attr, _wrap(member, name))
+    return cls
+
+
+# --- SQL statements ----------------------------------------------------------
+
+def _before_cursor_execute(conn, cursor, statement, parameters, context, executemany):
+    operation = statement.split(None, 1)[0].upper() if statement.strip() else "SQL"
+    child = _child(operation, CLIENT, {
+        "db.system": conn.dialect.name,
+        "db.operation": operation,
+        "db.statement": statement[:_MAX_STATEMENT],
+    })
+    if child is not None:
+        if executemany:
+            child.set("db.executemany", True)
+        conn.info.setdefault(_SQL_SPANS, []).append(child)
+
+
+def _after_cursor_execute(conn, cursor, statement, parameters, context, executemany):
+    spans = conn.info.get(_SQL_SPANS)
+    if spans:
+        child = spans.pop()
+        rowcount = getattr(cursor, "rowcount", -1)
+        if rowcount is not None and rowcount >= 0:
+            child.set("db.rowcount", rowcount)
+        child.end()
+
+
+def _handle_error(context):
+    conn = context.connection
+    spans = conn.info.get(_SQL_SPANS) if conn is not None else None
+    if spans:
+        child = spans.pop()
+        child.fail(context.original_exception)
+        child.end()
+
+
+def instrument_engine(engine: Engine):
+    """Record a span for every SQL statement executed through an engine."""
+    if not TRACING_ENABLED or event.contains(engine, "before_cursor_execute", _before_cursor_execute):
+        return
+    event.listen(engine, "before_cursor_execute", _before_cursor_execute)
+    event.listen(engine, "after_cursor_execute", _after_cursor_execute)
+    event.listen(engine, "handle_error", _handle_error)
+
+
+# --- Outbound HTTP -----------------------------------------------------------
+
+class TracedTransport(httpx.AsyncBaseTransport):
+    """httpx transport recording a client span per request and forwarding traceparent."""
+
+    def __init__(self, transport: Optional[httpx.AsyncBaseTransport] = None):
+        self._transport = transport or httpx.AsyncHTTPTransport()
+
+    async def handle_async_request(self, request: httpx.Request) -> httpx.Response:
+        url = request.url
+        child = _child(f"HTTP {request.method}", CLIENT, {
+            "http.request.method": request.method,
+            # Without the query string, which may carry tokens
+            "url.full": f"{url.scheme}://{url.netloc.decode()}{url.path}",
+            "server.address": url.host,
+        })
+        if child is None:
+            return await self._transport.handle_async_request(request)
+        request.headers["traceparent"] = child.traceparent
+        try:
+            response = await self._transport.handle_async_request(request)
+        except BaseException as e:
+            child.fail(e)
+            child.end()
+            raise
+        child.set("http.response.status_code", response.status_code)
+        if response.status_code >= 500:
+            child.fail(f"HTTP {response.status_code}")
+        child.end()
+        return response
+
+    async def aclose(self):
+        await self._transport.aclose()
+
+
+def http_transport() -> Optional[httpx.AsyncBaseTransport]:
+    """Transport for outbound httpx clients: traced when tracing is enabled, httpx's default otherwise."""
+    return TracedTransport() if TRACING_ENABLED else None
+
+
+# --- Export ------------------------------------------------------------------
+
+def _attribute(key: str, value) -> Dict:
+    if isinstance(value, bool):
+        encoded = {"boolValue": value}
+    elif isinstance(value, int):
+        encoded = {"intValue": str(value)}
+    elif isinstance(value, float):
+        encoded = {"doubleValue": value}
+    else:
+        encoded = {"stringValue": str(value)}
+    return {"key": key, "value": encoded}
+
+
+def _encode(traces: List[_Trace]) -> bytes:
+    """One OTLP/JSON ExportTraceServiceRequest for a batch of traces."""
+    spans = []
+    for current in traces:
+        for item in current.spans:
+            encoded = {
+                "traceId": current.trace_id,
+                "spanId": item.span_id,
+                "name": item.name,
+                "kind": item.kind,
+                "startTimeUnixNano": str(item.start_ns),
+                "endTimeUnixNano": str(item.end_ns),
+                "attributes": [_attribute(key, value) for key, value in item.attributes.items()],
+            }
+            if item.parent_id:
+                encoded["parentSpanId"] = item.parent_id
+            if item.error:
+                encoded["status"] = {"code": _STATUS_ERROR, "message": item.error}
+            spans.append(encoded)
+    request = {"resourceSpans": [{
+        "resource": {"attributes": [_attribute("service.name", TRACING_SERVICE_NAME)]},
+        "scopeSpans": [{"scope": {"name": __name__}, "spans": spans}],
+    }]}
+    return json.dumps(request, separators=(",", ":")).encode()
+
+
+class TraceExporter:
+    """Batches finished traces to the OTLP endpoint and/or file on the event loop."""
+
+    def __init__(self):
+        self._queue: deque = deque()
+        self._task: Optional[asyncio.Task] = None
+        self._client: Optional[httpx.AsyncClient] = None
+
+    @property
+    def queue_depth(self) -> int:
+        return len(self._queue)
+
+    def offer(self, current: _Trace):
+        """Queue a finished trace. Safe to call from any thread; drops it when the queue is full."""
+        if self._task is None or len(self._queue) >= TRACING_QUEUE_SIZE:
+            metrics.TRACES_DROPPED.inc()
+            return
+        self._queue.append(current)
+
+    async def start(self):
+        """Start the export loop. Must be called from the event loop."""
+        if not (TRACING_OTLP_ENDPOINT or TRACING_FILE):
+            logger.warning("TRACING_ENABLED is set without TRACING_OTLP_ENDPOINT or TRACING_FILE; traces are dropped")
+            return
+        if TRACING_OTLP_ENDPOINT:
+            self._client = httpx.AsyncClient(timeout=httpx.Timeout(5.0))
+        self._task = asyncio.create_task(self._run())
+        logger.info(
+            f"Tracing to {TRACING_OTLP_ENDPOINT or TRACING_FILE} (head sampling {TRACING_SAMPLE_RATIO:g}, "
+            f"tail latency {TRACING_TAIL_LATENCY_MS:g} ms)"
+        )
+
+    async def stop(self):
+        """Export what is queued, then stop."""
+        if self._task is None:
+            return
+        self._task.cancel()
+        await asyncio.gather(self._task, return_exceptions=True)
+        self._task = None
+        await self.flush()
+        if self._client is not None:
+            await self._client.aclose()
+            self._client = None
+
+    async def _run(self):
+        while True:
+            await asyncio.sleep(TRACING_EXPORT_INTERVAL_MS / 1000.0)
+            try:
+                await self.flush()
+            except Exception as e:
+                logger.error(f"Trace export failed: {str(e)}", exc_info=True)
+
+    async def flush(self):
+        while self._queue:
+            batch = [self._queue.popleft() for _ in range(min(_EXPORT_BATCH, len(self._queue)))]
+            body = await asyncio.to_thread(_encode, batch)
+            delivered = True
+            if TRACING_FILE:
+                await asyncio.to_thread(self._append, body)
+            if self._client is not None:
+                delivered = await self._post(body)
+            if delivered:
+                metrics.TRACES_EXPORTED.inc(len(batch))
+            else:
+                metrics.TRACES_DROPPED.inc(len(batch))
+
+    @staticmethod
+    def _append(body: bytes):
+        with open(TRACING_FILE, "ab") as f:
+            f.write(body + b"\n")
+
+    async def _post(self, body: bytes) -> bool:
+        try:
+            response = await self._client.post(
+                TRACING_OTLP_ENDPOINT, content=body, headers={"Content-Type": "application/json"}
+            )
+        except httpx.HTTPError as e:
+            logger.warning(f"Trace collector unreachable: {type(e).__name__}")
+            return False
+        if response.status_code >= 300:
+            logger.warning(f"Trace collector rejected a batch: HTTP {response.status_code}")
+            return False
+        return True
+
+
+# Global instance
+trace_exporter = TraceExporter()
+
+
+async def start_tracing():
+    """Start exporting traces if TRACING_ENABLED is set."""
+    if TRACING_ENABLED:
+        await trace_exporter.start()
+
+
+async def stop_tracing():
+    """Export queued traces and stop."""
+    await trace_exporter.stop()
@@ -14,8 +14,11 @@ from sqlalchemy import and_
 from typing import List, Dict, Optional, Tuple
 from datetime import datetime, timedelta
 from enum import Enum
+from operator import attrgetter
 from models.database import SensorReading
-import statistics
+from services import kernels, reading_store, tracing
+from services.metrics import ANALYZER_SECONDS, timed
+from services.rule_engine import rule_engine
 
 
 class RiskLevel(str, Enum):
@@ -33,20 +36,14 @@ class InsightType(str, Enum):
     SENSOR_FAILURE = "sensor_failure"
 
 
+@tracing.traced
 class TrendInsightService:
     """Service for analyzing sensor trends and generating AI insights."""
     
-    # Thresholds for analysis
-    SOIL_MOISTURE_DROUGHT_LOW = 30.0  # % - below this is drought risk
-    SOIL_MOISTURE_DROUGHT_CRITICAL = 20.0  # % - critical drought level
-    SOIL_MOISTURE_OVERWATERING_HIGH = 80.0  # % - above this is overwatering risk
-    SOIL_MOISTURE_OVERWATERING_CRITICAL = 90.0  # % - critical overwatering
-    
-    TEMP_MIN_OPTIMAL = 18.0  # °C - minimum optimal temperature
-    TEMP_MAX_OPTIMAL = 32.0  # °C - maximum optimal temperature
-    TEMP_STRESS_HIGH = 35.0  # °C - high temperature stress
-    TEMP_STRESS_CRITICAL = 38.0  # °C - critical temperature
-    TEMP_STRESS_LOW = 10.0  # °C - low temperature stress
+    # Thresholds for analysis. Soil moisture and temperature levels are the
+    # named limits of the rule config: soil_moisture critical_low/dry (drought),
+    # wet/critical_high (overwatering); temperature critical_low/optimal_min/
+    # optimal_max/critical_high/severe_high (stress)
     TEMP_RATE_RISKY = 2.0  # °C per hour - rapid temperature change
     
     SENSOR_FAILURE_MISSING_DATA_MINUTES = 15  # No data for this long suggests failure
@@ -77,9 +74,14 @@ class TrendInsightService:
         if node_id:
             query = query.filter(SensorReading.node_id == node_id)
         
-        return query.order_by(SensorReading.timestamp).all()
+        readings = query.order_by(SensorReading.timestamp).all()
+        compacted = reading_store.block_rows(db, since=cutoff_time, node_ids=node_id)
+        return reading_store.merge_by_time(
+            [reading_store.to_reading(row) for row in compacted], readings, attrgetter("timestamp")
+        )
     
     @staticmethod
+    @timed(ANALYZER_SECONDS.labels("drought_risk"))
     def detect_drought_risk(readings: List[SensorReading]) -> Optional[Dict]:
         """Detect drought risk from soil moisture trends.
         
@@ -115,15 +117,16 @@ class TrendInsightService:
         # Check for drought conditions
         risk_level = RiskLevel.LOW
         explanation_parts = []
+        limits = rule_engine.limits["soil_moisture"]
         
         # Critical drought: very low moisture
-        if latest_moisture <= TrendInsightService.SOIL_MOISTURE_DROUGHT_CRITICAL:
+        if latest_moisture <= limits["critical_low"]:
             risk_level = RiskLevel.HIGH
             explanation_parts.append(
-                f"Critical soil moisture level: {latest_moisture:.1f}% (critical threshold: {TrendInsightService.SOIL_MOISTURE_DROUGHT_CRITICAL}%)"
+                f"Critical soil moisture level: {latest_moisture:.1f}% (critical threshold: {limits['critical_low']}%)"
             )
         # High drought risk: low moisture or rapid decline
-        elif latest_moisture <= TrendInsightService.SOIL_MOISTURE_DROUGHT_LOW:
+        elif latest_moisture <= limits["dry"]:
             if drop_rate > 3.0:  # Rapid decline
                 risk_level = RiskLevel.HIGH
                 explanation_parts.append(
@@ -132,10 +135,10 @@ class TrendInsightService:
             else:
                 risk_level = RiskLevel.MEDIUM
                 explanation_parts.append(
-                    f"Low soil moisture detected: {latest_moisture:.1f}% (threshold: {TrendInsightService.SOIL_MOISTURE_DROUGHT_LOW}%)"
+                    f"Low soil moisture detected: {latest_moisture:.1f}% (threshold: {limits['dry']}%)"
                 )
         # Moderate risk: declining trend even if above threshold
-        elif drop_rate > 5.0 and latest_moisture < 40.0:
+        elif drop_rate > 5.0 and latest_moisture < limits["optimal_min"]:
             risk_level = RiskLevel.MEDIUM
             explanation_parts.append(
                 f"Soil moisture declining rapidly ({drop_rate:.1f}%/hour), currently at {latest_moisture:.1f}%"
@@ -171,6 +174,7 @@ class TrendInsightService:
         }
     
     @staticmethod
+    @timed(ANALYZER_SECONDS.labels("overwatering_risk"))
     def detect_overwatering_risk(readings: List[SensorReading]) -> Optional[Dict]:
         """Detect overwatering risk from soil moisture trends.
         
@@ -193,7 +197,7 @@ class TrendInsightService:
             return None
         
         latest_moisture = soil_values[-1]
-        avg_moisture = statistics.mean(soil_values)
+        avg_moisture = kernels.summary(soil_values).mean
         
         # Calculate change rate
         time_span_hours = (readings[-1].timestamp - readings[0].timestamp).total_seconds() / 3600
@@ -204,13 +208,14 @@ class TrendInsightService:
         
         # Check for overwatering conditions
         risk_level = RiskLevel.LOW
+        limits = rule_engine.limits["soil_moisture"]
         
         # Critical overwatering: very high moisture
-        if latest_moisture >= TrendInsightService.SOIL_MOISTURE_OVERWATERING_CRITICAL:
+        if latest_moisture >= limits["critical_high"]:
             risk_level = RiskLevel.HIGH
             explanation = (
                 f"Critical overwatering detected: soil moisture at {latest_moisture:.1f}% "
-                f"(critical threshold: {TrendInsightService.SOIL_MOISTURE_OVERWATERING_CRITICAL}%). "
+                f"(critical threshold: {limits['critical_high']}%). "
                 f"Poor drainage may cause root rot."
             )
             recommended_action = (
@@ -219,7 +224,7 @@ class TrendInsightService:
                 "Monitor for root rot symptoms."
             )
         # High overwatering risk: high moisture with poor drainage
-        elif latest_moisture >= TrendInsightService.SOIL_MOISTURE_OVERWATERING_HIGH:
+        elif latest_moisture >= limits["wet"]:
             if change_rate > -0.5:  # Moisture not decreasing (poor drainage)
                 risk_level = RiskLevel.HIGH
                 explanation = (
@@ -234,7 +239,7 @@ class TrendInsightService:
                 risk_level = RiskLevel.MEDIUM
                 explanation = (
                     f"High soil moisture detected: {latest_moisture:.1f}% "
-                    f"(threshold: {TrendInsightService.SOIL_MOISTURE_OVERWATERING_HIGH}%)"
+                    f"(threshold: {limits['wet']}%)"
                 )
                 recommended_action = (
                     "Reduce irrigation frequency by 30-50%. Monitor soil moisture levels. "
@@ -265,6 +270,7 @@ class TrendInsightService:
         }
     
     @staticmethod
+    @timed(ANALYZER_SECONDS.labels("temperature_stress"))
     def detect_temperature_stress(readings: List[SensorReading]) -> Optional[Dict]:
         """Detect temperature stress from temperature trends.
         
@@ -288,9 +294,8 @@ class TrendInsightService:
             return None
         
         latest_temp = temp_values[-1]
-        max_temp = max(temp_values)
-        min_temp = min(temp_values)
-        avg_temp = statistics.mean(temp_values)
+        stats = kernels.summary(temp_values)
+        max_temp, min_temp, avg_temp = stats.max, stats.min, stats.mean
         
         # Calculate temperature change rate
         time_span_hours = (readings[-1].timestamp - readings[0].timestamp).total_seconds() / 3600
@@ -301,19 +306,20 @@ class TrendInsightService:
         
         risk_level = RiskLevel.LOW
         explanation_parts = []
+        limits = rule_engine.limits["temperature"]
         
         # Critical high temperature
-        if latest_temp >= TrendInsightService.TEMP_STRESS_CRITICAL:
+        if latest_temp >= limits["severe_high"]:
             risk_level = RiskLevel.HIGH
             explanation_parts.append(
-                f"Critical high temperature: {latest_temp:.1f}°C (critical threshold: {TrendInsightService.TEMP_STRESS_CRITICAL}°C)"
+                f"Critical high temperature: {latest_temp:.1f}°C (critical threshold: {limits['severe_high']}°C)"
             )
             recommended_action = (
                 "Immediate cooling required. Activate emergency ventilation and cooling systems. "
                 "Consider shading. Monitor plants for heat stress symptoms."
             )
         # High temperature stress
-        elif latest_temp >= TrendInsightService.TEMP_STRESS_HIGH:
+        elif latest_temp >= limits["critical_high"]:
             if temp_rate > TrendInsightService.TEMP_RATE_RISKY:
                 risk_level = RiskLevel.HIGH
                 explanation_parts.append(
@@ -326,15 +332,15 @@ class TrendInsightService:
             else:
                 risk_level = RiskLevel.MEDIUM
                 explanation_parts.append(
-                    f"High temperature detected: {latest_temp:.1f}°C (threshold: {TrendInsightService.TEMP_STRESS_HIGH}°C)"
+                    f"High temperature detected: {latest_temp:.1f}°C (threshold: {limits['critical_high']}°C)"
                 )
                 recommended_action = (
                     "Increase ventilation. Activate cooling systems if available. "
                     "Start ventilation earlier and increase frequency."
                 )
         # Above optimal but not critical
-        elif latest_temp > TrendInsightService.TEMP_MAX_OPTIMAL:
-            if avg_temp > TrendInsightService.TEMP_MAX_OPTIMAL + 2:
+        elif latest_temp > limits["optimal_max"]:
+            if avg_temp > limits["optimal_max"] + 2:
                 risk_level = RiskLevel.MEDIUM
                 explanation_parts.append(
                     f"Sustained above-optimal temperature (avg: {avg_temp:.1f}°C, current: {latest_temp:.1f}°C)"
@@ -346,22 +352,22 @@ class TrendInsightService:
             else:
                 risk_level = RiskLevel.LOW
                 explanation_parts.append(
-                    f"Temperature slightly above optimal range (current: {latest_temp:.1f}°C, optimal max: {TrendInsightService.TEMP_MAX_OPTIMAL}°C)"
+                    f"Temperature slightly above optimal range (current: {latest_temp:.1f}°C, optimal max: {limits['optimal_max']}°C)"
                 )
                 recommended_action = "Increase ventilation. Monitor temperature trends."
         # Low temperature stress
-        elif latest_temp <= TrendInsightService.TEMP_STRESS_LOW:
+        elif latest_temp <= limits["critical_low"]:
             risk_level = RiskLevel.HIGH
             explanation_parts.append(
-                f"Critical low temperature: {latest_temp:.1f}°C (threshold: {TrendInsightService.TEMP_STRESS_LOW}°C)"
+                f"Critical low temperature: {latest_temp:.1f}°C (threshold: {limits['critical_low']}°C)"
             )
             recommended_action = (
                 "Immediate heating required. Check heating system. Protect plants from frost. "
                 "Monitor for cold damage symptoms."
             )
         # Below optimal
-        elif latest_temp < TrendInsightService.TEMP_MIN_OPTIMAL:
-            if avg_temp < TrendInsightService.TEMP_MIN_OPTIMAL - 2:
+        elif latest_temp < limits["optimal_min"]:
+            if avg_temp < limits["optimal_min"] - 2:
                 risk_level = RiskLevel.MEDIUM
                 explanation_parts.append(
                     f"Sustained below-optimal temperature (avg: {avg_temp:.1f}°C, current: {latest_temp:.1f}°C)"
@@ -373,7 +379,7 @@ class TrendInsightService:
             else:
                 risk_level = RiskLevel.LOW
                 explanation_parts.append(
-                    f"Temperature slightly below optimal range (current: {latest_temp:.1f}°C, optimal min: {TrendInsightService.TEMP_MIN_OPTIMAL}°C)"
+                    f"Temperature slightly below optimal range (current: {latest_temp:.1f}°C, optimal min: {limits['optimal_min']}°C)"
                 )
                 recommended_action = "Slight heating increase recommended. Monitor temperature."
         # Rapid temperature change
@@ -409,6 +415,7 @@ class TrendInsightService:
         }
     
     @staticmethod
+    @timed(ANALYZER_SECONDS.labels("sensor_failure"))
     def detect_sensor_failure(readings: List[SensorReading], node_id: Optional[str] = None) -> Optional[Dict]:
         """Detect sensor failure patterns.
         
@@ -469,7 +476,7 @@ class TrendInsightService:
             
             # Check temperature variation
             if len(temp_values) >= 5:
-                temp_std = statistics.stdev(temp_values) if len(temp_values) > 1 else 0
+                temp_std = kernels.summary(temp_values).stdev
                 if temp_std < TrendInsightService.SENSOR_FAILURE_CONSTANT_VALUES_THRESHOLD:
                     return {
                         "type": InsightType.SENSOR_FAILURE,
@@ -488,7 +495,7 @@ class TrendInsightService:
             
             # Check soil moisture variation
             if len(soil_values) >= 5:
-                soil_std = statistics.stdev(soil_values) if len(soil_values) > 1 else 0
+                soil_std = kernels.summary(soil_values).stdev
                 if soil_std < TrendInsightService.SENSOR_FAILURE_CONSTANT_VALUES_THRESHOLD:
                     return {
                         "type": InsightType.SENSOR_FAILURE,
@@ -588,6 +595,20 @@ class TrendInsightService:
         if sensor_failure_insight:
             insights.append(sensor_failure_insight)
         
+        overall_risk_level, summary = TrendInsightService.summarize(insights)
+        
+        return {
+            "insights": insights,
+            "overall_risk_level": overall_risk_level,
+            "summary": summary,
+            "analysis_period_minutes": minutes,
+            "readings_analyzed": len(readings),
+            "node_id": node_id
+        }
+
+    @staticmethod
+    def summarize(insights: List[Dict]) -> Tuple[str, str]:
+        """Overall risk level and human-readable summary of a list of insights."""
         # Determine overall risk level
         overall_risk_level = RiskLevel.LOW.value
         if any(i["risk_level"] == RiskLevel.HIGH.value for i in insights):
@@ -608,12 +629,5 @@ class TrendInsightService:
                 summary_parts.append(f"- {insight['type']}: {insight['explanation']}")
             summary = " ".join(summary_parts)
         
-        return {
-            "insights": insights,
-            "overall_risk_level": overall_risk_level,
-            "summary": summary,
-            "analysis_period_minutes": minutes,
-            "readings_analyzed": len(readings),
-            "node_id": node_id
-        }
+        return overall_risk_level, summary
 
@@ -0,0 +1,296 @@
+"""UDP datagram ingest listener for constrained gateways.
+
+LoRa gateways on metered or high-latency links cannot afford a TCP handshake
+per upload. They can instead send the binary frame from models/wire_format.py
+as a single UDP datagram holding one or more readings.
+
+Datagrams are unreliable, so the frame header carries a per-gateway sequence
+number. When FLAG_ACK_REQUESTED is set the listener replies with an ack naming
+that sequence number once the readings are stored. A gateway that does not
+receive the ack retransmits. The listener remembers the last few frames of
+each gateway (sequence number and a hash of the datagram): a datagram matching
+one of them is a retransmit, answered with the cached ack if the frame was
+stored, ignored if it is still queued (its ack follows), and stored otherwise.
+Any other datagram is a new frame, even if its sequence number is not above
+the last one: a gateway that reboots starts its sequence again, and that is
+logged as a sequence reset. Between new frames, gaps in the sequence are
+logged and counted so lost datagrams are visible.
+
+Decoded frames wait in a bounded queue for a fixed set of workers, so a flood
+of datagrams cannot pile up tasks and threads; when the queue is full further
+datagrams are dropped (and counted), and their gateways retransmit.
+
+Readings go through the same IngestService pipeline as the HTTP and MQTT
+transports. Enabled by setting UDP_INGEST_PORT.
+"""
+import asyncio
+import logging
+import os
+import socket
+from collections import OrderedDict
+from typing import Dict, List, Optional, Set, Tuple
+
+from models.database import SessionLocal
+from models.wire_format import (
+    Ack,
+    WireFormatError,
+    decode_ack,
+    decode_frame,
+    encode_ack,
+    ACK_ERROR,
+    ACK_OK,
+    ACK_PARTIAL,
+    ACK_REJECTED,
+    ACK_THROTTLED,
+    FLAG_ACK_REQUESTED
+)
+from services.ingest_service import IngestService, IngestValidationError
+from services.rate_limiter import RateLimitExceeded
+from services import metrics, tracing
+
+logger = logging.getLogger(__name__)
+
+UDP_INGEST_HOST = os.getenv("UDP_INGEST_HOST", "0.0.0.0")
+UDP_INGEST_PORT = os.getenv("UDP_INGEST_PORT")
+# Decoded frames waiting for a worker; datagrams arriving when it is full are dropped
+UDP_QUEUE_SIZE = int(os.getenv("UDP_QUEUE_SIZE", "256"))
+# Frames stored concurrently (each worker holds one thread and one DB session)
+UDP_WORKERS = int(os.getenv("UDP_WORKERS", "4"))
+# Recent frames remembered per gateway to recognise retransmits and answer them with the cached ack
+UDP_ACK_CACHE_SIZE = int(os.getenv("UDP_ACK_CACHE_SIZE", "16"))
+
+# Sequence numbers are u32; a forward jump larger than this is treated as a gateway restart
+SEQ_RESET_THRESHOLD = 1 << 16
+
+
+class UdpIngestProtocol(asyncio.DatagramProtocol):
+    """Receives binary frames, stores them and replies with acks."""
+
+    def __init__(self):
+        self.transport: Optional[asyncio.DatagramTransport] = None
+        self._last_seq: Dict[str, int] = {}
+        self._queue: asyncio.Queue = asyncio.Queue(maxsize=UDP_QUEUE_SIZE)
+        self._workers: List[asyncio.Task] = []
+        self._overloaded = False
+        # gateway_id -> seq -> (hash of the datagram, encoded ack or None until acked)
+        self._recent: "Dict[str, OrderedDict[int, Tuple[int, Optional[bytes]]]]" = {}
+        self._in_flight: Set[Tuple[str, int]] = set()
+        self.stats = {
+            "datagrams": 0,
+            "readings_stored": 0,
+            "duplicates": 0,
+            "rejected": 0,
+            "throttled": 0,
+            "malformed": 0,
+            "frames_lost": 0,
+            "retransmits": 0,
+            "acks_replayed": 0,
+            "dropped": 0,
+        }
+
+    @property
+    def queue_depth(self) -> int:
+        return self._queue.qsize()
+
+    def connection_made(self, transport):
+        self.transport = transport
+        loop = asyncio.get_running_loop()
+        self._workers = [loop.create_task(self._worker()) for _ in range(UDP_WORKERS)]
+
+    def connection_lost(self, exc: Optional[Exception]):
+        for worker in self._workers:
+            worker.cancel()
+        self._workers = []
+
+    def datagram_received(self, data: bytes, addr: Tuple[str, int]):
+        self.stats["datagrams"] += 1
+        try:
+            with metrics.INGEST_PARSE.time():
+                frame = decode_frame(data)
+        except WireFormatError as e:
+            self.stats["malformed"] += 1
+            metrics.UDP_MALFORMED_TOTAL.inc()
+            logger.warning(f"Malformed UDP datagram from {addr[0]}: {str(e)}")
+            return
+
+        key = (frame.gateway_id, frame.seq)
+        digest = hash(data)
+        recent = self._recent.setdefault(frame.gateway_id, OrderedDict())
+        seen = recent.get(frame.seq)
+        if seen is not None and seen[0] == digest:
+            self.stats["retransmits"] += 1
+            if key in self._in_flight:
+                return
+            if seen[1] is not None:
+                self.stats["acks_replayed"] += 1
+                if frame.flags & FLAG_ACK_REQUESTED and self.transport:
+                    self.transport.sendto(seen[1], addr)
+                return
+            # Not stored yet (dropped, throttled or failed): try again
+        else:
+            # A restarted gateway may reuse the sequence number for a different frame
+            self._track_sequence(frame.gateway_id, frame.seq)
+            recent[frame.seq] = (digest, None)
+            recent.move_to_end(frame.seq)
+            while len(recent) > UDP_ACK_CACHE_SIZE:
+                recent.popitem(last=False)
+
+        try:
+            self._queue.put_nowait((frame, addr, digest))
+        except asyncio.QueueFull:
+            self.stats["dropped"] += 1
+            metrics.UDP_QUEUE_FULL.inc()
+            if not self._overloaded:
+                self._overloaded = True
+                logger.warning(f"UDP ingest queue full ({UDP_QUEUE_SIZE} frames); dropping datagrams")
+            return
+        if self._overloaded:
+            self._overloaded = False
+            logger.info("UDP ingest queue has room again")
+        self._in_flight.add(key)
+
+    def _track_sequence(self, gateway_id: str, seq: int):
+        """Detect lost frames from the sequence number of a new (not retransmitted) frame."""
+        last = self._last_seq.get(gateway_id)
+        if last is not None:
+            gap = (seq - last) & 0xFFFFFFFF
+            if gap == 0 or gap > SEQ_RESET_THRESHOLD:
+                # A new frame with the same, an older or a far newer number: the gateway restarted
+                logger.info(
+                    f"UDP sequence reset (last {last}, now {seq})",
+                    extra={"gateway_id": gateway_id}
+                )
+            elif gap > 1:
+                self.stats["frames_lost"] += gap - 1
+                metrics.UDP_FRAMES_LOST_TOTAL.inc(gap - 1)
+                logger.warning(
+                    f"UDP frames lost: {gap - 1} (last seq {last}, received {seq})",
+                    extra={"gateway_id": gateway_id}
+                )
+        self._last_seq[gateway_id] = seq
+
+    async def _worker(self):
+        while True:
+            frame, addr, digest = await self._queue.get()
+            try:
+                await self._handle_frame(frame, addr, digest)
+            finally:
+                self._in_flight.discard((frame.gateway_id, frame.seq))
+                self._queue.task_done()
+
+    async def _handle_frame(self, frame, addr: Tuple[str, int], digest: int):
+        cacheable = True
+        retry_after = 0.0
+        try:
+            with tracing.trace("udp frame", kind=tracing.CONSUMER, gateway_id=frame.gateway_id, readings=len(frame.readings)):
+                accepted, duplicates, rejected = await asyncio.to_thread(self._store_frame, frame, addr[0])
+        except RateLimitExceeded as e:
+            # Nothing stored; not cached, so a retransmit after retry_after is tried again
+            status, accepted, duplicates, rejected = ACK_THROTTLED, 0, 0, 0
+            retry_after = e.retry_after
+            cacheable = False
+            self.stats["throttled"] += 1
+        except Exception as e:
+            logger.error(
+                f"Error storing UDP frame {frame.seq}: {str(e)}",
+                extra={"gateway_id": frame.gateway_id},
+                exc_info=True
+            )
+            status, accepted, duplicates, rejected = ACK_ERROR, 0, 0, 0
+            cacheable = False
+        else:
+            self.stats["readings_stored"] += accepted
+            self.stats["duplicates"] += duplicates
+            self.stats["rejected"] += rejected
+            if rejected == 0:
+                status = ACK_OK
+            elif accepted or duplicates:
+                status = ACK_PARTIAL
+            else:
+                status = ACK_REJECTED
+
+        ack = encode_ack(status, frame.seq, accepted, duplicates, rejected, retry_after)
+        recent = self._recent.get(frame.gateway_id, {})
+        # Unless a newer frame with the same sequence number replaced it meanwhile
+        if cacheable and recent.get(frame.seq, (None,))[0] == digest:
+            recent[frame.seq] = (digest, ack)
+        if frame.flags & FLAG_ACK_REQUESTED and self.transport:
+            self.transport.sendto(ack, addr)
+
+    @staticmethod
+    def _store_frame(frame, client_ip: str) -> Tuple[int, int, int]:
+        """Run every reading in the frame through the ingest pipeline (worker thread).
+
+        Raises:
+            RateLimitExceeded: If the frame's gateway is over its rate limit
+        """
+        IngestService.admit(frame.readings)
+        accepted = duplicates = rejected = 0
+        db = SessionLocal()
+        try:
+            for reading in frame.readings:
+                try:
+                    result = IngestService.ingest(db, reading, client_ip=client_ip)
+                except IngestValidationError:
+                    rejected += 1
+                    continue
+                if result.duplicate:
+                    duplicates += 1
+                else:
+                    accepted += 1
+        finally:
+            db.close()
+        return accepted, duplicates, rejected
+
+
+# Process-wide listener (created at startup when UDP_INGEST_PORT is set)
+udp_ingest: Optional[UdpIngestProtocol] = None
+
+
+async def start_udp_ingest(host: str = UDP_INGEST_HOST, port: Optional[int] = None) -> Optional[UdpIngestProtocol]:
+    """Start the UDP listener if a port is configured."""
+    global udp_ingest
+    if port is None:
+        if not UDP_INGEST_PORT:
+            return None
+        port = int(UDP_INGEST_PORT)
+
+    loop = asyncio.get_running_loop()
+    _, protocol = await loop.create_datagram_endpoint(UdpIngestProtocol, local_addr=(host, port))
+    udp_ingest = protocol
+    logger.info(f"UDP ingest listening on {host}:{port}")
+    return protocol
+
+
+def stop_udp_ingest():
+    """Close the UDP listener if it is running."""
+    global udp_ingest
+    if udp_ingest and udp_ingest.transport:
+        udp_ingest.transport.close()
+        logger.info("UDP ingest stopped")
+    udp_ingest = None
+
+
+def send_frame(host: str, port: int, frame: bytes, timeout: float = 1.0, retries: int = 3) -> Optional[Ack]:
+    """Reference client: send a frame and wait for its ack, retransmitting on timeout.
+
+    Useful for exercising the listener on localhost. Returns the ack, or None
+    if no ack arrived after all retries (or the frame did not request one).
+    """
+    seq = int.from_bytes(frame[4:8], "little")
+    with socket.socket(socket.AF_INET, socket.SOCK_DGRAM) as sock:
+        sock.settimeout(timeout)
+        for _ in range(retries + 1):
+            sock.sendto(frame, (host, port))
+            if not frame[3] & FLAG_ACK_REQUESTED:
+                return None
+            try:
+                while True:
+                    data, _ = sock.recvfrom(64)
+                    ack = decode_ack(data)
+                    # Ignore late acks for earlier transmissions of other frames
+                    if ack.seq == seq:
+                        return ack
+            except socket.timeout:
+                continue
+    return None
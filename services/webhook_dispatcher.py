@@ -0,0 +1,208 @@
+"""Asynchronous outbound webhook delivery for alert notifications.
+
+Alert transitions are enqueued from any thread (ingest runs in worker threads
+and the MQTT client thread) and delivered from the event loop, so the ingest
+path never waits on a remote endpoint.
+
+Each configured URL has its own worker and bounded queue, so one slow or dead
+endpoint does not delay the others. Workers batch events: once an event arrives
+they wait up to WEBHOOK_BATCH_INTERVAL_MS for more, up to WEBHOOK_BATCH_SIZE,
+and POST them together as
+
+    {"events": [{"event": "alert.opened", "alert": {...}, "sent_at": "..."}, ...]}
+
+Failed deliveries (connection errors, timeouts, 429 and 5xx) are retried with
+exponential backoff and jitter, honouring Retry-After. Other 4xx responses are
+not retried. When WEBHOOK_SECRET is set, each body is signed with HMAC-SHA256
+in the X-Greenhouse-Signature header (`sha256=<hex>`).
+
+Enabled by setting WEBHOOK_URLS (comma-separated). benchmarks/webhook_sink.py
+is a local HTTP sink for trying it out.
+"""
+import asyncio
+import hashlib
+import hmac
+import json
+import logging
+import os
+import random
+from collections import deque
+from datetime import datetime
+from typing import Dict, List, Optional
+
+import httpx
+
+from services import metrics, tracing
+
+logger = logging.getLogger(__name__)
+
+WEBHOOK_URLS = [url.strip() for url in os.getenv("WEBHOOK_URLS", "").split(",") if url.strip()]
+WEBHOOK_SECRET = os.getenv("WEBHOOK_SECRET", "")
+WEBHOOK_BATCH_SIZE = int(os.getenv("WEBHOOK_BATCH_SIZE", "20"))
+WEBHOOK_BATCH_INTERVAL_MS = int(os.getenv("WEBHOOK_BATCH_INTERVAL_MS", "1000"))
+WEBHOOK_MAX_ATTEMPTS = int(os.getenv("WEBHOOK_MAX_ATTEMPTS", "6"))
+WEBHOOK_TIMEOUT_SECONDS = float(os.getenv("WEBHOOK_TIMEOUT_SECONDS", "5"))
+# Undelivered events kept per endpoint; the oldest are dropped beyond this
+WEBHOOK_QUEUE_SIZE = int(os.getenv("WEBHOOK_QUEUE_SIZE", "1000"))
+
+# Backoff between attempts: 1s, 2s, 4s, ... capped at 60s, +/-20% jitter
+RETRY_BASE_SECONDS = 1.0
+RETRY_MAX_SECONDS = 60.0
+# Time allowed at shutdown to flush queued events
+SHUTDOWN_FLUSH_SECONDS = 5.0
+
+
+class WebhookEndpoint:
+    """Queue and delivery worker for one webhook URL."""
+
+    def __init__(self, url: str, queue_size: int = WEBHOOK_QUEUE_SIZE):
+        self.url = url
+        self.queue: deque = deque(maxlen=queue_size)
+        self.dropped = 0
+        self._event = asyncio.Event()
+        self._task: Optional[asyncio.Task] = None
+
+    def offer(self, event: Dict):
+        if len(self.queue) == self.queue.maxlen:
+            self.dropped += 1
+            metrics.WEBHOOK_DROPPED.inc()
+        self.queue.append(event)
+        self._event.set()
+
+    async def run(self, client: httpx.AsyncClient, dispatcher: "WebhookDispatcher"):
+        while True:
+            await self._event.wait()
+            if len(self.queue) < dispatcher.batch_size:
+                # Give related transitions a moment to join the batch
+                await asyncio.sleep(dispatcher.batch_interval)
+            self._event.clear()
+            while self.queue:
+                batch = [self.queue.popleft() for _ in range(min(dispatcher.batch_size, len(self.queue)))]
+                await dispatcher.deliver(client, self.url, batch)
+
+
+class WebhookDispatcher:
+    """Fans alert events out to the configured webhook endpoints."""
+
+    def __init__(
+        self,
+        urls: List[str],
+        secret: str = WEBHOOK_SECRET,
+        batch_size: int = WEBHOOK_BATCH_SIZE,
+        batch_interval_ms: int = WEBHOOK_BATCH_INTERVAL_MS,
+        max_attempts: int = WEBHOOK_MAX_ATTEMPTS
+    ):
+        self.urls = urls
+        self.secret = secret.encode() if secret else b""
+        self.batch_size = max(1, batch_size)
+        self.batch_interval = batch_interval_ms / 1000.0
+        self.max_attempts = max(1, max_attempts)
+        self.endpoints: List[WebhookEndpoint] = []
+        self._loop: Optional[asyncio.AbstractEventLoop] = None
+        self._client: Optional[httpx.AsyncClient] = None
+
+    async def start(self):
+        """Start one delivery worker per endpoint. Must be called from the event loop."""
+        self._loop = asyncio.get_running_loop()
+        self._client = httpx.AsyncClient(timeout=httpx.Timeout(WEBHOOK_TIMEOUT_SECONDS), transport=tracing.http_transport())
+        self.endpoints = [WebhookEndpoint(url) for url in self.urls]
+        for endpoint in self.endpoints:
+            endpoint._task = asyncio.create_task(endpoint.run(self._client, self))
+
+    async def stop(self):
+        """Flush what can be sent within SHUTDOWN_FLUSH_SECONDS, then stop the workers."""
+        deadline = self._loop.time() + SHUTDOWN_FLUSH_SECONDS
+        while any(endpoint.queue for endpoint in self.endpoints) and self._loop.time() < deadline:
+            await asyncio.sleep(0.1)
+        for endpoint in self.endpoints:
+            endpoint._task.cancel()
+        await asyncio.gather(*(endpoint._task for endpoint in self.endpoints), return_exceptions=True)
+        await self._client.aclose()
+        self._loop = None
+
+    @property
+    def queue_depth(self) -> int:
+        return sum(len(endpoint.queue) for endpoint in self.endpoints)
+
+    def enqueue(self, event_type: str, payload: Dict):
+        """Queue an event for every endpoint. Safe to call from any thread."""
+        loop = self._loop
+        if loop is None or loop.is_closed():
+            return
+        event = {"event": event_type, "alert": payload, "sent_at": datetime.utcnow().isoformat()}
+        try:
+            running = asyncio.get_running_loop()
+        except RuntimeError:
+            running = None
+        if running is loop:
+            self._offer(event)
+        else:
+            loop.call_soon_threadsafe(self._offer, event)
+
+    def _offer(self, event: Dict):
+        for endpoint in self.endpoints:
+            endpoint.offer(event)
+
+    def sign(self, body: bytes) -> str:
+        return "sha256=" + hmac.new(self.secret, body, hashlib.sha256).hexdigest()
+
+    async def deliver(self, client: httpx.AsyncClient, url: str, batch: List[Dict]) -> bool:
+        """POST a batch, retrying transient failures. Returns True once delivered."""
+        body = json.dumps({"events": batch}).encode()
+        headers = {"Content-Type": "application/json", "X-Greenhouse-Event-Count": str(len(batch))}
+        if self.secret:
+            headers["X-Greenhouse-Signature"] = self.sign(body)
+
+        for attempt in range(1, self.max_attempts + 1):
+            retry_after = None
+            try:
+                response = await client.post(url, content=body, headers=headers)
+                if response.status_code < 300:
+                    metrics.WEBHOOK_DELIVERED.inc(len(batch))
+                    return True
+                if response.status_code != 429 and response.status_code < 500:
+                    logger.error(f"Webhook {url} rejected {len(batch)} event(s): HTTP {response.status_code}")
+                    metrics.WEBHOOK_FAILED.inc(len(batch))
+                    return False
+                reason = f"HTTP {response.status_code}"
+                retry_after = _parse_retry_after(response.headers.get("Retry-After"))
+            except httpx.HTTPError as e:
+                reason = type(e).__name__
+
+            if attempt == self.max_attempts:
+                break
+            delay = retry_after if retry_after is not None else min(
+                RETRY_MAX_SECONDS, RETRY_BASE_SECONDS * 2 ** (attempt - 1)
+            ) * random.uniform(0.8, 1.2)
+            metrics.WEBHOOK_RETRIED.inc()
+            logger.warning(f"Webhook {url} failed ({reason}), retry {attempt}/{self.max_attempts - 1} in {delay:.1f}s")
+            await asyncio.sleep(delay)
+
+        logger.error(f"Webhook {url} failed after {self.max_attempts} attempts; {len(batch)} event(s) lost")
+        metrics.WEBHOOK_FAILED.inc(len(batch))
+        return False
+
+
+def _parse_retry_after(value: Optional[str]) -> Optional[float]:
+    try:
+        return min(RETRY_MAX_SECONDS, max(0.0, float(value)))
+    except (TypeError, ValueError):
+        return None
+
+
+# Process-wide dispatcher (started at startup when WEBHOOK_URLS is set)
+webhook_dispatcher = WebhookDispatcher(WEBHOOK_URLS)
+
+
+async def start_webhook_dispatcher():
+    """Start webhook delivery if any URLs are configured."""
+    if not webhook_dispatcher.urls:
+        return
+    await webhook_dispatcher.start()
+    logger.info(f"Webhook delivery enabled for {len(webhook_dispatcher.urls)} endpoint(s)")
+
+
+async def stop_webhook_dispatcher():
+    """Flush and stop webhook delivery."""
+    if webhook_dispatcher._loop is not None:
+        await webhook_dispatcher.stop()
@@ -0,0 +1,661 @@
+"""Zone hierarchy (greenhouse -> bay -> bench) with aggregates maintained at ingest.
+
+A node may be assigned to one zone. Each reading from an assigned node updates,
+for its zone and every zone above it:
+- the zone's latest snapshot, which holds the newest reading of each member node
+  and running sums over them. GET /api/zones/{id}/latest needs no query.
+- the current time bucket of the zone's rollup: a count, plus sum, min and max
+  per metric.
+
+Rollup buckets are summed in memory and merged into the zone_rollups table every
+ZONE_ROLLUP_FLUSH_SECONDS by a background task. The merge is an additive upsert,
+so worker processes sharing a database add to the same rows. Zone history and
+insights read these rows, plus buckets not yet flushed, instead of scanning the
+readings of every member node.
+
+A reading only counts towards the zones its node belongs to when it is stored.
+After nodes with existing history are assigned, POST /api/zones/{id}/rebuild
+recomputes a zone subtree's rollups from the raw readings.
+
+The hierarchy is cached in memory. This process reloads it after every change
+made through the API; other worker processes load it at startup.
+"""
+import asyncio
+import itertools
+import logging
+import math
+import os
+import threading
+from dataclasses import dataclass, field
+from datetime import datetime, timedelta
+from typing import Dict, List, Optional, Sequence, Tuple
+from sqlalchemy import func
+from sqlalchemy.orm import Session
+from models.database import SensorNode, SensorReading, SessionLocal, Zone, ZoneRollup
+from models.ingest import IngestReading
+from models.measurements import MEASUREMENT_SCALE, from_centi, to_centi
+from services import reading_store, tracing
+
+logger = logging.getLogger(__name__)
+
+# Levels of the hierarchy, outermost first; a zone's parent is one level up
+ZONE_KINDS = ("greenhouse", "bay", "bench")
+ZONE_METRICS = ("temperature", "humidity", "soil_moisture")
+
+ZONE_ROLLUP_BUCKET_SECONDS = int(os.getenv("ZONE_ROLLUP_BUCKET_SECONDS", "300"))
+ZONE_ROLLUP_FLUSH_SECONDS = float(os.getenv("ZONE_ROLLUP_FLUSH_SECONDS", "10"))
+
+_EPOCH = datetime(1970, 1, 1)
+# Reading columns used for snapshots and rollups
+_LATEST_COLUMNS = ("node_id", "timestamp") + ZONE_METRICS
+
+
+class ZoneError(ValueError):
+    """Raised when a zone change would break the hierarchy."""
+
+
+@dataclass(slots=True)
+class ZoneInfo:
+    """One zone of the cached hierarchy."""
+    zone_id: str
+    name: Optional[str]
+    kind: str
+    parent_id: Optional[str]
+
+
+@dataclass(slots=True)
+class Aggregate:
+    """Count, sum, min and max of each metric over a set of readings."""
+    readings: int = 0
+    sums: List[float] = field(default_factory=lambda: [0.0] * len(ZONE_METRICS))
+    mins: List[float] = field(default_factory=lambda: [math.inf] * len(ZONE_METRICS))
+    maxs: List[float] = field(default_factory=lambda: [-math.inf] * len(ZONE_METRICS))
+
+    def add(self, values: Sequence[float]):
+        self.readings += 1
+        for i, value in enumerate(values):
+            self.sums[i] += value
+            if value < self.mins[i]:
+                self.mins[i] = value
+            if value > self.maxs[i]:
+                self.maxs[i] = value
+
+    def merge(self, other: "Aggregate"):
+        self.readings += other.readings
+        for i in range(len(ZONE_METRICS)):
+            self.sums[i] += other.sums[i]
+            self.mins[i] = min(self.mins[i], other.mins[i])
+            self.maxs[i] = max(self.maxs[i], other.maxs[i])
+
+    def row(self, zone_id: str, bucket_start: datetime) -> Dict:
+        """Values of a zone_rollups row."""
+        row = {"zone_id": zone_id, "bucket_start": bucket_start, "readings": self.readings}
+        for i, metric in enumerate(ZONE_METRICS):
+            row[f"{metric}_sum"] = self.sums[i]
+            row[f"{metric}_min"] = self.mins[i]
+            row[f"{metric}_max"] = self.maxs[i]
+        return row
+
+    @classmethod
+    def from_row(cls, row: ZoneRollup) -> "Aggregate":
+        return cls(
+            row.readings,
+            [getattr(row, f"{metric}_sum") for metric in ZONE_METRICS],
+            [getattr(row, f"{metric}_min") for metric in ZONE_METRICS],
+            [getattr(row, f"{metric}_max") for metric in ZONE_METRICS],
+        )
+
+    def stats(self) -> Dict[str, Dict[str, float]]:
+        """{metric: {"avg", "min", "max"}} (empty if there are no readings)."""
+        if not self.readings:
+            return {}
+        return {
+            metric: {
+                "avg": round(self.sums[i] / self.readings, 2),
+                "min": round(self.mins[i], 2),
+                "max": round(self.maxs[i], 2),
+            }
+            for i, metric in enumerate(ZONE_METRICS)
+        }
+
+
+@dataclass(slots=True)
+class ZoneLatest:
+    """Newest reading of each member node, with running sums for the zone average.
+
+    Values are centi-units (models/measurements.py), so the sums stay exact
+    however often members are replaced.
+    """
+    members: Dict[str, Tuple[float, Tuple[int, ...]]] = field(default_factory=dict)  # node_id -> (epoch s, values)
+    sums: List[int] = field(default_factory=lambda: [0] * len(ZONE_METRICS))
+
+    def update(self, node_id: str, ts: float, values: Tuple[int, ...]):
+        previous = self.members.get(node_id)
+        if previous is not None:
+            if previous[0] > ts:
+                return
+            for i, value in enumerate(previous[1]):
+                self.sums[i] -= value
+        for i, value in enumerate(values):
+            self.sums[i] += value
+        self.members[node_id] = (ts, values)
+
+    def remove(self, node_id: str):
+        previous = self.members.pop(node_id, None)
+        if previous is not None:
+            for i, value in enumerate(previous[1]):
+                self.sums[i] -= value
+
+
+@dataclass
+class ZoneSnapshot:
+    """Current state of a zone from its members' newest readings."""
+    zone_id: str
+    nodes_reporting: int
+    metrics: Dict[str, Dict[str, float]]
+    newest_reading: datetime
+    oldest_reading: datetime
+
+
+@dataclass(slots=True)
+class BucketReading:
+    """Bucket averages shaped like a SensorReading, for the trend detectors."""
+    timestamp: datetime
+    temperature: float
+    humidity: float
+    soil_moisture: float
+
+
+class ZoneTree:
+    """Immutable view of the hierarchy and of which zones each node counts towards."""
+
+    def __init__(self, zones: Dict[str, ZoneInfo], node_zones: Dict[str, str]):
+        self.zones = zones
+        self.node_zones = node_zones
+        self.children: Dict[str, List[str]] = {zone_id: [] for zone_id in zones}
+        for zone in zones.values():
+            if zone.parent_id in self.children:
+                self.children[zone.parent_id].append(zone.zone_id)
+        # Zone followed by its ancestors, innermost first
+        self.chains: Dict[str, Tuple[str, ...]] = {}
+        for zone_id in zones:
+            chain = []
+            current = zone_id
+            while current in zones and current not in chain:
+                chain.append(current)
+                current = zones[current].parent_id
+            self.chains[zone_id] = tuple(chain)
+        self.node_chains: Dict[str, Tuple[str, ...]] = {
+            node_id: self.chains[zone_id] for node_id, zone_id in node_zones.items() if zone_id in self.chains
+        }
+
+    def chain(self, node_id: str) -> Tuple[str, ...]:
+        """Zones a node's readings count towards (its zone and all ancestors)."""
+        return self.node_chains.get(node_id, ())
+
+    def subtree(self, zone_id: str) -> List[str]:
+        """A zone and every zone below it."""
+        zones, stack = [], [zone_id]
+        while stack:
+            current = stack.pop()
+            zones.append(current)
+            stack.extend(self.children.get(current, ()))
+        return zones
+
+    def members(self, zone_id: str) -> List[str]:
+        """Nodes assigned to a zone or to any zone below it."""
+        return [node_id for node_id, chain in self.node_chains.items() if zone_id in chain]
+
+
+def _epoch_seconds(timestamp: datetime) -> float:
+    return (timestamp - _EPOCH).total_seconds()
+
+
+class ZoneAggregator:
+    """Maintains latest snapshots and time-bucketed rollups for every zone."""
+
+    def __init__(self, bucket_seconds: int = ZONE_ROLLUP_BUCKET_SECONDS):
+        self.bucket_seconds = bucket_seconds
+        self.tree = ZoneTree({}, {})
+        self._latest: Dict[str, ZoneLatest] = {}
+        self._pending: Dict[Tuple[str, float], Aggregate] = {}
+        self._lock = threading.Lock()
+        self._task: Optional[asyncio.Task] = None
+
+    @property
+    def pending_buckets(self) -> int:
+        return len(self._pending)
+
+    def _bucket(self, ts: float) -> float:
+        return ts - ts % self.bucket_seconds
+
+    # --- Hierarchy ---------------------------------------------------------------
+
+    def reload(self, db: Session) -> ZoneTree:
+        """Re-read zones and node assignments; drop nodes that left a zone from its snapshot."""
+        zones = {
+            zone.zone_id: ZoneInfo(zone.zone_id, zone.name, zone.kind, zone.parent_id)
+            for zone in db.query(Zone)
+        }
+        node_zones = dict(
+            db.query(SensorNode.node_id, SensorNode.zone_id).filter(SensorNode.zone_id.isnot(None))
+        )
+        tree = ZoneTree(zones, node_zones)
+        with self._lock:
+            self.tree = tree
+            for zone_id in list(self._latest):
+                if zone_id not in zones:
+                    del self._latest[zone_id]
+                    continue
+                latest = self._latest[zone_id]
+                for node_id in [n for n in latest.members if zone_id not in tree.chain(n)]:
+                    latest.remove(node_id)
+        return tree
+
+    def load(self, db: Session) -> int:
+        """Load the hierarchy and seed latest snapshots from each assigned node's newest reading."""
+        tree = self.reload(db)
+        if not tree.node_chains:
+            return 0
+        newest = db.query(
+            SensorReading.node_key, func.max(SensorReading.timestamp).label("timestamp")
+        ).filter(SensorReading.node_id.in_(list(tree.node_chains))).group_by(SensorReading.node_key).subquery()
+        rows = db.query(
+            SensorReading.node_id, SensorReading.timestamp,
+            SensorReading.temperature, SensorReading.humidity, SensorReading.soil_moisture
+        ).join(
+            newest, (SensorReading.node_key == newest.c.node_key) & (SensorReading.timestamp == newest.c.timestamp)
+        ).all()
+        # Nodes silent since before the compaction horizon have their newest reading in a block
+        for node_id in set(tree.node_chains) - {row[0] for row in rows}:
+            rows.extend(reading_store.latest_block_rows(db, 1, node_ids=node_id, columns=_LATEST_COLUMNS))
+        with self._lock:
+            for node_id, timestamp, *values in rows:
+                centi = tuple(to_centi(value) for value in values)
+                for zone_id in tree.chain(node_id):
+                    self._latest.setdefault(zone_id, ZoneLatest()).update(node_id, _epoch_seconds(timestamp), centi)
+        return len(tree.zones)
+
+    # --- Ingest ------------------------------------------------------------------
+
+    def observe(self, reading: IngestReading, timestamp: datetime):
+        """Add a stored reading to the snapshots and rollups of its node's zones."""
+        chain = self.tree.chain(reading.node_id)
+        if not chain:
+            return
+        ts = _epoch_seconds(timestamp)
+        bucket = self._bucket(ts)
+        values = (reading.temperature, reading.humidity, reading.soil_moisture)
+        centi = (to_centi(reading.temperature), to_centi(reading.humidity), to_centi(reading.soil_moisture))
+        with self._lock:
+            for zone_id in chain:
+                aggregate = self._pending.get((zone_id, bucket))
+                if aggregate is None:
+                    aggregate = self._pending[(zone_id, bucket)] = Aggregate()
+                aggregate.add(values)
+                latest = self._latest.get(zone_id)
+                if latest is None:
+                    latest = self._latest[zone_id] = ZoneLatest()
+                latest.update(reading.node_id, ts, centi)
+
+    # --- Queries -----------------------------------------------------------------
+
+    def latest(self, zone_id: str) -> Optional[ZoneSnapshot]:
+        """Current zone averages (and spread) over the newest reading of each member node."""
+        with self._lock:
+            latest = self._latest.get(zone_id)
+            if latest is None or not latest.members:
+                return None
+            count = len(latest.members)
+            sums = list(latest.sums)
+            members = list(latest.members.values())
+
+        stats = {}
+        for i, metric in enumerate(ZONE_METRICS):
+            values = [member[1][i] for member in members]
+            stats[metric] = {
+                "avg": round(sums[i] / count / MEASUREMENT_SCALE, 2),
+                "min": from_centi(min(values)),
+                "max": from_centi(max(values)),
+            }
+        times = [member[0] for member in members]
+        return ZoneSnapshot(
+            zone_id=zone_id,
+            nodes_reporting=count,
+            metrics=stats,
+            newest_reading=_EPOCH + timedelta(seconds=max(times)),
+            oldest_reading=_EPOCH + timedelta(seconds=min(times)),
+        )
+
+    def history(
+        self,
+        db: Session,
+        zone_id: str,
+        start: datetime,
+        end: Optional[datetime] = None,
+        resolution_seconds: Optional[int] = None
+    ) -> List[Tuple[datetime, Aggregate]]:
+        """Zone aggregates per time bucket, oldest first.
+
+        Args:
+            db: Database session
+            zone_id: Zone to read
+            start: Start of the window (rounded down to a bucket)
+            end: End of the window (default: now)
+            resolution_seconds: Width of the returned buckets; rounded to a multiple
+                of ZONE_ROLLUP_BUCKET_SECONDS (default: one rollup bucket)
+        """
+        step = max(1, round((resolution_seconds or self.bucket_seconds) / self.bucket_seconds)) * self.bucket_seconds
+        start_ts = self._bucket(_epoch_seconds(start))
+        end_ts = _epoch_seconds(end or datetime.utcnow())
+
+        combined: Dict[float, Aggregate] = {}
+
+        def add(ts: float, aggregate: Aggregate):
+            key = ts - ts % step
+            target = combined.get(key)
+            if target is None:
+                target = combined[key] = Aggregate()
+            target.merge(aggregate)
+
+        rows = db.query(ZoneRollup).filter(
+            ZoneRollup.zone_id == zone_id,
+            ZoneRollup.bucket_start >= _EPOCH + timedelta(seconds=start_ts),
+            ZoneRollup.bucket_start <= _EPOCH + timedelta(seconds=end_ts)
+        ).all()
+        for row in rows:
+            add(_epoch_seconds(row.bucket_start), Aggregate.from_row(row))
+        with self._lock:
+            pending = [
+                (bucket, aggregate) for (pending_zone, bucket), aggregate in self._pending.items()
+                if pending_zone == zone_id and start_ts <= bucket <= end_ts
+            ]
+            for bucket, aggregate in pending:
+                add(bucket, aggregate)
+        return [(_EPOCH + timedelta(seconds=ts), combined[ts]) for ts in sorted(combined)]
+
+    # --- Maintenance -------------------------------------------------------------
+
+    def rebuild(self, db: Session, zone_id: str, since: datetime) -> int:
+        """Recompute the rollups of a zone and the zones below it from raw readings.
+
+        Covers complete buckets from `since` up to the current bucket, using the
+        current node assignments. The current bucket keeps accumulating at ingest.
+
+        Returns:
+            Number of rollup rows written
+        """
+        tree = self.tree
+        zones = tree.subtree(zone_id)
+        zone_set = set(zones)
+        start_ts = self._bucket(_epoch_seconds(since))
+        cutoff_ts = self._bucket(_epoch_seconds(datetime.utcnow()))
+        start, cutoff = _EPOCH + timedelta(seconds=start_ts), _EPOCH + timedelta(seconds=cutoff_ts)
+
+        # Unflushed buckets in the range are superseded by the recomputation
+        with self._lock:
+            for key in [k for k in self._pending if k[0] in zone_set and start_ts <= k[1] < cutoff_ts]:
+                del self._pending[key]
+
+        buckets: Dict[Tuple[str, float], Aggregate] = {}
+        members = tree.members(zone_id)
+        if members:
+            rows = db.query(
+                SensorReading.node_id, SensorReading.timestamp,
+                SensorReading.temperature, SensorReading.humidity, SensorReading.soil_moisture
+            ).filter(
+                SensorReading.node_id.in_(members),
+                SensorReading.timestamp >= start,
+                SensorReading.timestamp < cutoff
+            ).yield_per(10000)
+            compacted = reading_store.block_rows(db, _LATEST_COLUMNS, since=start, until=cutoff, node_ids=members)
+            for node_id, timestamp, *values in itertools.chain(compacted, rows):
+                bucket = self._bucket(_epoch_seconds(timestamp))
+                for chain_zone in tree.chain(node_id):
+                    if chain_zone in zone_set:
+                        aggregate = buckets.get((chain_zone, bucket))
+                        if aggregate is None:
+                            aggregate = buckets[(chain_zone, bucket)] = Aggregate()
+                        aggregate.add(values)
+
+        db.query(ZoneRollup).filter(
+            ZoneRollup.zone_id.in_(zones),
+            ZoneRollup.bucket_start >= start,
+            ZoneRollup.bucket_start < cutoff
+        ).delete(synchronize_session=False)
+        if buckets:
+            db.execute(ZoneRollup.__table__.insert(), [
+                aggregate.row(bucket_zone, _EPOCH + timedelta(seconds=bucket))
+                for (bucket_zone, bucket), aggregate in buckets.items()
+            ])
+        db.commit()
+        logger.info(f"Rebuilt {len(buckets)} rollup bucket(s) for zone {zone_id} and {len(zones) - 1} zone(s) below it")
+        return len(buckets)
+
+    async def start(self):
+        """Start the periodic rollup flush. Must be called from the event loop."""
+        self._task = asyncio.create_task(self._run())
+
+    async def stop(self):
+        """Stop the flush task and write out pending buckets."""
+        if self._task is None:
+            return
+        self._task.cancel()
+        await asyncio.gather(self._task, return_exceptions=True)
+        self._task = None
+        await self.flush()
+
+    async def _run(self):
+        while True:
+            await asyncio.sleep(ZONE_ROLLUP_FLUSH_SECONDS)
+            await self.flush()
+
+    async def flush(self):
+        """Merge pending buckets into zone_rollups (off the event loop)."""
+        with self._lock:
+            batch, self._pending = self._pending, {}
+        if not batch:
+            return
+        if not await asyncio.to_thread(self._persist, batch):
+            # Keep the sums for the next attempt
+            with self._lock:
+                for key, aggregate in batch.items():
+                    existing = self._pending.get(key)
+                    if existing is None:
+                        self._pending[key] = aggregate
+                    else:
+                        existing.merge(aggregate)
+
+    @staticmethod
+    def _persist(batch: Dict[Tuple[str, float], Aggregate]) -> bool:
+        db = SessionLocal()
+        try:
+            # Additive upsert; both dialects support ON CONFLICT DO UPDATE
+            if db.bind.dialect.name == "postgresql":
+                from sqlalchemy.dialects.postgresql import insert
+                smaller, larger = func.least, func.greatest
+            else:
+                from sqlalchemy.dialects.sqlite import insert
+                smaller, larger = func.min, func.max
+            table = ZoneRollup.__table__
+            statement = insert(table)
+            excluded = statement.excluded
+            updates = {"readings": table.c.readings + excluded.readings}
+            for metric in ZONE_METRICS:
+                updates[f"{metric}_sum"] = table.c[f"{metric}_sum"] + excluded[f"{metric}_sum"]
+                updates[f"{metric}_min"] = smaller(table.c[f"{metric}_min"], excluded[f"{metric}_min"])
+                updates[f"{metric}_max"] = larger(table.c[f"{metric}_max"], excluded[f"{metric}_max"])
+            statement = statement.on_conflict_do_update(index_elements=["zone_id", "bucket_start"], set_=updates)
+            db.execute(statement, [
+                aggregate.row(zone_id, _EPOCH + timedelta(seconds=bucket))
+                for (zone_id, bucket), aggregate in batch.items()
+            ])
+            db.commit()
+            return True
+        except Exception as e:
+            db.rollback()
+            logger.error(f"Could not flush {len(batch)} zone rollup bucket(s): {str(e)}", exc_info=True)
+            return False
+        finally:
+            db.close()
+
+
+@tracing.traced
+class ZoneService:
+    """Zone hierarchy changes and node assignment."""
+
+    @staticmethod
+    def get_zone(db: Session, zone_id: str) -> Optional[Zone]:
+        return db.query(Zone).filter(Zone.zone_id == zone_id).first()
+
+    @staticmethod
+    def create_zone(db: Session, zone_id: str, kind: str, name: Optional[str] = None, parent_id: Optional[str] = None) -> Zone:
+        """Create a zone one level below its parent (greenhouses have no parent).
+
+        Raises:
+            ZoneError: If the id is taken, or the kind does not fit below the parent
+        """
+        if kind not in ZONE_KINDS:
+            raise ZoneError(f"Unknown zone kind '{kind}'. Expected one of: {', '.join(ZONE_KINDS)}")
+        if ZoneService.get_zone(db, zone_id):
+            raise ZoneError(f"Zone {zone_id} already exists")
+        level = ZONE_KINDS.index(kind)
+        if parent_id is None:
+            if level != 0:
+                raise ZoneError(f"A {kind} needs a parent {ZONE_KINDS[level - 1]}")
+        else:
+            parent = ZoneService.get_zone(db, parent_id)
+            if parent is None:
+                raise ZoneError(f"Parent zone {parent_id} not found")
+            if level == 0 or parent.kind != ZONE_KINDS[level - 1]:
+                raise ZoneError(f"A {kind} cannot be placed in a {parent.kind}")
+
+        zone = Zone(zone_id=zone_id, name=name or zone_id, kind=kind, parent_id=parent_id)
+        db.add(zone)
+        db.commit()
+        db.refresh(zone)
+        zone_aggregator.reload(db)
+        logger.info(f"Created {kind} zone {zone_id}" + (f" in {parent_id}" if parent_id else ""))
+        return zone
+
+    @staticmethod
+    def delete_zone(db: Session, zone_id: str) -> bool:
+        """Delete an empty leaf zone and its rollups. Returns False if it does not exist.
+
+        Raises:
+            ZoneError: If the zone still has child zones or nodes
+        """
+        zone = ZoneService.get_zone(db, zone_id)
+        if zone is None:
+            return False
+        if db.query(Zone).filter(Zone.parent_id == zone_id).first():
+            raise ZoneError(f"Zone {zone_id} has child zones; delete them first")
+        if db.query(SensorNode).filter(SensorNode.zone_id == zone_id).first():
+            raise ZoneError(f"Zone {zone_id} has nodes assigned; move them first")
+        db.query(ZoneRollup).filter(ZoneRollup.zone_id == zone_id).delete(synchronize_session=False)
+        db.delete(zone)
+        db.commit()
+        zone_aggregator.reload(db)
+        logger.info(f"Deleted zone {zone_id}")
+        return True
+
+    @staticmethod
+    def assign_nodes(db: Session, zone_id: Optional[str], node_ids: Sequence[str]) -> List[str]:
+        """Move nodes into a zone (None removes them from any zone).
+
+        The zone snapshots pick up each node's newest stored reading. Only
+        readings stored from now on count towards the rollups; use
+        ZoneAggregator.rebuild to include their history.
+
+        Returns:
+            The node ids that exist and were assigned
+        """
+        nodes = db.query(SensorNode).filter(SensorNode.node_id.in_(list(node_ids))).all()
+        for node in nodes:
+            node.zone_id = zone_id
+        db.commit()
+        zone_aggregator.load(db)
+        return [node.node_id for node in nodes]
+
+    @staticmethod
+    def analyze(db: Session, zone_id: str, minutes: int = 60) -> Dict:
+        """Trend insights for a zone from its rollup buckets.
+
+        Runs the drought, overwatering and temperature detectors of
+        TrendInsightService on bucket averages. Sensor-failure checks are per
+        node and are left to GET /api/ai/insights?node_id=.
+        """
+        # Imported here: the trend detectors read their limits from the rule
+        # engine, which imports this module for zone-scoped rules
+        from services.trend_insights_service import TrendInsightService
+
+        buckets = zone_aggregator.history(db, zone_id, datetime.utcnow() - timedelta(minutes=minutes))
+        readings = [
+            BucketReading(bucket_start, *(aggregate.sums[i] / aggregate.readings for i in range(len(ZONE_METRICS))))
+            for bucket_start, aggregate in buckets
+        ]
+        insights = []
+        if readings:
+            for detector in (
+                TrendInsightService.detect_drought_risk,
+                TrendInsightService.detect_overwatering_risk,
+                TrendInsightService.detect_temperature_stress,
+            ):
+                insight = detector(readings)
+                if insight:
+                    insights.append(insight)
+        overall_risk_level, summary = TrendInsightService.summarize(insights)
+        return {
+            "zone_id": zone_id,
+            "insights": insights,
+            "overall_risk_level": overall_risk_level,
+            "summary": summary,
+            "analysis_period_minutes": minutes,
+            "readings_analyzed": sum(aggregate.readings for _, aggregate in buckets),
+        }
+
+    @staticmethod
+    def list_zones(db: Session) -> List[Dict]:
+        """All zones with their direct and total member node counts, outermost first."""
+        tree = zone_aggregator.reload(db)
+        direct: Dict[str, int] = {}
+        for zone_id in tree.node_zones.values():
+            direct[zone_id] = direct.get(zone_id, 0) + 1
+        total: Dict[str, int] = {}
+        for chain in tree.node_chains.values():
+            for zone_id in chain:
+                total[zone_id] = total.get(zone_id, 0) + 1
+        zones = sorted(tree.zones.values(), key=lambda z: (len(tree.chains[z.zone_id]), z.zone_id))
+        return [
+            {
+                "zone_id": zone.zone_id,
+                "name": zone.name,
+                "kind": zone.kind,
+                "parent_id": zone.parent_id,
+                "children": sorted(tree.children[zone.zone_id]),
+                "direct_nodes": direct.get(zone.zone_id, 0),
+                "total_nodes": total.get(zone.zone_id, 0),
+            }
+            for zone in zones
+        ]
+
+
+# Process-wide aggregator fed by the ingest pipeline
+zone_aggregator = ZoneAggregator()
+
+
+async def start_zone_aggregator():
+    """Load the hierarchy and latest member readings, then start flushing rollups."""
+    db = SessionLocal()
+    try:
+        count = zone_aggregator.load(db)
+    finally:
+        db.close()
+    await zone_aggregator.start()
+    if count:
+        logger.info(f"Zone rollups active for {count} zone(s)")
+
+
+async def stop_zone_aggregator():
+    """Stop the flush task and write out pending rollup buckets."""
+    await zone_aggregator.stop()